@@ -62,14 +62,19 @@ namespace PMGD {
         void remove_property(StringID name);
     };
 
+    // Light edges read as having no properties.
     inline bool EdgeRef::check_property(StringID id, Property &result) const
-        { return edge()->check_property(id, result); }
+        { return !is_light() && edge()->check_property(id, result); }
     inline Property EdgeRef::get_property(StringID id) const
-        { return edge()->get_property(id); }
+    {
+        if (is_light())
+            throw PMGDException(PropertyNotFound);
+        return edge()->get_property(id);
+    }
     inline PropertyIterator EdgeRef::get_properties() const
-        { return edge()->get_properties(); }
+        { return is_light() ? PropertyIterator(NULL) : edge()->get_properties(); }
     inline void EdgeRef::set_property(StringID id, const Property &property)
-        { return edge()->set_property(id, property); }
+        { return record()->set_property(id, property); }
     inline void EdgeRef::remove_property(StringID id)
-        { return edge()->remove_property(id); }
+        { if (!is_light()) edge()->remove_property(id); }
 };
@@ -56,6 +56,10 @@ namespace PMGD {
 
         InvalidID,
 
+        LightEdgeMismatch,
+        EdgeOrderMismatch,
+        NotUnique,
+
         InternalErrorBase = 100,
         NotImplemented,
         PropertyTypeInvalid,
@@ -187,6 +187,13 @@ namespace PMGD {
                 case PropertyPredicate::Ge: r = val >= _pp.v1; break;
                 case PropertyPredicate::Lt: r = val < _pp.v1; break;
                 case PropertyPredicate::Le: r = val <= _pp.v1; break;
+                case PropertyPredicate::Prefix:
+                    {
+                        const std::string &prefix = _pp.v1.string_value();
+                        r = val.type() == PropertyType::String
+                            && val.string_value().compare(0, prefix.size(), prefix) == 0;
+                    }
+                    break;
                 case PropertyPredicate::GeLe: r = val >= _pp.v1 && val <= _pp.v2; break;
                 case PropertyPredicate::GeLt: r = val >= _pp.v1 && val < _pp.v2; break;
                 case PropertyPredicate::GtLe: r = val > _pp.v1 && val <= _pp.v2; break;
@@ -47,10 +47,32 @@ namespace PMGD {
         friend class Allocator;
         GraphImpl *_impl;
 
+        // Removes an edge, leaving the adjacency of skip alone
+        void remove_edge(Edge &edge, const Node *skip);
+        void remove_edge(EdgeRef &edge, const Node *skip);
+        void remove_light_edge(Node &source, Node &destination, StringID tag,
+                               const Node *skip);
+        bool remove_edges(Node &node, size_t max_edges, bool own);
+        void remove_node(Node &node);
+        NodeIterator hide_removing(NodeIterator i);
+        EdgeIterator hide_removing(EdgeIterator i);
+
     public:
         // In case of msync, MsyncOnCommit is the default.
+        // Prefetch asks the kernel to read in the used part of each
+        // region before the constructor returns; WarmUp touches the
+        // index roots, node and edge tables from a background thread.
+        // The Persist options pick how updates are made durable,
+        // overriding the build default (PMOPT): the cache flush
+        // instruction on persistent memory, non-temporal stores for
+        // bulk copies, msync for regular files, or nothing at all.
         enum OpenOptions { ReadWrite = 0, Create = 1, ReadOnly = 2, NoMsync = 4,
-                           MsyncOnCommit = 8, AlwaysMsync = 12};
+                           MsyncOnCommit = 8, AlwaysMsync = 12,
+                           Prefetch = 16, WarmUp = 32,
+                           PersistDefault = 0, PersistMsync = 0x100,
+                           PersistClflush = 0x200, PersistClflushopt = 0x300,
+                           PersistClwb = 0x400, PersistNTStore = 0x500,
+                           PersistNone = 0x600, PersistMask = 0x700 };
 
         struct Config {
             struct AllocatorInfo {
@@ -72,6 +94,11 @@ namespace PMGD {
 
             unsigned num_allocators;
 
+            // Keep a persistent map of pages written since the last
+            // snapshot or delta export, to allow incremental backups.
+            // Once set, tracking stays on for the life of the graph.
+            bool track_dirty_pages;
+
             // The parameters below are DRAM-based parameters that can be
             // modified each time the graph is created/opened. The variables
             // above are PM-based parameters which are fixed once the graph
@@ -106,20 +133,160 @@ namespace PMGD {
 
         NodeIterator get_nodes();
         NodeIterator get_nodes(StringID tag);
-        NodeIterator get_nodes(StringID tag, const PropertyPredicate &, bool reverse = false);
+        // The iterator starts offset objects into the ones that match,
+        // in the order it would give them.
+        NodeIterator get_nodes(StringID tag, const PropertyPredicate &, bool reverse = false,
+                               size_t offset = 0);
+        // Objects that match all of the predicates. A composite index
+        // serves them if it can, or else the index for the first
+        // predicate that has one, and that index gives the order. The
+        // other predicates with an index narrow what it gives to the
+        // objects their indexes select too, before any object is
+        // read. Only the predicates without an index are checked one
+        // by one.
+        NodeIterator get_nodes(StringID tag, const std::vector<PropertyPredicate> &,
+                               bool reverse = false);
 
         EdgeIterator get_edges();
         EdgeIterator get_edges(StringID tag);
-        EdgeIterator get_edges(StringID tag, const PropertyPredicate &, bool reverse = false);
+        EdgeIterator get_edges(StringID tag, const PropertyPredicate &, bool reverse = false,
+                               size_t offset = 0);
+        EdgeIterator get_edges(StringID tag, const std::vector<PropertyPredicate> &,
+                               bool reverse = false);
+
+        // The number of objects that match. Like an offset, this takes
+        // O(log n) with a counted AVL index for the predicate, unless
+        // remove_partial has nodes to leave out, and walks the objects
+        // otherwise.
+        size_t count_nodes(StringID tag, const PropertyPredicate &);
+        size_t count_edges(StringID tag, const PropertyPredicate &);
 
         Node &add_node(StringID tag);
+        // The node with the tag whose property_id is value, or a new
+        // one with it if there is none. This needs a unique index for
+        // the tag or for tag 0 and the property; it throws InvalidID
+        // otherwise. The value is looked up, and its entry added if it
+        // is missing, in one descent of the index, and the lock taken
+        // there keeps other transactions from adding it too. The callback, if any,
+        // sees the node only if it is new.
+        // Through an index on tag 0, the value may belong to a node
+        // with another tag. That throws NotUnique, unless tag is 0.
+        Node &get_or_add_node(StringID tag, StringID property_id,
+                              const Property &value,
+                              std::function<void(Node &)> f = nullptr);
         Edge &add_edge(Node &source, Node &destination, StringID tag);
+
+        // Light edges are kept only in the adjacency of their ends,
+        // with no edge record. Node iterators give their tag and ends,
+        // but they have no id or properties, and get_edges does not
+        // list them. A tag has to be made light before it has edges
+        // or indexes. After that add_edge throws for the tag, and
+        // add_light_edge throws for any other tag.
+        void set_light_edges(StringID tag);
+        void add_light_edge(Node &source, Node &destination, StringID tag);
+
+        // Keeps the adjacency of each node for edges with the given tag
+        // ordered by an Integer or Time edge property, for window
+        // queries through Node::get_edges with a predicate. Edges
+        // without the property are left out of the order. Like light
+        // edges, this has to be set before the tag has edges.
+        void set_edge_order(StringID tag, StringID property_id,
+                            PropertyType ptype);
+
+        // Bulk insertion. Table slots are reserved in one step, and the
+        // adjacency and tag index updates are grouped by node and tag.
+        // The callback, if any, sees each new node or edge in order.
+        // Specs with a light tag are the exception: having no edge
+        // record, they are added one at a time through add_light_edge
+        // before the rest of the batch, and the callback never sees them.
+        struct EdgeSpec {
+            Node &source;
+            Node &destination;
+            StringID tag;
+        };
+        void add_nodes(StringID tag, size_t count,
+                       std::function<void(Node &)> f = nullptr);
+        void add_edges(const std::vector<EdgeSpec> &edges,
+                       std::function<void(Edge &)> f = nullptr);
         void remove(Node &node);
+        // Removes a node with too many edges for one transaction. Each
+        // call removes up to max_edges of them, and the node with the
+        // last ones, returning true once the node is gone. Call it in
+        // successive transactions until then. From the first commit,
+        // iterators leave out the node and its edges as if it were
+        // gone already.
+        bool remove_partial(Node &node, size_t max_edges);
         void remove(Edge &edge);
+        // Removes light edges too
+        void remove(EdgeRef &edge);
 
         enum IndexType { NodeIndex, EdgeIndex };
+
+        // How a property index keeps its values. An AVL tree has one
+        // value per tree node. A B+-tree packs them into page sized
+        // nodes with linked leaves, so range scans read the values in
+        // order from consecutive leaves and inserts log less. A hash
+        // index finds a value in constant time, but serves only Eq;
+        // get_nodes and get_edges answer other predicates on it by
+        // filtering the tag. A radix index finds a value, or all the
+        // strings that start with a Prefix, in one descent over its
+        // bytes, however many values there are. A counted AVL index
+        // also keeps the number of objects under each tree node, so
+        // count_nodes and count_edges, and iterators that start at an
+        // offset, take O(log n) on it; but every change to it locks
+        // the whole index, so transactions that change it wait for
+        // each other and for the ones that read it.
+        // The indexes other than hash indexes serve Prefix only in
+        // the C locale, where the transformed strings keep the
+        // prefixes of the strings.
+        // In a unique index, no two objects can have the same value;
+        // setting a property to a value another object has throws
+        // NotUnique.
+        // Creating an index that exists already leaves it as it is.
+        // A new index is filled with the objects that have the
+        // property, in the creating transaction. Its journal has to
+        // hold an entry for every few dozen distinct values, for the
+        // allocator pages the fill takes them from; this throws
+        // NotUnique for a unique index if two of them have the same value, and
+        // PropertyTypeMismatch if one has a value of another type.
+        // Changes to the property by other transactions, and new
+        // objects with the tag, wait until it commits.
+        enum IndexKind { AvlIndex, BPlusTree, Hash, Radix, CountedAvl };
+        void create_index(IndexType index_type, StringID tag,
+                          StringID property_id, const PropertyType ptype,
+                          IndexKind kind = AvlIndex, bool unique = false);
+
+        // A composite index orders the objects with a tag by the values
+        // of up to eight properties, comparing the first, then the
+        // second, and so on. It serves a list of predicates with Eq on
+        // the leading properties and, optionally, a range on the next
+        // one. Objects without the first property are left out. Like
+        // create_index, this fills the index with the objects that
+        // have the properties already.
+        struct IndexColumn {
+            StringID property_id;
+            PropertyType ptype;
+        };
         void create_index(IndexType index_type, StringID tag,
-                          StringID property_id, const PropertyType ptype);
+                          const std::vector<IndexColumn> &columns);
+
+        // Write a consistent copy of the graph to the directory dest_name
+        // while the graph stays open. Read-write transactions go on while
+        // the region files are copied; new ones wait only for transactions
+        // in flight to finish at the start, and at the end while the pages
+        // written during the copy are written into it again.
+        // Must not be called with a read-write transaction open.
+        void snapshot(const char *dest_name);
+
+        // Incremental backups. These need track_dirty_pages.
+        // export_delta writes the pages changed since the last snapshot
+        // or delta to delta_file, the same way snapshot does. apply_delta
+        // applies a delta to a copy that is not open, and throws
+        // VersionMismatch unless the copy is at the point the delta
+        // starts from; deltas must be applied in the order they were
+        // exported.
+        void export_delta(const char *delta_file);
+        static void apply_delta(const char *db_name, const char *delta_file);
 
         //Stats
         struct IndexStats {
@@ -300,12 +300,17 @@ namespace PMGD {
         EdgeIteratorImplIntf *const _impl;
 
         Edge *edge() const { return _impl->get_edge(); }
+        // Throws for a light edge
+        Edge *record() const;
 
     public:
         EdgeRef(const EdgeRef &) = delete;
         void operator=(const EdgeRef &) = delete;
         EdgeRef(EdgeIteratorImplIntf *impl) : _impl(impl) {}
-        operator Edge &() { return *edge(); }
+        operator Edge &() { return *record(); }
+        // A light edge has a tag and two ends but no edge record,
+        // so no id and no properties.
+        bool is_light() const { return edge() == NULL; }
         EdgeID get_id() const;
         StringID get_tag() const { return _impl->get_tag(); }
         Node &get_source() const { return _impl->get_source(); }
@@ -29,6 +29,7 @@
 
 #pragma once
 
+#include <vector>
 #include "stringid.h"
 #include "property.h"
 #include "iterator.h"
@@ -37,6 +38,7 @@ namespace PMGD {
     class Graph;
     class EdgeIndex;
     class Allocator;
+    class IndexManager;
 
     typedef uint64_t NodeID;
     enum Direction { Any, Outgoing, Incoming };
@@ -45,16 +47,35 @@ namespace PMGD {
         EdgeIndex *_out_edges;
         EdgeIndex *_in_edges;
         StringID _tag;
+        // Set while Graph::remove_partial works through the edges.
+        // Iterators then leave the node and its edges out.
+        bool _removing;
         PropertyList _property_list;
 
         friend class Graph;
+        friend class IndexManager;
         void init(StringID tag, unsigned object_size,
                   Allocator &index_allocator);
         void cleanup(Allocator &index_allocator);
-        void add_edge(Edge *edge, Direction dir, StringID tag,
-                      Allocator &index_allocator);
+        EdgeIndex *edge_index(Direction dir, Allocator &index_allocator);
+        // The edge is NULL for a light edge
+        void *add_edge(Edge *edge, Node *other, Direction dir, StringID tag,
+                       Allocator &index_allocator);
+        void add_edges(Edge *const *edges, size_t count, Direction dir,
+                       StringID tag, void **pos, Allocator &index_allocator);
         void remove_all_properties();
-        void remove_edge(Edge *edge, Direction dir, Allocator &index_allocator);
+        void remove_edge(Edge *edge, Direction dir, void *pos,
+                         Allocator &index_allocator);
+        void remove_edges(Edge *const *edges, void *const *pos, size_t count,
+                          Direction dir, StringID tag,
+                          Allocator &index_allocator);
+        EdgeIterator hide_removing(EdgeIterator i) const;
+        void remove_light_edge(Node *other, Direction dir, StringID tag,
+                               Allocator &index_allocator);
+        void add_ordered_edge(Edge *edge, Direction dir, long long key,
+                              Allocator &index_allocator);
+        void remove_ordered_edge(Edge *edge, Direction dir, long long key,
+                                 Allocator &index_allocator);
 
     public:
         Node(const Node &) = delete;
@@ -72,6 +93,19 @@ namespace PMGD {
         EdgeIterator get_edges(Direction dir) const;
         EdgeIterator get_edges(StringID tag) const;
         EdgeIterator get_edges(Direction dir, StringID tag) const;
+        // If the tag has an edge order by the property of pp, this
+        // seeks to the matching edges in the ordered adjacency and
+        // gives them in property order, or in reverse. Otherwise it
+        // filters get_edges(dir, tag), and reverse is not supported.
+        EdgeIterator get_edges(Direction dir, StringID tag,
+                               const PropertyPredicate &pp,
+                               bool reverse = false) const;
+        EdgeIterator get_edges_to(const Node &neighbor, Direction dir = Any,
+                                  StringID tag = 0) const;
+        // Neighbors in node id order without duplicates, for merging
+        // and intersecting adjacency
+        std::vector<Node *> get_sorted_neighbors(Direction dir = Any,
+                                                 StringID tag = 0) const;
         void set_property(StringID id, const Property &);
         void remove_property(StringID name);
     };
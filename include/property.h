@@ -195,12 +195,14 @@ namespace PMGD {
 
     struct PropertyPredicate {
         StringID id;
-        enum Op { DontCare, Eq, Ne, Gt, Ge, Lt, Le, GeLe, GeLt, GtLe, GtLt } op;
+        // Prefix matches the strings that start with v1.
+        enum Op { DontCare, Eq, Ne, Gt, Ge, Lt, Le, Prefix,
+                  GeLe, GeLt, GtLe, GtLt } op;
         Property v1, v2;
         PropertyPredicate() : id(0) { }
         PropertyPredicate(StringID i) : id(i), op(DontCare) { }
         PropertyPredicate(StringID i, Op o, const Property &v)
-            : id(i), op(o), v1(v) { assert(o > DontCare && o <= Le); }
+            : id(i), op(o), v1(v) { assert(o > DontCare && o <= Prefix); }
         PropertyPredicate(StringID i, Op o,
                 const Property &val1, const Property &val2)
             : id(i), op(o), v1(val1), v2(val2)
@@ -30,6 +30,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <functional>
 #include "graph.h"
 
 namespace PMGD {
@@ -39,13 +40,23 @@ namespace PMGD {
         TransactionImpl *_impl;
 
     public:
+        // EarlyLockRelease lets a read-write transaction drop its
+        // locks as soon as its commit is ordered, before its changes
+        // are durable. A transaction that locks what it released does not
+        // become durable before it; use the commit callback to learn when
+        // that happens.
         enum TransactionOptions { Dependent = 0, Independent = 1,
-                                  ReadOnly = 0, ReadWrite = 2 };
+                                  ReadOnly = 0, ReadWrite = 2,
+                                  EarlyLockRelease = 4 };
 
         Transaction(const Transaction &) = delete;
         void operator=(const Transaction &) = delete;
         Transaction(Graph &db, int options = Dependent|ReadOnly);
         void commit();
+
+        // Commit and call on_durable once the commit is durable.
+        void commit(std::function<void()> on_durable);
+
         ~Transaction();
     };
 };
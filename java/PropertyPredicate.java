@@ -39,7 +39,7 @@ package pmgd;
 public class PropertyPredicate {
     private long pmgdHandle;
 
-    public enum Op { DontCare, Eq, Ne, Gt, Ge, Lt, Le,
+    public enum Op { DontCare, Eq, Ne, Gt, Ge, Lt, Le, Prefix,
                      GeLe, GeLt, GtLe, GtLt };
 
     public PropertyPredicate()
@@ -134,18 +134,21 @@ int Allocator::get_allocator()
     throw PMGDException(LockTimeout);
 }
 
-void *Allocator::alloc(size_t size)
+unsigned Allocator::instance()
 {
     TransactionImpl *tx = TransactionImpl::get_tx();
-    AllocatorUnit *allocator = NULL;
     int alloc_id;
 
     if ( (alloc_id = tx->get_allocator()) == -1) {
         alloc_id = get_allocator();
         tx->set_allocator(alloc_id);
     }
+    return alloc_id;
+}
 
-    allocator = _allocators[alloc_id];
+void *Allocator::alloc(size_t size)
+{
+    AllocatorUnit *allocator = _allocators[instance()];
     return allocator->alloc(size);
 }
 
@@ -218,6 +221,7 @@ bool Allocator::AllocatorLock::try_lock(TransactionImpl *tx)
     if (old_owner == NULL && cmpxchg(_owner_tx, old_owner, tx)) {
         // Make sure this is unlocked at TX commit/abort. Not during.
         tx->register_finalize_callback(this, AllocatorUnlockCallback(this));
+        tx->depend_on(_release_seq);
         return true;
     }
     return false;
@@ -238,6 +242,8 @@ void Allocator::AllocatorLock::release(TransactionImpl *tx)
     // This goes on the release list only if the TX
     // acquired this.
     assert (_owner_tx == tx);
+    if (tx->commit_seq() > _release_seq)
+        _release_seq = tx->commit_seq();
     _owner_tx = NULL;
 }
 
@@ -82,7 +82,11 @@ namespace PMGD {
 
             TransactionImpl *_owner_tx;
 
-            AllocatorLock() : _owner_tx(NULL) {}
+            // Commit sequence number of the last owner to release the
+            // lock after committing, so the next owner waits for it.
+            uint64_t _release_seq;
+
+            AllocatorLock() : _owner_tx(NULL), _release_seq(0) {}
             void lock(TransactionImpl *curr_tx);
             bool try_lock(TransactionImpl *curr_tx);
             void release(TransactionImpl *tx);
@@ -166,6 +170,11 @@ namespace PMGD {
         void *alloc(size_t size);
         void free(void *addr, size_t size);
 
+        // The instance the current transaction allocates from, assigned
+        // on first use. Concurrent transactions never share one.
+        unsigned instance();
+        unsigned num_instances() const { return unsigned(_allocators.size()); }
+
         // For stats
         uint64_t region_size() const
             { return _chunks.region_size() + CHUNK_SIZE; }
@@ -142,9 +142,12 @@ namespace PMGD {
 
                 FreeFormChunk(TransactionImpl *tx, unsigned alloc_id, unsigned used = 0);
                 bool has_space() { return max_cont_space >= MIN_ALLOC_BYTES; }
-                void *alloc(size_t sz);
+                // logged_size is the size of the free spot, and
+                // logged_max whether max_cont_space, already logged
+                // in this transaction.
+                void *alloc(size_t sz, uint32_t *&logged_size, bool &logged_max);
                 void free(void *addr, size_t size);
-                void find_max_cont_space();
+                void find_max_cont_space(bool &logged);
                 free_spot_t *compute_addr(uint64_t offset)
                   { return reinterpret_cast<free_spot_t *>(reinterpret_cast<uint64_t>(this) + offset); }
             };
@@ -182,6 +185,14 @@ namespace PMGD {
             FreeFormChunk *_chunk_to_scan;  // Point into the FixedAllocator.
             FreeFormChunk *_last_chunk_scanned;  // Needed to extend the linked list
 
+            // As in FixSizeAllocator, what the chunk last allocated
+            // from logged is kept for the rest of the transaction.
+            TransactionId _logged_tx;
+            FreeFormChunk *_logged_chunk;
+            uint32_t *_logged_size;
+            bool _logged_max;
+            void *alloc(FreeFormChunk *chunk, size_t sz);
+
             // This function assumes that the borderline case has already
             // been handled.
             void *alloc_large(size_t size);
@@ -316,7 +327,11 @@ namespace PMGD {
                 // the correct sized entities.
 
                 FixedChunk(unsigned alloc_id, unsigned bitmap_ints, unsigned max_spots);
-                void *alloc(unsigned obj_size, unsigned bitmap_ints);
+                // logged is whether the chunk has been logged in this
+                // transaction already; the header and the bitmap are
+                // logged together, on the first alloc.
+                void *alloc(unsigned obj_size, unsigned bitmap_ints,
+                            bool logged);
                 void free(void *addr, unsigned obj_size, unsigned bitmap_ints);
             };
 
@@ -356,6 +371,14 @@ namespace PMGD {
             FixedChunk *_chunk_to_scan;      // Point into the FixedAllocator.
             FixedChunk *_last_chunk_scanned; // Needed to extend the linked list
 
+            // An allocator serves one transaction at a time, and the
+            // journal needs only the first value of what changes, so
+            // what the chunk last allocated from logged is kept for the
+            // rest of the transaction.
+            TransactionId _logged_tx;
+            FixedChunk *_logged_chunk;
+            void *alloc(FixedChunk *chunk);
+
             friend class AllocatorAbortCallback<FixSizeAllocator>;
             void restore_dram_chunk(void *chunk);
             void remove_dram_chunk(void *chunk);
@@ -30,7 +30,9 @@
 #include <string.h>    // For memset
 #include "AvlTree.h"
 #include "node.h"
+#include "edge.h"
 #include "List.h"
+#include "PostingList.h"
 #include "IndexString.h"
 
 using namespace PMGD;
@@ -57,6 +59,8 @@ typename AvlTree<K,V>::TreeNode *AvlTree<K,V>::left_rotate(
     // TODO this might be a repeat given what follows in the caller
     // but for ensuring correct heights, lets set this anyway.
     new_root->height = max(height(hinge), height(new_root->right)) + 1;
+    update_count(hinge, tx);
+    update_count(new_root, tx);
     return new_root;
 }
 
@@ -82,6 +86,8 @@ typename AvlTree<K,V>::TreeNode *AvlTree<K,V>::right_rotate(
     // TODO this might be a repeat given what follows in the caller
     // but for ensuring correct heights, lets set this anyway.
     new_root->height = max(height(hinge), height(new_root->left)) + 1;
+    update_count(hinge, tx);
+    update_count(new_root, tx);
     return new_root;
 }
 
@@ -338,6 +344,7 @@ typename AvlTree<K,V>::TreeNode *AvlTree<K,V>::add_recursive(AvlTree<K,V>::TreeN
         tx->log(&curr->height, sizeof(curr->height));
         curr->height = new_height;
     }
+    update_count(curr, tx);
     return curr;
 }
 
@@ -664,6 +671,7 @@ typename AvlTree<K,V>::TreeNode *AvlTree<K,V>::remove_recursive(AvlTree<K,V>::Tr
         tx->log(&curr->height, sizeof(curr->height));
         curr->height = new_height;
     }
+    update_count(curr, tx);
     return curr;
 }
 
@@ -695,6 +703,7 @@ int AvlTree<K,V>::remove(const K &key, Allocator &allocator)
             to_lock->value = to_delete->value;
             tx->log(&to_lock->left, sizeof(to_lock->left));
             to_lock->left = remove_recursive(to_lock->left, to_delete->key, allocator, tx, rebalanced);
+            update_count(to_lock, tx);
         }
         else {
             // At this stage, we know that the pointer pointed to by to_lock
@@ -746,6 +755,182 @@ V *AvlTree<K,V>::find(const K &key, bool write_lock_tree_node)
     return NULL;
 }
 
+template <typename K, typename V>
+typename AvlTree<K,V>::TreeNode *AvlTree<K,V>::load_recursive(size_t begin, size_t end,
+                                const std::function<const K &(size_t)> &key,
+                                const std::function<void(size_t, V &)> &init,
+                                Allocator &allocator, TransactionImpl *tx)
+{
+    if (begin == end)
+        return NULL;
+    size_t mid = begin + (end - begin) / 2;
+    TreeNode *temp = (TreeNode *)allocator.alloc(sizeof(TreeNode));
+    new (&temp->key) K(key(mid));
+    init(mid, *new (&temp->value) V());
+    temp->left = load_recursive(begin, mid, key, init, allocator, tx);
+    temp->right = load_recursive(mid + 1, end, key, init, allocator, tx);
+    temp->height = max(height(temp->left), height(temp->right)) + 1;
+    tx->flush_range(temp, sizeof *temp);
+    return temp;
+}
+
+template <typename K, typename V>
+void AvlTree<K,V>::load(size_t count,
+                        const std::function<const K &(size_t)> &key,
+                        const std::function<void(size_t, V &)> &init,
+                        Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    _tree = load_recursive(0, count, key, init, allocator, tx);
+    tx->flush_range(&_tree, sizeof _tree);
+}
+
+template <typename K, typename V>
+void AvlTree<K,V>::clear_recursive(TreeNode *curr, Allocator &allocator,
+                                   const std::function<void(V &)> &free_value)
+{
+    if (curr == NULL)
+        return;
+    clear_recursive(curr->left, allocator, free_value);
+    clear_recursive(curr->right, allocator, free_value);
+    free_value(curr->value);
+    size_t size = treenode_size(curr);
+    curr->key.~K();
+    allocator.free(curr, size);
+}
+
+template <typename K, typename V>
+void AvlTree<K,V>::clear(Allocator &allocator,
+                         const std::function<void(V &)> &free_value)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    clear_recursive(_tree, allocator, free_value);
+    tx->write(&_tree, (TreeNode *)NULL);
+}
+
+template <typename K, typename V>
+void AvlTree<K,V>::visit_recursive(TreeNode *curr,
+                                   const std::function<void(const K &, V &)> &f)
+{
+    if (curr == NULL)
+        return;
+    visit_recursive(curr->left, f);
+    f(curr->key, curr->value);
+    visit_recursive(curr->right, f);
+}
+
+template <typename K, typename V>
+void AvlTree<K,V>::visit_recursive(TreeNode *curr, const K &min, const K &max,
+                                   const std::function<void(const K &, V &)> &f)
+{
+    if (curr == NULL)
+        return;
+    if (min < curr->key)
+        visit_recursive(curr->left, min, max, f);
+    if (!(curr->key < min) && !(max < curr->key))
+        f(curr->key, curr->value);
+    if (curr->key < max)
+        visit_recursive(curr->right, min, max, f);
+}
+
+// Tree nodes are added and removed with no elements, so only the
+// counts in the subtree that changes shape need to change with them.
+template <typename K, typename V>
+void AvlTree<K,V>::update_count(TreeNode *node, TransactionImpl *tx)
+{
+    if (!SubtreeCount<V>::kept)
+        return;
+    uint64_t count = subtree_count(node->left) + subtree_count(node->right)
+                     + SubtreeCount<V>::weight(node->value);
+    uint64_t *field = SubtreeCount<V>::field(node->value);
+    if (*field != count)
+        tx->write(field, count);
+}
+
+template <typename K, typename V>
+void AvlTree<K,V>::add_count(const K &key, int64_t delta)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    TreeNode *curr = _tree;
+    while (curr != NULL) {
+        uint64_t *field = SubtreeCount<V>::field(curr->value);
+        tx->write(field, *field + delta);
+        if (key == curr->key)
+            return;
+        curr = key < curr->key ? curr->left : curr->right;
+    }
+}
+
+template <typename K, typename V>
+uint64_t AvlTree<K,V>::recount_recursive(TreeNode *curr, TransactionImpl *tx)
+{
+    if (curr == NULL)
+        return 0;
+    uint64_t *field = SubtreeCount<V>::field(curr->value);
+    *field = recount_recursive(curr->left, tx) + recount_recursive(curr->right, tx)
+             + SubtreeCount<V>::weight(curr->value);
+    tx->flush_range(field, sizeof *field);
+    return *field;
+}
+
+template <typename K, typename V>
+void AvlTree<K,V>::recount()
+{
+    recount_recursive(_tree, TransactionImpl::get_tx());
+}
+
+// Writers lock the whole tree, so the counts need no tree node locks.
+template <typename K, typename V>
+uint64_t AvlTree<K,V>::count_all()
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    return subtree_count(_tree);
+}
+
+template <typename K, typename V>
+uint64_t AvlTree<K,V>::count_before(const K &key, bool incl)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    uint64_t count = 0;
+    TreeNode *curr = _tree;
+    while (curr != NULL) {
+        if (key < curr->key || (!incl && key == curr->key))
+            curr = curr->left;
+        else {
+            count += subtree_count(curr->left) + SubtreeCount<V>::weight(curr->value);
+            curr = curr->right;
+        }
+    }
+    return count;
+}
+
+template <typename K, typename V>
+const K *AvlTree<K,V>::find_position(uint64_t pos, uint64_t &first, uint64_t &weight)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    uint64_t base = 0;
+    TreeNode *curr = _tree;
+    while (curr != NULL) {
+        uint64_t left = subtree_count(curr->left);
+        uint64_t w = SubtreeCount<V>::weight(curr->value);
+        if (pos < base + left)
+            curr = curr->left;
+        else if (pos < base + left + w) {
+            first = base + left;
+            weight = w;
+            return &curr->key;
+        }
+        else {
+            base += left + w;
+            curr = curr->right;
+        }
+    }
+    return NULL;
+}
+
 template <typename K, typename V>
 size_t AvlTree<K,V>::treenode_size(TreeNode *node)
 {
@@ -755,7 +940,13 @@ size_t AvlTree<K,V>::treenode_size(TreeNode *node)
 namespace PMGD {
     // Specialization for the IndexString case
     template <>
-    size_t AvlTree<IndexString, List<void *> >::treenode_size(TreeNode *node)
+    size_t AvlTree<IndexString, PostingList>::treenode_size(TreeNode *node)
+    {
+        return sizeof(*node) + node->key.get_remainder_size();
+    }
+
+    template <>
+    size_t AvlTree<IndexString, CountedPostingList>::treenode_size(TreeNode *node)
     {
         return sizeof(*node) + node->key.get_remainder_size();
     }
@@ -763,8 +954,16 @@ namespace PMGD {
 
 // Explicitly instantiate any types that might be required
 template class AvlTree<int, int>;
-template class AvlTree<long long, List<void *>>;
-template class AvlTree<bool, List<void *>>;
-template class AvlTree<double, List<void *>>;
-template class AvlTree<Time, List<void *>>;
-template class AvlTree<IndexString, List<void *>>;
+template class AvlTree<long long, PostingList>;
+template class AvlTree<bool, PostingList>;
+template class AvlTree<double, PostingList>;
+template class AvlTree<Time, PostingList>;
+template class AvlTree<IndexString, PostingList>;
+template class AvlTree<long long, CountedPostingList>;
+template class AvlTree<bool, CountedPostingList>;
+template class AvlTree<double, CountedPostingList>;
+template class AvlTree<Time, CountedPostingList>;
+template class AvlTree<IndexString, CountedPostingList>;
+template class AvlTree<uint64_t, PostingChunk *>;
+template class AvlTree<Node *, List<Edge *>>;
+template class AvlTree<long long, List<Edge *>>;
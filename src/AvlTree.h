@@ -29,6 +29,7 @@
 
 #pragma once
 #include <vector>
+#include <functional>
 
 #include "Allocator.h"
 
@@ -43,6 +44,18 @@
 
 namespace PMGD {
     class TransactionImpl;
+
+    // A tree can keep in each tree node the number of elements in its
+    // subtree, counting each value by its weight, to count a range or
+    // find the element at a position in O(log n). SubtreeCount<V>
+    // says where a value keeps the count of its tree node; most keep
+    // none.
+    template <typename V> struct SubtreeCount {
+        static const bool kept = false;
+        static uint64_t weight(const V &) { return 0; }
+        static uint64_t *field(V &) { return NULL; }
+    };
+
     template<typename K, typename V> class AvlTree {
     protected:
         struct TreeNode {
@@ -104,6 +117,16 @@ namespace PMGD {
         TreeNode *remove_recursive(TreeNode *curr, const K &data,
                                    Allocator &allocator, TransactionImpl *tx,
                                    bool &rebalanced);
+        TreeNode *load_recursive(size_t begin, size_t end,
+                                 const std::function<const K &(size_t)> &key,
+                                 const std::function<void(size_t, V &)> &init,
+                                 Allocator &allocator, TransactionImpl *tx);
+        void clear_recursive(TreeNode *curr, Allocator &allocator,
+                             const std::function<void(V &)> &free_value);
+        void visit_recursive(TreeNode *curr,
+                             const std::function<void(const K &, V &)> &f);
+        void visit_recursive(TreeNode *curr, const K &min, const K &max,
+                             const std::function<void(const K &, V &)> &f);
 
         int height(const TreeNode *node)
         {
@@ -112,6 +135,11 @@ namespace PMGD {
             return node->height;
         }
 
+        static uint64_t subtree_count(TreeNode *node)
+            { return node == NULL ? 0 : *SubtreeCount<V>::field(node->value); }
+        void update_count(TreeNode *node, TransactionImpl *tx);
+        uint64_t recount_recursive(TreeNode *curr, TransactionImpl *tx);
+
         // Unit test and associated funtions
         friend class AvlTreeTest;
         friend class MTAvlTreeTest;
@@ -126,6 +154,7 @@ namespace PMGD {
         // While the stats like calls have locks on them, if they are not used
         // during quiescent period, they could cause a lot of LockTimeouts.
         size_t num_elems() const;
+        bool empty() const { return _tree == NULL; }
 
         // We could use a key value pair in the tree struct and return a pointer to
         // that but technically, the user shouldn't be allowed to modify anything
@@ -146,6 +175,48 @@ namespace PMGD {
         // to be modified.
         V *find(const K &key, bool write_lock_tree_node = false);
 
+        // Calls f on every entry in key order. No locks are taken, so
+        // the caller has to keep the tree from changing meanwhile.
+        void visit(const std::function<void(const K &, V &)> &f)
+            { visit_recursive(_tree, f); }
+        // As visit, for the entries with keys in [min, max], skipping
+        // the subtrees outside it.
+        void visit(const K &min, const K &max,
+                   const std::function<void(const K &, V &)> &f)
+            { visit_recursive(_tree, min, max, f); }
+
+        // Builds a balanced tree from count keys in increasing order,
+        // calling init on the value of each with its position. Only
+        // for an empty tree new in this transaction: no locks are
+        // taken and the tree nodes, and the root, are flushed rather
+        // than logged.
+        void load(size_t count, const std::function<const K &(size_t)> &key,
+                  const std::function<void(size_t, V &)> &init,
+                  Allocator &allocator);
+
+        // For trees that keep subtree counts. The caller write locks
+        // the whole tree for any change to them, since they change up
+        // to the root: add_count is for a change of delta in the
+        // weight of the value for key, and recount sets the counts of
+        // a tree filled by load once its values have their weights,
+        // logging nothing.
+        // count_before gives the elements with keys below key, or up
+        // to it if incl, and find_position the key of the value with
+        // the element at position pos in key order, with the position
+        // of the value's first element and its weight, or NULL if
+        // there is no such element.
+        void add_count(const K &key, int64_t delta);
+        void recount();
+        uint64_t count_all();
+        uint64_t count_before(const K &key, bool incl);
+        const K *find_position(uint64_t pos, uint64_t &first, uint64_t &weight);
+
+        // Frees every tree node, handing each value to free_value first.
+        // Only for a tree that goes away with its owner: there are no
+        // locks taken and no iterators notified.
+        void clear(Allocator &allocator,
+                   const std::function<void(V &)> &free_value);
+
         size_t treenode_size(TreeNode *node);
     };
 }
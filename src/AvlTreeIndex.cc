@@ -30,7 +30,7 @@
 #include <stack>
 #include "AvlTreeIndex.h"
 #include "iterator.h"
-#include "List.h"
+#include "PostingList.h"
 #include "IndexString.h"
 #include "GraphImpl.h"
 
@@ -38,10 +38,10 @@ using namespace PMGD;
 
 namespace PMGD {
     template <typename K, typename V> class AvlTreeIndex<K,V>::Compare {
-        K _val;
+        typename BoundKey<K>::type _val;
         bool _equal;
     public:
-        Compare(const K val, bool equal) : _val(val), _equal(equal) {}
+        Compare(const K &val, bool equal) : _val(val), _equal(equal) {}
 
         // This is to be used only for making sure the values
         // are not equal. No implications on < or > should be made.
@@ -87,8 +87,11 @@ void AvlTreeIndex<K,V>::find_start(TreeNode *root,
             path.push(root);
         find_start(root->left, cmin, cmax, path, tx);
     }
-    else if (cmin.equals(root->key))
+    else if (cmin.equals(root->key)) {
+        // An empty range can have min at or past max.
+        if (cmax.greaterthanequal(root->key))
             path.push(root);
+    }
     else  // Need to look for min in the right subtree
         find_start(root->right, cmin, cmax, path, tx);
 }
@@ -184,12 +187,9 @@ void AvlTreeIndex<K,V>::add_nodes_neq(TreeNode *root, const K &neq,
         path.push(root);
     else {
         // If the root is equal to the key, don't forget its right,
-        // which we can add to the path without checking againt neq
-        // because of uniqueness.
-        if (root->right != NULL) {
-            tx->acquire_lock(TransactionImpl::IndexLock, root->right, false);
-            path.push(root->right);
-        }
+        // and the smaller nodes below it, which we can add to the path
+        // without checking againt neq because of uniqueness.
+        find_start_all(root->right, path, tx);
     }
     add_nodes_neq(root->left, neq, path, tx);
 }
@@ -236,8 +236,10 @@ void AvlTreeIndex<K,V>::find_start_reverse(TreeNode *root,
             path.push(root);
         find_start_reverse(root->right, cmin, cmax, path, tx);
     }
-    else if (cmax.equals(root->key))
+    else if (cmax.equals(root->key)) {
+        if (cmin.lessthanequal(root->key))
             path.push(root);
+    }
     else  // Need to look for max in the left subtree as well.
         find_start_reverse(root->left, cmin, cmax, path, tx);
 }
@@ -331,12 +333,9 @@ void AvlTreeIndex<K,V>::add_nodes_neq_reverse(TreeNode *root, const K &neq,
         path.push(root);
     else {
         // If the root is equal to the key, don't forget its left,
-        // which we can add to the path without checking againt neq
-        // because of uniqueness.
-        if (root->left != NULL) {
-            tx->acquire_lock(TransactionImpl::IndexLock, root->left, false);
-            path.push(root->left);
-        }
+        // and the larger nodes below it, which we can add to the path
+        // without checking againt neq because of uniqueness.
+        find_start_all_reverse(root->left, path, tx);
     }
     add_nodes_neq_reverse(root->right, neq, path, tx);
 }
@@ -373,31 +372,31 @@ namespace PMGD {
 // The BASE_DECLS macro is used to avoid repeating the list of typedefs
 // and using declarations in all seven derived classes.
 #define BASE_DECLS \
-        typedef typename Index_IteratorImplBase<K>::IndexValue IndexValue; \
-        typedef typename Index_IteratorImplBase<K>::IndexNode IndexNode; \
-        typedef typename Index_IteratorImplBase<K>::Stack Stack; \
-        using Index_IteratorImplBase<K>::_tree; \
-        using Index_IteratorImplBase<K>::_curr; \
-        using Index_IteratorImplBase<K>::_path; \
-        using Index_IteratorImplBase<K>::_list_it; \
-        using Index_IteratorImplBase<K>::_vacant_flag; \
-        using Index_IteratorImplBase<K>::finish_init; \
-        using Index_IteratorImplBase<K>::_tx; \
-        using Index_IteratorImplBase<K>::_index_type;
+        typedef typename Index_IteratorImplBase<K, V>::IndexValue IndexValue; \
+        typedef typename Index_IteratorImplBase<K, V>::IndexNode IndexNode; \
+        typedef typename Index_IteratorImplBase<K, V>::Stack Stack; \
+        using Index_IteratorImplBase<K, V>::_tree; \
+        using Index_IteratorImplBase<K, V>::_curr; \
+        using Index_IteratorImplBase<K, V>::_path; \
+        using Index_IteratorImplBase<K, V>::_list_it; \
+        using Index_IteratorImplBase<K, V>::_vacant_flag; \
+        using Index_IteratorImplBase<K, V>::finish_init; \
+        using Index_IteratorImplBase<K, V>::_tx; \
+        using Index_IteratorImplBase<K, V>::_index_type;
 
     // These iterator implementations are specific to instantiations
-    // of AvlTreeIndex<K, V> with V = List<void *>.
-    template <typename K>
+    // of AvlTreeIndex<K, V> with V = PostingList or CountedPostingList.
+    template <typename K, typename V>
     class Index_IteratorImplBase : public Index::Index_IteratorImplIntf {
     protected:
-        typedef List<void *> IndexValue;
+        typedef V IndexValue;
         typedef AvlTreeIndex<K, IndexValue> IndexNode;
         typedef typename IndexNode::Stack Stack;
 
         IndexNode *const _tree;
         typename IndexNode::TreeNode *_curr;
         Stack _path;
-        ListTraverser<void *> _list_it;
+        PostingListTraverser _list_it;
         bool _vacant_flag = false;
         TransactionImpl *_tx;
         Graph::IndexType _index_type;
@@ -421,8 +420,7 @@ namespace PMGD {
             if (_tx->is_read_write()) {
                 _tx->iterator_callbacks().register_iterator(this,
                     [this](void *list_node) { remove_notify(list_node); },
-                    [this](void *tree)
-                    { rebalance_notify(static_cast<IndexNode *>(tree)); });
+                    [this](void *tree) { rebalance_notify(tree); });
             }
         }
 
@@ -460,22 +458,30 @@ namespace PMGD {
         void set_index_type(Graph::IndexType index_type)
           { _index_type = index_type; }
 
+        // Moves on n objects within the current list
+        void skip(uint64_t n) { _list_it.skip(n); }
+
         void *ref() const
         {
             // _vacant_flag indicates that the object referred to by the
-            // iterator has been removed from the index.
-            if (EXPECT_FALSE(_vacant_flag))
+            // iterator has been removed from the index along with the
+            // rest of its list. If only the object went, the list
+            // still has the position but no longer the member.
+            if (EXPECT_FALSE(_vacant_flag || !_list_it.is_member()))
                 throw PMGDException(VacantIterator);
-            void *value = _list_it.ref();
+            void *value = _tx->get_db()->object_table(_index_type)
+                              .get_object(_list_it.ref() + 1);
             TransactionImpl::lock(_index_type, value, false);
             return value;
         }
 
-        void remove_notify(void *list_node)
+        uint64_t slot() const { return _list_it.ref(); }
+
+        void remove_notify(void *list)
         {
-            // If the object referred to by the iterator is being removed
-            // from the index, move to the next object.
-            if (_list_it.check(list_node)) {
+            // If the list the iterator is on is being removed from the
+            // index, move to the next list.
+            if (_list_it.check(list)) {
                 // Clear _vacant_flag to ensure that next actually advances
                 // the iterator, and then set _vacant_flag to indicate that
                 // the current object has been removed from the index.
@@ -485,7 +491,7 @@ namespace PMGD {
             }
         }
 
-        void rebalance_notify(IndexNode *tree)
+        void rebalance_notify(void *tree)
         {
             if (tree == _tree && _curr != NULL && bool(_list_it)) {
                 _path.clear();
@@ -494,17 +500,21 @@ namespace PMGD {
                 assert(!_path.empty());
                 _curr = _path.top();
                 _path.pop();
+                _list_it.reset(&_curr->value);
             }
+            // The chunks of the list moved
+            else if (_list_it.check(tree))
+                _list_it.reset(static_cast<IndexValue *>(tree));
         }
     };
 
-    template <typename K>
-    class IndexEq_IteratorImpl : public Index_IteratorImplBase<K> {
+    template <typename K, typename V>
+    class IndexEq_IteratorImpl : public Index_IteratorImplBase<K, V> {
         BASE_DECLS
 
     public:
         IndexEq_IteratorImpl(IndexNode *tree, const K &key)
-            : Index_IteratorImplBase<K>(tree)
+            : Index_IteratorImplBase<K, V>(tree)
             { _list_it.set(tree->find(key)); }
 
         void _next()
@@ -515,8 +525,8 @@ namespace PMGD {
     };
 
     // Handle gele, gelt, gtle, gtlt, le, lt.
-    template <typename K>
-    class IndexRange_IteratorImpl : public Index_IteratorImplBase<K> {
+    template <typename K, typename V>
+    class IndexRange_IteratorImpl : public Index_IteratorImplBase<K, V> {
         BASE_DECLS
         typename IndexNode::Compare _cmax;
 
@@ -524,7 +534,7 @@ namespace PMGD {
         IndexRange_IteratorImpl(IndexNode *tree,
                                     const K &min, const K &max,
                                     bool incl_min, bool incl_max)
-            : Index_IteratorImplBase<K>(tree),
+            : Index_IteratorImplBase<K, V>(tree),
               _cmax(max, incl_max)
         {
             typename IndexNode::Compare cmin(min, incl_min);
@@ -535,7 +545,7 @@ namespace PMGD {
         // When a max is given but no min is specified, next is same as
         // that for gele kind of cases. So just add a constructor.
         IndexRange_IteratorImpl(IndexNode *tree, const K &max, bool incl_max)
-            : Index_IteratorImplBase<K>(tree),
+            : Index_IteratorImplBase<K, V>(tree),
               _cmax(max, incl_max)
         {
             _tree->find_start_min(tree->_tree, _cmax, _path, _tx);
@@ -550,15 +560,15 @@ namespace PMGD {
     };
 
     // Handle ge, gt, dont_care.
-    template <typename K>
-    class IndexRangeNomax_IteratorImpl : public Index_IteratorImplBase<K> {
+    template <typename K, typename V>
+    class IndexRangeNomax_IteratorImpl : public Index_IteratorImplBase<K, V> {
         BASE_DECLS
 
     public:
         IndexRangeNomax_IteratorImpl(IndexNode *tree,
                                     const K &min,
                                     bool incl_min)
-            : Index_IteratorImplBase<K>(tree)
+            : Index_IteratorImplBase<K, V>(tree)
         {
             typename IndexNode::Compare cmin(min, incl_min);
             _tree->find_start_max(tree->_tree, cmin, _path, _tx);
@@ -567,7 +577,7 @@ namespace PMGD {
 
         // The dont_care case where no min and max are given.
         IndexRangeNomax_IteratorImpl(IndexNode *tree)
-            : Index_IteratorImplBase<K>(tree)
+            : Index_IteratorImplBase<K, V>(tree)
         {
             _tree->find_start_all(tree->_tree, _path, _tx);
             finish_init();
@@ -580,14 +590,14 @@ namespace PMGD {
             { _tree->find_start_max(_tree->_tree, cur, _path, _tx); }
     };
 
-    template <typename K>
-    class IndexRangeNeq_IteratorImpl : public Index_IteratorImplBase<K> {
+    template <typename K, typename V>
+    class IndexRangeNeq_IteratorImpl : public Index_IteratorImplBase<K, V> {
         BASE_DECLS
-        K _neq;
+        typename BoundKey<K>::type _neq;
 
     public:
         IndexRangeNeq_IteratorImpl(IndexNode *tree, const K &neq)
-            : Index_IteratorImplBase<K>(tree),
+            : Index_IteratorImplBase<K, V>(tree),
               _neq(neq)
         {
             // Get to the minimum of the tree but make sure that is
@@ -605,8 +615,8 @@ namespace PMGD {
 
     // Reverse iterators.
     // Handle gele, gelt, gtle, gtlt, gt, ge.
-    template <typename K>
-    class IndexRangeReverse_IteratorImpl : public Index_IteratorImplBase<K> {
+    template <typename K, typename V>
+    class IndexRangeReverse_IteratorImpl : public Index_IteratorImplBase<K, V> {
         BASE_DECLS
         typename IndexNode::Compare _cmin;
 
@@ -614,7 +624,7 @@ namespace PMGD {
         IndexRangeReverse_IteratorImpl(IndexNode *tree,
                                     const K &min, const K &max,
                                     bool incl_min, bool incl_max)
-            : Index_IteratorImplBase<K>(tree),
+            : Index_IteratorImplBase<K, V>(tree),
               _cmin(min, incl_min)
         {
             typename IndexNode::Compare cmax(max, incl_max);
@@ -625,7 +635,7 @@ namespace PMGD {
         // When a min is given but no max is specified, next is same as
         // that for gele kind of cases. So just add a constructor.
         IndexRangeReverse_IteratorImpl(IndexNode *tree, const K &min, bool incl_min)
-            : Index_IteratorImplBase<K>(tree),
+            : Index_IteratorImplBase<K, V>(tree),
               _cmin(min, incl_min)
         {
             _tree->find_start_max_reverse(tree->_tree, _cmin, _path, _tx);
@@ -640,13 +650,13 @@ namespace PMGD {
     };
 
     // Handle lt, le, dont_care
-    template <typename K>
-    class IndexRangeNomin_IteratorImpl : public Index_IteratorImplBase<K> {
+    template <typename K, typename V>
+    class IndexRangeNomin_IteratorImpl : public Index_IteratorImplBase<K, V> {
         BASE_DECLS
 
     public:
         IndexRangeNomin_IteratorImpl(IndexNode *tree, const K &max, bool incl_max)
-            : Index_IteratorImplBase<K>(tree)
+            : Index_IteratorImplBase<K, V>(tree)
         {
             typename IndexNode::Compare cmax(max, incl_max);
             _tree->find_start_min_reverse(tree->_tree, cmax, _path, _tx);
@@ -655,7 +665,7 @@ namespace PMGD {
 
         // The dont_care case where no min and max are given.
         IndexRangeNomin_IteratorImpl(IndexNode *tree)
-            : Index_IteratorImplBase<K>(tree)
+            : Index_IteratorImplBase<K, V>(tree)
         {
             _tree->find_start_all_reverse(tree->_tree, _path, _tx);
             finish_init();
@@ -668,14 +678,14 @@ namespace PMGD {
             { _tree->find_start_min_reverse(_tree->_tree, cur, _path, _tx); }
     };
 
-    template <typename K>
-    class IndexRangeNeqReverse_IteratorImpl : public Index_IteratorImplBase<K> {
+    template <typename K, typename V>
+    class IndexRangeNeqReverse_IteratorImpl : public Index_IteratorImplBase<K, V> {
         BASE_DECLS
-        K _neq;
+        typename BoundKey<K>::type _neq;
 
     public:
         IndexRangeNeqReverse_IteratorImpl(IndexNode *tree, const K &neq)
-            : Index_IteratorImplBase<K>(tree),
+            : Index_IteratorImplBase<K, V>(tree),
               _neq(neq)
         {
             // Get to the minimum of the tree but make sure that is
@@ -698,12 +708,12 @@ Index::Index_IteratorImplIntf *AvlTreeIndex<K,V>::get_iterator(Graph::IndexType
     // We can read lock the main index class here.
     TransactionImpl *tx = TransactionImpl::get_tx();
     tx->acquire_lock(TransactionImpl::IndexLock, this, false);
-    Index_IteratorImplBase<K> *impl = NULL;
+    Index_IteratorImplBase<K, V> *impl = NULL;
 
     if (!reverse)
-        impl = new IndexRangeNomax_IteratorImpl<K>(this);
+        impl = new IndexRangeNomax_IteratorImpl<K, V>(this);
     else
-        impl =  new IndexRangeNomin_IteratorImpl<K>(this);
+        impl =  new IndexRangeNomin_IteratorImpl<K, V>(this);
 
     impl->set_index_type(index_type);
     return impl;
@@ -716,42 +726,42 @@ Index::Index_IteratorImplIntf *AvlTreeIndex<K,V>::get_iterator(Graph::IndexType
     // We can read lock the main index class here.
     TransactionImpl *tx = TransactionImpl::get_tx();
     tx->acquire_lock(TransactionImpl::IndexLock, this, false);
-    Index_IteratorImplBase<K> *impl = NULL;
+    Index_IteratorImplBase<K, V> *impl = NULL;
     switch (op) {
         case PropertyPredicate::Eq:
-            impl = new IndexEq_IteratorImpl<K>(this, key);
+            impl = new IndexEq_IteratorImpl<K, V>(this, key);
             break;
         case PropertyPredicate::Ne:
             if (!reverse)
-                impl = new IndexRangeNeq_IteratorImpl<K>(this, key);
+                impl = new IndexRangeNeq_IteratorImpl<K, V>(this, key);
             else
-                impl = new IndexRangeNeqReverse_IteratorImpl<K>(this, key);
+                impl = new IndexRangeNeqReverse_IteratorImpl<K, V>(this, key);
             break;
         // < or <= some max. But start from min of tree.
         case PropertyPredicate::Lt:
             if (!reverse)
-                impl = new IndexRange_IteratorImpl<K>(this, key, false);
+                impl = new IndexRange_IteratorImpl<K, V>(this, key, false);
             else
-                impl = new IndexRangeNomin_IteratorImpl<K>(this, key, false);
+                impl = new IndexRangeNomin_IteratorImpl<K, V>(this, key, false);
             break;
         case PropertyPredicate::Le:
             if (!reverse)
-                impl = new IndexRange_IteratorImpl<K>(this, key, true);
+                impl = new IndexRange_IteratorImpl<K, V>(this, key, true);
             else
-                impl = new IndexRangeNomin_IteratorImpl<K>(this, key, true);
+                impl = new IndexRangeNomin_IteratorImpl<K, V>(this, key, true);
             break;
         // > or >= some min. But go till the max of tree.
         case PropertyPredicate::Gt:
             if (!reverse)
-                impl = new IndexRangeNomax_IteratorImpl<K>(this, key, false);
+                impl = new IndexRangeNomax_IteratorImpl<K, V>(this, key, false);
             else
-                impl = new IndexRangeReverse_IteratorImpl<K>(this, key, false);
+                impl = new IndexRangeReverse_IteratorImpl<K, V>(this, key, false);
             break;
         case PropertyPredicate::Ge:
             if (!reverse)
-                impl = new IndexRangeNomax_IteratorImpl<K>(this, key, true);
+                impl = new IndexRangeNomax_IteratorImpl<K, V>(this, key, true);
             else
-                impl = new IndexRangeReverse_IteratorImpl<K>(this, key, true);
+                impl = new IndexRangeReverse_IteratorImpl<K, V>(this, key, true);
             break;
         default: // Since Index already checks ops, this shouldn't happen.
             assert(0);
@@ -781,27 +791,135 @@ Index::Index_IteratorImplIntf *AvlTreeIndex<K,V>::get_iterator(Graph::IndexType
 
     TransactionImpl *tx = TransactionImpl::get_tx();
     tx->acquire_lock(TransactionImpl::IndexLock, this, false);
-    Index_IteratorImplBase<K> *impl = NULL;
+    Index_IteratorImplBase<K, V> *impl = NULL;
 
     if (!reverse)
-        impl =  new IndexRange_IteratorImpl<K>(this, min, max, incl_min, incl_max);
+        impl =  new IndexRange_IteratorImpl<K, V>(this, min, max, incl_min, incl_max);
     else
-        impl =  new IndexRangeReverse_IteratorImpl<K>(this, min, max, incl_min, incl_max);
+        impl =  new IndexRangeReverse_IteratorImpl<K, V>(this, min, max, incl_min, incl_max);
 
     impl->set_index_type(index_type);
     return impl;
 }
 
+template <typename K, typename V>
+void AvlTreeIndex<K,V>::positions(const K &min, const K &max, PropertyPredicate::Op op,
+                                  uint64_t &first, uint64_t &end)
+{
+    first = 0;
+    end = this->count_all();
+    switch (op) {
+        case PropertyPredicate::Eq:
+            first = this->count_before(min, false);
+            end = this->count_before(min, true);
+            break;
+        case PropertyPredicate::Lt:
+        case PropertyPredicate::Le:
+            end = this->count_before(min, op == PropertyPredicate::Le);
+            break;
+        case PropertyPredicate::Gt:
+        case PropertyPredicate::Ge:
+            first = this->count_before(min, op == PropertyPredicate::Gt);
+            break;
+        case PropertyPredicate::GeLe:
+        case PropertyPredicate::GeLt:
+        case PropertyPredicate::GtLe:
+        case PropertyPredicate::GtLt:
+            first = this->count_before(min, op == PropertyPredicate::GtLe
+                                            || op == PropertyPredicate::GtLt);
+            end = this->count_before(max, op == PropertyPredicate::GeLe
+                                          || op == PropertyPredicate::GtLe);
+            break;
+        default:
+            break;
+    }
+    // An empty range may have its bounds crossed
+    if (end < first)
+        end = first;
+}
+
+template <typename K, typename V>
+size_t AvlTreeIndex<K,V>::count(const K &min, const K &max, PropertyPredicate::Op op)
+{
+    uint64_t first, end;
+    if (op == PropertyPredicate::Ne) {
+        positions(min, max, PropertyPredicate::Eq, first, end);
+        return this->count_all() - (end - first);
+    }
+    positions(min, max, op, first, end);
+    return end - first;
+}
+
+// The iterator starts at the key with the object at the offset, and
+// skips the objects before it in its list. A reverse iterator walks
+// each list forward, so the offset in the list is from the end of
+// the objects past it.
+template <typename K, typename V>
+Index::Index_IteratorImplIntf *AvlTreeIndex<K,V>::get_iterator(Graph::IndexType index_type, const K &min,
+                                                               const K &max, PropertyPredicate::Op op,
+                                                               bool reverse, size_t offset)
+{
+    if (op == PropertyPredicate::Ne) {
+        Index::Index_IteratorImplIntf *impl = get_iterator(index_type, min, op, reverse);
+        while (offset-- > 0 && bool(*impl) && impl->next())
+            ;
+        return impl;
+    }
+
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    uint64_t first, end;
+    positions(min, max, op, first, end);
+    if (offset >= end - first) {
+        Index_IteratorImplBase<K, V> *impl
+            = new IndexRange_IteratorImpl<K, V>(this, min, min, false, false);
+        impl->set_index_type(index_type);
+        return impl;
+    }
+
+    uint64_t start, weight;
+    const K &key = *this->find_position(reverse ? end - 1 - offset : first + offset,
+                                        start, weight);
+    bool single = op < PropertyPredicate::GeLe;
+    Index_IteratorImplBase<K, V> *impl = NULL;
+    uint64_t skip;
+    if (!reverse) {
+        bool has_max = op == PropertyPredicate::Eq || op == PropertyPredicate::Lt
+                       || op == PropertyPredicate::Le || !single;
+        bool incl_max = op == PropertyPredicate::Eq || op == PropertyPredicate::Le
+                        || op == PropertyPredicate::GeLe || op == PropertyPredicate::GtLe;
+        if (has_max)
+            impl = new IndexRange_IteratorImpl<K, V>(this, key, single ? min : max,
+                                                     true, incl_max);
+        else
+            impl = new IndexRangeNomax_IteratorImpl<K, V>(this, key, true);
+        skip = first + offset - start;
+    }
+    else {
+        bool has_min = op == PropertyPredicate::Eq || op == PropertyPredicate::Gt
+                       || op == PropertyPredicate::Ge || !single;
+        bool incl_min = op == PropertyPredicate::Eq || op == PropertyPredicate::Ge
+                        || op == PropertyPredicate::GeLe || op == PropertyPredicate::GeLt;
+        if (has_min)
+            impl = new IndexRangeReverse_IteratorImpl<K, V>(this, min, key, incl_min, true);
+        else
+            impl = new IndexRangeNomin_IteratorImpl<K, V>(this, key, true);
+        skip = offset - (end - (start + weight));
+    }
+    impl->set_index_type(index_type);
+    impl->skip(skip);
+    return impl;
+}
+
 template <typename K, typename V>
 void AvlTreeIndex<K,V>::stats_recursive(TreeNode *root, Graph::IndexStats &stats)
 {
     if (root == NULL)
         return;
-    List<void *> node_list = root->value;
-    size_t num_elems = node_list.num_elems();
-    stats.total_elements   += num_elems;
+    PostingList &list = root->value;
+    stats.total_elements   += list.num_elems();
     stats.total_size_bytes += this->treenode_size(root);
-    stats.total_size_bytes += num_elems * node_list.list_type_size();
+    stats.total_size_bytes += list.size_bytes();
     stats_recursive(root->left,  stats);
     stats_recursive(root->right, stats);
 }
@@ -826,8 +944,7 @@ void AvlTreeIndex<K,V>::stats_health_recursive(TreeNode *root,
 
     if (root == NULL)
         return;
-    List<void *> node_list = root->value;
-    size_t node_elements = node_list.num_elems();
+    size_t node_elements = root->value.num_elems();
 
     if (node_elements > avg_elem_per_node) {
         stats.health_factor -= (100*node_elements) / stats.total_elements;
@@ -858,9 +975,33 @@ void AvlTreeIndex<K,V>::index_stats_info(Graph::IndexStats &stats)
     stats_health_recursive(this->_tree, stats, avg_elem_per_node);
 }
 
+template <typename K, typename V>
+void AvlTreeIndex<K,V>::prefetch_recursive(TreeNode *root, unsigned levels,
+                                           TransactionImpl *tx)
+{
+    if (root == NULL || levels == 0)
+        return;
+    tx->acquire_lock(TransactionImpl::IndexLock, root, false);
+    (void)*(volatile int *)&root->height;
+    prefetch_recursive(root->left, levels - 1, tx);
+    prefetch_recursive(root->right, levels - 1, tx);
+}
+
+template <typename K, typename V>
+void AvlTreeIndex<K,V>::prefetch(unsigned levels)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    prefetch_recursive(this->_tree, levels, tx);
+}
+
 // Explicitly instantiate any types that might be required
-template class AvlTreeIndex<long long, List<void *>>;
-template class AvlTreeIndex<bool, List<void *>>;
-template class AvlTreeIndex<double, List<void *>>;
-template class AvlTreeIndex<Time, List<void *>>;
-template class AvlTreeIndex<IndexString, List<void *>>;
+template class AvlTreeIndex<long long, PostingList>;
+template class AvlTreeIndex<bool, PostingList>;
+template class AvlTreeIndex<double, PostingList>;
+template class AvlTreeIndex<Time, PostingList>;
+template class AvlTreeIndex<IndexString, PostingList>;
+template class AvlTreeIndex<long long, CountedPostingList>;
+template class AvlTreeIndex<bool, CountedPostingList>;
+template class AvlTreeIndex<double, CountedPostingList>;
+template class AvlTreeIndex<Time, CountedPostingList>;
+template class AvlTreeIndex<IndexString, CountedPostingList>;
@@ -75,18 +75,29 @@ namespace PMGD {
         void stats_recursive(TreeNode *root, Graph::IndexStats &stats);
         void stats_health_recursive(TreeNode *root, Graph::IndexStats &stats, size_t &avg_elem_per_node);
 
-        template <class D> friend class Index_IteratorImplBase;
-        template <class D> friend class IndexEq_IteratorImpl;
-        template <class D> friend class IndexRange_IteratorImpl;
-        template <class D> friend class IndexRangeNomax_IteratorImpl;
-        template <class D> friend class IndexRangeNeq_IteratorImpl;
-        template <class D> friend class IndexRangeReverse_IteratorImpl;
-        template <class D> friend class IndexRangeNomin_IteratorImpl;
-        template <class D> friend class IndexRangeNeqReverse_IteratorImpl;
+        // For counted trees, the positions in key order of the first
+        // object op selects and of the one after the last, for all
+        // the ops but Ne
+        void positions(const K &min, const K &max, PropertyPredicate::Op op,
+                       uint64_t &first, uint64_t &end);
+
+        // For warming up the cache at open time
+        void prefetch_recursive(TreeNode *root, unsigned levels, TransactionImpl *tx);
+
+        template <class D, class W> friend class Index_IteratorImplBase;
+        template <class D, class W> friend class IndexEq_IteratorImpl;
+        template <class D, class W> friend class IndexRange_IteratorImpl;
+        template <class D, class W> friend class IndexRangeNomax_IteratorImpl;
+        template <class D, class W> friend class IndexRangeNeq_IteratorImpl;
+        template <class D, class W> friend class IndexRangeReverse_IteratorImpl;
+        template <class D, class W> friend class IndexRangeNomin_IteratorImpl;
+        template <class D, class W> friend class IndexRangeNeqReverse_IteratorImpl;
 
     public:
         // Initialize both and they do their own transaction flush
-        AvlTreeIndex(PropertyType ptype) : Index(ptype), AvlTree<K,V>()
+        AvlTreeIndex(PropertyType ptype)
+            : Index(ptype, SubtreeCount<V>::kept ? Graph::CountedAvl : Graph::AvlIndex),
+              AvlTree<K,V>()
         {
             // This will flush for both the base classes too.
             TransactionImpl *tx = TransactionImpl::get_tx();
@@ -103,16 +114,29 @@ namespace PMGD {
                                                     const K &max, PropertyPredicate::Op op,
                                                     bool reverse);
 
+        // For counted trees. min is the key for the ops with one, and
+        // the iterator starts offset objects into what op selects, in
+        // O(log n) except for Ne, which steps over them.
+        size_t count(const K &min, const K &max, PropertyPredicate::Op op);
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type, const K &min,
+                                                    const K &max, PropertyPredicate::Op op,
+                                                    bool reverse, size_t offset);
+
         // For statistics
         void index_stats_info(Graph::IndexStats &stats);
+
+        // Touch the top levels of the tree
+        void prefetch(unsigned levels);
     };
 
     // For the actual property value indices
     class IndexString;
-    template <class T> class List;
-    typedef AvlTreeIndex<long long, List<void *>> LongValueIndex;
-    typedef AvlTreeIndex<double, List<void *>> FloatValueIndex;
-    typedef AvlTreeIndex<bool, List<void *>> BoolValueIndex;
-    typedef AvlTreeIndex<Time, List<void *>> TimeValueIndex;
-    typedef AvlTreeIndex<IndexString, List<void *>> StringValueIndex;
+    class PostingList;
+    class CountedPostingList;
+    typedef AvlTreeIndex<long long, PostingList> LongValueIndex;
+    typedef AvlTreeIndex<double, PostingList> FloatValueIndex;
+    typedef AvlTreeIndex<bool, PostingList> BoolValueIndex;
+    typedef AvlTreeIndex<Time, PostingList> TimeValueIndex;
+    typedef AvlTreeIndex<IndexString, PostingList> StringValueIndex;
+    template <typename K> using CountedAvlTreeIndex = AvlTreeIndex<K, CountedPostingList>;
 }
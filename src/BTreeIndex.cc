@@ -0,0 +1,784 @@
+/**
+ * @file   BTreeIndex.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <new>
+#include "BTreeIndex.h"
+#include "PostingList.h"
+#include "IndexString.h"
+#include "GraphImpl.h"
+
+using namespace PMGD;
+
+// Keys move between and within nodes as raw bytes. For IndexString
+// that hands over the remainder, so only keys put in place by copy
+// construction need destroying.
+template <typename K>
+static void move_keys(K *dst, const K *src, unsigned n)
+{
+    memmove((void *)dst, (const void *)src, n * sizeof(K));
+}
+
+template <typename K>
+static size_t key_bytes(K &)
+    { return 0; }
+
+static size_t key_bytes(IndexString &key)
+    { return key.get_remainder_size(); }
+
+// The first key in node at or after key
+template <typename K>
+unsigned BTreeIndex<K>::lower_bound(Node *node, const K &key)
+{
+    const K *keys = node->leaf ? static_cast<Leaf *>(node)->keys
+                               : static_cast<Inner *>(node)->keys;
+    unsigned lo = 0, hi = node->count;
+    while (lo < hi) {
+        unsigned mid = (lo + hi) / 2;
+        if (keys[mid] < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// The first key in node after key
+template <typename K>
+unsigned BTreeIndex<K>::upper_bound(Node *node, const K &key)
+{
+    const K *keys = node->leaf ? static_cast<Leaf *>(node)->keys
+                               : static_cast<Inner *>(node)->keys;
+    unsigned lo = 0, hi = node->count;
+    while (lo < hi) {
+        unsigned mid = (lo + hi) / 2;
+        if (key < keys[mid])
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+// Read locks the nodes on the way down to the leaf for key. Adds
+// them to path if given.
+template <typename K>
+typename BTreeIndex<K>::Leaf *BTreeIndex<K>::find_leaf(const K &key,
+                                                      Path *path,
+                                                      TransactionImpl *tx)
+{
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    if (path != NULL)
+        path->depth = 0;
+    Node *node = _root;
+    while (node != NULL) {
+        tx->acquire_lock(TransactionImpl::IndexLock, node, false);
+        unsigned slot = node->leaf ? 0 : upper_bound(node, key);
+        if (path != NULL) {
+            path->nodes[path->depth] = node;
+            path->slots[path->depth++] = slot;
+        }
+        if (node->leaf)
+            return static_cast<Leaf *>(node);
+        node = static_cast<Inner *>(node)->children[slot];
+    }
+    return NULL;
+}
+
+template <typename K>
+typename BTreeIndex<K>::Leaf *BTreeIndex<K>::first_leaf(bool last,
+                                                       TransactionImpl *tx)
+{
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    Node *node = _root;
+    while (node != NULL) {
+        tx->acquire_lock(TransactionImpl::IndexLock, node, false);
+        if (node->leaf)
+            return static_cast<Leaf *>(node);
+        Inner *inner = static_cast<Inner *>(node);
+        node = inner->children[last ? inner->count : 0];
+    }
+    return NULL;
+}
+
+// New nodes are write locked, so that nobody else sees them before
+// the transaction commits. The caller flushes them once filled in.
+template <typename K>
+typename BTreeIndex<K>::Leaf *BTreeIndex<K>::new_leaf(Allocator &allocator)
+{
+    static_assert(sizeof(Leaf) <= NODE_SIZE, "B+-tree leaf too large");
+    Leaf *leaf = static_cast<Leaf *>(allocator.alloc(NODE_SIZE));
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::IndexLock,
+                                            leaf, true);
+    leaf->count = 0;
+    leaf->leaf = 1;
+    leaf->unused = 0;
+    leaf->prev = NULL;
+    leaf->next = NULL;
+    return leaf;
+}
+
+template <typename K>
+typename BTreeIndex<K>::Inner *BTreeIndex<K>::new_inner(Allocator &allocator)
+{
+    static_assert(sizeof(Inner) <= NODE_SIZE, "B+-tree inner node too large");
+    Inner *inner = static_cast<Inner *>(allocator.alloc(NODE_SIZE));
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::IndexLock,
+                                            inner, true);
+    inner->count = 0;
+    inner->leaf = 0;
+    inner->unused = 0;
+    return inner;
+}
+
+static PostingList *new_list(Allocator &allocator, TransactionImpl *tx)
+{
+    PostingList *list = new (allocator.alloc(sizeof(PostingList))) PostingList();
+    tx->flush_range(list, sizeof *list);
+    return list;
+}
+
+template <typename K>
+PostingList *BTreeIndex<K>::add(const K &key, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    Path path;
+    Leaf *leaf = find_leaf(key, &path, tx);
+
+    if (leaf == NULL) {
+        tx->acquire_lock(TransactionImpl::IndexLock, this, true);
+        leaf = new_leaf(allocator);
+        PostingList *list = new_list(allocator, tx);
+        new (&leaf->keys[0]) K(key);
+        leaf->values[0] = list;
+        leaf->count = 1;
+        tx->flush_range(leaf, NODE_SIZE);
+        tx->write(&_root, static_cast<Node *>(leaf));
+        tx->write(&_height, uint32_t(1));
+        return list;
+    }
+
+    unsigned pos = lower_bound(leaf, key);
+    tx->acquire_lock(TransactionImpl::IndexLock, leaf, true);
+    if (pos < leaf->count && leaf->keys[pos] == key)
+        return leaf->values[pos];
+
+    PostingList *list = leaf->count < Leaf::MAX_KEYS
+                            ? insert(path, pos, key, allocator, tx)
+                            : split_leaf(path, pos, key, allocator, tx);
+    tx->iterator_callbacks().iterator_rebalance_notify(this);
+    return list;
+}
+
+// Adds key at pos in a leaf with room for it
+template <typename K>
+PostingList *BTreeIndex<K>::insert(Path &path, unsigned pos, const K &key,
+                                   Allocator &allocator, TransactionImpl *tx)
+{
+    Leaf *leaf = static_cast<Leaf *>(path.nodes[path.depth - 1]);
+    unsigned n = leaf->count;
+
+    tx->log_range(&leaf->values[pos], &leaf->values[n]);
+    tx->log_range(&leaf->keys[pos], &leaf->keys[n]);
+    memmove(&leaf->values[pos + 1], &leaf->values[pos],
+            (n - pos) * sizeof leaf->values[0]);
+    move_keys(&leaf->keys[pos + 1], &leaf->keys[pos], n - pos);
+
+    PostingList *list = new_list(allocator, tx);
+    new (&leaf->keys[pos]) K(key);
+    leaf->values[pos] = list;
+    tx->write(&leaf->count, uint16_t(n + 1));
+    return list;
+}
+
+// Adds key at pos in a full leaf, moving the upper half of the
+// entries to a new leaf after it. Only the entries that stay and
+// move up in the leaf are logged.
+template <typename K>
+PostingList *BTreeIndex<K>::split_leaf(Path &path, unsigned pos, const K &key,
+                                       Allocator &allocator,
+                                       TransactionImpl *tx)
+{
+    Leaf *leaf = static_cast<Leaf *>(path.nodes[path.depth - 1]);
+    unsigned n = leaf->count;
+    unsigned left = (n + 1) / 2;
+    Leaf *right = new_leaf(allocator);
+    PostingList *list = new_list(allocator, tx);
+
+    if (pos >= left) {
+        unsigned rpos = pos - left;
+        memcpy(right->values, &leaf->values[left], rpos * sizeof right->values[0]);
+        move_keys(right->keys, &leaf->keys[left], rpos);
+        new (&right->keys[rpos]) K(key);
+        right->values[rpos] = list;
+        memcpy(&right->values[rpos + 1], &leaf->values[pos],
+               (n - pos) * sizeof right->values[0]);
+        move_keys(&right->keys[rpos + 1], &leaf->keys[pos], n - pos);
+    }
+    else {
+        memcpy(right->values, &leaf->values[left - 1],
+               (n - left + 1) * sizeof right->values[0]);
+        move_keys(right->keys, &leaf->keys[left - 1], n - left + 1);
+        tx->log_range(&leaf->values[pos], &leaf->values[left - 1]);
+        tx->log_range(&leaf->keys[pos], &leaf->keys[left - 1]);
+        memmove(&leaf->values[pos + 1], &leaf->values[pos],
+                (left - 1 - pos) * sizeof leaf->values[0]);
+        move_keys(&leaf->keys[pos + 1], &leaf->keys[pos], left - 1 - pos);
+        new (&leaf->keys[pos]) K(key);
+        leaf->values[pos] = list;
+    }
+    right->count = n + 1 - left;
+    right->prev = leaf;
+    right->next = leaf->next;
+    tx->flush_range(right, NODE_SIZE);
+
+    if (leaf->next != NULL) {
+        tx->acquire_lock(TransactionImpl::IndexLock, leaf->next, true);
+        tx->write(&leaf->next->prev, right);
+    }
+    tx->write(&leaf->next, right);
+    tx->write(&leaf->count, uint16_t(left));
+
+    // The separator is a copy, since the leaf key can go on its own.
+    insert_inner(path, path.depth - 2, &right->keys[0], right, true,
+                 allocator, tx);
+    return list;
+}
+
+// Adds sep and the child after it to the inner node at level in path,
+// splitting it if full, or adds a new root above the old one when
+// level is past the top of path. A separator pushed up from an inner node
+// split moves as it is, while one from a leaf is copied.
+template <typename K>
+void BTreeIndex<K>::insert_inner(Path &path, unsigned level, K *sep,
+                                 Node *child, bool copy_sep,
+                                 Allocator &allocator, TransactionImpl *tx)
+{
+    if (level >= path.depth) {
+        tx->acquire_lock(TransactionImpl::IndexLock, this, true);
+        Inner *root = new_inner(allocator);
+        root->children[0] = _root;
+        root->children[1] = child;
+        if (copy_sep)
+            new (&root->keys[0]) K(*sep);
+        else
+            move_keys(&root->keys[0], sep, 1);
+        root->count = 1;
+        tx->flush_range(root, NODE_SIZE);
+        tx->write(&_root, static_cast<Node *>(root));
+        tx->write(&_height, _height + 1);
+        return;
+    }
+
+    Inner *node = static_cast<Inner *>(path.nodes[level]);
+    unsigned i = path.slots[level];
+    unsigned n = node->count;
+    tx->acquire_lock(TransactionImpl::IndexLock, node, true);
+
+    if (n < Inner::MAX_KEYS) {
+        tx->log_range(&node->keys[i], &node->keys[n]);
+        tx->log_range(&node->children[i + 1], &node->children[n + 1]);
+        move_keys(&node->keys[i + 1], &node->keys[i], n - i);
+        memmove(&node->children[i + 2], &node->children[i + 1],
+                (n - i) * sizeof node->children[0]);
+        if (copy_sep)
+            new (&node->keys[i]) K(*sep);
+        else
+            move_keys(&node->keys[i], sep, 1);
+        node->children[i + 1] = child;
+        tx->write(&node->count, uint16_t(n + 1));
+        return;
+    }
+
+    // Lay out the n + 1 keys and n + 2 children in order, keep the
+    // lower half, and push the middle key up with the upper half.
+    alignas(K) char key_buf[(Inner::MAX_KEYS + 1) * sizeof(K)];
+    K *keys = reinterpret_cast<K *>(key_buf);
+    Node *children[Inner::MAX_KEYS + 2];
+    move_keys(keys, node->keys, i);
+    if (copy_sep)
+        new (&keys[i]) K(*sep);
+    else
+        move_keys(&keys[i], sep, 1);
+    move_keys(&keys[i + 1], &node->keys[i], n - i);
+    memcpy(children, node->children, (i + 1) * sizeof children[0]);
+    children[i + 1] = child;
+    memcpy(&children[i + 2], &node->children[i + 1],
+           (n - i) * sizeof children[0]);
+
+    unsigned left = (n + 1) / 2;
+    Inner *right = new_inner(allocator);
+    right->count = n - left;
+    move_keys(right->keys, &keys[left + 1], n - left);
+    memcpy(right->children, &children[left + 1],
+           (n - left + 1) * sizeof children[0]);
+    tx->flush_range(right, NODE_SIZE);
+
+    tx->log(node, NODE_SIZE);
+    move_keys(node->keys, keys, left);
+    memcpy(node->children, children, (left + 1) * sizeof children[0]);
+    node->count = left;
+
+    insert_inner(path, level - 1, &keys[left], right, false, allocator, tx);
+}
+
+// Spreads count entries over the fewest nodes that hold at most
+// fill each, as evenly as possible, so no node is left near empty
+static std::vector<size_t> spread(size_t count, size_t fill)
+{
+    size_t nodes = (count + fill - 1) / fill;
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < nodes; i++)
+        sizes.push_back(count / nodes + (i < count % nodes));
+    return sizes;
+}
+
+// The nodes are new, so they are flushed once filled in instead of
+// logged. The separator above each node is a copy of the first key in
+// its leftmost leaf.
+template <typename K>
+void BTreeIndex<K>::load(const std::vector<const K *> &keys,
+                         std::vector<PostingList *> &lists,
+                         Allocator &allocator)
+{
+    if (keys.empty())
+        return;
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, true);
+    assert(_root == NULL);
+
+    std::vector<Node *> level;
+    std::vector<const K *> firsts;
+    Leaf *prev = NULL;
+    size_t i = 0;
+    for (size_t n : spread(keys.size(), Leaf::MAX_KEYS * 3 / 4)) {
+        Leaf *leaf = new_leaf(allocator);
+        for (unsigned j = 0; j < n; j++, i++) {
+            new (&leaf->keys[j]) K(*keys[i]);
+            leaf->values[j] = new_list(allocator, tx);
+            lists.push_back(leaf->values[j]);
+        }
+        leaf->count = uint16_t(n);
+        leaf->prev = prev;
+        if (prev != NULL) {
+            prev->next = leaf;
+            tx->flush_range(prev, NODE_SIZE);
+        }
+        prev = leaf;
+        level.push_back(leaf);
+        firsts.push_back(&leaf->keys[0]);
+    }
+    tx->flush_range(prev, NODE_SIZE);
+
+    uint32_t height = 1;
+    while (level.size() > 1) {
+        std::vector<Node *> upper;
+        std::vector<const K *> upper_firsts;
+        size_t c = 0;
+        for (size_t n : spread(level.size(), Inner::MAX_KEYS * 3 / 4 + 1)) {
+            Inner *inner = new_inner(allocator);
+            upper.push_back(inner);
+            upper_firsts.push_back(firsts[c]);
+            for (unsigned j = 0; j < n; j++, c++) {
+                inner->children[j] = level[c];
+                if (j > 0)
+                    new (&inner->keys[j - 1]) K(*firsts[c]);
+            }
+            inner->count = uint16_t(n - 1);
+            tx->flush_range(inner, NODE_SIZE);
+        }
+        level.swap(upper);
+        firsts.swap(upper_firsts);
+        height++;
+    }
+
+    tx->write(&_root, level[0]);
+    tx->write(&_height, height);
+}
+
+template <typename K>
+PostingList *BTreeIndex<K>::find(const K &key, bool write_lock)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    Leaf *leaf = find_leaf(key, NULL, tx);
+    if (leaf == NULL)
+        return NULL;
+    unsigned pos = lower_bound(leaf, key);
+    if (pos == leaf->count || !(leaf->keys[pos] == key))
+        return NULL;
+    if (write_lock)
+        tx->acquire_lock(TransactionImpl::IndexLock, leaf, true);
+    return leaf->values[pos];
+}
+
+template <typename K>
+void BTreeIndex<K>::remove(const K &key, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    Leaf *leaf = find_leaf(key, NULL, tx);
+    if (leaf == NULL)
+        return;
+    unsigned pos = lower_bound(leaf, key);
+    if (pos == leaf->count || !(leaf->keys[pos] == key))
+        return;
+
+    tx->acquire_lock(TransactionImpl::IndexLock, leaf, true);
+    unsigned n = leaf->count;
+    PostingList *list = leaf->values[pos];
+    assert(list->num_elems() == 0);
+
+    tx->log_range(&leaf->values[pos], &leaf->values[n - 1]);
+    tx->log_range(&leaf->keys[pos], &leaf->keys[n - 1]);
+    leaf->keys[pos].~K();
+    memmove(&leaf->values[pos], &leaf->values[pos + 1],
+            (n - pos - 1) * sizeof leaf->values[0]);
+    move_keys(&leaf->keys[pos], &leaf->keys[pos + 1], n - pos - 1);
+    tx->write(&leaf->count, uint16_t(n - 1));
+    allocator.free(list, sizeof *list);
+
+    tx->iterator_callbacks().iterator_rebalance_notify(this);
+}
+
+namespace PMGD {
+    // One iterator for all the predicates: it starts at the first key
+    // within the bounds in the direction of the scan and walks the
+    // leaves until it passes the far bound.
+    template <typename K>
+    class BTreeIndex<K>::BTree_IteratorImpl
+        : public Index::Index_IteratorImplIntf
+    {
+    public:
+        struct Bound {
+            typename BoundKey<K>::type key;
+            bool incl;
+            Bound(const K &k, bool i) : key(k), incl(i) { }
+        };
+
+    private:
+        BTreeIndex *const _tree;
+        Leaf *_leaf;
+        int _pos;
+        PostingListTraverser _list_it;
+        bool _vacant_flag = false;
+        TransactionImpl *_tx;
+        const Graph::IndexType _index_type;
+        const bool _reverse;
+        Bound *const _min;
+        Bound *const _max;
+        Bound *const _neq;
+
+        bool past_end(const K &key) const
+        {
+            if (_reverse)
+                return _min != NULL && (key < _min->key
+                                        || (!_min->incl && key == _min->key));
+            return _max != NULL && (_max->key < key
+                                    || (!_max->incl && key == _max->key));
+        }
+
+        // Moves to the nearest entry from _pos on in the direction
+        // of the scan that is not skipped, or to the end.
+        void settle()
+        {
+            while (_leaf != NULL) {
+                if (_pos < 0 || _pos >= int(_leaf->count)) {
+                    _leaf = _reverse ? _leaf->prev : _leaf->next;
+                    if (_leaf != NULL) {
+                        _tx->acquire_lock(TransactionImpl::IndexLock, _leaf, false);
+                        _pos = _reverse ? int(_leaf->count) - 1 : 0;
+                    }
+                    continue;
+                }
+                const K &key = _leaf->keys[_pos];
+                if (past_end(key))
+                    break;
+                if (_neq == NULL || !(key == _neq->key)) {
+                    _list_it.set(_leaf->values[_pos]);
+                    if (bool(_list_it))
+                        return;
+                }
+                _pos += _reverse ? -1 : 1;
+            }
+            _leaf = NULL;
+            _list_it.set(NULL);
+        }
+
+    public:
+        BTree_IteratorImpl(BTreeIndex *tree, Graph::IndexType index_type,
+                           bool reverse, Bound *min, Bound *max, Bound *neq)
+            : _tree(tree), _leaf(NULL), _pos(0), _list_it(NULL),
+              _tx(TransactionImpl::get_tx()), _index_type(index_type),
+              _reverse(reverse), _min(min), _max(max), _neq(neq)
+        {
+            if (_tx->is_read_write()) {
+                _tx->iterator_callbacks().register_iterator(this,
+                    [this](void *list) { remove_notify(list); },
+                    [this](void *tree) { rebalance_notify(tree); });
+            }
+
+            Bound *start = _reverse ? _max : _min;
+            if (start == NULL) {
+                _leaf = _tree->first_leaf(_reverse, _tx);
+                if (_leaf != NULL)
+                    _pos = _reverse ? int(_leaf->count) - 1 : 0;
+            }
+            else {
+                _leaf = _tree->find_leaf(start->key, NULL, _tx);
+                if (_leaf != NULL) {
+                    // Forward from the first key in range, or back
+                    // from the last
+                    bool lower = _reverse ? !start->incl : start->incl;
+                    _pos = lower ? lower_bound(_leaf, start->key)
+                                 : upper_bound(_leaf, start->key);
+                    if (_reverse)
+                        _pos--;
+                }
+            }
+            settle();
+        }
+
+        ~BTree_IteratorImpl()
+        {
+            if (_tx->is_read_write())
+                _tx->iterator_callbacks().unregister_iterator(this);
+            delete _min;
+            delete _max;
+            delete _neq;
+        }
+
+        operator bool() const { return _vacant_flag || bool(_list_it); }
+
+        bool next()
+        {
+            // If _vacant_flag is set, the iterator has already advanced
+            // to the next object, so just clear _vacant_flag.
+            if (EXPECT_FALSE(_vacant_flag)) {
+                _vacant_flag = false;
+                return operator bool();
+            }
+
+            if (_list_it.next())
+                return true;
+
+            if (_leaf == NULL)
+                return false;
+            _pos += _reverse ? -1 : 1;
+            settle();
+            return bool(_list_it);
+        }
+
+        void *ref() const
+        {
+            if (EXPECT_FALSE(_vacant_flag || !_list_it.is_member()))
+                throw PMGDException(VacantIterator);
+            void *value = _tx->get_db()->object_table(_index_type)
+                              .get_object(_list_it.ref() + 1);
+            TransactionImpl::lock(_index_type, value, false);
+            return value;
+        }
+
+        uint64_t slot() const { return _list_it.ref(); }
+
+        void remove_notify(void *list)
+        {
+            // The list the iterator is on is being removed from the
+            // index, so move to the next one.
+            if (_list_it.check(list)) {
+                _vacant_flag = false;
+                next();
+                _vacant_flag = true;
+            }
+        }
+
+        void rebalance_notify(void *tree)
+        {
+            // Entries only move up or down within a leaf, or on to
+            // the new leaf after it when it splits.
+            if (tree == _tree && _leaf != NULL && bool(_list_it)) {
+                if (_pos < int(_leaf->count)
+                        && _list_it.check(_leaf->values[_pos]))
+                    return;
+                Leaf *leaves[] = { _leaf, _leaf->next };
+                for (Leaf *leaf : leaves) {
+                    for (int i = 0; leaf != NULL && i < int(leaf->count); i++) {
+                        if (_list_it.check(leaf->values[i])) {
+                            _leaf = leaf;
+                            _pos = i;
+                            return;
+                        }
+                    }
+                }
+                assert(0);
+            }
+            // The chunks of the list moved
+            else if (_list_it.check(tree))
+                _list_it.reset(static_cast<PostingList *>(tree));
+        }
+    };
+}
+
+template <typename K>
+Index::Index_IteratorImplIntf *BTreeIndex<K>::get_iterator(Graph::IndexType index_type,
+                                                          bool reverse)
+{
+    return new BTree_IteratorImpl(this, index_type, reverse, NULL, NULL, NULL);
+}
+
+template <typename K>
+Index::Index_IteratorImplIntf *BTreeIndex<K>::get_iterator(Graph::IndexType index_type,
+                                                          const K &key,
+                                                          PropertyPredicate::Op op,
+                                                          bool reverse)
+{
+    typedef typename BTree_IteratorImpl::Bound Bound;
+    Bound *min = NULL, *max = NULL, *neq = NULL;
+
+    switch (op) {
+        case PropertyPredicate::Eq:
+            min = new Bound(key, true);
+            max = new Bound(key, true);
+            break;
+        case PropertyPredicate::Ne:
+            neq = new Bound(key, false);
+            break;
+        case PropertyPredicate::Lt:
+        case PropertyPredicate::Le:
+            max = new Bound(key, op == PropertyPredicate::Le);
+            break;
+        case PropertyPredicate::Gt:
+        case PropertyPredicate::Ge:
+            min = new Bound(key, op == PropertyPredicate::Ge);
+            break;
+        default: // Since Index already checks ops, this shouldn't happen.
+            assert(0);
+            break;
+    }
+
+    return new BTree_IteratorImpl(this, index_type, reverse, min, max, neq);
+}
+
+template <typename K>
+Index::Index_IteratorImplIntf *BTreeIndex<K>::get_iterator(Graph::IndexType index_type,
+                                                          const K &min,
+                                                          const K &max,
+                                                          PropertyPredicate::Op op,
+                                                          bool reverse)
+{
+    typedef typename BTree_IteratorImpl::Bound Bound;
+    bool incl_min = op == PropertyPredicate::GeLe || op == PropertyPredicate::GeLt;
+    bool incl_max = op == PropertyPredicate::GeLe || op == PropertyPredicate::GtLe;
+    return new BTree_IteratorImpl(this, index_type, reverse,
+                                  new Bound(min, incl_min),
+                                  new Bound(max, incl_max), NULL);
+}
+
+template <typename K>
+void BTreeIndex<K>::stats_recursive(Node *node, Graph::IndexStats &stats)
+{
+    stats.total_size_bytes += NODE_SIZE;
+    if (node->leaf) {
+        Leaf *leaf = static_cast<Leaf *>(node);
+        for (unsigned i = 0; i < leaf->count; i++) {
+            PostingList *list = leaf->values[i];
+            stats.total_unique_entries++;
+            stats.total_elements += list->num_elems();
+            stats.total_size_bytes += sizeof *list + list->size_bytes()
+                                      + key_bytes(leaf->keys[i]);
+        }
+        return;
+    }
+    Inner *inner = static_cast<Inner *>(node);
+    for (unsigned i = 0; i <= inner->count; i++)
+        stats_recursive(inner->children[i], stats);
+    for (unsigned i = 0; i < inner->count; i++)
+        stats.total_size_bytes += key_bytes(inner->keys[i]);
+}
+
+template <typename K>
+void BTreeIndex<K>::index_stats_info(Graph::IndexStats &stats)
+{
+    // Each value takes its share of a leaf and its list header;
+    // total_size_bytes has the actual sizes.
+    stats.unique_entry_size     = sizeof(K) + sizeof(PostingList *)
+                                  + sizeof(PostingList);
+    stats.total_unique_entries  = 0;
+    stats.total_elements        = 0;
+    stats.total_size_bytes      = sizeof(*this);
+    stats.health_factor         = 100;
+
+    if (_root == NULL)
+        return;
+
+    stats_recursive(_root, stats);
+    if (stats.total_unique_entries == 0)
+        return;
+
+    // The health measure is the one AvlTreeIndex uses: values with
+    // more than the average number of elements take off their share.
+    size_t avg_elem_per_node = stats.total_elements / stats.total_unique_entries;
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    for (Leaf *leaf = first_leaf(false, tx); leaf != NULL; leaf = leaf->next) {
+        for (unsigned i = 0; i < leaf->count; i++) {
+            size_t node_elements = leaf->values[i]->num_elems();
+            if (node_elements > avg_elem_per_node)
+                stats.health_factor -= (100 * node_elements) / stats.total_elements;
+        }
+    }
+}
+
+template <typename K>
+void BTreeIndex<K>::prefetch_recursive(Node *node, unsigned levels,
+                                       TransactionImpl *tx)
+{
+    if (node == NULL || levels == 0 || node->leaf)
+        return;
+    tx->acquire_lock(TransactionImpl::IndexLock, node, false);
+    Inner *inner = static_cast<Inner *>(node);
+    for (unsigned i = 0; i < sizeof *inner; i += 64)
+        (void)*((volatile char *)inner + i);
+    for (unsigned i = 0; i <= inner->count; i++)
+        prefetch_recursive(inner->children[i], levels - 1, tx);
+}
+
+// Only the inner nodes are touched: the leaves are most of the tree.
+template <typename K>
+void BTreeIndex<K>::prefetch(unsigned levels)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    prefetch_recursive(_root, levels, tx);
+}
+
+// Explicitly instantiate any types that might be required
+template class BTreeIndex<long long>;
+template class BTreeIndex<bool>;
+template class BTreeIndex<double>;
+template class BTreeIndex<Time>;
+template class BTreeIndex<IndexString>;
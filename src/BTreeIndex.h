@@ -0,0 +1,148 @@
+/**
+ * @file   BTreeIndex.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "Index.h"
+#include "TransactionImpl.h"
+
+namespace PMGD {
+    class Allocator;
+    class PostingList;
+
+    // A B+-tree over the values of a property. Nodes are NODE_SIZE
+    // bytes with the keys packed together, so a search reads a few
+    // cache lines per level, and the leaves are linked both ways for
+    // range scans in either direction. Each leaf entry points to the
+    // posting list of its value, which stays where it is when entries
+    // move between leaves.
+    // Adding a value shifts the entries after it in one leaf and logs
+    // only those. Leaves are not merged when values are removed, and
+    // empty leaves stay in the tree for later values in their range.
+    // Data resides in PM
+    template <typename K> class BTreeIndex : public Index {
+        static const unsigned NODE_SIZE = 512;
+        static const unsigned MAX_HEIGHT = 16;
+
+        struct Node {
+            uint16_t count;
+            uint16_t leaf;
+            uint32_t unused;
+        };
+
+        // Keys go last so that small keys do not leave gaps.
+        struct Leaf : Node {
+            static const unsigned MAX_KEYS =
+                (NODE_SIZE - sizeof(Node) - 2 * sizeof(void *))
+                    / (sizeof(K) + sizeof(PostingList *));
+            Leaf *prev;
+            Leaf *next;
+            PostingList *values[MAX_KEYS];
+            K keys[MAX_KEYS];
+        };
+
+        // children[i] holds the keys from keys[i - 1] up to keys[i].
+        struct Inner : Node {
+            static const unsigned MAX_KEYS =
+                (NODE_SIZE - sizeof(Node) - sizeof(void *))
+                    / (sizeof(K) + sizeof(Node *));
+            Node *children[MAX_KEYS + 1];
+            K keys[MAX_KEYS];
+        };
+
+        // The nodes from the root down to a leaf, with the child
+        // taken at each
+        struct Path {
+            unsigned depth;
+            Node *nodes[MAX_HEIGHT];
+            unsigned slots[MAX_HEIGHT];
+        };
+
+        Node *_root;
+        uint32_t _height;
+
+        class BTree_IteratorImpl;
+
+        static unsigned lower_bound(Node *node, const K &key);
+        static unsigned upper_bound(Node *node, const K &key);
+
+        Leaf *find_leaf(const K &key, Path *path, TransactionImpl *tx);
+        Leaf *first_leaf(bool last, TransactionImpl *tx);
+        Leaf *new_leaf(Allocator &allocator);
+        Inner *new_inner(Allocator &allocator);
+        PostingList *insert(Path &path, unsigned pos, const K &key,
+                            Allocator &allocator, TransactionImpl *tx);
+        PostingList *split_leaf(Path &path, unsigned pos, const K &key,
+                                Allocator &allocator, TransactionImpl *tx);
+        void insert_inner(Path &path, unsigned level, K *sep, Node *child,
+                          bool copy_sep, Allocator &allocator,
+                          TransactionImpl *tx);
+
+        void stats_recursive(Node *node, Graph::IndexStats &stats);
+        void prefetch_recursive(Node *node, unsigned levels,
+                                TransactionImpl *tx);
+
+    public:
+        BTreeIndex(PropertyType ptype)
+            : Index(ptype, Graph::BPlusTree), _root(NULL), _height(0)
+        {
+            TransactionImpl *tx = TransactionImpl::get_tx();
+            tx->flush_range(this, sizeof *this);
+        }
+
+        // As for AvlTree: add returns the list for the key, adding it
+        // if needed, and both add and find with write_lock set leave
+        // the leaf with it write locked for changes to the list.
+        PostingList *add(const K &key, Allocator &allocator);
+        PostingList *find(const K &key, bool write_lock = false);
+        // Removes the key and its list, which must be empty.
+        void remove(const K &key, Allocator &allocator);
+
+        // Builds the tree, which must be empty, from keys in increasing
+        // order, level by level, leaving room in each node for later
+        // adds. Appends a new empty list for each key to lists.
+        void load(const std::vector<const K *> &keys,
+                  std::vector<PostingList *> &lists, Allocator &allocator);
+
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type, bool reverse);
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type, const K &key,
+                                                    PropertyPredicate::Op op, bool reverse);
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type, const K &min,
+                                                    const K &max, PropertyPredicate::Op op,
+                                                    bool reverse);
+
+        // For statistics
+        void index_stats_info(Graph::IndexStats &stats);
+
+        // Touch the top levels of the tree
+        void prefetch(unsigned levels);
+    };
+}
@@ -0,0 +1,320 @@
+/**
+ * @file   CompositeIndex.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "CompositeIndex.h"
+#include "PostingList.h"
+#include "GraphImpl.h"
+#include "node.h"
+#include "edge.h"
+#include "exception.h"
+
+using namespace PMGD;
+
+static void put_bits(std::string &key, uint64_t v)
+{
+    for (int shift = 56; shift >= 0; shift -= 8)
+        key += char(v >> shift);
+}
+
+// Appends bytes that compare as the value does against other values
+// of its type. Each value has a fixed length or a terminator, so a
+// shorter tuple sorts before the ones it starts.
+static void encode(std::string &key, const Property &p, const std::locale &loc)
+{
+    switch (p.type()) {
+        case PropertyType::Integer:
+            put_bits(key, uint64_t(p.int_value()) ^ uint64_t(1) << 63);
+            break;
+        case PropertyType::Time:
+            put_bits(key, uint64_t(p.time_value().time_val) ^ uint64_t(1) << 63);
+            break;
+        case PropertyType::Boolean:
+            key += char(p.bool_value());
+            break;
+        case PropertyType::Float: {
+            double d = p.float_value();
+            if (d == 0)
+                d = 0;
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof bits);
+            put_bits(key, bits >> 63 ? ~bits : bits | uint64_t(1) << 63);
+            break;
+        }
+        case PropertyType::String: {
+            // The collation key, as for IndexString, with a zero byte
+            // escaped as 0 0xff, and 0 0 at the end
+            const std::string &s = p.string_value();
+            const std::collate<char> &col = std::use_facet<std::collate<char> >(loc);
+            for (char c : col.transform(s.data(), s.data() + s.length())) {
+                key += c;
+                if (c == 0)
+                    key += char(0xff);
+            }
+            key += char(0);
+            key += char(0);
+            break;
+        }
+        default:
+            throw PMGDException(PropertyTypeInvalid);
+    }
+}
+
+void CompositeIndex::check_columns(const std::vector<Graph::IndexColumn> &columns)
+{
+    if (columns.empty() || columns.size() > MAX_COLUMNS)
+        throw PMGDException(InvalidConfig);
+    for (size_t i = 0; i < columns.size(); i++) {
+        switch (columns[i].ptype) {
+            case PropertyType::Integer:
+            case PropertyType::Float:
+            case PropertyType::Boolean:
+            case PropertyType::Time:
+            case PropertyType::String:
+                break;
+            default:
+                throw PMGDException(PropertyTypeInvalid);
+        }
+        if (columns[i].property_id == 0)
+            throw PMGDException(InvalidID);
+        for (size_t j = 0; j < i; j++)
+            if (columns[j].property_id == columns[i].property_id)
+                throw PMGDException(InvalidID);
+    }
+}
+
+CompositeIndex::CompositeIndex(const std::vector<Graph::IndexColumn> &columns)
+    : BTreeIndex<IndexString>(PropertyType::String),
+      _num_columns(columns.size())
+{
+    for (unsigned i = 0; i < _num_columns; i++) {
+        _ids[i] = columns[i].property_id;
+        _types[i] = columns[i].ptype;
+    }
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->flush_range(&_num_columns, sizeof *this - sizeof(BTreeIndex<IndexString>));
+}
+
+bool CompositeIndex::same_columns(const std::vector<Graph::IndexColumn> &columns) const
+{
+    if (columns.size() != _num_columns)
+        return false;
+    for (unsigned i = 0; i < _num_columns; i++)
+        if (columns[i].property_id != _ids[i] || columns[i].ptype != _types[i])
+            return false;
+    return true;
+}
+
+bool CompositeIndex::has_column(StringID id) const
+{
+    for (unsigned i = 0; i < _num_columns; i++)
+        if (_ids[i] == id)
+            return true;
+    return false;
+}
+
+void CompositeIndex::check_column_type(StringID id, PropertyType ptype) const
+{
+    for (unsigned i = 0; i < _num_columns; i++)
+        if (_ids[i] == id && ptype != _types[i])
+            throw PMGDException(PropertyTypeMismatch);
+}
+
+// The key of obj with value for property id and its own values for
+// the other columns, up to the first one it has no value for. False
+// if it has none for the first.
+bool CompositeIndex::get_key(std::string &key, Graph::IndexType index_type,
+                             void *obj, StringID id, const Property &value,
+                             const std::locale &loc) const
+{
+    key.clear();
+    for (unsigned i = 0; i < _num_columns; i++) {
+        Property p;
+        const Property *v = &value;
+        if (!(_ids[i] == id)) {
+            bool found = index_type == Graph::NodeIndex
+                         ? static_cast<PMGD::Node *>(obj)->check_property(_ids[i], p)
+                         : static_cast<PMGD::Edge *>(obj)->check_property(_ids[i], p);
+            if (!found)
+                break;
+            v = &p;
+        }
+        // A value set before the index was created may be of
+        // another type.
+        if (v->type() != _types[i])
+            break;
+        encode(key, *v, loc);
+    }
+    return !key.empty();
+}
+
+void CompositeIndex::add(Graph::IndexType index_type, const std::string &key,
+                         void *obj, GraphImpl *db)
+{
+    Allocator &allocator = db->allocator();
+    TransientIndexString istr(key);
+    PostingList *dest = BTreeIndex<IndexString>::add(istr, allocator);
+    dest->add(db->object_table(index_type).get_id(obj) - 1, allocator);
+}
+
+void CompositeIndex::remove(Graph::IndexType index_type, const std::string &key,
+                            void *obj, GraphImpl *db)
+{
+    Allocator &allocator = db->allocator();
+    TransientIndexString istr(key);
+    PostingList *dest = find(istr, true);
+    if (dest) {
+        dest->remove(db->object_table(index_type).get_id(obj) - 1, allocator);
+        if (dest->num_elems() == 0)
+            BTreeIndex<IndexString>::remove(istr, allocator);
+    }
+}
+
+void CompositeIndex::update(GraphImpl *db, Graph::IndexType index_type,
+                            void *obj, StringID id,
+                            const PropertyRef *old_value,
+                            const Property *new_value)
+{
+    // No value, like one of another type, ends the key at id.
+    Property old_p = old_value != NULL ? Property(*old_value) : Property();
+    Property new_p = new_value != NULL ? *new_value : Property();
+    std::string old_key, new_key;
+    bool had_key = get_key(old_key, index_type, obj, id, old_p, db->locale());
+    bool has_key = get_key(new_key, index_type, obj, id, new_p, db->locale());
+    if (had_key == has_key && old_key == new_key)
+        return;
+    if (had_key)
+        remove(index_type, old_key, obj, db);
+    if (has_key)
+        add(index_type, new_key, obj, db);
+}
+
+void CompositeIndex::remove(GraphImpl *db, Graph::IndexType index_type, void *obj)
+{
+    std::string key;
+    if (get_key(key, index_type, obj, db->locale()))
+        remove(index_type, key, obj, db);
+}
+
+unsigned CompositeIndex::plan(const std::vector<PropertyPredicate> &preds,
+                              std::vector<const PropertyPredicate *> &cols) const
+{
+    cols.clear();
+    for (unsigned i = 0; i < _num_columns; i++) {
+        const PropertyPredicate *eq = NULL;
+        const PropertyPredicate *range = NULL;
+        for (const PropertyPredicate &pp : preds) {
+            if (!(pp.id == _ids[i]))
+                continue;
+            if (pp.op == PropertyPredicate::Eq) {
+                eq = &pp;
+                break;
+            }
+            if (range == NULL && pp.op > PropertyPredicate::Ne
+                    && pp.op != PropertyPredicate::Prefix)
+                range = &pp;
+        }
+        const PropertyPredicate *pp = eq ? eq : range;
+        if (pp == NULL)
+            break;
+        if (pp->v1.type() != _types[i]
+                || (pp->op >= PropertyPredicate::GeLe && pp->v2.type() != _types[i]))
+            throw PMGDException(PropertyTypeMismatch);
+        cols.push_back(pp);
+        if (pp == range)
+            break;
+    }
+    return cols.size();
+}
+
+Index::Index_IteratorImplIntf *CompositeIndex::get_iterator(Graph::IndexType index_type,
+                                    const std::vector<const PropertyPredicate *> &cols,
+                                    const std::locale &loc, bool reverse)
+{
+    // The keys that start with the Eq values, narrowed by the range
+    // on the last column if there is one. Keys that end with the Eq
+    // values have no value for the range column.
+    std::string prefix;
+    for (const PropertyPredicate *pp : cols)
+        if (pp->op == PropertyPredicate::Eq)
+            encode(prefix, pp->v1, loc);
+    std::string min = prefix;
+    bool min_incl = true;
+    std::string max = prefix;
+    bool has_max = successor(max);
+
+    const PropertyPredicate *range = cols.back();
+    switch (range->op) {
+        case PropertyPredicate::Gt:
+        case PropertyPredicate::GtLe:
+        case PropertyPredicate::GtLt:
+            encode(min, range->v1, loc);
+            // Nothing comes after the greatest key.
+            if (!successor(min))
+                return BTreeIndex<IndexString>::get_iterator(index_type,
+                           TransientIndexString(prefix),
+                           TransientIndexString(prefix),
+                           PropertyPredicate::GtLt, reverse);
+            break;
+        case PropertyPredicate::Ge:
+        case PropertyPredicate::GeLe:
+        case PropertyPredicate::GeLt:
+            encode(min, range->v1, loc);
+            break;
+        case PropertyPredicate::Lt:
+        case PropertyPredicate::Le:
+            min_incl = false;
+            break;
+        default:
+            break;
+    }
+
+    const Property *upper = range->op >= PropertyPredicate::GeLe ? &range->v2
+                            : range->op >= PropertyPredicate::Lt ? &range->v1
+                            : NULL;
+    if (upper != NULL) {
+        max = prefix;
+        encode(max, *upper, loc);
+        if (range->op == PropertyPredicate::Le || range->op == PropertyPredicate::GeLe
+                || range->op == PropertyPredicate::GtLe)
+            has_max = successor(max);
+        else
+            has_max = true;
+    }
+
+    TransientIndexString lo(min);
+    if (!has_max)
+        return BTreeIndex<IndexString>::get_iterator(index_type, lo,
+                   min_incl ? PropertyPredicate::Ge : PropertyPredicate::Gt,
+                   reverse);
+    TransientIndexString hi(max);
+    return BTreeIndex<IndexString>::get_iterator(index_type, lo, hi,
+               min_incl ? PropertyPredicate::GeLt : PropertyPredicate::GtLt,
+               reverse);
+}
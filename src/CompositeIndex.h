@@ -0,0 +1,103 @@
+/**
+ * @file   CompositeIndex.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <locale>
+#include "BTreeIndex.h"
+#include "IndexString.h"
+
+namespace PMGD {
+    class GraphImpl;
+
+    // An index over several properties of the objects with a tag,
+    // ordered by the first, then the second, and so on. The key of an
+    // object strings together an encoding of each value that sorts
+    // the way the values do, so the keys are IndexStrings in a
+    // B+-tree, compared byte by byte. A key stops at the first
+    // property the object does not have, so that it still matches Eq
+    // on the ones before. Objects without the first are left out.
+    // Data resides in PM
+    class CompositeIndex : public BTreeIndex<IndexString> {
+    public:
+        static const unsigned MAX_COLUMNS = 8;
+
+    private:
+        uint32_t _num_columns;
+        StringID _ids[MAX_COLUMNS];
+        PropertyType _types[MAX_COLUMNS];
+
+        bool get_key(std::string &key, Graph::IndexType index_type, void *obj,
+                     StringID id, const Property &value,
+                     const std::locale &loc) const;
+        void add(Graph::IndexType index_type, const std::string &key,
+                 void *obj, GraphImpl *db);
+        void remove(Graph::IndexType index_type, const std::string &key,
+                    void *obj, GraphImpl *db);
+
+    public:
+        // Throws for an empty or overlong list, a property listed
+        // twice, or a type that cannot be indexed
+        static void check_columns(const std::vector<Graph::IndexColumn> &columns);
+
+        CompositeIndex(const std::vector<Graph::IndexColumn> &columns);
+
+        bool same_columns(const std::vector<Graph::IndexColumn> &columns) const;
+        bool has_column(StringID id) const;
+        // Throws if id is a column of another type
+        void check_column_type(StringID id, PropertyType ptype) const;
+
+        // Moves obj from its key with the old value of property id to
+        // its key with the new one. Either may be NULL. The caller
+        // checks the type of the new value.
+        void update(GraphImpl *db, Graph::IndexType index_type, void *obj,
+                    StringID id, const PropertyRef *old_value,
+                    const Property *new_value);
+
+        // Takes obj out of the index
+        void remove(GraphImpl *db, Graph::IndexType index_type, void *obj);
+
+        // The key of obj as it is, or false if it has none. This reads
+        // the properties without locking them. No column has id 0.
+        bool get_key(std::string &key, Graph::IndexType index_type, void *obj,
+                     const std::locale &loc) const
+            { return get_key(key, index_type, obj, 0, Property(), loc); }
+
+        // Picks the predicates that an iterator can serve: Eq on the
+        // leading columns and then, if there is one, a range on the
+        // next column. Returns how many there are.
+        unsigned plan(const std::vector<PropertyPredicate> &preds,
+                      std::vector<const PropertyPredicate *> &cols) const;
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type,
+                                     const std::vector<const PropertyPredicate *> &cols,
+                                     const std::locale &loc, bool reverse);
+    };
+}
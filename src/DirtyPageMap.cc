@@ -0,0 +1,222 @@
+/**
+ * @file   DirtyPageMap.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include "DirtyPageMap.h"
+#include "TransactionManager.h"
+#include "TransactionImpl.h"
+#include "os.h"
+
+using namespace PMGD;
+
+DirtyPageMap *DirtyPageMap::_active = NULL;
+
+static inline uint64_t align_page(uint64_t size)
+{
+    return (size + DirtyPageMap::PAGE_BYTES - 1) & ~(DirtyPageMap::PAGE_BYTES - 1);
+}
+
+// Bytes of bitmap needed for n bits, rounded to whole words
+static inline uint64_t bitmap_bytes(uint64_t n)
+{
+    return ((n + 63) / 64) * sizeof(uint64_t);
+}
+
+uint64_t DirtyPageMap::region_size(uint64_t span)
+{
+    uint64_t num_pages = span >> PAGE_SHIFT;
+    uint64_t summary_bits = (num_pages + (1ull << SUMMARY_SHIFT) - 1) >> SUMMARY_SHIFT;
+    return PAGE_BYTES + align_page(bitmap_bytes(summary_bits))
+                      + align_page(bitmap_bytes(num_pages));
+}
+
+DirtyPageMap::DirtyPageMap(uint64_t map_addr, bool create,
+                           uint64_t base, uint64_t span,
+                           uint64_t skip_begin, uint64_t skip_end,
+                           bool msync_needed, RangeSet &pending_commits)
+    : _hdr(reinterpret_cast<Header *>(map_addr)),
+      _base(base),
+      _num_pages(span >> PAGE_SHIFT),
+      _skip_begin(skip_begin),
+      _skip_end(skip_end)
+{
+    uint64_t summary_bits = (_num_pages + (1ull << SUMMARY_SHIFT) - 1) >> SUMMARY_SHIFT;
+    _summary = reinterpret_cast<uint64_t *>(map_addr + PAGE_BYTES);
+    _bitmap = reinterpret_cast<uint64_t *>(map_addr + PAGE_BYTES
+                                           + align_page(bitmap_bytes(summary_bits)));
+
+    if (create) {
+        _hdr->epoch = 0;
+        _hdr->num_pages = _num_pages;
+        TransactionImpl::flush_range(_hdr, sizeof *_hdr, msync_needed, pending_commits);
+    }
+    else if (_hdr->num_pages != _num_pages)
+        throw PMGDException(VersionMismatch, "dirty page map does not match graph");
+
+    _active = this;
+}
+
+DirtyPageMap::~DirtyPageMap()
+{
+    if (_active == this)
+        _active = NULL;
+}
+
+void DirtyPageMap::set_dirty(uint64_t page, bool msync_needed, RangeSet &pending_commits)
+{
+    uint64_t *word = &_bitmap[page >> 6];
+    if (bts(*word, page & 63))
+        return;
+    TransactionManager::flush(word, msync_needed, pending_commits);
+
+    uint64_t bpage = page >> SUMMARY_SHIFT;
+    uint64_t *sword = &_summary[bpage >> 6];
+    if (!(*sword & (1ull << (bpage & 63))) && !bts(*sword, bpage & 63))
+        TransactionManager::flush(sword, msync_needed, pending_commits);
+}
+
+// Call f with the address of each page whose bit is set, using the
+// summary to skip clean stretches of the bitmap.
+static void for_each_set(const uint64_t *summary, const uint64_t *bitmap,
+                         uint64_t base, uint64_t num_pages, unsigned summary_shift,
+                         std::function<void(uint64_t)> f)
+{
+    static const uint64_t WORDS_PER_BPAGE = DirtyPageMap::PAGE_BYTES / sizeof(uint64_t);
+    uint64_t summary_bits = (num_pages + (1ull << summary_shift) - 1) >> summary_shift;
+
+    for (uint64_t s = 0; s < summary_bits; s += 64) {
+        for (uint64_t sw = summary[s >> 6]; sw != 0; sw &= sw - 1) {
+            uint64_t bpage = s + __builtin_ctzll(sw);
+            uint64_t wend = (bpage + 1) * WORDS_PER_BPAGE;
+            uint64_t wmax = (num_pages + 63) / 64;
+            for (uint64_t w = bpage * WORDS_PER_BPAGE; w < wend && w < wmax; w++) {
+                for (uint64_t bw = bitmap[w]; bw != 0; bw &= bw - 1) {
+                    uint64_t page = w * 64 + __builtin_ctzll(bw);
+                    f(base + (page << DirtyPageMap::PAGE_SHIFT));
+                }
+            }
+        }
+    }
+}
+
+void DirtyPageMap::for_each_dirty(std::function<void(uint64_t)> f) const
+{
+    for_each_set(_summary, _bitmap, _base, _num_pages, SUMMARY_SHIFT, f);
+}
+
+// Clear the bitmap before the summary, so a crash part way
+// leaves every dirty page still reachable.
+struct DirtyPageMap::ClearBits {
+    template <PersistMode M>
+    static void run(uint64_t *summary, uint64_t *bitmap, uint64_t num_pages,
+                    bool msync_needed, RangeSet &pending_commits)
+    {
+        static const uint64_t WORDS_PER_BPAGE = PAGE_BYTES / sizeof(uint64_t);
+        uint64_t summary_bits = (num_pages + (1ull << SUMMARY_SHIFT) - 1) >> SUMMARY_SHIFT;
+
+        for (uint64_t s = 0; s < summary_bits; s += 64) {
+            uint64_t &sw = summary[s >> 6];
+            for (uint64_t bits = sw; bits != 0; bits &= bits - 1) {
+                uint64_t bpage = s + __builtin_ctzll(bits);
+                uint64_t *words = &bitmap[bpage * WORDS_PER_BPAGE];
+                for (uint64_t w = 0; w < WORDS_PER_BPAGE; w++) {
+                    if (words[w] != 0) {
+                        words[w] = 0;
+                        TransactionManager::flush<M>(&words[w], msync_needed, pending_commits);
+                    }
+                }
+            }
+            if (sw != 0) {
+                Persist<M>::commit(msync_needed, pending_commits);
+                sw = 0;
+                TransactionManager::flush<M>(&sw, msync_needed, pending_commits);
+            }
+        }
+    }
+};
+
+void DirtyPageMap::reset(uint64_t epoch, bool msync_needed, RangeSet &pending_commits)
+{
+    TransactionManager::with_mode<ClearBits>(_summary, _bitmap, _num_pages,
+                                             msync_needed, pending_commits);
+
+    _hdr->epoch = epoch;
+    TransactionManager::flush(_hdr, msync_needed, pending_commits);
+    TransactionManager::commit(msync_needed, pending_commits);
+}
+
+PageTracker *PageTracker::_active = NULL;
+
+PageTracker::PageTracker(uint64_t base, uint64_t span,
+                         uint64_t skip_begin, uint64_t skip_end)
+    : _base(base),
+      _num_pages(span >> DirtyPageMap::PAGE_SHIFT),
+      _skip_begin(skip_begin),
+      _skip_end(skip_end)
+{
+    // calloc leaves the untouched parts of a large map unbacked.
+    uint64_t summary_bits = (_num_pages + (1ull << SUMMARY_SHIFT) - 1) >> SUMMARY_SHIFT;
+    uint64_t summary_len = align_page(bitmap_bytes(summary_bits));
+    uint64_t *map = (uint64_t *)calloc(1, summary_len + align_page(bitmap_bytes(_num_pages)));
+    if (map == NULL)
+        throw PMGDException(BadAlloc);
+    _summary = map;
+    _bitmap = map + summary_len / sizeof(uint64_t);
+
+    memory_barrier();
+    _active = this;
+}
+
+PageTracker::~PageTracker()
+{
+    stop();
+    free(_summary);
+}
+
+void PageTracker::stop()
+{
+    if (_active == this)
+        _active = NULL;
+}
+
+void PageTracker::set(uint64_t page)
+{
+    if (bts(_bitmap[page >> 6], page & 63))
+        return;
+    uint64_t bpage = page >> SUMMARY_SHIFT;
+    uint64_t *sword = &_summary[bpage >> 6];
+    if (!(*sword & (1ull << (bpage & 63))))
+        bts(*sword, bpage & 63);
+}
+
+void PageTracker::for_each(std::function<void(uint64_t)> f) const
+{
+    for_each_set(_summary, _bitmap, _base, _num_pages, SUMMARY_SHIFT, f);
+}
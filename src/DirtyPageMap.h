@@ -0,0 +1,178 @@
+/**
+ * @file   DirtyPageMap.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include "arch.h"
+#include "RangeSet.h"
+
+namespace PMGD {
+    // Persistent record of the graph pages written since the last
+    // backup point, used to export incremental backups.
+    // The map covers the address range of all the graph regions,
+    // except the journal, with one bit per 4KB page. A summary bitmap
+    // with one bit per page of the main bitmap keeps scans short.
+    // Bits are set at flush points, so a page is marked before the
+    // commit that makes its new contents durable.
+    class DirtyPageMap {
+    public:
+        static const unsigned PAGE_SHIFT = 12;
+        static const uint64_t PAGE_BYTES = 1ull << PAGE_SHIFT;
+
+        struct Header {
+            uint64_t epoch;         // Last backup point taken
+            uint64_t num_pages;     // Pages covered by the map
+        };
+
+    private:
+        // Pages covered by one page of the bitmap
+        static const unsigned SUMMARY_SHIFT = PAGE_SHIFT + 3;
+
+        // There is at most one graph open per process, since graphs
+        // are mapped at a fixed address. Flush points find the map here.
+        static DirtyPageMap *_active;
+
+        Header *_hdr;
+        uint64_t *_summary;
+        uint64_t *_bitmap;
+
+        const uint64_t _base;
+        const uint64_t _num_pages;
+
+        // The journal is never needed in a copy with no active
+        // transactions, so it is not tracked.
+        const uint64_t _skip_begin;
+        const uint64_t _skip_end;
+
+        void set_dirty(uint64_t page, bool msync_needed, RangeSet &pending_commits);
+
+        // The clearing loop of reset, for one persistence mode
+        struct ClearBits;
+
+    public:
+        DirtyPageMap(const DirtyPageMap &) = delete;
+        void operator=(const DirtyPageMap &) = delete;
+
+        DirtyPageMap(uint64_t map_addr, bool create,
+                     uint64_t base, uint64_t span,
+                     uint64_t skip_begin, uint64_t skip_end,
+                     bool msync_needed, RangeSet &pending_commits);
+        ~DirtyPageMap();
+
+        // Size of the map region for a graph spanning span bytes
+        static uint64_t region_size(uint64_t span);
+
+        static void mark(void *addr, bool msync_needed, RangeSet &pending_commits);
+
+        uint64_t epoch() const { return _hdr->epoch; }
+        uint64_t num_pages() const { return _num_pages; }
+
+        // Call f with the address of each dirty page. Unless the graph
+        // is quiesced, pages that writers mark during the call may be
+        // left out.
+        void for_each_dirty(std::function<void(uint64_t)> f) const;
+
+        // Clear all bits and record a new backup point.
+        void reset(uint64_t epoch, bool msync_needed, RangeSet &pending_commits);
+    };
+
+    // Pages written while a snapshot copies the regions with writers
+    // running, so that it can catch up on just those pages once the
+    // writers are held back. Kept in DRAM, with the same layout and
+    // coverage as DirtyPageMap. Tracking lasts from construction
+    // until stop or destruction.
+    class PageTracker {
+        static const unsigned SUMMARY_SHIFT = DirtyPageMap::PAGE_SHIFT + 3;
+
+        static PageTracker *_active;
+
+        uint64_t *_summary;
+        uint64_t *_bitmap;
+
+        const uint64_t _base;
+        const uint64_t _num_pages;
+        const uint64_t _skip_begin;
+        const uint64_t _skip_end;
+
+        void set(uint64_t page);
+
+    public:
+        PageTracker(const PageTracker &) = delete;
+        void operator=(const PageTracker &) = delete;
+
+        PageTracker(uint64_t base, uint64_t span,
+                    uint64_t skip_begin, uint64_t skip_end);
+        ~PageTracker();
+
+        void stop();
+
+        static inline void mark(void *addr)
+        {
+            PageTracker *t = _active;
+            if (t == NULL)
+                return;
+
+            uint64_t offset = uint64_t(addr) - t->_base;
+            if (offset >= t->_num_pages << DirtyPageMap::PAGE_SHIFT
+                    || (uint64_t(addr) >= t->_skip_begin
+                        && uint64_t(addr) < t->_skip_end))
+                return;
+
+            uint64_t page = offset >> DirtyPageMap::PAGE_SHIFT;
+            if (!(t->_bitmap[page >> 6] & (1ull << (page & 63))))
+                t->set(page);
+        }
+
+        // Call f with the address of each page written. Tracking
+        // must have stopped.
+        void for_each(std::function<void(uint64_t)> f) const;
+    };
+
+    inline void DirtyPageMap::mark(void *addr, bool msync_needed, RangeSet &pending_commits)
+    {
+        PageTracker::mark(addr);
+
+        DirtyPageMap *map = _active;
+        if (map == NULL)
+            return;
+
+        uint64_t offset = uint64_t(addr) - map->_base;
+        if (offset >= map->_num_pages << PAGE_SHIFT
+                || (uint64_t(addr) >= map->_skip_begin
+                    && uint64_t(addr) < map->_skip_end))
+            return;
+
+        uint64_t page = offset >> PAGE_SHIFT;
+        if (!(map->_bitmap[page >> 6] & (1ull << (page & 63))))
+            map->set_dirty(page, msync_needed, pending_commits);
+    }
+};
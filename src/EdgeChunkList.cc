@@ -0,0 +1,294 @@
+/**
+ * @file   EdgeChunkList.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include <stddef.h>
+#include "EdgeChunkList.h"
+#include "Allocator.h"
+#include "TransactionImpl.h"
+#include "arch.h"
+
+using namespace PMGD;
+
+void EdgeChunkList::Position::skip(unsigned slot)
+{
+    while (true) {
+        while (_chunk != NULL) {
+            unsigned rest = _chunk->occupants & ~((1u << slot) - 1);
+            if (rest != 0) {
+                _slot = bsf(rest);
+                return;
+            }
+            _chunk = _chunk->next;
+            slot = 0;
+        }
+        if (_more == _end)
+            return;
+        _chunk = _more->list._head;
+        _more++;
+        slot = 0;
+    }
+}
+
+void EdgeChunkList::add(const EdgeNodePair *pairs, size_t count, void **chunks,
+                        Allocator &allocator, unsigned list)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    // Header fields are contiguous, so log them all at once.
+    tx->log(this, sizeof *this);
+
+    size_t i = 0;
+    while (i < count) {
+        Chunk *chunk = _head;
+        if (chunk == NULL || chunk->num_elems == chunk->slots) {
+            if (_hole != NULL)
+                chunk = _hole;
+            else
+                chunk = new_chunk(allocator, list);
+        }
+
+        // The slots are free, so an abort only has to restore the bitmap.
+        tx->log(&chunk->occupants, sizeof chunk->occupants + sizeof chunk->num_elems);
+        for (; i < count && chunk->num_elems < chunk->slots; i++) {
+            unsigned slot = bsf(unsigned(~chunk->occupants));
+            tx->write_nolog(&chunk->pairs[slot], pairs[i]);
+            chunk->occupants |= uint16_t(1 << slot);
+            chunk->num_elems++;
+            chunks[i] = chunk;
+        }
+
+        if (chunk == _hole && chunk->num_elems == chunk->slots)
+            _hole = NULL;
+    }
+    _num_elems += count;
+}
+
+// Where a pair can go between pred and succ, either of which may be
+// NULL, without moving them: in free slots [lo, hi] of chunk, or in a
+// new chunk after pred if chunk is NULL. The slots between the two are
+// free in an ordered list. Returns false if there are none in a chunk
+// holding both.
+static bool find_gap(EdgeChunkList::Chunk *pred, unsigned pred_slot,
+                     EdgeChunkList::Chunk *succ, unsigned succ_slot,
+                     EdgeChunkList::Chunk *&chunk, unsigned &lo, unsigned &hi)
+{
+    chunk = NULL;
+    lo = hi = 0;
+    unsigned end = (succ == pred) ? succ_slot : pred != NULL ? pred->slots : 0;
+    if (pred != NULL && pred_slot + 1 < end) {
+        chunk = pred;
+        lo = pred_slot + 1;
+        hi = end - 1;
+    }
+    else if (succ != NULL && succ != pred && succ_slot > 0) {
+        chunk = succ;
+        hi = succ_slot - 1;
+    }
+    return chunk != NULL || succ == NULL || succ != pred;
+}
+
+EdgeChunkList::Chunk *EdgeChunkList::add_ordered(const EdgeNodePair &pair,
+                                                 Allocator &allocator,
+                                                 unsigned list)
+{
+    // Find the pairs around this one's neighbor. A parallel edge can
+    // go after the pairs with the same neighbor or before them.
+    Node *node = pair.value();
+    Chunk *before = NULL, *first_same = NULL, *last = NULL, *after = NULL;
+    unsigned before_slot = 0, first_slot = 0, last_slot = 0, after_slot = 0;
+    for (Chunk *c = _head; c != NULL && after == NULL; c = c->next) {
+        unsigned bits = c->occupants;
+        while (bits != 0) {
+            unsigned s = bsf(bits);
+            Node *n = c->pairs[s].value();
+            if (node < n) {
+                after = c;
+                after_slot = s;
+                break;
+            }
+            if (n < node) {
+                before = c;
+                before_slot = s;
+            }
+            else if (first_same == NULL) {
+                first_same = c;
+                first_slot = s;
+            }
+            last = c;
+            last_slot = s;
+            bits &= bits - 1;
+        }
+    }
+
+    Chunk *pred = last, *succ = after, *chunk;
+    unsigned pred_slot = last_slot, succ_slot = after_slot, lo, hi;
+    if (!find_gap(pred, pred_slot, succ, succ_slot, chunk, lo, hi)) {
+        if (first_same == NULL)
+            return NULL;
+        pred = before;
+        pred_slot = before_slot;
+        succ = first_same;
+        succ_slot = first_slot;
+        if (!find_gap(pred, pred_slot, succ, succ_slot, chunk, lo, hi))
+            return NULL;
+    }
+
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->log(this, sizeof *this);
+    if (chunk == NULL) {
+        chunk = new_chunk(allocator, list, pred);
+        hi = chunk->slots - 1;
+    }
+
+    // Leave room on the side later pairs are likely to come from.
+    unsigned slot = succ == NULL ? lo : pred == NULL ? hi : (lo + hi) / 2;
+    tx->log(&chunk->occupants, sizeof chunk->occupants + sizeof chunk->num_elems);
+    tx->write_nolog(&chunk->pairs[slot], pair);
+    chunk->occupants |= uint16_t(1 << slot);
+    chunk->num_elems++;
+    if (chunk == _hole && chunk->num_elems == chunk->slots)
+        _hole = NULL;
+    _num_elems++;
+    return chunk;
+}
+
+// Caller has logged the list header. The chunk goes after prev, or at
+// the head if prev is NULL.
+EdgeChunkList::Chunk *EdgeChunkList::new_chunk(Allocator &allocator,
+                                               unsigned list, Chunk *prev)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    // Grow the chunks with the list: 2, 6 and then 14 slots.
+    unsigned size = MIN_CHUNK_SIZE;
+    while (size < CHUNK_SIZE && (size - HEADER_SIZE) / sizeof(EdgeNodePair) <= _num_elems)
+        size *= 2;
+    Chunk *chunk = (Chunk *)allocator.alloc(size);
+    Chunk *next = prev == NULL ? _head : prev->next;
+    chunk->next = next;
+    chunk->prev = prev;
+    chunk->occupants = 0;
+    chunk->num_elems = 0;
+    chunk->slots = uint8_t((size - HEADER_SIZE) / sizeof(EdgeNodePair));
+    chunk->list = uint8_t(list);
+    // New allocation, just flush the header without logging.
+    tx->flush_range(chunk, HEADER_SIZE);
+    if (next != NULL)
+        tx->write(&next->prev, chunk);
+    if (prev != NULL)
+        tx->write(&prev->next, chunk);
+    else
+        _head = chunk;
+    return chunk;
+}
+
+bool EdgeChunkList::find(const EdgeNodePair &pair, Chunk *&chunk,
+                         unsigned &slot) const
+{
+    const Edge *edge = pair.key();
+    for (Chunk *c = _head; c != NULL; c = c->next) {
+        unsigned bits = c->occupants;
+        while (bits != 0) {
+            unsigned s = bsf(bits);
+            if (c->pairs[s].key() == edge
+                    && (edge != NULL || c->pairs[s].value() == pair.value())) {
+                chunk = c;
+                slot = s;
+                return true;
+            }
+            bits &= bits - 1;
+        }
+    }
+    return false;
+}
+
+Node *EdgeChunkList::remove(const EdgeNodePair &pair, Allocator &allocator)
+{
+    Chunk *chunk;
+    unsigned slot;
+    if (find(pair, chunk, slot))
+        return remove(chunk, slot, allocator);
+    return NULL;
+}
+
+Node *EdgeChunkList::remove(const Edge *edge, Chunk *chunk, Allocator &allocator)
+{
+    unsigned bits = chunk->occupants;
+    while (bits != 0) {
+        unsigned slot = bsf(bits);
+        if (chunk->pairs[slot].key() == edge)
+            return remove(chunk, slot, allocator);
+        bits &= bits - 1;
+    }
+    return NULL;
+}
+
+Node *EdgeChunkList::remove(Chunk *chunk, unsigned slot, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    Node *node = chunk->pairs[slot].value();
+    tx->iterator_callbacks().iterator_remove_notify(&chunk->pairs[slot]);
+
+    tx->log(this, sizeof *this);
+    if (chunk->num_elems == 1) {
+        // Last pair in the chunk: unlink and free it.
+        if (chunk->prev != NULL)
+            tx->write(&chunk->prev->next, chunk->next);
+        else
+            _head = chunk->next;
+        if (chunk->next != NULL)
+            tx->write(&chunk->next->prev, chunk->prev);
+        if (_hole == chunk)
+            _hole = NULL;
+        allocator.free(chunk, chunk_size(chunk->slots));
+    }
+    else {
+        tx->log(&chunk->occupants, sizeof chunk->occupants + sizeof chunk->num_elems);
+        chunk->occupants &= uint16_t(~(1 << slot));
+        chunk->num_elems--;
+        if (chunk != _head)
+            _hole = chunk;
+    }
+    _num_elems--;
+    return node;
+}
+
+void EdgeChunkList::clear(Allocator &allocator)
+{
+    Chunk *chunk = _head;
+    while (chunk != NULL) {
+        Chunk *next = chunk->next;
+        allocator.free(chunk, chunk_size(chunk->slots));
+        chunk = next;
+    }
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->log(this, sizeof *this);
+    *this = EdgeChunkList();
+}
@@ -0,0 +1,175 @@
+/**
+ * @file   EdgeChunkList.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "KeyValuePair.h"
+
+namespace PMGD {
+    class Node;
+    class Edge;
+    class Allocator;
+
+    typedef KeyValuePair<Edge *, Node *> EdgeNodePair;
+
+    // Adjacency storage for one node and tag. (edge, neighbor) pairs
+    // are packed into chunks so a traversal reads them contiguously
+    // instead of chasing one list node per edge. A bitmap marks the
+    // occupied slots, so removal clears a bit; chunks are doubly linked
+    // so an empty one is unlinked without a walk. Chunks grow from 64
+    // to 256 bytes with the list, since most nodes have few edges.
+    // This class *lives* in PM, like List.
+    class EdgeChunkList {
+    public:
+        static const unsigned CHUNK_SIZE = 256;
+        static const unsigned HEADER_SIZE = 24;
+        static const unsigned MIN_CHUNK_SIZE = 64;
+        static const unsigned SLOTS = (CHUNK_SIZE - HEADER_SIZE) / sizeof(EdgeNodePair);
+        static const unsigned SEGMENT_SIZE = 64;
+
+        struct Chunk {
+            Chunk *next;
+            Chunk *prev;
+            uint16_t occupants;     // Bit i is set when pairs[i] is in use
+            uint8_t num_elems;      // In this chunk
+            uint8_t slots;          // Capacity of this chunk
+            uint8_t list;           // Which list of the owner it is on
+            EdgeNodePair pairs[SLOTS];
+        };
+
+        // A list padded out to a lock stripe, so that an array of them
+        // can be locked one at a time.
+        struct Segment;
+
+        // Allocation size of a chunk with the given capacity
+        static unsigned chunk_size(unsigned slots)
+        {
+            unsigned size = MIN_CHUNK_SIZE;
+            while (size < HEADER_SIZE + slots * sizeof(EdgeNodePair))
+                size *= 2;
+            return size;
+        }
+
+        // Iterates over the occupied slots, going on to the lists in
+        // [more, end) once this one runs out. A removal notifies
+        // iterators with the address of the pair.
+        class Position {
+            const Chunk *_chunk;
+            unsigned _slot;
+            const Segment *_more;
+            const Segment *_end;
+
+            void skip(unsigned slot);
+
+        public:
+            Position() : _chunk(NULL), _slot(0), _more(NULL), _end(NULL) { }
+            Position(const Chunk *chunk, const Segment *more = NULL,
+                     const Segment *end = NULL)
+                : _chunk(chunk), _slot(0), _more(more), _end(end)
+                { skip(0); }
+
+            operator bool() const { return _chunk != NULL; }
+            const EdgeNodePair *pair() const { return &_chunk->pairs[_slot]; }
+            Edge *edge() const { return _chunk->pairs[_slot].key(); }
+            Node *node() const { return _chunk->pairs[_slot].value(); }
+            bool next() { skip(_slot + 1); return _chunk != NULL; }
+        };
+
+    private:
+        Chunk *_head;
+        Chunk *_hole;           // Some chunk other than the head with a free slot
+        size_t _num_elems;
+
+        bool find(const EdgeNodePair &pair, Chunk *&chunk, unsigned &slot) const;
+        Chunk *new_chunk(Allocator &allocator, unsigned list, Chunk *prev = NULL);
+        Node *remove(Chunk *chunk, unsigned slot, Allocator &allocator);
+
+    public:
+        // Constructor for temporary objects. No need to log.
+        EdgeChunkList() : _head(NULL), _hole(NULL), _num_elems(0) { }
+
+        // Called as part of node creation. Will be flushed when
+        // the new object is flushed.
+        void init() { *this = EdgeChunkList(); }
+
+        // Returns the chunk the pair went into, which stays put until
+        // the pair is removed. New chunks are marked with list, so the
+        // owner of several lists can tell which one a chunk is on.
+        Chunk *add(const EdgeNodePair &pair, Allocator &allocator,
+                   unsigned list = 0)
+        {
+            void *chunk;
+            add(&pair, 1, &chunk, allocator, list);
+            return (Chunk *)chunk;
+        }
+
+        // For a list kept in neighbor order, adds the pair where it
+        // keeps that order: in a free slot between its neighbors or in
+        // a new chunk linked between theirs. No other pair moves, so
+        // this returns NULL, having added nothing, when the pair falls
+        // inside a full stretch of one chunk.
+        Chunk *add_ordered(const EdgeNodePair &pair, Allocator &allocator,
+                           unsigned list = 0);
+
+        // Adds count pairs, storing the chunk of pair i in chunks[i].
+        // The header and each chunk bitmap are logged once.
+        void add(const EdgeNodePair *pairs, size_t count, void **chunks,
+                 Allocator &allocator, unsigned list = 0);
+
+        // Both removes return the neighbor of the removed pair, or
+        // NULL if the edge was not found. Light edges have no edge
+        // record, so a pair with a NULL edge matches on the neighbor.
+        Node *remove(const EdgeNodePair &pair, Allocator &allocator);
+
+        // Remove given the chunk returned by add: a scan of one chunk
+        // instead of the whole list.
+        Node *remove(const Edge *edge, Chunk *chunk, Allocator &allocator);
+
+        // Frees every chunk. No iterators are notified.
+        void clear(Allocator &allocator);
+        size_t num_elems() const { return _num_elems; }
+        Position begin(const Segment *more = NULL, const Segment *end = NULL) const
+            { return Position(_head, more, end); }
+    };
+
+    struct EdgeChunkList::Segment {
+        EdgeChunkList list;
+        uint8_t pad[SEGMENT_SIZE - sizeof(EdgeChunkList)];
+    };
+
+    static_assert(offsetof(EdgeChunkList::Chunk, pairs) == EdgeChunkList::HEADER_SIZE,
+                  "Unexpected edge chunk header size");
+    static_assert(sizeof(EdgeChunkList::Chunk) <= EdgeChunkList::CHUNK_SIZE,
+                  "Edge chunk too large");
+    static_assert(sizeof(EdgeChunkList::Segment) == EdgeChunkList::SEGMENT_SIZE,
+                  "Unexpected edge segment size");
+}
@@ -27,13 +27,243 @@
  *
  */
 
+#include <algorithm>
 #include "EdgeIndex.h"
+#include "TransactionImpl.h"
 #include "exception.h"
 
 using namespace PMGD;
 
 namespace PMGD {
-    void EdgeIndex::add(StringID key, Edge* edge, Node* node,
+    EdgeChunkList::Chunk *EdgeIndex::EdgeIndexType::add_to_list(const EdgeNodePair &pair,
+                                                                Allocator &allocator)
+    {
+        // Past the threshold the neighbor tree takes over, and is
+        // built by the caller.
+        if (_ordered && _neighbors.empty()
+                && _list.num_elems() < NEIGHBOR_THRESHOLD) {
+            EdgeChunkList::Chunk *chunk = _list.add_ordered(pair, allocator);
+            if (chunk != NULL)
+                return chunk;
+            TransactionImpl::get_tx()->write(&_ordered, uint8_t(0));
+        }
+        return _list.add(pair, allocator);
+    }
+
+    void EdgeIndex::EdgeIndexType::removed_from_list()
+    {
+        // A single pair is in order again.
+        if (!_ordered && _neighbors.empty() && _list.num_elems() == 1)
+            TransactionImpl::get_tx()->write(&_ordered, uint8_t(1));
+    }
+
+    EdgeChunkList::Chunk *EdgeIndex::EdgeIndexType::add(const EdgeNodePair &pair,
+                                                        Allocator &allocator)
+    {
+        EdgeChunkList::Chunk *chunk = add_to_list(pair, allocator);
+        if (!_neighbors.empty())
+            add_neighbor(pair.key(), pair.value(), allocator);
+        else if (_list.num_elems() > NEIGHBOR_THRESHOLD)
+            build_neighbors(allocator);
+        return chunk;
+    }
+
+    void EdgeIndex::EdgeIndexType::add(const EdgeNodePair *pairs, size_t count,
+                                       void **pos, Allocator &allocator)
+    {
+        size_t i = 0;
+        for (; i < count && _ordered && _neighbors.empty()
+                   && _list.num_elems() < NEIGHBOR_THRESHOLD; i++)
+            pos[i] = add_to_list(pairs[i], allocator);
+        if (i < count)
+            _list.add(pairs + i, count - i, pos + i, allocator);
+        if (!_neighbors.empty()) {
+            for (size_t i = 0; i < count; i++)
+                add_neighbor(pairs[i].key(), pairs[i].value(), allocator);
+        }
+        else if (_list.num_elems() > NEIGHBOR_THRESHOLD)
+            build_neighbors(allocator);
+    }
+
+    EdgeChunkList::Chunk *EdgeIndex::EdgeIndexType::append(const EdgeNodePair &pair,
+                                                           Allocator &allocator)
+    {
+        if (_segments == NULL)
+            return NULL;
+        unsigned i = allocator.instance() % _num_segments;
+        EdgeChunkList::Segment *segment = &_segments[i];
+        TransactionImpl *tx = TransactionImpl::get_tx();
+        tx->acquire_lock(TransactionImpl::IndexLock, segment, true);
+        EdgeChunkList::Chunk *chunk = segment->list.add(pair, allocator, i + 1);
+        // The tree locks just the part of itself that changes.
+        add_neighbor(pair.key(), pair.value(), allocator);
+        return chunk;
+    }
+
+    void EdgeIndex::EdgeIndexType::lock_segments() const
+    {
+        // Appenders hold their segment until they commit, and only
+        // touch the tree while holding it.
+        TransactionImpl *tx = TransactionImpl::get_tx();
+        for (unsigned i = 0; i < _num_segments; i++)
+            tx->acquire_lock(TransactionImpl::IndexLock, &_segments[i], false);
+    }
+
+    void EdgeIndex::EdgeIndexType::remove(const EdgeNodePair &pair,
+                                          Allocator &allocator)
+    {
+        Node *node = _list.remove(pair, allocator);
+        for (unsigned i = 0; node == NULL && i < _num_segments; i++)
+            node = _segments[i].list.remove(pair, allocator);
+        if (node != NULL && !_neighbors.empty())
+            remove_neighbor(pair.key(), node, allocator);
+        removed_from_list();
+    }
+
+    void EdgeIndex::EdgeIndexType::remove(const Edge *edge,
+                                          EdgeChunkList::Chunk *chunk,
+                                          Allocator &allocator)
+    {
+        Node *node = list_of(chunk).remove(edge, chunk, allocator);
+        if (node != NULL && !_neighbors.empty())
+            remove_neighbor(edge, node, allocator);
+        removed_from_list();
+    }
+
+    size_t EdgeIndex::EdgeIndexType::num_elems()
+    {
+        size_t n = _list.num_elems();
+        for (unsigned i = 0; i < _num_segments; i++)
+            n += _segments[i].list.num_elems();
+        return n;
+    }
+
+    void EdgeIndex::EdgeIndexType::build_neighbors(Allocator &allocator)
+    {
+        // Once built, the tree is kept up to date until the bucket
+        // is removed, even if the bucket shrinks again.
+        for (EdgePosition pos = _list.begin(); pos; pos.next())
+            add_neighbor(pos.edge(), pos.node(), allocator);
+
+        // A bucket this busy is likely to see concurrent adds too.
+        build_segments(allocator);
+    }
+
+    void EdgeIndex::EdgeIndexType::build_segments(Allocator &allocator)
+    {
+        TransactionImpl *tx = TransactionImpl::get_tx();
+        unsigned n = std::min(allocator.num_instances(), unsigned(MAX_SEGMENTS));
+        size_t size = n * sizeof(EdgeChunkList::Segment);
+        EdgeChunkList::Segment *segments = (EdgeChunkList::Segment *)allocator.alloc(size);
+        for (unsigned i = 0; i < n; i++)
+            segments[i].list.init();
+        // New allocation, so flush without logging.
+        tx->flush_range(segments, size);
+        tx->write(&_num_segments, uint16_t(n));
+        tx->write(&_segments, segments);
+    }
+
+    void EdgeIndex::EdgeIndexType::add_neighbor(Edge *edge, Node *node,
+                                                Allocator &allocator)
+    {
+        // Logging done inside add for both
+        List<Edge *> *edges = _neighbors.add(node, allocator);
+        edges->add(edge, allocator);
+    }
+
+    void EdgeIndex::EdgeIndexType::remove_neighbor(const Edge *edge, Node *node,
+                                                   Allocator &allocator)
+    {
+        List<Edge *> *edges = _neighbors.find(node, true);
+        if (edges == NULL)
+            return;
+        edges->remove(const_cast<Edge *>(edge), allocator);
+        if (edges->num_elems() == 0)
+            _neighbors.remove(node, allocator);
+    }
+
+    void EdgeIndex::EdgeIndexType::add_ordered(long long order, Edge *edge,
+                                               Allocator &allocator)
+    {
+        List<Edge *> *edges = _order.add(order, allocator);
+        edges->add(edge, allocator);
+    }
+
+    void EdgeIndex::EdgeIndexType::remove_ordered(long long order, Edge *edge,
+                                                  Allocator &allocator)
+    {
+        List<Edge *> *edges = _order.find(order, true);
+        if (edges == NULL)
+            return;
+        edges->remove(edge, allocator);
+        if (edges->num_elems() == 0)
+            _order.remove(order, allocator);
+    }
+
+    void EdgeIndex::EdgeIndexType::get_ordered(long long min, long long max,
+                                               std::vector<OrderedSlot> &edges)
+    {
+        // As with the neighbor tree, List::remove notifies with the
+        // address of the value.
+        _order.visit(min, max, [this, &edges](const long long &order,
+                                              List<Edge *> &list) {
+            for (ListTraverser<Edge *> t(&list); t; t.next())
+                edges.push_back(OrderedSlot(order,
+                                            EdgeSlot{ t.ref(), &t.ref(), _key }));
+        });
+    }
+
+    void EdgeIndex::EdgeIndexType::clear(Allocator &allocator)
+    {
+        _list.clear(allocator);
+        if (!_neighbors.empty())
+            _neighbors.clear(allocator,
+                [&allocator](List<Edge *> &edges) { edges.clear(allocator); });
+        if (!_order.empty())
+            _order.clear(allocator,
+                [&allocator](List<Edge *> &edges) { edges.clear(allocator); });
+        if (_segments != NULL) {
+            for (unsigned i = 0; i < _num_segments; i++)
+                _segments[i].list.clear(allocator);
+            allocator.free(_segments, _num_segments * sizeof *_segments);
+            TransactionImpl *tx = TransactionImpl::get_tx();
+            tx->write(&_segments, (EdgeChunkList::Segment *)NULL);
+            tx->write(&_num_segments, uint16_t(0));
+        }
+    }
+
+    void EdgeIndex::EdgeIndexType::get_edges_to(Node *node,
+                                                std::vector<EdgeSlot> &edges)
+    {
+        lock_segments();
+        if (!_neighbors.empty()) {
+            List<Edge *> *list = _neighbors.find(node);
+            // The value is the first member of a list node, so its
+            // address is also what List::remove notifies with.
+            for (ListTraverser<Edge *> t(list); t; t.next())
+                edges.push_back(EdgeSlot{ t.ref(), &t.ref(), _key });
+            return;
+        }
+        for (EdgePosition pos = _list.begin(); pos; pos.next())
+            if (pos.node() == node)
+                edges.push_back(EdgeSlot{ pos.edge(), pos.pair(), _key });
+    }
+
+    bool EdgeIndex::EdgeIndexType::get_neighbors(std::vector<Node *> &neighbors)
+    {
+        // The tree has each neighbor once, in order.
+        lock_segments();
+        if (!_neighbors.empty()) {
+            _neighbors.visit([&neighbors](Node *const &node, List<Edge *> &)
+                                 { neighbors.push_back(node); });
+            return true;
+        }
+        for (EdgePosition pos = _list.begin(); pos; pos.next())
+            neighbors.push_back(pos.node());
+        return _ordered || _list.num_elems() <= 1;
+    }
+
+    void *EdgeIndex::add(StringID key, Edge* edge, Node* node,
             Allocator &allocator)
     {
         // Temporary DRAM object for searching the key data structure
@@ -52,10 +282,29 @@ namespace PMGD {
         }
 
         // Logging done inside add
-        ptr->add(addrs, allocator);
+        return ptr->add(addrs, allocator);
+    }
+
+    void *EdgeIndex::append(StringID key, Edge* edge, Node* node,
+                            Allocator &allocator)
+    {
+        EdgeIndexType *ptr = _key_list.find(EdgeIndexType(key));
+        if (ptr == NULL)
+            return NULL;
+        return ptr->append(EdgeNodePair(edge, node), allocator);
+    }
+
+    void EdgeIndex::add(StringID key, const EdgeNodePair *pairs, size_t count,
+                        void **pos, Allocator &allocator)
+    {
+        EdgeIndexType newkey(key);
+        EdgeIndexType *ptr = _key_list.find(newkey);
+        if (ptr == NULL)
+            ptr = _key_list.add(newkey, allocator);
+        ptr->add(pairs, count, pos, allocator);
     }
 
-    const EdgeIndex::EdgePosition *EdgeIndex::get_first(StringID key)
+    EdgeIndex::EdgePosition EdgeIndex::get_first(StringID key)
     {
         EdgeIndexType newkey(key);
         // Construct the entry for search in the list
@@ -64,10 +313,11 @@ namespace PMGD {
         EdgeIndexType *ptr = _key_list.find(newkey);
         if (ptr != NULL)
             return ptr->get_first();
-        return NULL;
+        return EdgePosition();
     }
 
-    void EdgeIndex::remove(StringID key, Edge* edge, Allocator &allocator)
+    void EdgeIndex::remove(StringID key, Edge* edge, Allocator &allocator,
+                           void *pos)
     {
         // Construct the entry that gets removed from the list
         EdgeIndexType newkey(key);
@@ -79,11 +329,122 @@ namespace PMGD {
         if (ptr != NULL) {
             // Logging for both the steps handled in the remove function
             // First remove from internal data structure
-            ptr->remove(addrs, allocator);
+            if (pos != NULL)
+                ptr->remove(edge, (EdgeChunkList::Chunk *)pos, allocator);
+            else
+                ptr->remove(addrs, allocator);
             // If no more edges in that tag bucket, remove the bucket
-            if (ptr->num_elems() == 0)
+            // along with its segments
+            if (ptr->num_elems() == 0) {
+                ptr->clear(allocator);
                 _key_list.remove(newkey, allocator);
+            }
+            return;
+        }
+    }
+
+    void EdgeIndex::remove(StringID key, Edge *const *edges, void *const *pos,
+                           size_t count, Allocator &allocator)
+    {
+        EdgeIndexType newkey(key);
+        EdgeIndexType *ptr = _key_list.find(newkey);
+        if (ptr == NULL)
             return;
+        for (size_t i = 0; i < count; i++) {
+            if (pos[i] != NULL)
+                ptr->remove(edges[i], (EdgeChunkList::Chunk *)pos[i], allocator);
+            else
+                ptr->remove(EdgeNodePair(edges[i], NULL), allocator);
         }
+        if (ptr->num_elems() == 0) {
+            ptr->clear(allocator);
+            _key_list.remove(newkey, allocator);
+        }
+    }
+
+    void EdgeIndex::remove_light(StringID key, Node *node, Allocator &allocator)
+    {
+        EdgeIndexType newkey(key);
+        EdgeIndexType *ptr = _key_list.find(newkey);
+        if (ptr == NULL)
+            return;
+        ptr->remove(EdgeNodePair(NULL, node), allocator);
+        if (ptr->num_elems() == 0) {
+            ptr->clear(allocator);
+            _key_list.remove(newkey, allocator);
+        }
+    }
+
+    void EdgeIndex::get_edges_to(StringID key, const Node *node,
+                                 std::vector<EdgeSlot> &edges)
+    {
+        Node *n = const_cast<Node *>(node);
+        if (key != 0) {
+            EdgeIndexType *ptr = _key_list.find(EdgeIndexType(key));
+            if (ptr != NULL)
+                ptr->get_edges_to(n, edges);
+            return;
+        }
+        for (KeyPosition *k = _key_list._list; k != NULL; k = k->next)
+            k->value.get_edges_to(n, edges);
+    }
+
+    void EdgeIndex::clear(Allocator &allocator)
+    {
+        for (KeyPosition *k = _key_list._list; k != NULL; k = k->next)
+            k->value.clear(allocator);
+        _key_list.clear(allocator);
+    }
+
+    bool EdgeIndex::get_neighbors(StringID key, std::vector<Node *> &neighbors)
+    {
+        if (key != 0) {
+            EdgeIndexType *ptr = _key_list.find(EdgeIndexType(key));
+            return ptr == NULL || ptr->get_neighbors(neighbors);
+        }
+        size_t runs = 0;
+        bool sorted = true;
+        for (KeyPosition *k = _key_list._list; k != NULL; k = k->next, runs++)
+            sorted = k->value.get_neighbors(neighbors) && sorted;
+        return runs <= 1 && sorted;
+    }
+
+    bool EdgeIndex::get_pairs(size_t max,
+                              std::vector<std::pair<StringID, EdgeNodePair>> &pairs)
+    {
+        for (KeyPosition *k = _key_list._list; k != NULL; k = k->next) {
+            for (EdgePosition pos = k->value.get_first(); pos; pos.next()) {
+                if (max == 0)
+                    return false;
+                pairs.push_back(std::make_pair(k->value.get_key(),
+                                               EdgeNodePair(pos.edge(), pos.node())));
+                max--;
+            }
+        }
+        return true;
+    }
+
+    void EdgeIndex::add_ordered(StringID key, long long order, Edge *edge,
+                                Allocator &allocator)
+    {
+        EdgeIndexType *ptr = _key_list.find(EdgeIndexType(key));
+        if (ptr != NULL)
+            ptr->add_ordered(order, edge, allocator);
+    }
+
+    void EdgeIndex::remove_ordered(StringID key, long long order, Edge *edge,
+                                   Allocator &allocator)
+    {
+        EdgeIndexType *ptr = _key_list.find(EdgeIndexType(key));
+        if (ptr != NULL)
+            ptr->remove_ordered(order, edge, allocator);
+    }
+
+    void EdgeIndex::get_ordered(StringID key, long long min, long long max,
+                                std::vector<OrderedSlot> &edges)
+    {
+        EdgeIndexType *ptr = _key_list.find(EdgeIndexType(key));
+        if (ptr != NULL)
+            ptr->get_ordered(min, max, edges);
     }
 }
@@ -30,9 +30,12 @@
 #pragma once
 
 #include <stddef.h>
+#include <vector>
 #include "Allocator.h"
 #include "stringid.h"
 #include "List.h"
+#include "EdgeChunkList.h"
+#include "AvlTree.h"
 #include "exception.h"
 #include "node.h"
 #include "edge.h"
@@ -44,28 +47,86 @@ namespace PMGD {
     class EdgeIndex {
         class EdgeIndexType;
     public:
-        typedef KeyValuePair<Edge *, Node *> EdgeNodePair;
-        typedef List<EdgeNodePair> EdgeList;
-        typedef List<EdgeNodePair>::ListType EdgePosition;
+        typedef PMGD::EdgeNodePair EdgeNodePair;
+        typedef EdgeChunkList EdgeList;
+        typedef EdgeChunkList::Position EdgePosition;
         typedef List<EdgeIndexType>::ListType KeyPosition;
+
+        // An edge to a given neighbor, NULL if the edge is light, and
+        // the address a removal of that edge will notify iterators with.
+        struct EdgeSlot {
+            Edge *edge;
+            const void *pos;
+            StringID tag;
+        };
+        // An edge in the ordered adjacency, with its order key
+        typedef std::pair<long long, EdgeSlot> OrderedSlot;
     private:
+        typedef AvlTree<Node *, List<Edge *>> NeighborTree;
+        typedef AvlTree<long long, List<Edge *>> OrderTree;
+
         class EdgeIndexType {
+            // Past this many edges, a tag bucket also keeps its edges
+            // keyed by neighbor, so finding the edges to one neighbor
+            // does not scan the whole bucket.
+            static const size_t NEIGHBOR_THRESHOLD = 64;
+
+            // Most sub-lists a busy bucket gets for concurrent appends
+            static const unsigned MAX_SEGMENTS = 16;
+
             // Tag values
             StringID _key;
+            uint16_t _num_segments;
+            // Set while the pairs in _list are in neighbor order, so a
+            // small bucket lists its neighbors sorted without a tree.
+            // Pairs never move, since removal finds an edge by its
+            // chunk and iterators hold a slot, so an add that cannot
+            // keep the order clears this. Graphs from before it was
+            // kept have 0 here.
+            uint8_t _ordered;
             // List of Edge, (src/dest) Node references
             EdgeList _list;
+            // Neighbor to edges, empty until the threshold is crossed.
+            // Node addresses sort the same as node ids.
+            NeighborTree _neighbors;
+            // Sub-lists for appends that only read lock the node, one
+            // per allocator instance. Created with the neighbor tree
+            // when there is more than one instance. A chunk on
+            // segment i has list i + 1.
+            EdgeChunkList::Segment *_segments;
+            // Order key to edges, for a tag with an edge order. Only
+            // the edges that have the order property are here.
+            OrderTree _order;
+
+            EdgeChunkList::Chunk *add_to_list(const EdgeNodePair &pair,
+                                              Allocator &allocator);
+            void removed_from_list();
+            void build_neighbors(Allocator &allocator);
+            void build_segments(Allocator &allocator);
+            void add_neighbor(Edge *edge, Node *node, Allocator &allocator);
+            void remove_neighbor(const Edge *edge, Node *node, Allocator &allocator);
+            void lock_segments() const;
+            EdgeList &list_of(const EdgeChunkList::Chunk *chunk)
+                { return chunk->list == 0 ? _list : _segments[chunk->list - 1].list; }
 
         public:
             // Use for temp objects
             // List should get a default constructor which is fine
-            EdgeIndexType(StringID key): _key(key), _list() {}
+            EdgeIndexType(StringID key)
+                : _key(key), _num_segments(0), _ordered(1), _list(), _neighbors(),
+                  _segments(NULL), _order() {}
 
             // This is used inside add() for the data structure. That value
             // then gets flushed in there. So no need to log here
             EdgeIndexType& operator= (const EdgeIndexType &src)
             {
                 _key = src._key;
+                _num_segments = src._num_segments;
+                _ordered = src._ordered;
                 _list = src._list;
+                _neighbors = src._neighbors;
+                _segments = src._segments;
+                _order = src._order;
                 return *this;
             }
             bool operator==(const EdgeIndexType& val2) const
@@ -78,27 +139,47 @@ namespace PMGD {
             }
 
             // Use when list exists
-            void add(const EdgeNodePair &pair, Allocator &allocator)
-            {
-                _list.add(pair, allocator);
-            }
-            void remove(const EdgeNodePair &pair, Allocator &allocator)
+            EdgeChunkList::Chunk *add(const EdgeNodePair &pair, Allocator &allocator);
+            void add(const EdgeNodePair *pairs, size_t count, void **pos,
+                     Allocator &allocator);
+            // Adds to the segment of the current transaction's allocator
+            // instance, write locking only that segment. Returns NULL if
+            // the bucket has no segments.
+            EdgeChunkList::Chunk *append(const EdgeNodePair &pair,
+                                         Allocator &allocator);
+            void remove(const EdgeNodePair &pair, Allocator &allocator);
+            void remove(const Edge *edge, EdgeChunkList::Chunk *chunk,
+                        Allocator &allocator);
+            size_t num_elems();
+            void clear(Allocator &allocator);
+
+            // Appends the edges whose other end is node
+            void get_edges_to(Node *node, std::vector<EdgeSlot> &edges);
+
+            void add_ordered(long long order, Edge *edge, Allocator &allocator);
+            void remove_ordered(long long order, Edge *edge, Allocator &allocator);
+            void get_ordered(long long min, long long max,
+                             std::vector<OrderedSlot> &edges);
+
+            // Appends the neighbors, returning true if they were
+            // appended in order. Parallel edges repeat a neighbor.
+            bool get_neighbors(std::vector<Node *> &neighbors);
+
+            // For iterators. Covers the segments too, once any
+            // appends to them have committed.
+            EdgePosition get_first() const
             {
-                _list.remove(pair, allocator);
+                lock_segments();
+                return _list.begin(_segments, _segments + _num_segments);
             }
-            size_t num_elems() { return _list.num_elems(); }
-
-            // For iterators
-            const EdgePosition *get_first() const { return _list.begin(); }
             const StringID &get_key() const { return _key; }
         };
 
         // Data structure for the keys that come in. Choosing a list
         // since there shouldn't be too many tags per node. Eventually
         // we can make this adaptive.
-        // The second element is how the pairs will be organized.
-        // Choosing a simple list for that too since all pairs are always
-        // traversed
+        // The second element is how the pairs will be organized:
+        // packed into chunks since all pairs are always traversed.
         List<EdgeIndexType> _key_list;
 
     public:
@@ -113,18 +194,65 @@ namespace PMGD {
             return edge_table;
         }
 
+        // Frees whatever edges are left along with the index
         static void free(EdgeIndex *edge_table, Allocator &allocator)
         {
+            edge_table->clear(allocator);
             allocator.free(edge_table, sizeof *edge_table);
         }
 
-        void add(const StringID key, Edge* edge, Node* node, Allocator &allocator);
+        // Returns where the pair went, for remove
+        void *add(const StringID key, Edge* edge, Node* node, Allocator &allocator);
+        // As add, for a caller holding only a read lock on the node.
+        // Returns NULL if the bucket for key has no segments, in which
+        // case the caller needs the write lock and add.
+        void *append(const StringID key, Edge* edge, Node* node,
+                     Allocator &allocator);
+        // Adds count pairs under one tag, with pos[i] set as add()
+        // would return for pairs[i]
+        void add(const StringID key, const EdgeNodePair *pairs, size_t count,
+                 void **pos, Allocator &allocator);
         // For the iterator, give it head of PairList for the key
-        const EdgePosition *get_first(StringID key);
+        EdgePosition get_first(StringID key);
         // For the iterator, give it head of the key list
         const KeyPosition *get_first() { return _key_list.begin(); }
         size_t num_elems() { return _key_list.num_elems(); }
-        // This will remove the element based on edge pointer value
-        void remove(const StringID key, Edge* edge, Allocator& allocator);
+        // This will remove the element based on edge pointer value.
+        // With the position returned by add, it does not search.
+        void remove(const StringID key, Edge* edge, Allocator& allocator,
+                    void *pos = NULL);
+        // Removes count edges with the same tag, with the positions
+        // add returned for them
+        void remove(const StringID key, Edge *const *edges, void *const *pos,
+                    size_t count, Allocator &allocator);
+        // Removes one light edge to node. They are all alike.
+        void remove_light(const StringID key, Node *node, Allocator &allocator);
+        // Frees all the tag buckets without notifying iterators. The
+        // edges stay in the index of the node at their other end.
+        void clear(Allocator &allocator);
+        // Appends the edges to node with the given tag, or with any
+        // tag if the tag is 0.
+        void get_edges_to(const StringID key, const Node *node,
+                          std::vector<EdgeSlot> &edges);
+        // Appends the neighbors through edges with the given tag, or
+        // with any tag if the tag is 0. Returns true if they were
+        // appended in order, possibly with repeats.
+        bool get_neighbors(const StringID key, std::vector<Node *> &neighbors);
+
+        // Appends up to max of the pairs with their tags, for bulk
+        // removal. Returns false if there were more.
+        bool get_pairs(size_t max,
+                       std::vector<std::pair<StringID, EdgeNodePair>> &pairs);
+
+        // Ordered adjacency for tags with an edge order. The edge has
+        // to be in the index already. Removing an edge that is not in
+        // the order does nothing.
+        void add_ordered(const StringID key, long long order, Edge *edge,
+                         Allocator &allocator);
+        void remove_ordered(const StringID key, long long order, Edge *edge,
+                            Allocator &allocator);
+        // Appends the edges with order keys in [min, max], in key order
+        void get_ordered(const StringID key, long long min, long long max,
+                         std::vector<OrderedSlot> &edges);
     };
 }
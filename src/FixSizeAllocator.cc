@@ -56,6 +56,8 @@ AllocatorUnit::FixSizeAllocator::FixSizeAllocator(FlexFixedAllocator &allocator,
 
     _chunk_to_scan = hdr->start_chunk;
     _last_chunk_scanned = NULL;
+    _logged_tx = 0;
+    _logged_chunk = NULL;
 
     _max_spots = (SMALL_CHUNK_SIZE - ALLOC_OFFSET(_bitmap_ints, _obj_size)) /
                           _obj_size;
@@ -81,7 +83,8 @@ AllocatorUnit::FixSizeAllocator::FixedChunk::FixedChunk(unsigned alloc_id,
 }
 
 void *AllocatorUnit::FixSizeAllocator::FixedChunk::alloc(unsigned obj_size,
-                                                        unsigned bitmap_ints)
+                                                        unsigned bitmap_ints,
+                                                        bool logged)
 {
     // Next index may point to a free spot in a chunk where there
     // is free space. Make allocs fast.
@@ -121,10 +124,8 @@ void *AllocatorUnit::FixSizeAllocator::FixedChunk::alloc(unsigned obj_size,
 
 found:
     TransactionImpl *tx = TransactionImpl::get_tx();
-    tx->log_range(&free_spots, &next_index);
-    // *** Could combine the next one in the range if logging just the first
-    // int
-    tx->log(&occupants[main_idx], sizeof(uint32_t));
+    if (!logged)
+        tx->log_range(&free_spots, &occupants[bitmap_ints - 1]);
     --free_spots;
     occupants[main_idx] |= mask;
     next_index = index + 1;
@@ -135,6 +136,15 @@ found:
                + (obj_size * index);
 }
 
+void *AllocatorUnit::FixSizeAllocator::alloc(FixedChunk *chunk)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    bool logged = chunk == _logged_chunk && tx->tx_id() == _logged_tx;
+    _logged_tx = tx->tx_id();
+    _logged_chunk = chunk;
+    return chunk->alloc(_obj_size, _bitmap_ints, logged);
+}
+
 void *AllocatorUnit::FixSizeAllocator::alloc()
 {
     void *addr = NULL;
@@ -145,7 +155,7 @@ void *AllocatorUnit::FixSizeAllocator::alloc()
     // Check the vector first.
     if (it != _free_chunks.end()) {
         FixedChunk *dst_chunk = *it;
-        addr = dst_chunk->alloc(_obj_size, _bitmap_ints);
+        addr = alloc(dst_chunk);
 
         // If the chunk is in the list, it should have space.
         assert(addr != NULL);
@@ -171,7 +181,7 @@ void *AllocatorUnit::FixSizeAllocator::alloc()
         // in a sequence.
         if (dst_chunk->free_spots > 0) {
 
-            addr = dst_chunk->alloc(_obj_size, _bitmap_ints);
+            addr = alloc(dst_chunk);
 
             // For later scans
             if (dst_chunk->free_spots > 0)
@@ -213,7 +223,7 @@ void *AllocatorUnit::FixSizeAllocator::alloc()
     }
     _last_chunk_scanned = dst_chunk;
 
-    addr = dst_chunk->alloc(_obj_size, _bitmap_ints);
+    addr = alloc(dst_chunk);
 
     // Since we just allocated an entire chunk for one request,
     // it obviously has space left. So add it to that list. And that
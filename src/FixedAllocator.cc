@@ -36,6 +36,7 @@
 
 #include <stddef.h>
 #include <assert.h>
+#include <algorithm>
 
 #include "exception.h"
 #include "FixedAllocator.h"
@@ -48,7 +49,10 @@ FixedAllocator::FixedAllocator(uint64_t pool_addr, RegionHeader *hdr_addr,
                                uint32_t object_size, uint64_t pool_size,
                                CommonParams &params)
     : _pm(hdr_addr),
-      _pool_addr(pool_addr)
+      _pool_addr(pool_addr),
+      _slabs(NULL),
+      _num_slabs(0),
+      _slab_block(0)
 {
     if ((uint64_t)hdr_addr == pool_addr)
         _alloc_offset = ALLOC_OFFSET(params.create ? object_size : _pm->size);
@@ -81,6 +85,18 @@ FixedAllocator::FixedAllocator(uint64_t pool_addr,
                      params)
 { }
 
+// The slabs are zeroed, and so empty, when the graph is created.
+FixedAllocator::FixedAllocator(uint64_t pool_addr,
+                               uint32_t object_size, uint64_t pool_size,
+                               Slab *slabs, unsigned num_slabs,
+                               unsigned slab_block, CommonParams &params)
+    : FixedAllocator(pool_addr, object_size, pool_size, params)
+{
+    _slabs = slabs;
+    _num_slabs = num_slabs;
+    _slab_block = slab_block;
+}
+
 void *FixedAllocator::alloc()
 {
     TransactionImpl *tx = TransactionImpl::get_tx();
@@ -113,6 +129,119 @@ void *FixedAllocator::alloc()
     return p;
 }
 
+void FixedAllocator::alloc(size_t count, std::vector<void *> &objs)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    tx->log_range(&_pm->tail_ptr, &_pm->num_allocated);
+    _pm->num_allocated += count;
+
+    // Same order as alloc(): the free list first, then the tail.
+    for (; count > 0 && _pm->free_ptr != NULL; count--) {
+        uint64_t *p = _pm->free_ptr;
+        tx->log(p, sizeof(uint64_t));
+        *p &= ~FREE_BIT;
+        _pm->free_ptr = (uint64_t *)*_pm->free_ptr;
+        objs.push_back(p);
+    }
+
+    if (((uint64_t)_pm->tail_ptr + count * _pm->size) > _pm->max_addr)
+        throw PMGDException(BadAlloc);
+
+    for (; count > 0; count--) {
+        objs.push_back(_pm->tail_ptr);
+        _pm->tail_ptr = (uint64_t *)((uint64_t)_pm->tail_ptr + _pm->size);
+    }
+}
+
+void *FixedAllocator::alloc(Slab *slab)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    tx->log_range(&slab->next, &slab->num_allocated);
+
+    uint64_t *p;
+    if (slab->free_ptr != NULL) {
+        p = slab->free_ptr;
+        tx->log(p, sizeof(uint64_t));
+        *p &= ~FREE_BIT;
+        slab->free_ptr = (uint64_t *)*p;
+    }
+    else {
+        if (slab->next == slab->end)
+            refill(slab, 1);
+        p = slab->next;
+        slab->next = (uint64_t *)((uint64_t)p + _pm->size);
+
+        // Unlike at the tail, the object stays in the table if the
+        // transaction rolls back, so it has to be marked free again.
+        tx->log(p, sizeof(uint64_t));
+    }
+
+    slab->num_allocated++;
+
+    return p;
+}
+
+void FixedAllocator::alloc(Slab *slab, size_t count, std::vector<void *> &objs)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    tx->log_range(&slab->next, &slab->num_allocated);
+    slab->num_allocated += count;
+
+    for (; count > 0 && slab->free_ptr != NULL; count--) {
+        uint64_t *p = slab->free_ptr;
+        tx->log(p, sizeof(uint64_t));
+        *p &= ~FREE_BIT;
+        slab->free_ptr = (uint64_t *)*p;
+        objs.push_back(p);
+    }
+
+    while (count > 0) {
+        if (slab->next == slab->end)
+            refill(slab, count);
+
+        // As in alloc(), logged so that they are marked free again
+        // on a rollback; one range for the lot is fewer entries.
+        size_t n = std::min<size_t>(count,
+                       ((uint64_t)slab->end - (uint64_t)slab->next) / _pm->size);
+        tx->log(slab->next, n * _pm->size);
+        for (; n > 0; n--, count--) {
+            objs.push_back(slab->next);
+            slab->next = (uint64_t *)((uint64_t)slab->next + _pm->size);
+        }
+    }
+}
+
+// Moves the tail past at least count objects, up to a multiple of
+// the slab block, so that slabs never share a block. The objects
+// are marked free until handed out, for the table iterators; they
+// are beyond the old tail, so they need no logging. The slab header
+// is logged by the caller.
+void FixedAllocator::refill(Slab *slab, size_t count)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    uint64_t begin = (uint64_t)this->begin();
+    uint64_t tail = (uint64_t)_pm->tail_ptr;
+    if (tail + count * _pm->size > _pm->max_addr)
+        throw PMGDException(BadAlloc);
+
+    uint64_t slot = (tail - begin) / _pm->size + count;
+    slot = (slot + _slab_block - 1) / _slab_block * _slab_block;
+    uint64_t end = std::min(begin + slot * _pm->size, _pm->max_addr);
+    end -= (end - begin) % _pm->size;
+
+    for (uint64_t p = tail; p < end; p += _pm->size)
+        *(uint64_t *)p = FREE_BIT;
+    tx->flush_range((void *)tail, end - tail);
+
+    slab->next = (uint64_t *)tail;
+    slab->end = (uint64_t *)end;
+    tx->write(&_pm->tail_ptr, (uint64_t *)end);
+}
+
 void *FixedAllocator::alloc(unsigned num)
 {
     // Makes sense to optimize here to ensure the
@@ -157,15 +286,29 @@ void FixedAllocator::free(void *p)
     // assert(Check free list for p);
     TransactionImpl *tx = TransactionImpl::get_tx();
 
-    AllocatorCallback::delayed_free(tx, this, p);
+    AllocatorCallback::delayed_free(tx, this, NULL, p);
+}
+
+// The object goes on the slab's free list at commit, whichever slab
+// it came from.
+void FixedAllocator::free(Slab *slab, void *p)
+{
+    assert(p >= (void *)((uint64_t)_pool_addr + _alloc_offset) && p < _pm->tail_ptr);
+    assert((uint64_t)p % _pm->size == 0);
+
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    AllocatorCallback::delayed_free(tx, this, slab, p);
 }
 
 void FixedAllocator::clean_free_list
-    (TransactionImpl *tx, const std::list<void *> &list)
+    (TransactionImpl *tx, Slab *slab, const std::list<void *> &list)
 {
-    tx->log_range(&_pm->free_ptr, &_pm->num_allocated);
-    int64_t num_allocated = _pm->num_allocated;
-    void *free_ptr = _pm->free_ptr;
+    uint64_t **head = slab != NULL ? &slab->free_ptr : &_pm->free_ptr;
+    int64_t *count = slab != NULL ? &slab->num_allocated : &_pm->num_allocated;
+    tx->log_range(head, count);
+    int64_t num_allocated = *count;
+    void *free_ptr = *head;
 
     for (auto p : list) {
         *(uint64_t *)p = (uint64_t)free_ptr | FREE_BIT;
@@ -173,8 +316,8 @@ void FixedAllocator::clean_free_list
         num_allocated--;
     }
 
-    _pm->free_ptr = (uint64_t *)free_ptr;
-    _pm->num_allocated = num_allocated;
+    *head = (uint64_t *)free_ptr;
+    *count = num_allocated;
 }
 
 // This should only be called at commit time by Allocator::clean_free_list()
@@ -31,6 +31,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <vector>
 #include "TransactionImpl.h"
 #include "GraphConfig.h"
 
@@ -65,6 +66,25 @@ namespace PMGD {
             uint32_t size;                   ///< Object size
         };
 
+        static const unsigned SLAB_SIZE = 64;
+
+        /**
+         * Objects set aside for one allocator instance
+         *
+         * Allocations and frees through a slab touch only the slab,
+         * so transactions on different instances do not share a
+         * header. A slab takes fresh objects from the region up to
+         * the next multiple of the slab block, and is padded out to
+         * a lock stripe.
+         */
+        struct Slab {
+            uint64_t *next;                  ///< Next never used object
+            uint64_t *end;
+            uint64_t *free_ptr;
+            int64_t num_allocated;           ///< Allocated less freed here
+            uint8_t pad[SLAB_SIZE - 4 * sizeof(uint64_t)];
+        };
+
     private:
         static const uint64_t FREE_BIT = 0x1;
 
@@ -78,11 +98,20 @@ namespace PMGD {
         // Offset from the region's base where objects start
         unsigned _alloc_offset;
 
+        // Per instance slabs, if any, and the object count slabs
+        // take from the region in multiples of
+        Slab *_slabs;
+        unsigned _num_slabs;
+        unsigned _slab_block;
+
+        void refill(Slab *slab, size_t count);
+
         // Maintain objects to be freed at commit time, in this list.
         std::list<void *> _free_list;
 
         friend class AllocatorCallback;
-        void clean_free_list(TransactionImpl *tx, const std::list<void *> &list);
+        void clean_free_list(TransactionImpl *tx, Slab *slab,
+                             const std::list<void *> &list);
 
     public:
         FixedAllocator(const FixedAllocator &) = delete;
@@ -96,10 +125,33 @@ namespace PMGD {
                                uint32_t object_size, uint64_t pool_size,
                                CommonParams &params);
 
+        FixedAllocator(uint64_t pool_addr,
+                               uint32_t object_size, uint64_t pool_size,
+                               Slab *slabs, unsigned num_slabs,
+                               unsigned slab_block, CommonParams &params);
+
         // Primary allocator functions; serialized
         void *alloc();
         void free(void *p);
 
+        // Appends count new objects to objs, logging the header once
+        void alloc(size_t count, std::vector<void *> &objs);
+
+        // The same through a slab. The caller serializes use of the
+        // slab, and of the region header too unless has_room says
+        // the slab can serve the request alone.
+        Slab *slab(unsigned instance) const
+          { return &_slabs[instance % _num_slabs]; }
+        unsigned num_slabs() const { return _num_slabs; }
+        bool has_room(const Slab *slab, size_t count) const
+        {
+            return (count <= 1 && slab->free_ptr != NULL)
+                || ((uint64_t)slab->end - (uint64_t)slab->next) / _pm->size >= count;
+        }
+        void *alloc(Slab *slab);
+        void alloc(Slab *slab, size_t count, std::vector<void *> &objs);
+        void free(Slab *slab, void *p);
+
         // Support for contiguous multi-object allocations and commit time
         // free. These are only used by the Allocator. This free must only
         // be called at commit time.
@@ -120,7 +172,12 @@ namespace PMGD {
           { return *(uint64_t *)curr & FREE_BIT; }
 
         int64_t num_allocated() const
-          { return _pm->num_allocated; }
+        {
+            int64_t n = _pm->num_allocated;
+            for (unsigned i = 0; i < _num_slabs; i++)
+                n += _slabs[i].num_allocated;
+            return n;
+        }
 
         static int64_t num_allocated(RegionHeader *hdr)
           { return hdr->num_allocated; }
@@ -128,11 +185,14 @@ namespace PMGD {
         uint64_t get_id(const void *obj) const
           { return (((uint64_t)obj - (uint64_t)begin()) / _pm->size) + 1; }
 
+        void *get_object(uint64_t id) const
+          { return (void *)((uint64_t)begin() + (id - 1) * _pm->size); }
+
         uint32_t object_size() const
           { return _pm->size; }
 
         uint64_t used_bytes() const
-          { return _pm->size * (uint64_t)_pm->num_allocated; }
+          { return _pm->size * (uint64_t)num_allocated(); }
 
         uint64_t region_size() const
           { return _pm->max_addr - _pool_addr; }
@@ -144,26 +204,30 @@ namespace PMGD {
     class AllocatorCallback
     {
         FixedAllocator *_allocator;
+        FixedAllocator::Slab *_slab;
         std::list<void *> _list;
     public:
-        AllocatorCallback(FixedAllocator *a) : _allocator(a) { }
+        AllocatorCallback(FixedAllocator *a, FixedAllocator::Slab *slab)
+            : _allocator(a), _slab(slab) { }
 
         void operator()(TransactionImpl *tx)
-            { _allocator->clean_free_list(tx, _list); }
+            { _allocator->clean_free_list(tx, _slab, _list); }
 
         void add(void *s) { _list.push_front(s); }
 
+        // Frees through a slab are keyed by the slab.
         static void delayed_free(TransactionImpl *tx, FixedAllocator *allocator,
-                                 void *s)
+                                 FixedAllocator::Slab *slab, void *s)
         {
-            auto *f = tx->lookup_commit_callback(allocator);
+            void *key = slab != NULL ? (void *)slab : (void *)allocator;
+            auto *f = tx->lookup_commit_callback(key);
             if (f == NULL) {
-                tx->register_commit_callback(allocator, AllocatorCallback(allocator));
+                tx->register_commit_callback(key, AllocatorCallback(allocator, slab));
 
                 // The callback object is copied when it is registered,
                 // so we have to call lookup again to get a pointer to
                 // the stored object.
-                f = tx->lookup_commit_callback(allocator);
+                f = tx->lookup_commit_callback(key);
             }
 
             auto *cb = f->template target<AllocatorCallback>();
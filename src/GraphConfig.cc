@@ -44,7 +44,8 @@ static const size_t DEFAULT_EDGE_SIZE = 32;
 static const size_t DEFAULT_TRANSACTION_TABLE_SIZE = SIZE_4KB;
 static const size_t DEFAULT_JOURNAL_SIZE = 64 * SIZE_2MB;
 
-static const size_t INDEX_MANAGER_SIZE = SIZE_4KB;
+// The tag lists, the 8KB light edge tag bitmap and the edge orders
+static const size_t INDEX_MANAGER_SIZE = 4 * SIZE_4KB;
 
 static const int DEFAULT_MAX_STRINGID_LENGTH = 16;
 static const int DEFAULT_MAX_STRINGIDS = 4096;
@@ -118,6 +119,8 @@ GraphConfig::GraphConfig(const Graph::Config *user_config)
 
     // Put constraints on number of instances based on the region size
     // and core count.
+    track_dirty_pages = user_config != NULL && user_config->track_dirty_pages;
+
     num_allocators = VALUE(num_allocators, DEFAULT_NUM_ALLOCATORS);
     if (allocator_region_size < 2 * Allocator::CHUNK_SIZE || num_allocators < 1)
         throw PMGDException(InvalidConfig, "Cannot even support one allocator instance");
@@ -154,6 +157,8 @@ GraphConfig::GraphConfig(const Graph::Config *user_config)
     init_region_info(journal_info, "journal.jdb", addr, journal_size);
     init_region_info(node_info, "nodes.jdb", addr, node_table_size);
     init_region_info(edge_info, "edges.jdb", addr, edge_table_size);
+    init_region_info(edgepos_info, "edgepos.jdb", addr,
+         edge_table_size / edge_size * GraphImpl::EDGE_POSITIONS_SIZE);
     init_region_info(allocator_info, "allocator.jdb", addr,
          allocator_region_size);
 }
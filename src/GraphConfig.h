@@ -85,6 +85,7 @@ namespace PMGD {
         unsigned edge_size;
         unsigned max_stringid_length;
         unsigned num_allocators;
+        bool track_dirty_pages;
 
         // The parameters below until locale_name are DRAM-based parameters
         // that can be modified each time the graph is created/opened.
@@ -110,10 +111,11 @@ namespace PMGD {
         RegionInfo stringtable_info;
         RegionInfo node_info;
         RegionInfo edge_info;
+        RegionInfo edgepos_info;
         RegionInfo allocator_info;
 
         GraphConfig(const Graph::Config *user_config);
-        void init_region_info(RegionInfo &info, const char *name,
-                              uint64_t &addr, size_t size);
+        static void init_region_info(RegionInfo &info, const char *name,
+                                     uint64_t &addr, size_t size);
     };
 };
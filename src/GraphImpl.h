@@ -30,6 +30,11 @@
 #pragma once
 
 #include <locale>
+#include <string>
+#include <vector>
+#include <utility>
+#include <thread>
+#include <atomic>
 #include <stddef.h>
 #include "graph.h"
 #include "GraphConfig.h"
@@ -39,6 +44,7 @@
 #include "os.h"
 #include "StringTable.h"
 #include "lock.h"
+#include "DirtyPageMap.h"
 
 namespace PMGD {
     struct RegionInfo;
@@ -48,13 +54,21 @@ namespace PMGD {
         typedef FixedAllocator NodeTable;
         typedef FixedAllocator EdgeTable;
 
+        // Bytes of adjacency positions per edge table slot
+        static const unsigned EDGE_POSITIONS_SIZE = 2 * sizeof(void *);
+
+        // Edge table slabs, shared by allocator instance number
+        static const unsigned EDGE_SLABS = 16;
+
     private:
+        friend class Graph;
         struct GraphInfo;
 
         struct GraphInit {
             unsigned node_size;
             unsigned edge_size;
             unsigned num_allocators;
+            bool track_dirty_pages;
 
             CommonParams params;
 
@@ -80,6 +94,37 @@ namespace PMGD {
             MapRegion(const char *db_name, const RegionInfo &info, bool create, bool read_only);
         };
 
+        // The dirty page map is optional, and can be added to an
+        // existing graph, so it is mapped separately.
+        class DirtyMapRegion {
+            os::MapRegion *_region;
+            DirtyPageMap *_map;
+        public:
+            DirtyMapRegion(const DirtyMapRegion &) = delete;
+            void operator=(const DirtyMapRegion &) = delete;
+            DirtyMapRegion(const char *db_name, GraphInit &init);
+            ~DirtyMapRegion();
+            DirtyPageMap *map() { return _map; }
+        };
+
+        // Cache warm-up requested through the Prefetch and WarmUp
+        // open options. The background thread is stopped and joined
+        // before the rest of the graph is torn down.
+        class Warmer {
+            static const unsigned INDEX_LEVELS = 8;
+
+            std::thread _thread;
+            std::atomic<bool> _stop;
+
+            bool touch(const void *addr, size_t len);
+            void run(GraphImpl *db);
+        public:
+            Warmer(const Warmer &) = delete;
+            void operator=(const Warmer &) = delete;
+            Warmer(GraphImpl *db, int options);
+            ~Warmer();
+        };
+
         // Order here is important: SigHandler must be first,
         // followed by GraphInit.
         os::SigHandler _sighandler;
@@ -92,14 +137,26 @@ namespace PMGD {
         MapRegion _stringtable_region;
         MapRegion _node_region;
         MapRegion _edge_region;
+        MapRegion _edgepos_region;
         MapRegion _allocator_region;
 
+        // Must be in place before recovery writes anything.
+        DirtyMapRegion _dirtymap_region;
+
         // TransactionManager needs be first to do recovery.
         TransactionManager _transaction_manager;
         IndexManager _index_manager;
         StringTable _string_table;
         NodeTable _node_table;
         EdgeTable _edge_table;
+
+        // Where each edge sits in the adjacency of its source and of
+        // its destination, so it can be removed without searching.
+        // One pair per edge table slot, kept apart from the edge
+        // records so that they stay small.
+        void **const _edge_positions;
+        const uint64_t _edge_base;
+        const unsigned _edge_shift;
         Allocator _allocator;
 
         std::locale _locale;
@@ -109,6 +166,21 @@ namespace PMGD {
         StripedLock _edge_locks;
         StripedLock _index_locks;
 
+        // Needed to locate the region files for snapshots.
+        const std::string _name;
+
+        // Must be last.
+        Warmer _warmer;
+
+        typedef std::vector<std::pair<const void *, size_t>> RangeList;
+        RangeList used_ranges(bool with_indexes);
+
+        // Start tracking the pages written to the regions, which
+        // snapshots and deltas copy with writers running. Tracking
+        // starts with no transaction in flight, so that every change
+        // made after the call is tracked.
+        PageTracker *track_pages();
+
     public:
         GraphImpl(const char *name, int options, const Graph::Config *config);
         TransactionManager &transaction_manager() { return _transaction_manager; }
@@ -116,6 +188,13 @@ namespace PMGD {
         StringTable &string_table() { return _string_table; }
         NodeTable &node_table() { return _node_table; }
         EdgeTable &edge_table() { return _edge_table; }
+        void **edge_positions(const Edge *edge)
+        {
+            uint64_t slot = (uint64_t(edge) - _edge_base) >> _edge_shift;
+            return _edge_positions + 2 * slot;
+        }
+        FixedAllocator &object_table(Graph::IndexType index_type)
+            { return index_type == Graph::NodeIndex ? _node_table : _edge_table; }
         Allocator &allocator() { return _allocator; }
         std::locale &locale() { return _locale; }
         StripedLock &node_locks() { return _node_locks; }
@@ -133,5 +212,23 @@ namespace PMGD {
             msync_needed = _init.params.msync_needed;
             always_msync = _init.params.always_msync;
         }
+
+        // Nodes that Graph::remove_partial has started on and not
+        // finished. Iterators leave them out while there are any.
+        // Read locks the count.
+        uint64_t num_removing();
+        void add_removing(int delta);
+
+        // Write locks the edge table slab of the current transaction's
+        // allocator instance, and the table itself if the slab cannot
+        // take count more edges alone.
+        FixedAllocator::Slab *edge_slab(size_t count);
+
+        // Read locks the node or edge table, with any slabs, against
+        // adds and removes.
+        void lock_table(Graph::IndexType index_type);
+
+        void snapshot(const char *dest_name);
+        void export_delta(const char *delta_file);
     };
 };
@@ -0,0 +1,622 @@
+/**
+ * @file   HashIndex.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <new>
+#include "HashIndex.h"
+#include "PostingList.h"
+#include "IndexString.h"
+#include "GraphImpl.h"
+#include "compiler.h"
+
+using namespace PMGD;
+
+// The splitmix64 finalizer, so that keys that differ in a few bits
+// spread over all the buckets
+static uint64_t mix(uint64_t x)
+{
+    x = (x ^ x >> 30) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ x >> 27) * 0x94d049bb133111ebull;
+    return x ^ x >> 31;
+}
+
+static uint64_t hash_key(long long key) { return mix(key); }
+static uint64_t hash_key(bool key) { return mix(key); }
+static uint64_t hash_key(const Time &key) { return mix(key.time_val); }
+static uint64_t hash_key(const IndexString &key) { return mix(key.hash()); }
+
+static uint64_t hash_key(double key)
+{
+    // -0.0 is equal to 0.0.
+    if (key == 0)
+        key = 0;
+    uint64_t bits;
+    memcpy(&bits, &key, sizeof bits);
+    return mix(bits);
+}
+
+template <typename K>
+static size_t key_bytes(K &)
+    { return 0; }
+
+static size_t key_bytes(IndexString &key)
+    { return key.get_remainder_size(); }
+
+// Keys move as raw bytes, as in BTreeIndex.
+template <class B>
+static void move_entry(B *dst, unsigned d, B *src, unsigned s)
+{
+    dst->hashes[d] = src->hashes[s];
+    dst->values[d] = src->values[s];
+    memcpy((void *)&dst->keys[d], (const void *)&src->keys[s], sizeof dst->keys[d]);
+}
+
+template <class B>
+static void log_entry(B *b, unsigned i, TransactionImpl *tx)
+{
+    tx->log(&b->hashes[i], sizeof b->hashes[i]);
+    tx->log(&b->values[i], sizeof b->values[i]);
+    tx->log(&b->keys[i], sizeof b->keys[i]);
+}
+
+template <class B>
+static void flush_entry(B *b, unsigned i, TransactionImpl *tx)
+{
+    tx->flush_range(&b->hashes[i], sizeof b->hashes[i]);
+    tx->flush_range(&b->values[i], sizeof b->values[i]);
+    tx->flush_range(&b->keys[i], sizeof b->keys[i]);
+}
+
+static PostingList *new_list(Allocator &allocator, TransactionImpl *tx)
+{
+    PostingList *list = new (allocator.alloc(sizeof(PostingList))) PostingList();
+    tx->flush_range(list, sizeof *list);
+    return list;
+}
+
+template <typename K>
+uint64_t HashIndex<K>::bucket_of(uint64_t hash) const
+{
+    uint64_t mask = (uint64_t(1) << _level) - 1;
+    uint64_t bucket = hash & mask;
+    if (bucket < _split)
+        bucket = hash & (mask << 1 | 1);
+    return bucket;
+}
+
+// The caller holds the index lock, for write if it passes an
+// allocator to add the directories on the way.
+template <typename K>
+typename HashIndex<K>::Bucket **HashIndex<K>::find_slot(uint64_t bucket,
+                                                       Allocator *allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    if (_root == NULL || bucket >= span(_height)) {
+        if (allocator == NULL)
+            return NULL;
+        // Grow by putting the root under new directories.
+        do {
+            Dir *dir = (Dir *)allocator->alloc(sizeof(Dir));
+            memset(dir, 0, sizeof *dir);
+            dir->slots[0] = _root;
+            tx->flush_range(dir, sizeof *dir);
+            if (_root != NULL)
+                tx->write(&_height, _height + 1);
+            tx->write(&_root, dir);
+        } while (bucket >= span(_height));
+    }
+
+    Dir *dir = _root;
+    for (unsigned h = _height; h > 0; h--) {
+        void **slot = &dir->slots[bucket / span(h - 1) % DIR_SIZE];
+        if (*slot == NULL) {
+            if (allocator == NULL)
+                return NULL;
+            Dir *child = (Dir *)allocator->alloc(sizeof(Dir));
+            memset(child, 0, sizeof *child);
+            tx->flush_range(child, sizeof *child);
+            tx->write(slot, (void *)child);
+        }
+        dir = (Dir *)*slot;
+    }
+    return (Bucket **)&dir->slots[bucket % DIR_SIZE];
+}
+
+template <typename K>
+typename HashIndex<K>::Bucket *HashIndex<K>::find_entry(Bucket *chain,
+                                                       uint64_t hash,
+                                                       const K &key,
+                                                       unsigned &pos)
+{
+    for (Bucket *b = chain; b != NULL; b = b->overflow) {
+        for (unsigned i = 0; i < b->count; i++) {
+            if (b->hashes[i] == hash && b->keys[i] == key) {
+                pos = i;
+                return b;
+            }
+        }
+    }
+    return NULL;
+}
+
+template <typename K>
+PostingList *HashIndex<K>::add(const K &key, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    if (_root == NULL) {
+        tx->acquire_lock(TransactionImpl::IndexLock, this, true);
+        find_slot(0, &allocator);
+    }
+
+    uint64_t hash = hash_key(key);
+    Bucket **slot = find_slot(bucket_of(hash), NULL);
+    tx->acquire_lock(TransactionImpl::IndexLock, slot, true);
+    unsigned pos;
+    Bucket *b = find_entry(*slot, hash, key, pos);
+    if (b != NULL)
+        return b->values[pos];
+
+    // Split rather than add a page to a full bucket. That may not
+    // make room in this bucket, but it keeps the chains short on
+    // the whole.
+    for (b = *slot; b != NULL && b->count == Bucket::MAX_KEYS; b = b->overflow)
+        ;
+    if (b == NULL && *slot != NULL) {
+        tx->acquire_lock(TransactionImpl::IndexLock, this, true);
+        split(allocator, tx);
+        slot = find_slot(bucket_of(hash), NULL);
+        tx->acquire_lock(TransactionImpl::IndexLock, slot, true);
+        for (b = *slot; b != NULL && b->count == Bucket::MAX_KEYS; b = b->overflow)
+            ;
+    }
+
+    PostingList *list = new_list(allocator, tx);
+    if (b == NULL) {
+        b = (Bucket *)allocator.alloc(NODE_SIZE);
+        b->count = 1;
+        b->unused = 0;
+        b->overflow = *slot;
+        b->hashes[0] = hash;
+        b->values[0] = list;
+        new (&b->keys[0]) K(key);
+        tx->flush_range(b, NODE_SIZE);
+        tx->write(slot, b);
+    }
+    else {
+        unsigned i = b->count;
+        b->hashes[i] = hash;
+        b->values[i] = list;
+        new (&b->keys[i]) K(key);
+        flush_entry(b, i, tx);
+        tx->write(&b->count, i + 1);
+    }
+    return list;
+}
+
+// Moves the values in bucket _split whose next hash bit is set to a
+// new bucket at the end of the table. The chain is logged whole,
+// since the values that stay are packed to the front of it.
+template <typename K>
+void HashIndex<K>::split(Allocator &allocator, TransactionImpl *tx)
+{
+    uint64_t half = uint64_t(1) << _level;
+    Bucket **to = find_slot(_split + half, &allocator);
+    Bucket **from = find_slot(_split, NULL);
+    tx->acquire_lock(TransactionImpl::IndexLock, from, true);
+    tx->acquire_lock(TransactionImpl::IndexLock, to, true);
+
+    Bucket *chain = *from;
+    for (Bucket *b = chain; b != NULL; b = b->overflow)
+        tx->log(b, NODE_SIZE);
+
+    Bucket *moved = NULL;
+    Bucket *w = chain;
+    unsigned wi = 0;
+    for (Bucket *b = chain; b != NULL; b = b->overflow) {
+        for (unsigned i = 0; i < b->count; i++) {
+            if (b->hashes[i] >> _level & 1) {
+                if (moved == NULL || moved->count == Bucket::MAX_KEYS) {
+                    Bucket *n = (Bucket *)allocator.alloc(NODE_SIZE);
+                    n->count = 0;
+                    n->unused = 0;
+                    n->overflow = moved;
+                    moved = n;
+                }
+                move_entry(moved, moved->count++, b, i);
+            }
+            else {
+                if (w != b || wi != i)
+                    move_entry(w, wi, b, i);
+                if (++wi == Bucket::MAX_KEYS) {
+                    w = w->overflow;
+                    wi = 0;
+                }
+            }
+        }
+    }
+
+    // The pages before w are full. Those from w on that hold nothing
+    // go.
+    Bucket **link = from;
+    for (Bucket *b = chain; b != w; b = b->overflow) {
+        b->count = Bucket::MAX_KEYS;
+        link = &b->overflow;
+    }
+    if (w != NULL) {
+        Bucket *rest = w->overflow;
+        if (wi == 0)
+            rest = w;
+        else {
+            w->count = wi;
+            link = &w->overflow;
+        }
+        tx->write(link, (Bucket *)NULL);
+        while (rest != NULL) {
+            Bucket *next = rest->overflow;
+            allocator.free(rest, NODE_SIZE);
+            rest = next;
+        }
+    }
+
+    for (Bucket *b = moved; b != NULL; b = b->overflow)
+        tx->flush_range(b, NODE_SIZE);
+    tx->write(to, moved);
+
+    if (_split + 1 == half) {
+        tx->write(&_level, _level + 1);
+        tx->write(&_split, uint64_t(0));
+    }
+    else
+        tx->write(&_split, _split + 1);
+}
+
+// The buckets are sorted by counting, and each is filled in one go,
+// so the keys in a bucket stay in the order they came in.
+template <typename K>
+void HashIndex<K>::load(const std::vector<const K *> &keys,
+                        std::vector<PostingList *> &lists,
+                        Allocator &allocator)
+{
+    if (keys.empty())
+        return;
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, true);
+    assert(_root == NULL);
+
+    uint32_t level = 0;
+    while ((uint64_t(Bucket::MAX_KEYS) * 3 / 4 << level) < keys.size())
+        level++;
+    uint64_t buckets = uint64_t(1) << level;
+    uint32_t height = 0;
+    while (buckets > span(height))
+        height++;
+
+    std::vector<uint64_t> hashes(keys.size());
+    std::vector<size_t> starts(buckets + 1, 0);
+    for (size_t i = 0; i < keys.size(); i++) {
+        hashes[i] = hash_key(*keys[i]);
+        starts[(hashes[i] & (buckets - 1)) + 1]++;
+    }
+    for (uint64_t b = 0; b < buckets; b++)
+        starts[b + 1] += starts[b];
+    std::vector<size_t> order(keys.size());
+    std::vector<size_t> next(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < keys.size(); i++)
+        order[next[hashes[i] & (buckets - 1)]++] = i;
+
+    size_t first = lists.size();
+    lists.resize(first + keys.size());
+    std::vector<Dir *> dirs;
+    Dir *root = NULL;
+    for (uint64_t bucket = 0; bucket < buckets; bucket++) {
+        if (starts[bucket] == starts[bucket + 1])
+            continue;
+
+        // Pages past the first one hold what does not fit, as an add
+        // to a full bucket would have left them before a split.
+        Bucket *chain = NULL;
+        for (size_t j = starts[bucket]; j < starts[bucket + 1]; ) {
+            Bucket *b = (Bucket *)allocator.alloc(NODE_SIZE);
+            b->count = 0;
+            b->unused = 0;
+            b->overflow = chain;
+            for (; j < starts[bucket + 1] && b->count < Bucket::MAX_KEYS; j++) {
+                size_t i = order[j];
+                unsigned k = b->count++;
+                b->hashes[k] = hashes[i];
+                b->values[k] = new_list(allocator, tx);
+                new (&b->keys[k]) K(*keys[i]);
+                lists[first + i] = b->values[k];
+            }
+            tx->flush_range(b, NODE_SIZE);
+            chain = b;
+        }
+
+        void **slot = (void **)&root;
+        for (unsigned h = height + 1; h > 0; h--) {
+            if (*slot == NULL) {
+                Dir *dir = (Dir *)allocator.alloc(sizeof(Dir));
+                memset(dir, 0, sizeof *dir);
+                dirs.push_back(dir);
+                *slot = dir;
+            }
+            uint64_t unit = h > 1 ? span(h - 2) : 1;
+            slot = &((Dir *)*slot)->slots[bucket / unit % DIR_SIZE];
+        }
+        *slot = chain;
+    }
+    for (Dir *dir : dirs)
+        tx->flush_range(dir, sizeof *dir);
+
+    tx->write(&_level, level);
+    tx->write(&_height, height);
+    tx->write(&_split, uint64_t(0));
+    tx->write(&_root, root);
+}
+
+template <typename K>
+PostingList *HashIndex<K>::find(const K &key, bool write_lock)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    if (_root == NULL)
+        return NULL;
+
+    uint64_t hash = hash_key(key);
+    Bucket **slot = find_slot(bucket_of(hash), NULL);
+    tx->acquire_lock(TransactionImpl::IndexLock, slot, write_lock);
+    unsigned pos;
+    Bucket *b = find_entry(*slot, hash, key, pos);
+    return b == NULL ? NULL : b->values[pos];
+}
+
+template <typename K>
+void HashIndex<K>::remove(const K &key, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    if (_root == NULL)
+        return;
+
+    uint64_t hash = hash_key(key);
+    Bucket **slot = find_slot(bucket_of(hash), NULL);
+    tx->acquire_lock(TransactionImpl::IndexLock, slot, true);
+    unsigned pos;
+    Bucket *b = find_entry(*slot, hash, key, pos);
+    if (b == NULL)
+        return;
+
+    PostingList *list = b->values[pos];
+    assert(list->num_elems() == 0);
+    unsigned last = b->count - 1;
+
+    // The last value in the page takes the place of the one removed.
+    log_entry(b, pos, tx);
+    b->keys[pos].~K();
+    if (pos != last)
+        move_entry(b, pos, b, last);
+    tx->write(&b->count, last);
+
+    if (last == 0) {
+        Bucket **link = slot;
+        while (*link != b)
+            link = &(*link)->overflow;
+        tx->write(link, b->overflow);
+        allocator.free(b, NODE_SIZE);
+    }
+    allocator.free(list, sizeof *list);
+}
+
+namespace PMGD {
+    // Walks the list for one value
+    template <typename K>
+    class HashIndex<K>::Hash_IteratorImpl : public Index::Index_IteratorImplIntf {
+        PostingListTraverser _list_it;
+        bool _vacant_flag = false;
+        TransactionImpl *_tx;
+        const Graph::IndexType _index_type;
+
+    public:
+        Hash_IteratorImpl(PostingList *list, Graph::IndexType index_type)
+            : _list_it(list), _tx(TransactionImpl::get_tx()),
+              _index_type(index_type)
+        {
+            if (_tx->is_read_write()) {
+                _tx->iterator_callbacks().register_iterator(this,
+                    [this](void *list) { remove_notify(list); },
+                    [this](void *tree) { rebalance_notify(tree); });
+            }
+        }
+
+        ~Hash_IteratorImpl()
+        {
+            if (_tx->is_read_write())
+                _tx->iterator_callbacks().unregister_iterator(this);
+        }
+
+        operator bool() const { return _vacant_flag || bool(_list_it); }
+
+        bool next()
+        {
+            if (EXPECT_FALSE(_vacant_flag)) {
+                _vacant_flag = false;
+                return operator bool();
+            }
+            return _list_it.next();
+        }
+
+        void *ref() const
+        {
+            if (EXPECT_FALSE(_vacant_flag || !_list_it.is_member()))
+                throw PMGDException(VacantIterator);
+            void *value = _tx->get_db()->object_table(_index_type)
+                              .get_object(_list_it.ref() + 1);
+            TransactionImpl::lock(_index_type, value, false);
+            return value;
+        }
+
+        uint64_t slot() const { return _list_it.ref(); }
+
+        void remove_notify(void *list)
+        {
+            // The list is going, and with it the rest of the scan.
+            if (_list_it.check(list)) {
+                _list_it.set(NULL);
+                _vacant_flag = true;
+            }
+        }
+
+        void rebalance_notify(void *tree)
+        {
+            // The chunks of the list moved
+            if (_list_it.check(tree))
+                _list_it.reset(static_cast<PostingList *>(tree));
+        }
+    };
+}
+
+template <typename K>
+Index::Index_IteratorImplIntf *HashIndex<K>::get_iterator(Graph::IndexType,
+                                                         bool)
+{
+    throw PMGDException(NotImplemented);
+}
+
+template <typename K>
+Index::Index_IteratorImplIntf *HashIndex<K>::get_iterator(Graph::IndexType index_type,
+                                                         const K &key,
+                                                         PropertyPredicate::Op op,
+                                                         bool)
+{
+    if (op != PropertyPredicate::Eq)
+        throw PMGDException(NotImplemented);
+    return new Hash_IteratorImpl(find(key), index_type);
+}
+
+template <typename K>
+Index::Index_IteratorImplIntf *HashIndex<K>::get_iterator(Graph::IndexType,
+                                                         const K &, const K &,
+                                                         PropertyPredicate::Op,
+                                                         bool)
+{
+    throw PMGDException(NotImplemented);
+}
+
+// Without avg, adds up the sizes, and with it, takes off the health
+// as AvlTreeIndex does.
+template <typename K>
+void HashIndex<K>::stats_recursive(Dir *dir, unsigned height,
+                                   Graph::IndexStats &stats, size_t *avg)
+{
+    if (avg == NULL)
+        stats.total_size_bytes += sizeof *dir;
+    for (unsigned s = 0; s < DIR_SIZE; s++) {
+        if (dir->slots[s] == NULL)
+            continue;
+        if (height > 0) {
+            stats_recursive((Dir *)dir->slots[s], height - 1, stats, avg);
+            continue;
+        }
+        for (Bucket *b = (Bucket *)dir->slots[s]; b != NULL; b = b->overflow) {
+            if (avg == NULL)
+                stats.total_size_bytes += NODE_SIZE;
+            for (unsigned i = 0; i < b->count; i++) {
+                PostingList *list = b->values[i];
+                size_t elements = list->num_elems();
+                if (avg != NULL) {
+                    if (elements > *avg)
+                        stats.health_factor -= (100 * elements) / stats.total_elements;
+                    continue;
+                }
+                stats.total_unique_entries++;
+                stats.total_elements += elements;
+                stats.total_size_bytes += sizeof *list + list->size_bytes()
+                                          + key_bytes(b->keys[i]);
+            }
+        }
+    }
+}
+
+template <typename K>
+void HashIndex<K>::index_stats_info(Graph::IndexStats &stats)
+{
+    stats.unique_entry_size     = sizeof(uint64_t) + sizeof(K)
+                                  + sizeof(PostingList *) + sizeof(PostingList);
+    stats.total_unique_entries  = 0;
+    stats.total_elements        = 0;
+    stats.total_size_bytes      = sizeof(*this);
+    stats.health_factor         = 100;
+
+    if (_root == NULL)
+        return;
+
+    stats_recursive(_root, _height, stats, NULL);
+    if (stats.total_unique_entries == 0)
+        return;
+
+    size_t avg_elem_per_node = stats.total_elements / stats.total_unique_entries;
+    stats_recursive(_root, _height, stats, &avg_elem_per_node);
+}
+
+template <typename K>
+void HashIndex<K>::prefetch_recursive(Dir *dir, unsigned height,
+                                      unsigned levels, TransactionImpl *tx)
+{
+    if (dir == NULL || levels == 0)
+        return;
+    for (unsigned s = 0; s < DIR_SIZE; s++) {
+        void *child = dir->slots[s];
+        if (child == NULL)
+            continue;
+        if (height > 0)
+            prefetch_recursive((Dir *)child, height - 1, levels - 1, tx);
+        else if (levels > 1) {
+            tx->acquire_lock(TransactionImpl::IndexLock, &dir->slots[s], false);
+            (void)*(volatile uint32_t *)child;
+        }
+    }
+}
+
+template <typename K>
+void HashIndex<K>::prefetch(unsigned levels)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    prefetch_recursive(_root, _height, levels, tx);
+}
+
+// Explicitly instantiate any types that might be required
+template class HashIndex<long long>;
+template class HashIndex<bool>;
+template class HashIndex<double>;
+template class HashIndex<Time>;
+template class HashIndex<IndexString>;
@@ -0,0 +1,133 @@
+/**
+ * @file   HashIndex.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "Index.h"
+#include "TransactionImpl.h"
+
+namespace PMGD {
+    class Allocator;
+    class PostingList;
+
+    // A linear hash table over the values of a property, for indexes
+    // that are only queried for equality. Each bucket is a chain of
+    // NODE_SIZE pages holding the hash, key and posting list of its
+    // values. Instead of overflowing a bucket, an add splits the next
+    // bucket in turn, moving the values that now hash past the end of
+    // the table to a new bucket there, so the buckets stay about one
+    // page long and a lookup reads one or two pages.
+    // The buckets are found through a radix tree of directories, like
+    // the pages of a TagIndex. Each bucket is locked on its slot in
+    // the directory, but a split write locks the whole index.
+    // Buckets are not merged when values are removed.
+    // Data resides in PM
+    template <typename K> class HashIndex : public Index {
+        static const unsigned NODE_SIZE = 512;
+        static const unsigned DIR_BITS = 9;
+        static const unsigned DIR_SIZE = 1 << DIR_BITS;
+
+        struct Bucket {
+            static const unsigned MAX_KEYS = (NODE_SIZE - 2 * sizeof(uint64_t))
+                / (sizeof(uint64_t) + sizeof(PostingList *) + sizeof(K));
+            uint32_t count;
+            uint32_t unused;
+            Bucket *overflow;
+            uint64_t hashes[MAX_KEYS];
+            PostingList *values[MAX_KEYS];
+            K keys[MAX_KEYS];
+        };
+
+        // The directories at height 0 hold bucket pointers.
+        struct Dir {
+            void *slots[DIR_SIZE];
+        };
+
+        // The table has 2^_level + _split buckets. The ones below
+        // _split have been split in this round.
+        uint32_t _level;
+        uint32_t _height;
+        uint64_t _split;
+        Dir *_root;
+
+        class Hash_IteratorImpl;
+
+        static uint64_t span(unsigned height)
+            { return uint64_t(1) << DIR_BITS * (height + 1); }
+
+        uint64_t bucket_of(uint64_t hash) const;
+        Bucket **find_slot(uint64_t bucket, Allocator *allocator);
+        Bucket *find_entry(Bucket *chain, uint64_t hash, const K &key,
+                           unsigned &pos);
+        void split(Allocator &allocator, TransactionImpl *tx);
+
+        void stats_recursive(Dir *dir, unsigned height,
+                             Graph::IndexStats &stats, size_t *avg);
+        void prefetch_recursive(Dir *dir, unsigned height, unsigned levels,
+                                TransactionImpl *tx);
+
+    public:
+        HashIndex(PropertyType ptype)
+            : Index(ptype, Graph::Hash),
+              _level(0), _height(0), _split(0), _root(NULL)
+        {
+            TransactionImpl *tx = TransactionImpl::get_tx();
+            tx->flush_range(this, sizeof *this);
+        }
+
+        // As for BTreeIndex
+        PostingList *add(const K &key, Allocator &allocator);
+        PostingList *find(const K &key, bool write_lock = false);
+        void remove(const K &key, Allocator &allocator);
+
+        // Builds the table, which must be empty, with enough buckets
+        // that each is about three quarters full, and appends a new
+        // empty list for each key to lists. The buckets and
+        // directories are new, so they are flushed rather than logged;
+        // only the header, and the allocator, go to the journal.
+        void load(const std::vector<const K *> &keys,
+                  std::vector<PostingList *> &lists, Allocator &allocator);
+
+        // Only Eq is supported; see Index::supports.
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type, bool reverse);
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type, const K &key,
+                                                    PropertyPredicate::Op op, bool reverse);
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type, const K &min,
+                                                    const K &max, PropertyPredicate::Op op,
+                                                    bool reverse);
+
+        // For statistics
+        void index_stats_info(Graph::IndexStats &stats);
+
+        // Touch the directories and the first levels of buckets
+        void prefetch(unsigned levels);
+    };
+}
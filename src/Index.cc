@@ -30,7 +30,11 @@
 #include <string>
 #include "Index.h"
 #include "AvlTreeIndex.h"
-#include "List.h"
+#include "BTreeIndex.h"
+#include "HashIndex.h"
+#include "RadixIndex.h"
+#include "TagIndex.h"
+#include "PostingList.h"
 #include "exception.h"
 #include "TransactionImpl.h"
 #include "GraphImpl.h"
@@ -38,38 +42,221 @@
 
 using namespace PMGD;
 
-void Index::add(const Property &p, void *n, GraphImpl *db)
+// A counted tree keeps counts up to its root, so any change to it
+// write locks the whole tree, for iterators and for counts.
+template <typename K>
+static CountedAvlTreeIndex<K> *lock_counted(Index *index)
+{
+    CountedAvlTreeIndex<K> *tree = static_cast<CountedAvlTreeIndex<K> *>(index);
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, tree, true);
+    tx->acquire_lock(TransactionImpl::IndexLock,
+                     static_cast<AvlTree<K, CountedPostingList> *>(tree), true);
+    return tree;
+}
+
+template <typename K>
+PostingList *Index::add_key(const K &key, Allocator &allocator)
+{
+    if (_kind == Graph::CountedAvl)
+        return lock_counted<K>(this)->add(key, allocator);
+    if (_kind == Graph::BPlusTree)
+        return static_cast<BTreeIndex<K> *>(this)->add(key, allocator);
+    if (_kind == Graph::Hash)
+        return static_cast<HashIndex<K> *>(this)->add(key, allocator);
+    if (_kind == Graph::Radix)
+        return static_cast<RadixIndex<K> *>(this)->add(key, allocator);
+    return static_cast<AvlTreeIndex<K, PostingList> *>(this)->add(key, allocator);
+}
+
+template <typename K, class I>
+static void adjust_counts(I *, const K &, int64_t)
+{
+}
+
+template <typename K>
+static void adjust_counts(CountedAvlTreeIndex<K> *tree, const K &key, int64_t delta)
+{
+    if (delta != 0)
+        tree->add_count(key, delta);
+}
+
+template <typename K, class I>
+static void remove_from(I *prop_idx, const K &key, uint64_t slot,
+                        Allocator &allocator)
+{
+    PostingList *dest = prop_idx->find(key, true);
+    if (dest) {
+        size_t before = dest->num_elems();
+        dest->remove(slot, allocator);
+        // The counts have to be right before a key goes.
+        adjust_counts(prop_idx, key, int64_t(dest->num_elems()) - int64_t(before));
+        // TODO: Re-traversal of tree.
+        if (dest->num_elems() == 0)
+            prop_idx->remove(key, allocator);
+    }
+}
+
+template <typename K>
+void Index::remove_key(const K &key, uint64_t slot, Allocator &allocator)
+{
+    if (_kind == Graph::CountedAvl)
+        remove_from(lock_counted<K>(this), key, slot, allocator);
+    else if (_kind == Graph::BPlusTree)
+        remove_from(static_cast<BTreeIndex<K> *>(this), key, slot, allocator);
+    else if (_kind == Graph::Hash)
+        remove_from(static_cast<HashIndex<K> *>(this), key, slot, allocator);
+    else if (_kind == Graph::Radix)
+        remove_from(static_cast<RadixIndex<K> *>(this), key, slot, allocator);
+    else
+        remove_from(static_cast<AvlTreeIndex<K, PostingList> *>(this),
+                    key, slot, allocator);
+}
+
+template <typename K>
+PostingList *Index::find_key(const K &key, bool write_lock)
+{
+    if (_kind == Graph::CountedAvl)
+        return static_cast<CountedAvlTreeIndex<K> *>(this)->find(key, write_lock);
+    if (_kind == Graph::BPlusTree)
+        return static_cast<BTreeIndex<K> *>(this)->find(key, write_lock);
+    if (_kind == Graph::Hash)
+        return static_cast<HashIndex<K> *>(this)->find(key, write_lock);
+    if (_kind == Graph::Radix)
+        return static_cast<RadixIndex<K> *>(this)->find(key, write_lock);
+    return static_cast<AvlTreeIndex<K, PostingList> *>(this)->find(key, write_lock);
+}
+
+bool Index::supports(PropertyPredicate::Op op, const std::locale &loc) const
+{
+    if (op == PropertyPredicate::Prefix)
+        return _ptype == PropertyType::String && _kind != Graph::Hash
+               && loc == std::locale::classic();
+    return _kind != Graph::Hash || op == PropertyPredicate::Eq;
+}
+
+void Index::set_unique()
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->write(&_unique, true);
+}
+
+// Whether the list has an object other than the one at slot
+static bool held_by_other(PostingList *list, uint64_t slot)
+{
+    if (list == NULL || list->num_elems() == 0)
+        return false;
+    if (list->num_elems() > 1)
+        return true;
+    PostingListTraverser t(list);
+    return t.ref() != slot;
+}
+
+PostingList *Index::get_list(const Property &p, GraphImpl *db)
 {
     if (_ptype != p.type())
         throw PMGDException(PropertyTypeMismatch);
 
     Allocator &allocator = db->allocator();
 
-    // TODO: Tree is unnecessary and Node* needs better arrangement for
-    // quick search and remove operations
-    List<void*> *dest = NULL;
+    switch(_ptype) {
+        case PropertyType::Integer:
+            return add_key(p.int_value(), allocator);
+        case PropertyType::Float:
+            return add_key(p.float_value(), allocator);
+        case PropertyType::Boolean:
+            return add_key(p.bool_value(), allocator);
+        case PropertyType::Time:
+            return add_key(p.time_value(), allocator);
+        case PropertyType::String:
+            {
+                TransientIndexString istr(p.string_value(), db->locale());
+                return add_key<IndexString>(istr, allocator);
+            }
+        case PropertyType::NoValue:
+            throw PMGDException(NotImplemented);
+        case PropertyType::Blob:
+        default:
+            throw PMGDException(PropertyTypeInvalid);
+    }
+}
+
+void Index::add(Graph::IndexType index_type, const Property &p, void *n,
+                GraphImpl *db)
+{
+    // dest will never be null since it gets allocated at the add time.
+    // Also, if it was a new element, the add code does a placement new,
+    // which gets flushed with the rest of the new tree node.
+    PostingList *dest = get_list(p, db);
+
+    // The list keeps table slots rather than pointers.
+    uint64_t slot = db->object_table(index_type).get_id(n) - 1;
+    if (_unique && held_by_other(dest, slot))
+        throw PMGDException(NotUnique);
+    size_t before = dest->num_elems();
+    dest->add(slot, db->allocator());
+    if (_kind == Graph::CountedAvl && dest->num_elems() != before)
+        count_changed(p, int64_t(dest->num_elems()) - int64_t(before), db);
+}
+
+template <typename K>
+static void add_count(Index *index, const K &key, int64_t delta)
+{
+    static_cast<CountedAvlTreeIndex<K> *>(index)->add_count(key, delta);
+}
 
+void Index::count_changed(const Property &p, int64_t delta, GraphImpl *db)
+{
     switch(_ptype) {
         case PropertyType::Integer:
-            dest = static_cast<LongValueIndex *>(this)->add(p.int_value(),
-                                                            allocator);
+            add_count(this, p.int_value(), delta);
             break;
         case PropertyType::Float:
-            dest = static_cast<FloatValueIndex *>(this)->add(p.float_value(),
-                                                             allocator);
+            add_count(this, p.float_value(), delta);
             break;
         case PropertyType::Boolean:
-            dest = static_cast<BoolValueIndex *>(this)->add(p.bool_value(),
-                                                            allocator);
+            add_count(this, p.bool_value(), delta);
             break;
         case PropertyType::Time:
-            dest = static_cast<TimeValueIndex *>(this)->add(p.time_value(),
-                                                            allocator);
+            add_count(this, p.time_value(), delta);
             break;
         case PropertyType::String:
             {
                 TransientIndexString istr(p.string_value(), db->locale());
-                dest = static_cast<StringValueIndex *>(this)->add(istr, allocator);
+                add_count<IndexString>(this, istr, delta);
+            }
+            break;
+        default:
+            throw PMGDException(PropertyTypeInvalid);
+    }
+}
+
+void Index::check_unique(Graph::IndexType index_type, const Property &p,
+                         void *n, GraphImpl *db)
+{
+    if (!_unique)
+        return;
+    if (_ptype != p.type())
+        throw PMGDException(PropertyTypeMismatch);
+
+    PostingList *list;
+    switch(_ptype) {
+        case PropertyType::Integer:
+            list = find_key(p.int_value(), false);
+            break;
+        case PropertyType::Float:
+            list = find_key(p.float_value(), false);
+            break;
+        case PropertyType::Boolean:
+            list = find_key(p.bool_value(), false);
+            break;
+        case PropertyType::Time:
+            list = find_key(p.time_value(), false);
+            break;
+        case PropertyType::String:
+            {
+                TransientIndexString istr(p.string_value(), db->locale());
+                list = find_key<IndexString>(istr, false);
             }
             break;
         case PropertyType::NoValue:
@@ -78,83 +265,38 @@ void Index::add(const Property &p, void *n, GraphImpl *db)
         default:
             throw PMGDException(PropertyTypeInvalid);
     }
-    // dest will never be null since it gets allocated at the add time.
-    // Also, if it was a new element, the add code does a placement new.
-    // The List->init() function does not do a transaction flush but
-    // we are going to add an element right after before the transaction
-    // gets over and that does the right logging of the very same
-    // elements that get modified in init().
-    dest->add(n, allocator);
+
+    uint64_t slot = db->object_table(index_type).get_id(n) - 1;
+    if (held_by_other(list, slot))
+        throw PMGDException(NotUnique);
 }
 
-void Index::remove(const Property &p, void *n, GraphImpl *db)
+void Index::remove(Graph::IndexType index_type, const Property &p, void *n,
+                   GraphImpl *db)
 {
     if (_ptype != p.type())
         throw PMGDException(PropertyTypeMismatch);
 
     Allocator &allocator = db->allocator();
+    uint64_t slot = db->object_table(index_type).get_id(n) - 1;
 
-    List<void*> *dest;
     switch(_ptype) {
         case PropertyType::Integer:
-            {
-                LongValueIndex *prop_idx = static_cast<LongValueIndex *>(this);
-                dest = prop_idx->find(p.int_value(), true);
-                if (dest) {
-                    dest->remove(n, allocator);
-                    // TODO: Re-traversal of tree.
-                    if (dest->num_elems() == 0)
-                        prop_idx->remove(p.int_value(), allocator);
-                }
-            }
+            remove_key(p.int_value(), slot, allocator);
             break;
         case PropertyType::Float:
-            {
-                FloatValueIndex *prop_idx = static_cast<FloatValueIndex *>(this);
-                dest = prop_idx->find(p.float_value(), true);
-                if (dest) {
-                    dest->remove(n, allocator);
-                    // TODO: Re-traversal of tree.
-                    if (dest->num_elems() == 0)
-                        prop_idx->remove(p.float_value(), allocator);
-                }
-            }
+            remove_key(p.float_value(), slot, allocator);
             break;
         case PropertyType::Boolean:
-            {
-                BoolValueIndex *prop_idx = static_cast<BoolValueIndex *>(this);
-                dest = prop_idx->find(p.bool_value(), true);
-                if (dest) {
-                    dest->remove(n, allocator);
-                    // TODO: Re-traversal of tree.
-                    if (dest->num_elems() == 0)
-                        prop_idx->remove(p.bool_value(), allocator);
-                }
-            }
+            remove_key(p.bool_value(), slot, allocator);
             break;
         case PropertyType::Time:
-            {
-                TimeValueIndex *prop_idx = static_cast<TimeValueIndex *>(this);
-                dest = prop_idx->find(p.time_value(), true);
-                if (dest) {
-                    dest->remove(n, allocator);
-                    // TODO: Re-traversal of tree.
-                    if (dest->num_elems() == 0)
-                        prop_idx->remove(p.time_value(), allocator);
-                }
-            }
+            remove_key(p.time_value(), slot, allocator);
             break;
         case PropertyType::String:
             {
                 TransientIndexString istr(p.string_value(), db->locale());
-                StringValueIndex *prop_idx = static_cast<StringValueIndex *>(this);
-                dest = prop_idx->find(istr, true);
-                if (dest) {
-                    dest->remove(n, allocator);
-                    // TODO: Re-traversal of tree.
-                    if (dest->num_elems() == 0)
-                        prop_idx->remove(istr, allocator);
-                }
+                remove_key<IndexString>(istr, slot, allocator);
             }
             break;
         case PropertyType::NoValue:
@@ -165,17 +307,155 @@ void Index::remove(const Property &p, void *n, GraphImpl *db)
     }
 }
 
-Index::Index_IteratorImplIntf *Index::get_iterator(Graph::IndexType index_type,
-                                        const PropertyPredicate &pp, std::locale *loc,
+template <typename K, typename V>
+static void load_tree(AvlTree<K, V> *tree, const std::vector<const K *> &keys,
+                      std::vector<PostingList *> &lists, Allocator &allocator)
+{
+    lists.resize(keys.size());
+    tree->load(keys.size(),
+               [&](size_t i) -> const K & { return *keys[i]; },
+               [&](size_t i, V &list) { lists[i] = &list; },
+               allocator);
+}
+
+// The trees and hash tables are built bottom up, with nothing logged
+// but their roots, and a counted tree gets its counts once the lists
+// are full. Radix indexes take one key at a time, in order.
+template <typename K>
+void Index::load(const std::vector<std::pair<const K *, uint64_t>> &entries,
+                 GraphImpl *db)
+{
+    Allocator &allocator = db->allocator();
+    std::vector<const K *> keys;
+    std::vector<size_t> starts;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (i > 0 && *entries[i].first == *entries[i - 1].first) {
+            if (_unique)
+                throw PMGDException(NotUnique);
+            continue;
+        }
+        keys.push_back(entries[i].first);
+        starts.push_back(i);
+    }
+    starts.push_back(entries.size());
+
+    std::vector<PostingList *> lists;
+    if (_kind == Graph::BPlusTree)
+        static_cast<BTreeIndex<K> *>(this)->load(keys, lists, allocator);
+    else if (_kind == Graph::AvlIndex)
+        load_tree<K, PostingList>(static_cast<AvlTreeIndex<K, PostingList> *>(this),
+                                  keys, lists, allocator);
+    else if (_kind == Graph::CountedAvl)
+        load_tree<K, CountedPostingList>(static_cast<CountedAvlTreeIndex<K> *>(this),
+                                         keys, lists, allocator);
+    else if (_kind == Graph::Hash)
+        static_cast<HashIndex<K> *>(this)->load(keys, lists, allocator);
+    else {
+        for (const K *key : keys)
+            lists.push_back(add_key(*key, allocator));
+    }
+
+    std::vector<uint64_t> slots;
+    for (size_t k = 0; k < keys.size(); k++) {
+        slots.clear();
+        for (size_t i = starts[k]; i < starts[k + 1]; i++)
+            slots.push_back(entries[i].second);
+        lists[k]->load(slots.data(), slots.size(), allocator);
+    }
+    if (_kind == Graph::CountedAvl)
+        static_cast<CountedAvlTreeIndex<K> *>(this)->recount();
+}
+
+template void Index::load(const std::vector<std::pair<const long long *, uint64_t>> &,
+                          GraphImpl *);
+template void Index::load(const std::vector<std::pair<const double *, uint64_t>> &,
+                          GraphImpl *);
+template void Index::load(const std::vector<std::pair<const bool *, uint64_t>> &,
+                          GraphImpl *);
+template void Index::load(const std::vector<std::pair<const Time *, uint64_t>> &,
+                          GraphImpl *);
+template void Index::load(const std::vector<std::pair<const IndexString *, uint64_t>> &,
+                          GraphImpl *);
+
+template <typename K, class I>
+static Index::Index_IteratorImplIntf *iterator_from(I *This,
+                                        Graph::IndexType index_type,
+                                        PropertyPredicate::Op op,
+                                        const K &min, const K &max,
                                         bool reverse)
+{
+    if (op >= PropertyPredicate::GeLe)
+        return This->get_iterator(index_type, min, max, op, reverse);
+    else if (op == PropertyPredicate::DontCare)
+        return This->get_iterator(index_type, reverse);
+    else
+        return This->get_iterator(index_type, min, op, reverse);
+}
+
+// For DontCare, min and max are not looked at, and for the single
+// value ops, max is not.
+template <typename K>
+Index::Index_IteratorImplIntf *Index::get_iterator(Graph::IndexType index_type,
+                                        PropertyPredicate::Op op,
+                                        const K &min, const K &max,
+                                        bool reverse, size_t offset)
+{
+    if (_kind == Graph::CountedAvl)
+        return static_cast<CountedAvlTreeIndex<K> *>(this)->get_iterator(
+                   index_type, min, max, op, reverse, offset);
+
+    Index_IteratorImplIntf *it;
+    if (_kind == Graph::BPlusTree)
+        it = iterator_from(static_cast<BTreeIndex<K> *>(this),
+                           index_type, op, min, max, reverse);
+    else if (_kind == Graph::Hash)
+        it = iterator_from(static_cast<HashIndex<K> *>(this),
+                           index_type, op, min, max, reverse);
+    else if (_kind == Graph::Radix)
+        it = iterator_from(static_cast<RadixIndex<K> *>(this),
+                           index_type, op, min, max, reverse);
+    else
+        it = iterator_from(static_cast<AvlTreeIndex<K, PostingList> *>(this),
+                           index_type, op, min, max, reverse);
+    while (offset-- > 0 && bool(*it) && it->next())
+        ;
+    return it;
+}
+
+struct Index::IteratorOf {
+    typedef Index_IteratorImplIntf *Result;
+    Index *index;
+    Graph::IndexType index_type;
+    bool reverse;
+    size_t offset;
+
+    template <typename K>
+    Result operator()(PropertyPredicate::Op op, const K &min, const K &max) const
+        { return index->get_iterator(index_type, op, min, max, reverse, offset); }
+};
+
+struct Index::CountOf {
+    typedef size_t Result;
+    Index *index;
+
+    template <typename K>
+    Result operator()(PropertyPredicate::Op op, const K &min, const K &max) const
+        { return static_cast<CountedAvlTreeIndex<K> *>(index)->count(min, max, op); }
+};
+
+template <class F>
+typename F::Result Index::with_keys(const PropertyPredicate &pp, std::locale *loc,
+                                    F f)
 {
     const Property &p1 = pp.v1;
     const Property &p2 = pp.v2;
+    bool has_min = pp.op != PropertyPredicate::DontCare;
+    bool has_max = pp.op >= PropertyPredicate::GeLe;
 
-    if (pp.op != PropertyPredicate::DontCare) {
+    if (has_min) {
         if (_ptype != p1.type())
             throw PMGDException(PropertyTypeMismatch);
-        if (pp.op >= PropertyPredicate::GeLe) {
+        if (has_max) {
             if (_ptype != p2.type())
                 throw PMGDException(PropertyTypeMismatch);
         }
@@ -184,62 +464,47 @@ Index::Index_IteratorImplIntf *Index::get_iterator(Graph::IndexType index_type,
     switch(_ptype) {
         case PropertyType::Integer:
             {
-                LongValueIndex *This = static_cast<LongValueIndex *>(this);
-                if (pp.op >= PropertyPredicate::GeLe)
-                    return This->get_iterator(index_type, p1.int_value(), p2.int_value(), pp.op, reverse);
-                else if (pp.op == PropertyPredicate::DontCare)
-                    return This->get_iterator(index_type, reverse);
-                else
-                    return This->get_iterator(index_type, p1.int_value(), pp.op, reverse);
+                long long min = has_min ? p1.int_value() : 0;
+                long long max = has_max ? p2.int_value() : min;
+                return f(pp.op, min, max);
             }
-            break;
         case PropertyType::Float:
             {
-                FloatValueIndex *This = static_cast<FloatValueIndex *>(this);
-                if (pp.op >= PropertyPredicate::GeLe)
-                    return This->get_iterator(index_type, p1.float_value(), p2.float_value(), pp.op, reverse);
-                else if (pp.op == PropertyPredicate::DontCare)
-                    return This->get_iterator(index_type, reverse);
-                else
-                    return This->get_iterator(index_type, p1.float_value(), pp.op, reverse);
+                double min = has_min ? p1.float_value() : 0;
+                double max = has_max ? p2.float_value() : min;
+                return f(pp.op, min, max);
             }
-            break;
         case PropertyType::Boolean:
             {
-                BoolValueIndex *This = static_cast<BoolValueIndex *>(this);
-                if (pp.op >= PropertyPredicate::GeLe)
-                    return This->get_iterator(index_type, p1.bool_value(), p2.bool_value(), pp.op, reverse);
-                else if (pp.op == PropertyPredicate::DontCare)
-                    return This->get_iterator(index_type, reverse);
-                else
-                    return This->get_iterator(index_type, p1.bool_value(), pp.op, reverse);
+                bool min = has_min ? p1.bool_value() : false;
+                bool max = has_max ? p2.bool_value() : min;
+                return f(pp.op, min, max);
             }
-            break;
         case PropertyType::Time:
             {
-                TimeValueIndex *This = static_cast<TimeValueIndex *>(this);
-                if (pp.op >= PropertyPredicate::GeLe)
-                    return This->get_iterator(index_type, p1.time_value(), p2.time_value(), pp.op, reverse);
-                else if (pp.op == PropertyPredicate::DontCare)
-                    return This->get_iterator(index_type, reverse);
-                else
-                    return This->get_iterator(index_type, p1.time_value(), pp.op, reverse);
+                Time min = has_min ? p1.time_value() : Time();
+                Time max = has_max ? p2.time_value() : min;
+                return f(pp.op, min, max);
             }
-            break;
         case PropertyType::String:
             {
-                StringValueIndex *This = static_cast<StringValueIndex *>(this);
-                if (pp.op == PropertyPredicate::DontCare)
-                    return This->get_iterator(index_type, reverse);
-                TransientIndexString istr(p1.string_value(), *loc);
-                if (pp.op >= PropertyPredicate::GeLe) {
-                    TransientIndexString istr2(p2.string_value(), *loc);
-                    return This->get_iterator(index_type, istr, istr2, pp.op, reverse);
+                TransientIndexString min(has_min ? p1.string_value() : "", *loc);
+                if (pp.op == PropertyPredicate::Prefix && _kind != Graph::Radix) {
+                    // The trees find a prefix as the range of keys up
+                    // to the next key that does not start with it.
+                    std::string next;
+                    min.append_to(next);
+                    const IndexString &lo = min;
+                    if (!successor(next))
+                        return f(PropertyPredicate::Ge, lo, lo);
+                    TransientIndexString max(next);
+                    const IndexString &hi = max;
+                    return f(PropertyPredicate::GeLt, lo, hi);
                 }
-                else
-                    return This->get_iterator(index_type, istr, pp.op, reverse);
+                TransientIndexString max(has_max ? p2.string_value() : "", *loc);
+                const IndexString &lo = min, &hi = max;
+                return f(pp.op, lo, hi);
             }
-            break;
         case PropertyType::NoValue:
             throw PMGDException(NotImplemented);
         case PropertyType::Blob:
@@ -248,42 +513,55 @@ Index::Index_IteratorImplIntf *Index::get_iterator(Graph::IndexType index_type,
     }
 }
 
+Index::Index_IteratorImplIntf *Index::get_iterator(Graph::IndexType index_type,
+                                        const PropertyPredicate &pp, std::locale *loc,
+                                        bool reverse, size_t offset)
+{
+    return with_keys(pp, loc, IteratorOf{this, index_type, reverse, offset});
+}
+
+size_t Index::count(const PropertyPredicate &pp, std::locale *loc)
+{
+    return with_keys(pp, loc, CountOf{this});
+}
+
+template <typename K>
+void Index::key_stats(Graph::IndexStats &stats)
+{
+    if (_kind == Graph::CountedAvl)
+        static_cast<CountedAvlTreeIndex<K> *>(this)->index_stats_info(stats);
+    else if (_kind == Graph::BPlusTree)
+        static_cast<BTreeIndex<K> *>(this)->index_stats_info(stats);
+    else if (_kind == Graph::Hash)
+        static_cast<HashIndex<K> *>(this)->index_stats_info(stats);
+    else if (_kind == Graph::Radix)
+        static_cast<RadixIndex<K> *>(this)->index_stats_info(stats);
+    else
+        static_cast<AvlTreeIndex<K, PostingList> *>(this)->index_stats_info(stats);
+}
+
 Graph::IndexStats Index::get_stats()
 {
     Graph::IndexStats stats;
     switch(_ptype) {
         case PropertyType::Integer:
-            {
-                LongValueIndex *This   = static_cast<LongValueIndex *>(this);
-                This->index_stats_info(stats);
-            }
+            key_stats<long long>(stats);
             break;
         case PropertyType::Float:
-            {
-                FloatValueIndex *This = static_cast<FloatValueIndex *>(this);
-                This->index_stats_info(stats);
-            }
+            key_stats<double>(stats);
             break;
         case PropertyType::Boolean:
-            {
-                BoolValueIndex *This = static_cast<BoolValueIndex *>(this);
-                This->index_stats_info(stats);
-            }
+            key_stats<bool>(stats);
             break;
         case PropertyType::Time:
-            {
-                TimeValueIndex *This = static_cast<TimeValueIndex *>(this);
-                This->index_stats_info(stats);
-            }
+            key_stats<Time>(stats);
             break;
         case PropertyType::String:
-            {
-                StringValueIndex *This = static_cast<StringValueIndex *>(this);
-                This->index_stats_info(stats);
-            }
+            key_stats<IndexString>(stats);
             break;
         case PropertyType::NoValue:
-            throw PMGDException(NotImplemented);
+            static_cast<TagIndex *>(this)->index_stats_info(stats);
+            break;
         case PropertyType::Blob:
             throw PMGDException(NotImplemented);
         default:
@@ -292,3 +570,44 @@ Graph::IndexStats Index::get_stats()
 
     return stats;
 }
+
+template <typename K>
+void Index::key_prefetch(unsigned levels)
+{
+    if (_kind == Graph::CountedAvl)
+        static_cast<CountedAvlTreeIndex<K> *>(this)->prefetch(levels);
+    else if (_kind == Graph::BPlusTree)
+        static_cast<BTreeIndex<K> *>(this)->prefetch(levels);
+    else if (_kind == Graph::Hash)
+        static_cast<HashIndex<K> *>(this)->prefetch(levels);
+    else if (_kind == Graph::Radix)
+        static_cast<RadixIndex<K> *>(this)->prefetch(levels);
+    else
+        static_cast<AvlTreeIndex<K, PostingList> *>(this)->prefetch(levels);
+}
+
+void Index::prefetch(unsigned levels)
+{
+    switch(_ptype) {
+        case PropertyType::Integer:
+            key_prefetch<long long>(levels);
+            break;
+        case PropertyType::Float:
+            key_prefetch<double>(levels);
+            break;
+        case PropertyType::Boolean:
+            key_prefetch<bool>(levels);
+            break;
+        case PropertyType::Time:
+            key_prefetch<Time>(levels);
+            break;
+        case PropertyType::String:
+            key_prefetch<IndexString>(levels);
+            break;
+        case PropertyType::NoValue:
+            static_cast<TagIndex *>(this)->prefetch(levels);
+            break;
+        default:
+            break;
+    }
+}
@@ -28,6 +28,8 @@
  */
 
 #pragma once
+#include <vector>
+#include <utility>
 #include "property.h"
 #include "iterator.h"
 #include "graph.h"
@@ -35,36 +37,118 @@
 namespace PMGD {
     class Node;
     class Allocator;
+    class PostingList;
     class GraphImpl;
 
     // Base class for all the property value indices
     // Data resides in PM
     class Index {
+        // Bytes, to keep the flag in what was padding
         PropertyType _ptype;
+        uint8_t _kind;          // Graph::IndexKind
+        bool _unique;
+
     public:
         class Index_IteratorImplIntf {
         public:
             virtual ~Index_IteratorImplIntf() { }
             virtual void *ref() const = 0;
+            // The table slot of the object at the iterator, without
+            // locking the object
+            virtual uint64_t slot() const = 0;
             virtual operator bool() const = 0;
             virtual bool next() = 0;
         };
 
-        Index(PropertyType ptype) : _ptype(ptype) {}
+        Index(PropertyType ptype, Graph::IndexKind kind = Graph::AvlIndex)
+            : _ptype(ptype), _kind(kind), _unique(false) {}
+
+        Graph::IndexKind kind() const { return Graph::IndexKind(_kind); }
+
+        // At most one object per value. Set only when the index is
+        // created, before it has values.
+        bool unique() const { return _unique; }
+        void set_unique();
+
+        // A hash index can only look up single values, and Prefix
+        // needs string keys that keep the prefixes of the strings.
+        bool supports(PropertyPredicate::Op op, const std::locale &loc) const;
+
+        void add(Graph::IndexType index_type, const Property &p, void *n,
+                 GraphImpl *db);
+        void remove(Graph::IndexType index_type, const Property &p, void *n,
+                    GraphImpl *db);
+        // Throws NotUnique if another object has the value in a
+        // unique index. add checks this too, but under the write lock
+        // on the value; this lets a caller check before it changes
+        // anything.
+        void check_unique(Graph::IndexType index_type, const Property &p,
+                          void *n, GraphImpl *db);
+
+        // The list of objects with the value, added empty if there is
+        // none, and write locked for changes, in one descent of the
+        // index
+        PostingList *get_list(const Property &p, GraphImpl *db);
+
+        // Fills the index, which must be new, with the objects at the
+        // table slots in entries, sorted by key and then slot. The
+        // keys stay with the caller.
+        template <typename K>
+        void load(const std::vector<std::pair<const K *, uint64_t>> &entries,
+                  GraphImpl *db);
 
-        void add(const Property &p, void *n, GraphImpl *db);
-        void remove(const Property &p, void *n, GraphImpl *db);
         void check_type(const PropertyType ptype)
             { if (_ptype != ptype) throw PMGDException(PropertyTypeMismatch); }
 
         // Use a locale pointer here so that callers, where locale is
         // irrelevant, do not need to acquire it from the GraphImpl object.
+        // The iterator starts offset objects in; only a counted index
+        // finds the start without stepping over them.
         Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type,
                                              const PropertyPredicate &pp, std::locale *loc,
-                                             bool reverse);
+                                             bool reverse, size_t offset = 0);
+
+        // A counted AVL index keeps the number of objects under each
+        // tree node, to count what a predicate selects in O(log n).
+        // count is only for counted indexes.
+        bool counted() const { return _kind == Graph::CountedAvl; }
+        size_t count(const PropertyPredicate &pp, std::locale *loc);
 
         // Function to gather statistics
         Graph::IndexStats get_stats();
         void index_stats_info(Graph::IndexStats &stats);
+
+        // Bring the top levels of the index into the cache
+        void prefetch(unsigned levels);
+
+    private:
+        struct IteratorOf;
+        struct CountOf;
+
+        // Calls f with the op of pp and its values as keys of the
+        // type of the index
+        template <class F>
+        typename F::Result with_keys(const PropertyPredicate &pp, std::locale *loc,
+                                     F f);
+
+        void count_changed(const Property &p, int64_t delta, GraphImpl *db);
+
+        // These cast this to the index class for _kind with keys of
+        // type K.
+        template <typename K>
+        PostingList *add_key(const K &key, Allocator &allocator);
+        template <typename K>
+        PostingList *find_key(const K &key, bool write_lock);
+        template <typename K>
+        void remove_key(const K &key, uint64_t slot, Allocator &allocator);
+        template <typename K>
+        Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type,
+                                             PropertyPredicate::Op op,
+                                             const K &min, const K &max,
+                                             bool reverse, size_t offset);
+        template <typename K>
+        void key_stats(Graph::IndexStats &stats);
+        template <typename K>
+        void key_prefetch(unsigned levels);
     };
 }
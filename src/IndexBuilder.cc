@@ -0,0 +1,222 @@
+/**
+ * @file   IndexBuilder.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+#include "IndexBuilder.h"
+#include "Index.h"
+#include "CompositeIndex.h"
+#include "IndexString.h"
+#include "GraphImpl.h"
+#include "node.h"
+#include "edge.h"
+#include "exception.h"
+
+using namespace PMGD;
+
+// The keys a thread finds, kept where they were put, and its run
+// pointing to them. Strings are kept transformed, in DRAM.
+template <typename K> struct RunKey { typedef K type; };
+template <> struct RunKey<IndexString> { typedef TransientIndexString type; };
+
+template <typename K> struct Run {
+    std::deque<typename RunKey<K>::type> keys;
+    std::vector<std::pair<const K *, uint64_t>> entries;
+};
+
+static void add_key(std::deque<long long> &keys, const Property &p,
+                    const std::locale &)
+    { keys.push_back(p.int_value()); }
+static void add_key(std::deque<double> &keys, const Property &p,
+                    const std::locale &)
+    { keys.push_back(p.float_value()); }
+static void add_key(std::deque<bool> &keys, const Property &p,
+                    const std::locale &)
+    { keys.push_back(p.bool_value()); }
+static void add_key(std::deque<Time> &keys, const Property &p,
+                    const std::locale &)
+    { keys.push_back(p.time_value()); }
+static void add_key(std::deque<TransientIndexString> &keys, const Property &p,
+                    const std::locale &loc)
+    { keys.emplace_back(p.string_value(), loc); }
+
+template <typename K>
+static bool entry_less(const std::pair<const K *, uint64_t> &a,
+                       const std::pair<const K *, uint64_t> &b)
+{
+    if (*a.first < *b.first)
+        return true;
+    if (*b.first < *a.first)
+        return false;
+    return a.second < b.second;
+}
+
+// Merges the sorted runs pairwise into one list
+template <typename K>
+static std::vector<std::pair<const K *, uint64_t>> merge_runs(std::vector<Run<K>> &runs)
+{
+    std::vector<std::pair<const K *, uint64_t>> entries;
+    std::vector<size_t> bounds(1, 0);
+    for (Run<K> &run : runs) {
+        entries.insert(entries.end(), run.entries.begin(), run.entries.end());
+        run.entries.clear();
+        bounds.push_back(entries.size());
+    }
+    while (bounds.size() > 2) {
+        std::vector<size_t> merged(1, 0);
+        for (size_t i = 2; i < bounds.size(); i += 2) {
+            std::inplace_merge(entries.begin() + bounds[i - 2],
+                               entries.begin() + bounds[i - 1],
+                               entries.begin() + bounds[i], entry_less<K>);
+            merged.push_back(bounds[i]);
+        }
+        if (bounds.size() % 2 == 0)
+            merged.push_back(bounds.back());
+        bounds.swap(merged);
+    }
+    return entries;
+}
+
+// Calls found(t, slot, obj) for each object with the tag in slice t
+// of the table, and done(t) at the end of the slice, from one thread
+// per slice. Exceptions are passed on once all the threads are done.
+template <typename F, typename D>
+void IndexBuilder::scan(F found, D done)
+{
+    FixedAllocator &table = _db->object_table(_index_type);
+    char *begin = (char *)table.begin();
+    size_t size = table.object_size();
+    size_t count = ((const char *)table.end() - begin) / size;
+
+    size_t slices = std::min<size_t>(MAX_THREADS, count / MIN_SLICE);
+    slices = std::min<size_t>(slices, std::thread::hardware_concurrency());
+    if (slices == 0)
+        slices = 1;
+
+    std::vector<std::exception_ptr> errors(slices);
+    auto work = [&](unsigned t) {
+        try {
+            for (size_t i = count * t / slices; i < count * (t + 1) / slices; i++) {
+                void *obj = begin + i * size;
+                if (table.is_free(obj))
+                    continue;
+                StringID tag = _index_type == Graph::NodeIndex
+                                   ? static_cast<Node *>(obj)->get_tag()
+                                   : static_cast<Edge *>(obj)->get_tag();
+                if (_tag == 0 || tag == _tag)
+                    found(t, i, obj);
+            }
+            done(t);
+        }
+        catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < slices; t++)
+        threads.push_back(std::thread(work, t));
+    work(0);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    for (std::exception_ptr &e : errors)
+        if (e)
+            std::rethrow_exception(e);
+}
+
+template <typename K>
+void IndexBuilder::build(Index *index, StringID property_id, PropertyType ptype)
+{
+    const std::locale &loc = _db->locale();
+    std::vector<Run<K>> runs(MAX_THREADS);
+    scan([&](unsigned t, uint64_t slot, void *obj) {
+             Property p;
+             bool has = _index_type == Graph::NodeIndex
+                            ? static_cast<Node *>(obj)->check_property(property_id, p)
+                            : static_cast<Edge *>(obj)->check_property(property_id, p);
+             if (!has)
+                 return;
+             if (p.type() != ptype)
+                 throw PMGDException(PropertyTypeMismatch);
+             add_key(runs[t].keys, p, loc);
+             runs[t].entries.push_back(std::make_pair(&runs[t].keys.back(), slot));
+         },
+         [&](unsigned t) {
+             std::sort(runs[t].entries.begin(), runs[t].entries.end(),
+                       entry_less<K>);
+         });
+    index->load(merge_runs(runs), _db);
+}
+
+void IndexBuilder::build(Index *index, StringID property_id, PropertyType ptype)
+{
+    switch(ptype) {
+        case PropertyType::Integer:
+            build<long long>(index, property_id, ptype);
+            break;
+        case PropertyType::Float:
+            build<double>(index, property_id, ptype);
+            break;
+        case PropertyType::Boolean:
+            build<bool>(index, property_id, ptype);
+            break;
+        case PropertyType::Time:
+            build<Time>(index, property_id, ptype);
+            break;
+        case PropertyType::String:
+            build<IndexString>(index, property_id, ptype);
+            break;
+        default:
+            throw PMGDException(PropertyTypeInvalid);
+    }
+}
+
+void IndexBuilder::build(CompositeIndex *index)
+{
+    const std::locale &loc = _db->locale();
+    std::vector<Run<IndexString>> runs(MAX_THREADS);
+    scan([&](unsigned t, uint64_t slot, void *obj) {
+             std::string key;
+             if (!index->get_key(key, _index_type, obj, loc))
+                 return;
+             runs[t].keys.emplace_back(key);
+             runs[t].entries.push_back(std::make_pair(&runs[t].keys.back(), slot));
+         },
+         [&](unsigned t) {
+             std::sort(runs[t].entries.begin(), runs[t].entries.end(),
+                       entry_less<IndexString>);
+         });
+    // The B+-tree's own load takes the keys alone.
+    index->Index::load(merge_runs(runs), _db);
+}
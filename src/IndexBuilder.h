@@ -0,0 +1,76 @@
+/**
+ * @file   IndexBuilder.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "stringid.h"
+#include "property.h"
+#include "graph.h"
+
+namespace PMGD {
+    class GraphImpl;
+    class Index;
+    class CompositeIndex;
+
+    // Fills a new index with the objects that have its properties
+    // already. A few threads each scan a slice of the node or edge
+    // table and sort the keys they find into a run; the runs are
+    // merged and the index is loaded from them in key order.
+    // The threads read the objects outside of any transaction. The
+    // caller has the table read locked, so no objects are added
+    // meanwhile, and the index list for the tag write locked, which
+    // every change to a property of an object with the tag reads
+    // first; so the objects stay as the threads saw them until the
+    // new index is committed, and there are no changes to catch up
+    // on.
+    class IndexBuilder {
+        static const unsigned MAX_THREADS = 8;
+        static const size_t MIN_SLICE = 4096;
+
+        GraphImpl *_db;
+        Graph::IndexType _index_type;
+        StringID _tag;
+
+        template <typename F, typename D> void scan(F found, D done);
+        template <typename K> void build(Index *index, StringID property_id,
+                                         PropertyType ptype);
+
+    public:
+        IndexBuilder(GraphImpl *db, Graph::IndexType index_type, StringID tag)
+            : _db(db), _index_type(index_type), _tag(tag) { }
+
+        // Throws PropertyTypeMismatch if an object has the property
+        // with another type.
+        void build(Index *index, StringID property_id, PropertyType ptype);
+
+        // Values of other types end the key, as for later changes.
+        void build(CompositeIndex *index);
+    };
+}
@@ -32,6 +32,13 @@
 #include "graph.h"
 #include "List.h"
 #include "AvlTreeIndex.h"
+#include "BTreeIndex.h"
+#include "HashIndex.h"
+#include "RadixIndex.h"
+#include "CompositeIndex.h"
+#include "TagIndex.h"
+#include "IndexBuilder.h"
+#include "GraphImpl.h"
 
 using namespace PMGD;
 
@@ -53,9 +60,7 @@ IndexManager::IndexList *IndexManager::add_tag_index(
     // all nodes/edges for this tag will get indexed here apart from their
     // indexed property values.
     if (tag_entry->num_elems() == 0 && !(tag == 0)) {
-        // All we need is one value in the tree. Hopefully we will have different
-        // type of data structure options eventually.
-        Index *prop0_idx = new (allocator.alloc(sizeof(BoolValueIndex))) BoolValueIndex(PropertyType::Boolean);
+        Index *prop0_idx = new (allocator.alloc(sizeof(TagIndex))) TagIndex();
         Index **value = tag_entry->add(0, allocator);
         *value = prop0_idx;
     }
@@ -63,13 +68,143 @@ IndexManager::IndexList *IndexManager::add_tag_index(
     return tag_entry;
 }
 
+TagIndex *IndexManager::get_tag_index(Graph::IndexType index_type, StringID tag)
+{
+    // Every non-zero tag gets one with its entry, so this is only
+    // NULL for a tag that was never used.
+    return static_cast<TagIndex *>(get_index(index_type, tag, 0));
+}
+
+void IndexManager::set_light(StringID tag)
+{
+    if (tag == 0 || _tag_prop_map[Graph::EdgeIndex].find(tag) != NULL
+            || edge_order(tag) != NULL)
+        throw PMGDException(LightEdgeMismatch);
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    uint64_t *word = &_light_tags[tag.id() / 64];
+    tx->acquire_lock(TransactionImpl::IndexLock, word, true);
+    tx->write(word, *word | uint64_t(1) << tag.id() % 64);
+}
+
+bool IndexManager::is_light(StringID tag)
+{
+    uint64_t *word = &_light_tags[tag.id() / 64];
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::IndexLock, word, false);
+    return *word >> tag.id() % 64 & 1;
+}
+
+void IndexManager::set_edge_order(StringID tag, StringID property_id,
+                                  PropertyType ptype)
+{
+    if (ptype != PropertyType::Integer && ptype != PropertyType::Time)
+        throw PMGDException(PropertyTypeInvalid);
+    if (tag == 0 || is_light(tag) || has_elems(Graph::EdgeIndex, tag))
+        throw PMGDException(EdgeOrderMismatch);
+
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, _edge_orders, true);
+    EdgeOrder order = { tag, property_id, ptype };
+    EdgeOrder *entry = const_cast<EdgeOrder *>(edge_order(tag));
+    if (entry == NULL) {
+        if (_edge_orders->count == MAX_EDGE_ORDERS)
+            throw PMGDException(OutOfSpace);
+        entry = &_edge_orders->orders[_edge_orders->count];
+        tx->write(&_edge_orders->count, _edge_orders->count + 1);
+    }
+    tx->write(entry, order);
+}
+
+const IndexManager::EdgeOrder *IndexManager::edge_order(StringID tag)
+{
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::IndexLock,
+                                            _edge_orders, false);
+    for (unsigned i = 0; i < _edge_orders->count; i++)
+        if (_edge_orders->orders[i].tag == tag)
+            return &_edge_orders->orders[i];
+    return NULL;
+}
+
+// Time keeps UTC in time_val, which is what Time compares by.
+long long IndexManager::order_key(const Property &p)
+{
+    if (p.type() == PropertyType::Time)
+        return p.time_value().time_val;
+    return p.int_value();
+}
+
+// Keeps both ends of the edge in step with its order property. The
+// nodes get write locked, since readers of the ordered adjacency only
+// hold read locks on them.
+void IndexManager::update_order(Edge *edge, StringID id,
+                                const PropertyRef *old_value,
+                                const Property *new_value)
+{
+    const EdgeOrder *order = edge_order(edge->get_tag());
+    if (order == NULL || !(order->property_id == id))
+        return;
+    if (new_value != NULL && new_value->type() != order->ptype)
+        throw PMGDException(PropertyTypeMismatch);
+
+    Allocator &allocator = TransactionImpl::get_tx()->get_db()->allocator();
+    Node &src = edge->get_source();
+    Node &dest = edge->get_destination();
+    if (old_value != NULL) {
+        long long key = order_key(Property(*old_value));
+        src.remove_ordered_edge(edge, Outgoing, key, allocator);
+        dest.remove_ordered_edge(edge, Incoming, key, allocator);
+    }
+    if (new_value != NULL) {
+        long long key = order_key(*new_value);
+        src.add_ordered_edge(edge, Outgoing, key, allocator);
+        dest.add_ordered_edge(edge, Incoming, key, allocator);
+    }
+}
+
 // The general order of data structures is:
 // IndexManager->_tag_prop_map[node/edge]->_propid_propvalueadt_map->the index
+template <template <typename> class I, typename K>
+static Index *new_index(PropertyType ptype, Allocator &allocator)
+{
+    return new (allocator.alloc(sizeof(I<K>))) I<K>(ptype);
+}
+
+// For the kinds other than AvlIndex
+template <template <typename> class I>
+static Index *new_index(PropertyType ptype, Allocator &allocator)
+{
+    switch(ptype) {
+        case PropertyType::Integer:
+            return new_index<I, long long>(ptype, allocator);
+        case PropertyType::Float:
+            return new_index<I, double>(ptype, allocator);
+        case PropertyType::Boolean:
+            return new_index<I, bool>(ptype, allocator);
+        case PropertyType::Time:
+            return new_index<I, Time>(ptype, allocator);
+        case PropertyType::String:
+            return new_index<I, IndexString>(ptype, allocator);
+        case PropertyType::NoValue:
+            throw PMGDException(NotImplemented);
+        default:
+            throw PMGDException(PropertyTypeInvalid);
+    }
+}
+
 void IndexManager::create_index(Graph::IndexType index_type, StringID tag,
                                 StringID property_id,
                                 PropertyType ptype,
+                                Graph::IndexKind kind, bool unique,
                                 Allocator &allocator)
 {
+    // Light edges have no records to index.
+    if (index_type == Graph::EdgeIndex && is_light(tag))
+        throw PMGDException(LightEdgeMismatch);
+
+    // Keep objects from being added while the index is filled. The
+    // table is locked before the index list, as add_node does.
+    GraphImpl *db = TransactionImpl::get_tx()->get_db();
+    db->lock_table(index_type);
+
     // Check if there is an entry for this tag. If there is,
     // there will already be a property id data structure there,
     // which will get returned to us and then we can add a new
@@ -81,7 +216,18 @@ void IndexManager::create_index(Graph::IndexType index_type, StringID tag,
     // (tag,propid) combination for node or edge
     Index **prop_idx = tag_entry->add(property_id, allocator);
 
-    if (*prop_idx == NULL) {
+    if (*prop_idx != NULL)
+        return;
+
+    if (kind == Graph::BPlusTree)
+        *prop_idx = new_index<BTreeIndex>(ptype, allocator);
+    else if (kind == Graph::Hash)
+        *prop_idx = new_index<HashIndex>(ptype, allocator);
+    else if (kind == Graph::Radix)
+        *prop_idx = new_index<RadixIndex>(ptype, allocator);
+    else if (kind == Graph::CountedAvl)
+        *prop_idx = new_index<CountedAvlTreeIndex>(ptype, allocator);
+    else {
         switch(ptype) {
             case PropertyType::Integer:
                 *prop_idx = new (allocator.alloc(sizeof(LongValueIndex))) LongValueIndex(ptype);
@@ -104,12 +250,46 @@ void IndexManager::create_index(Graph::IndexType index_type, StringID tag,
                 throw PMGDException(PropertyTypeInvalid);
         }
     }
+    if (unique)
+        (*prop_idx)->set_unique();
+    IndexBuilder(db, index_type, tag).build(*prop_idx, property_id, ptype);
+}
+
+void IndexManager::create_index(Graph::IndexType index_type, StringID tag,
+                                const std::vector<Graph::IndexColumn> &columns,
+                                Allocator &allocator)
+{
+    if (index_type == Graph::EdgeIndex && is_light(tag))
+        throw PMGDException(LightEdgeMismatch);
+    CompositeIndex::check_columns(columns);
+
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    GraphImpl *db = tx->get_db();
+    db->lock_table(index_type);
+    tx->acquire_lock(TransactionImpl::IndexLock, _composites, true);
+    for (unsigned i = 0; i < _composites->count; i++) {
+        auto &entry = _composites->entries[i];
+        if (entry.index_type == index_type && entry.tag == tag
+                && entry.index->same_columns(columns))
+            return;
+    }
+    if (_composites->count == MAX_COMPOSITES)
+        throw PMGDException(OutOfSpace);
+
+    add_tag_index(index_type, tag, allocator);
+    auto &entry = _composites->entries[_composites->count];
+    tx->log(&entry, sizeof entry);
+    entry.index_type = index_type;
+    entry.tag = tag;
+    entry.index = new (allocator.alloc(sizeof(CompositeIndex))) CompositeIndex(columns);
+    tx->write(&_composites->count, _composites->count + 1);
+    IndexBuilder(db, index_type, tag).build(entry.index);
 }
 
-bool IndexManager::add(Graph::IndexType index_type, StringID tag, void *obj,
-                       Allocator &allocator)
+bool IndexManager::add(Graph::IndexType index_type, StringID tag,
+                       void *const *objs, size_t count, Allocator &allocator)
 {
-    assert(obj != NULL);
+    assert(count == 0 || objs[0] != NULL);
 
     if (tag == 0)
         return false;
@@ -122,43 +302,32 @@ bool IndexManager::add(Graph::IndexType index_type, StringID tag, void *obj,
     // For now, add only to the no property list ==> index via tag
     // This entry should always exist since we add it explicitly when
     // creating a new tag entry
-    // TODO: Perhaps use NoValue in this case instead of Boolean.
-    // TODO: Tree is unnecessary and Node* needs better arrangement for
-    // quick search and remove operations
-    BoolValueIndex *idx = (BoolValueIndex *)*(tag_entry->find(0));
-
-    // Now retrieve the list where node pointers are getting added
-    // This particular property only has one value = true and should
-    // be the first and only node in the tree.
-    bool value = true;
-    List<void *> *list = idx->add(value, allocator);
-    list->add(obj, allocator);
+    TagIndex *idx = static_cast<TagIndex *>(*(tag_entry->find(0)));
+    FixedAllocator &table = TransactionImpl::get_tx()->get_db()->object_table(index_type);
+    idx->add(objs, count, table, allocator);
 
     return true;
 }
 
-void IndexManager::remove(Graph::IndexType index_type, StringID tag, void *obj,
-                          Allocator &allocator)
+void IndexManager::remove(Graph::IndexType index_type, StringID tag,
+                          void *const *objs, size_t count, Allocator &allocator)
 {
-    assert(obj != NULL);
+    assert(count == 0 || objs[0] != NULL);
 
     if (tag == 0)
         return;
 
-    // Get the tag index. Since we are indexing all nodes based
-    // on their tags, it should always exist.
-    IndexList *tag_entry = _tag_prop_map[index_type].add(tag, allocator);
-
-    // Get the no property list ==> index via tag
-    // This entry should always exist.
-    BoolValueIndex *idx = (BoolValueIndex *)*(tag_entry->find(0));
+    // Get the no property list ==> index via tag. Since we are indexing
+    // all nodes based on their tags, it should always exist.
+    TagIndex *idx = get_tag_index(index_type, tag);
+    FixedAllocator &table = TransactionImpl::get_tx()->get_db()->object_table(index_type);
+    idx->remove(objs, count, table, allocator);
+}
 
-    // Now retrieve the list where node pointers are added
-    // This particular property only has one value = true and should
-    // be the first and only node in the tree.
-    bool value = true;
-    List<void *> *list = idx->find(value, true);
-    list->remove(obj, allocator);
+bool IndexManager::has_elems(Graph::IndexType index_type, StringID tag)
+{
+    TagIndex *idx = get_tag_index(index_type, tag);
+    return idx != NULL && idx->has_elems();
 }
 
 Index *IndexManager::get_index(Graph::IndexType index_type, StringID tag,
@@ -186,6 +355,28 @@ Index *IndexManager::get_index(Graph::IndexType index_type, StringID tag,
     return *idx;
 }
 
+CompositeIndex *IndexManager::get_composite(Graph::IndexType index_type,
+                                   StringID tag,
+                                   const std::vector<PropertyPredicate> &preds,
+                                   std::vector<const PropertyPredicate *> &cols)
+{
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::IndexLock,
+                                            _composites, false);
+    CompositeIndex *best = NULL;
+    std::vector<const PropertyPredicate *> served;
+    cols.clear();
+    for (unsigned i = 0; i < _composites->count; i++) {
+        auto &entry = _composites->entries[i];
+        if (entry.index_type != unsigned(index_type) || !(entry.tag == tag))
+            continue;
+        if (entry.index->plan(preds, served) > cols.size()) {
+            best = entry.index;
+            cols.swap(served);
+        }
+    }
+    return best;
+}
+
 Graph::IndexStats IndexManager::get_index_stats(Graph::IndexType index_type, StringID tag,
                                StringID property_id)
 {
@@ -304,6 +495,20 @@ Graph::IndexStats IndexManager::get_index_stats()
     return stats;
 }
 
+void IndexManager::prefetch(unsigned levels)
+{
+    for (int i = 0; i < 2; i++) {
+        for (auto &tag_entry : _tag_prop_map[i].get_key_values()) {
+            for (auto &idx : tag_entry->value().get_key_values())
+                idx->value()->prefetch(levels);
+        }
+    }
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::IndexLock,
+                                            _composites, false);
+    for (unsigned i = 0; i < _composites->count; i++)
+        _composites->entries[i].index->prefetch(levels);
+}
+
 Graph::ChunkStats IndexManager::get_all_chunk_lists_stats()
 {
     Graph::ChunkStats stats = {0,0,0,0,0};
@@ -389,22 +594,23 @@ Graph::ChunkStats IndexManager::get_chunk_list_stats(Graph::IndexType index_type
 Index::Index_IteratorImplIntf *IndexManager::get_iterator
     (Graph::IndexType index_type, StringID tag)
 {
-    Index *prop0_idx;
-    prop0_idx = get_index(index_type, tag, 0);
+    TagIndex *prop0_idx = get_tag_index(index_type, tag);
     if (!prop0_idx)
         return NULL;
 
-    // This index can never be null cause we create it for each non-zero tag.
-    // The second parameter here is the locale which we surely do not need for
-    // a boolean property.
-    return prop0_idx->get_iterator(index_type, PropertyPredicate(0, PropertyPredicate::Eq, true),
-                                    NULL, false);
+    FixedAllocator &table = TransactionImpl::get_tx()->get_db()->object_table(index_type);
+    return prop0_idx->get_iterator(index_type, table);
 }
 
 void IndexManager::update
     (GraphImpl *db, Graph::IndexType index_type, StringID tag, void *obj,
-     StringID id, const PropertyRef *old_value, const Property *new_value)
+     StringID id, const PropertyRef *old_value, const Property *new_value,
+     bool composites)
 {
+    // This throws for a value of the wrong type before anything changes.
+    if (index_type == Graph::EdgeIndex)
+        update_order((Edge *)obj, id, old_value, new_value);
+
     // get_index throws if the property type doesn't match the index.
     PropertyType ptype = new_value ? new_value->type() : PropertyType(0);
     Index *index = get_index(index_type, tag, id, ptype);
@@ -413,18 +619,67 @@ void IndexManager::update
     // This is a general all-tag index for certain properties such as loader id.
     Index *gindex = get_index(Graph::IndexType(index_type), 0, id, ptype);
 
+    // Fail before anything changes for a value that is taken.
+    if (new_value != NULL) {
+        if (index)
+            index->check_unique(index_type, *new_value, obj, db);
+        if (gindex)
+            gindex->check_unique(index_type, *new_value, obj, db);
+    }
+
+    if (composites)
+        update_composites(db, index_type, tag, obj, id, old_value, new_value);
+
     if (old_value != NULL && (index != NULL || gindex != NULL)) {
         Property tmp(*old_value);
         if (index)
-            index->remove(tmp, obj, db);
+            index->remove(index_type, tmp, obj, db);
         if (gindex)
-            gindex->remove(tmp, obj, db);
+            gindex->remove(index_type, tmp, obj, db);
     }
 
     if (new_value != NULL) {
         if (index)
-            index->add(*new_value, obj, db);
+            index->add(index_type, *new_value, obj, db);
         if (gindex)
-            gindex->add(*new_value, obj, db);
+            gindex->add(index_type, *new_value, obj, db);
+    }
+}
+
+// An index on tag 0 takes objects with any tag, as for single
+// properties.
+void IndexManager::update_composites(GraphImpl *db, Graph::IndexType index_type,
+                                     StringID tag, void *obj, StringID id,
+                                     const PropertyRef *old_value,
+                                     const Property *new_value)
+{
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::IndexLock,
+                                            _composites, false);
+    std::vector<CompositeIndex *> indexes;
+    for (unsigned i = 0; i < _composites->count; i++) {
+        auto &entry = _composites->entries[i];
+        if (entry.index_type == unsigned(index_type)
+                && (entry.tag == tag || entry.tag == 0)
+                && entry.index->has_column(id)) {
+            // Check them all before changing any.
+            if (new_value != NULL)
+                entry.index->check_column_type(id, new_value->type());
+            indexes.push_back(entry.index);
+        }
+    }
+    for (CompositeIndex *index : indexes)
+        index->update(db, index_type, obj, id, old_value, new_value);
+}
+
+void IndexManager::remove_composites(GraphImpl *db, Graph::IndexType index_type,
+                                     StringID tag, void *obj)
+{
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::IndexLock,
+                                            _composites, false);
+    for (unsigned i = 0; i < _composites->count; i++) {
+        auto &entry = _composites->entries[i];
+        if (entry.index_type == unsigned(index_type)
+                && (entry.tag == tag || entry.tag == 0))
+            entry.index->remove(db, index_type, obj);
     }
 }
@@ -40,6 +40,8 @@
 
 namespace PMGD {
     class Allocator;
+    class TagIndex;
+    class CompositeIndex;
 
     // This class creates/maintains all indexes in PMGD.
     // It supports the create_index() API visible to the user
@@ -49,6 +51,15 @@ namespace PMGD {
     // index data structure.
     // The final index structure indexes based on property values
     class IndexManager {
+    public:
+        // The property that the adjacency of edges with a tag is
+        // ordered by
+        struct EdgeOrder {
+            StringID tag;
+            StringID property_id;
+            PropertyType ptype;
+        };
+
     private:
         static const unsigned TAGLIST_CHUNK_SIZE = 128;
         static const unsigned INDEXLIST_CHUNK_SIZE = 128;
@@ -67,31 +78,106 @@ namespace PMGD {
         // This is a pointer so we can typecast it in PM at the constructor
         TagList *_tag_prop_map;
 
+        // One bit per string id, set for edge tags whose edges are
+        // light. Follows the tag lists in the region.
+        static const size_t LIGHT_TAG_WORDS = (size_t(1) << 16) / 64;
+        uint64_t *_light_tags;
+
+        // The edge orders set so far. Follows the light tag bitmap.
+        // There shouldn't be many, so a search is fine.
+        static const unsigned MAX_EDGE_ORDERS = 255;
+        struct EdgeOrderTable {
+            uint32_t count;
+            EdgeOrder orders[MAX_EDGE_ORDERS];
+        };
+        EdgeOrderTable *_edge_orders;
+
+        // The composite indexes. Follows the edge order table. These
+        // are searched too.
+        static const unsigned MAX_COMPOSITES = 127;
+        struct CompositeTable {
+            uint32_t count;
+            struct {
+                uint32_t index_type;
+                StringID tag;
+                CompositeIndex *index;
+            } entries[MAX_COMPOSITES];
+        };
+        CompositeTable *_composites;
+
         IndexList *add_tag_index(Graph::IndexType index_type,
                                      StringID tag,
                                      Allocator &allocator);
+        TagIndex *get_tag_index(Graph::IndexType index_type, StringID tag);
 
         bool add(Graph::IndexType index_type, StringID tag, void *obj,
-                 Allocator &allocator);
+                 Allocator &allocator)
+            { return add(index_type, tag, &obj, 1, allocator); }
+        bool add(Graph::IndexType index_type, StringID tag,
+                 void *const *objs, size_t count, Allocator &allocator);
         void remove(Graph::IndexType index_type, StringID tag, void *obj,
-                 Allocator &allocator);
+                 Allocator &allocator)
+            { remove(index_type, tag, &obj, 1, allocator); }
+        void remove(Graph::IndexType index_type, StringID tag,
+                    void *const *objs, size_t count, Allocator &allocator);
+        bool has_elems(Graph::IndexType index_type, StringID tag);
+        void update_order(Edge *edge, StringID id,
+                          const PropertyRef *old_value, const Property *new_value);
+        void update_composites(GraphImpl *db, Graph::IndexType index_type,
+                               StringID tag, void *obj, StringID id,
+                               const PropertyRef *old_value,
+                               const Property *new_value);
 
         Graph::IndexStats get_index_stats(IndexList *tag_entry);
 
     public:
         IndexManager(const uint64_t region_addr, CommonParams &params)
-            : _tag_prop_map(reinterpret_cast<TagList *>(region_addr))
+            : _tag_prop_map(reinterpret_cast<TagList *>(region_addr)),
+              _light_tags(reinterpret_cast<uint64_t *>(_tag_prop_map + 2)),
+              _edge_orders(reinterpret_cast<EdgeOrderTable *>(_light_tags + LIGHT_TAG_WORDS)),
+              _composites(reinterpret_cast<CompositeTable *>(_edge_orders + 1))
         {
             if (params.create) {
                 _tag_prop_map[0].init(params.msync_needed, *params.pending_commits);
                 _tag_prop_map[1].init(params.msync_needed, *params.pending_commits);
+                memset(_light_tags, 0, LIGHT_TAG_WORDS * sizeof *_light_tags);
+                TransactionImpl::flush_range(_light_tags,
+                                             LIGHT_TAG_WORDS * sizeof *_light_tags,
+                                             params.msync_needed,
+                                             *params.pending_commits);
+                _edge_orders->count = 0;
+                TransactionImpl::flush_range(&_edge_orders->count,
+                                             sizeof _edge_orders->count,
+                                             params.msync_needed,
+                                             *params.pending_commits);
+                _composites->count = 0;
+                TransactionImpl::flush_range(&_composites->count,
+                                             sizeof _composites->count,
+                                             params.msync_needed,
+                                             *params.pending_commits);
             }
         }
 
+        // A tag can only be made light before it has edges or
+        // indexes of its own.
+        void set_light(StringID tag);
+        bool is_light(StringID tag);
+
+        // Likewise, an edge order can only be set before the tag has
+        // edges. Returns NULL if the tag has none.
+        void set_edge_order(StringID tag, StringID property_id,
+                            PropertyType ptype);
+        const EdgeOrder *edge_order(StringID tag);
+        static long long order_key(const Property &p);
+
         void create_index(Graph::IndexType index_type, StringID tag,
                             StringID property_id,
                             PropertyType ptype,
+                            Graph::IndexKind kind, bool unique,
                             Allocator &allocator);
+        void create_index(Graph::IndexType index_type, StringID tag,
+                          const std::vector<Graph::IndexColumn> &columns,
+                          Allocator &allocator);
 
         // Nodes and edges have to be added to an index in two
         // stages. One at the add_node or add_edge stage. Another at
@@ -104,21 +190,48 @@ namespace PMGD {
         bool add_edge(Edge *edge, Allocator &allocator)
             { return add(Graph::EdgeIndex, edge->get_tag(), edge, allocator); }
 
+        // For batches of objects that all have the same tag
+        bool add_nodes(StringID tag, void *const *nodes, size_t count,
+                       Allocator &allocator)
+            { return add(Graph::NodeIndex, tag, nodes, count, allocator); }
+
+        bool add_edges(StringID tag, void *const *edges, size_t count,
+                       Allocator &allocator)
+            { return add(Graph::EdgeIndex, tag, edges, count, allocator); }
+
         void remove_node(Node *node, Allocator &allocator)
             { remove(Graph::NodeIndex, node->get_tag(), node, allocator); }
 
         void remove_edge(Edge *edge, Allocator &allocator)
             { remove(Graph::EdgeIndex, edge->get_tag(), edge, allocator); }
 
+        // For batches of edges that all have the same tag
+        void remove_edges(StringID tag, void *const *edges, size_t count,
+                          Allocator &allocator)
+            { remove(Graph::EdgeIndex, tag, edges, count, allocator); }
+
+        // Without composites, the composite indexes are left alone.
+        // Removing all the properties of an object takes it out of
+        // them once, with remove_composites, since a composite key
+        // depends on the properties still to go.
         void update(GraphImpl *db,
                     Graph::IndexType index_type, StringID tag, void *obj,
                     StringID id,
-                    const PropertyRef *old_value, const Property *new_value);
+                    const PropertyRef *old_value, const Property *new_value,
+                    bool composites = true);
+        void remove_composites(GraphImpl *db, Graph::IndexType index_type,
+                               StringID tag, void *obj);
 
         Index *get_index(Graph::IndexType index_type, StringID tag,
                          StringID property_id,
                          PropertyType ptype = PropertyType(0));
 
+        // The composite index on tag that serves the most of preds,
+        // with the ones it serves in cols, or NULL if none serves any
+        CompositeIndex *get_composite(Graph::IndexType index_type, StringID tag,
+                                      const std::vector<PropertyPredicate> &preds,
+                                      std::vector<const PropertyPredicate *> &cols);
+
         Graph::IndexStats get_index_stats();
         Graph::IndexStats get_index_stats(Graph::IndexType index_type);
         Graph::IndexStats get_index_stats(Graph::IndexType index_type, StringID tag);
@@ -131,5 +244,9 @@ namespace PMGD {
 
         Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type,
                                                     StringID tag);
+
+        // Touch the tag and property lists and the top levels of
+        // every index. Needs a transaction for the read locks.
+        void prefetch(unsigned levels);
     };
 }
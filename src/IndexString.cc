@@ -115,6 +115,37 @@ int IndexString::compare(const IndexString &istr) const
     return (long long)_len - (long long)istr._len;
 }
 
+uint64_t IndexString::hash() const
+{
+    // FNV-1a over the transformed string
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned i = 0; i < PREFIX_LEN; i++)
+        h = (h ^ (unsigned char)_prefix[i]) * 0x100000001b3ull;
+    for (uint32_t i = 0; i + PREFIX_LEN < _len; i++)
+        h = (h ^ (unsigned char)_remainder[i]) * 0x100000001b3ull;
+    return h ^ _len;
+}
+
+void IndexString::append_to(std::string &s) const
+{
+    if (_len > PREFIX_LEN) {
+        s.append(_prefix, PREFIX_LEN);
+        s.append(_remainder, _len - PREFIX_LEN);
+    }
+    else
+        s.append(_prefix, _len);
+}
+
+bool PMGD::successor(std::string &key)
+{
+    while (!key.empty() && (unsigned char)key.back() == 0xff)
+        key.pop_back();
+    if (key.empty())
+        return false;
+    key.back()++;
+    return true;
+}
+
 TransientIndexString::TransientIndexString(const std::string &str,
                                             const std::locale &loc)
 {
@@ -122,17 +153,37 @@ TransientIndexString::TransientIndexString(const std::string &str,
     // This also makes it easier to break the string at any point
     // without losing multi-byte characters.
     const std::collate<char>& col = std::use_facet<std::collate<char> >(loc);
-    std::string tstr = col.transform(str.data(), str.data() + str.length());
-    _len = tstr.length();
+    init(col.transform(str.data(), str.data() + str.length()));
+}
+
+TransientIndexString::TransientIndexString(const IndexString &istr)
+{
+    _len = istr._len;
+    memcpy(_prefix, istr._prefix, PREFIX_LEN);
+    if (_len > PREFIX_LEN) {
+        uint32_t remaining = _len - PREFIX_LEN;
+        _remainder = (char *)malloc(remaining * sizeof(char));
+        memcpy(_remainder, istr._remainder, remaining);
+    }
+}
+
+TransientIndexString::TransientIndexString(const std::string &key)
+{
+    init(key);
+}
+
+void TransientIndexString::init(const std::string &str)
+{
+    _len = str.length();
 
     if (_len > PREFIX_LEN) {
-        memcpy(_prefix, tstr.data(), PREFIX_LEN);
+        memcpy(_prefix, str.data(), PREFIX_LEN);
         uint32_t remaining = _len - PREFIX_LEN;
         _remainder = (char *)malloc(remaining * sizeof(char));
-        memcpy(_remainder, tstr.data() + PREFIX_LEN, remaining);
+        memcpy(_remainder, str.data() + PREFIX_LEN, remaining);
     }
     else {
-        memcpy(_prefix, tstr.data(), _len);
+        memcpy(_prefix, str.data(), _len);
         memset(_prefix + _len, 0, PREFIX_LEN - _len);
     }
 }
@@ -33,8 +33,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <locale>
+#include <string>
 
 namespace PMGD {
+    class TransientIndexString;
+
     // String representation for Index nodes
     // This version of the class will always create a PM copy.
     class IndexString {
@@ -50,6 +53,8 @@ namespace PMGD {
 
         IndexString() : _remainder(NULL) { }
 
+        friend class PMGD::TransientIndexString;
+
     public:
         // Use this constructor to create a PM copy.
         IndexString(const IndexString &istr);
@@ -75,10 +80,20 @@ namespace PMGD {
         bool operator>(const IndexString &istr) const
             { return (compare(istr) > 0); }
 
+        // Equal strings hash the same.
+        uint64_t hash() const;
+
         size_t get_remainder_size()
             { return (_len > PREFIX_LEN)? _len - PREFIX_LEN : 0; }
+
+        // Appends the transformed string to s
+        void append_to(std::string &s) const;
     };
 
+    // The least key after every key that starts with key, if there is
+    // one
+    bool successor(std::string &key);
+
     // We need to create this class to know which version of _remainder
     // lives in PM vs. DRAM so that we do not try to free something that
     // doesnt belong to our allocators.
@@ -89,11 +104,25 @@ namespace PMGD {
         // Avoid accidental assignments and copies.
         TransientIndexString(const TransientIndexString&);
         TransientIndexString& operator=(const TransientIndexString&);
+
+        void init(const std::string &str);
     public:
         // Doesn't create a copy in PM. But the locale based transformation
         // happens here and gets copied at a DRAM location.
         TransientIndexString(const std::string &str, const std::locale &loc);
 
+        // A DRAM copy of a string that is transformed already
+        explicit TransientIndexString(const IndexString &istr);
+
+        // For keys that are built to compare as bytes, such as the
+        // keys of a CompositeIndex
+        explicit TransientIndexString(const std::string &key);
+
         ~TransientIndexString();
     };
+
+    // The type for an iterator to keep a key in DRAM, so that a
+    // query does not allocate in PM
+    template <typename K> struct BoundKey { typedef K type; };
+    template <> struct BoundKey<IndexString> { typedef TransientIndexString type; };
 }
@@ -29,6 +29,7 @@
 
 #pragma once
 #include <stdint.h>
+#include <unordered_set>
 #include "Allocator.h"
 #include "TransactionImpl.h"
 #include "GraphImpl.h"
@@ -69,7 +70,14 @@ namespace PMGD {
         void init() { *this = List(); }
 
         T* add(const T &value, Allocator &allocator);
+        // Same result as adding the values one at a time
+        void add(const T *values, size_t count, Allocator &allocator);
         void remove(const T &value, Allocator &allocator);
+        // Same result as removing the values one at a time, in one
+        // pass over the list
+        void remove(const T *values, size_t count, Allocator &allocator);
+        // Frees every element. No iterators are notified.
+        void clear(Allocator &allocator);
         T* find(const T &val);
         size_t num_elems() const { return _num_elems; }
         size_t elem_size() const { return sizeof(T); }
@@ -117,6 +125,26 @@ namespace PMGD {
         return &(new_node->value);
     }
 
+    template <typename T> void List<T>::add(const T *values, size_t count,
+                                            Allocator &allocator)
+    {
+        if (count == 0)
+            return;
+        TransactionImpl *tx = TransactionImpl::get_tx();
+        ListType *head = _list;
+        for (size_t i = 0; i < count; i++) {
+            ListType *new_node = (ListType *)allocator.alloc(sizeof *new_node);
+            new_node->value = values[i];
+            new_node->next = head;
+            tx->flush_range(new_node, sizeof *new_node);
+            head = new_node;
+        }
+
+        tx->log(this, sizeof *this);
+        _list = head;
+        _num_elems += count;
+    }
+
     template <typename T> void List<T>::remove(const T &value, Allocator &allocator)
     {
         ListType *prev = NULL, *temp = _list;
@@ -146,6 +174,50 @@ namespace PMGD {
         }
     }
 
+    template <typename T> void List<T>::remove(const T *values, size_t count,
+                                               Allocator &allocator)
+    {
+        if (count <= 1) {
+            if (count == 1)
+                remove(values[0], allocator);
+            return;
+        }
+
+        std::unordered_set<T> set(values, values + count);
+        TransactionImpl *tx = TransactionImpl::get_tx();
+        ListType **link = &_list;
+        ListType *temp = _list;
+        size_t removed = 0;
+        while (temp != NULL && removed < set.size()) {
+            ListType *next = temp->next;
+            if (set.count(temp->value) != 0) {
+                tx->iterator_callbacks().iterator_remove_notify(temp);
+                tx->write(link, next);
+                allocator.free(temp, sizeof *temp);
+                removed++;
+            }
+            else
+                link = &temp->next;
+            temp = next;
+        }
+        if (removed > 0)
+            tx->write(&_num_elems, _num_elems - removed);
+    }
+
+    template <typename T> void List<T>::clear(Allocator &allocator)
+    {
+        ListType *temp = _list;
+        while (temp != NULL) {
+            ListType *next = temp->next;
+            allocator.free(temp, sizeof *temp);
+            temp = next;
+        }
+        TransactionImpl *tx = TransactionImpl::get_tx();
+        tx->log(this, sizeof *this);
+        _list = NULL;
+        _num_elems = 0;
+    }
+
     template <typename T> T* List<T>::find(const T &value)
     {
         ListType *temp = _list;
@@ -0,0 +1,412 @@
+/**
+ * @file   PostingList.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+#include <vector>
+#include "PostingList.h"
+#include "Allocator.h"
+#include "TransactionImpl.h"
+
+using namespace PMGD;
+
+bool PostingChunk::contains(unsigned off)
+{
+    if (capacity == BITMAP)
+        return bits()[off / 64] >> off % 64 & 1;
+    return std::binary_search(offsets(), offsets() + count, uint16_t(off));
+}
+
+unsigned PostingChunk::next(unsigned off)
+{
+    if (off >= SLOTS)
+        return SLOTS;
+    if (capacity != BITMAP) {
+        uint16_t *a = offsets();
+        uint16_t *p = std::lower_bound(a, a + count, uint16_t(off));
+        return p == a + count ? SLOTS : *p;
+    }
+    unsigned w = off / 64;
+    uint64_t word = bits()[w] & ~uint64_t(0) << off % 64;
+    while (word == 0 && ++w < SLOTS / 64)
+        word = bits()[w];
+    return word == 0 ? SLOTS : w * 64 + __builtin_ctzll(word);
+}
+
+unsigned PostingChunk::rank(unsigned off)
+{
+    if (capacity != BITMAP) {
+        uint16_t *a = offsets();
+        return std::lower_bound(a, a + count, uint16_t(off)) - a;
+    }
+    unsigned n = 0;
+    unsigned w = off / 64;
+    for (unsigned i = 0; i < w; ++i)
+        n += __builtin_popcountll(bits()[i]);
+    if (off % 64 != 0)
+        n += __builtin_popcountll(bits()[w] & ~(~uint64_t(0) << off % 64));
+    return n;
+}
+
+unsigned PostingChunk::nth(unsigned n)
+{
+    if (capacity != BITMAP)
+        return offsets()[n];
+    unsigned w = 0;
+    for (unsigned c; (c = __builtin_popcountll(bits()[w])) <= n; ++w)
+        n -= c;
+    uint64_t word = bits()[w];
+    while (n-- > 0)
+        word &= word - 1;
+    return w * 64 + __builtin_ctzll(word);
+}
+
+PostingChunk *PostingList::new_chunk(unsigned capacity, Allocator &allocator)
+{
+    PostingChunk header = { 0, uint16_t(capacity), 0 };
+    PostingChunk *chunk = (PostingChunk *)allocator.alloc(header.size());
+    memset(chunk, 0, header.size());
+    *chunk = header;
+    return chunk;
+}
+
+// Moves the chunk to a larger array, or to a bitmap once the array
+// would be as large as one. Iterators are told to look it up again.
+PostingChunk *PostingList::grow(PostingChunk *chunk, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    PostingChunk *bigger;
+    if (chunk->capacity < MAX_CAPACITY) {
+        bigger = new_chunk(chunk->capacity * 2, allocator);
+        memcpy(bigger->offsets(), chunk->offsets(),
+               chunk->count * sizeof(uint16_t));
+    }
+    else {
+        bigger = new_chunk(PostingChunk::BITMAP, allocator);
+        for (unsigned i = 0; i < chunk->count; i++) {
+            unsigned off = chunk->offsets()[i];
+            bigger->bits()[off / 64] |= uint64_t(1) << off % 64;
+        }
+    }
+    bigger->count = chunk->count;
+
+    // Since bigger is a new allocation, just flush it without logging.
+    tx->flush_range(bigger, bigger->size());
+    allocator.free(chunk, chunk->size());
+    tx->iterator_callbacks().iterator_rebalance_notify(this);
+    return bigger;
+}
+
+// Adds slot to the chunk tree, and returns false if it was there.
+bool PostingList::insert(uint64_t slot, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    // This write locks the tree node, which covers the chunk.
+    PostingChunk **where = AvlTree::add(slot / PostingChunk::SLOTS, allocator);
+    PostingChunk *chunk = *where;
+    unsigned off = slot % PostingChunk::SLOTS;
+
+    if (chunk == NULL) {
+        chunk = new_chunk(MIN_CAPACITY, allocator);
+        tx->flush_range(chunk, chunk->size());
+        tx->write(where, chunk);
+    }
+    else if (chunk->contains(off))
+        return false;
+    else if (chunk->count == chunk->capacity) {
+        chunk = grow(chunk, allocator);
+        tx->write(where, chunk);
+    }
+
+    if (chunk->capacity == PostingChunk::BITMAP) {
+        uint64_t *word = &chunk->bits()[off / 64];
+        tx->write(word, *word | uint64_t(1) << off % 64);
+    }
+    else {
+        uint16_t *a = chunk->offsets();
+        uint16_t *p = std::lower_bound(a, a + chunk->count, uint16_t(off));
+        size_t tail = a + chunk->count - p;
+        tx->log(p, (tail + 1) * sizeof *p);
+        memmove(p + 1, p, tail * sizeof *p);
+        *p = uint16_t(off);
+    }
+    tx->write(&chunk->count, uint16_t(chunk->count + 1));
+    return true;
+}
+
+void PostingList::add(uint64_t slot, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    if (_num_elems >= 2) {
+        if (insert(slot, allocator))
+            tx->write(&_num_elems, _num_elems + 1);
+        return;
+    }
+
+    tx->acquire_lock(TransactionImpl::IndexLock, this, true);
+    if (_num_elems == 0)
+        tx->write(&_tree, (TreeNode *)slot);
+    else if (single() == slot)
+        return;
+    else {
+        // A second member: move the first one into a chunk tree.
+        uint64_t first = single();
+        tx->write(&_tree, (TreeNode *)NULL);
+        insert(first, allocator);
+        insert(slot, allocator);
+        tx->iterator_callbacks().iterator_rebalance_notify(this);
+    }
+    tx->write(&_num_elems, _num_elems + 1);
+}
+
+void PostingList::load(const uint64_t *slots, size_t count,
+                       Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    assert(_num_elems == 0);
+
+    // The list is new, so it is flushed rather than logged.
+    if (count == 1) {
+        _tree = (TreeNode *)slots[0];
+        _num_elems = 1;
+        tx->flush_range(this, sizeof *this);
+        return;
+    }
+
+    std::vector<uint64_t> keys;
+    std::vector<PostingChunk *> chunks;
+    for (size_t i = 0; i < count; ) {
+        uint64_t key = slots[i] / PostingChunk::SLOTS;
+        size_t n = 1;
+        while (i + n < count && slots[i + n] / PostingChunk::SLOTS == key)
+            n++;
+
+        // The capacity that adds one at a time would have grown to
+        unsigned capacity = MIN_CAPACITY;
+        while (capacity < n && capacity < MAX_CAPACITY)
+            capacity *= 2;
+        PostingChunk *chunk = new_chunk(n > capacity ? PostingChunk::BITMAP
+                                                     : capacity, allocator);
+        for (size_t j = i; j < i + n; j++) {
+            unsigned off = slots[j] % PostingChunk::SLOTS;
+            if (chunk->capacity == PostingChunk::BITMAP)
+                chunk->bits()[off / 64] |= uint64_t(1) << off % 64;
+            else
+                chunk->offsets()[j - i] = uint16_t(off);
+        }
+        chunk->count = uint16_t(n);
+        // Since the chunk is a new allocation, flush it without logging.
+        tx->flush_range(chunk, chunk->size());
+        keys.push_back(key);
+        chunks.push_back(chunk);
+        i += n;
+    }
+
+    AvlTree::load(keys.size(),
+                  [&](size_t i) -> const uint64_t & { return keys[i]; },
+                  [&](size_t i, PostingChunk *&v) { v = chunks[i]; },
+                  allocator);
+    // The list is new too.
+    _num_elems = count;
+    tx->flush_range(&_num_elems, sizeof _num_elems);
+}
+
+void PostingList::remove(uint64_t slot, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    if (_num_elems < 2) {
+        tx->acquire_lock(TransactionImpl::IndexLock, this, true);
+        if (_num_elems == 0 || single() != slot)
+            return;
+        tx->write(&_tree, (TreeNode *)NULL);
+        tx->write(&_num_elems, uint64_t(0));
+
+        // The caller removes an empty list from its index, so
+        // iterators on it have to move on.
+        tx->iterator_callbacks().iterator_remove_notify(this);
+        return;
+    }
+
+    uint64_t key = slot / PostingChunk::SLOTS;
+    PostingChunk **where = find(key, true);
+    unsigned off = slot % PostingChunk::SLOTS;
+    if (where == NULL || !(*where)->contains(off))
+        return;
+
+    PostingChunk *chunk = *where;
+    if (chunk->capacity == PostingChunk::BITMAP) {
+        uint64_t *word = &chunk->bits()[off / 64];
+        tx->write(word, *word & ~(uint64_t(1) << off % 64));
+    }
+    else {
+        uint16_t *a = chunk->offsets();
+        uint16_t *p = std::lower_bound(a, a + chunk->count, uint16_t(off));
+        size_t tail = a + chunk->count - p - 1;
+        tx->log(p, (tail + 1) * sizeof *p);
+        memmove(p, p + 1, tail * sizeof *p);
+    }
+    tx->write(&chunk->count, uint16_t(chunk->count - 1));
+    tx->write(&_num_elems, _num_elems - 1);
+
+    if (chunk->count == 0) {
+        AvlTree::remove(key, allocator);
+        allocator.free(chunk, chunk->size());
+        tx->iterator_callbacks().iterator_rebalance_notify(this);
+    }
+
+    // Back to one member: keep it inline and take the tree down.
+    if (_num_elems == 1) {
+        key = 0;
+        chunk = next_chunk(key);
+        uint64_t last = key * PostingChunk::SLOTS + chunk->next(0);
+        AvlTree::remove(key, allocator);
+        allocator.free(chunk, chunk->size());
+        tx->write(&_tree, (TreeNode *)last);
+        tx->iterator_callbacks().iterator_rebalance_notify(this);
+    }
+}
+
+// The chunk with the smallest number at or after key
+PostingChunk *PostingList::next_chunk(uint64_t &key)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    TreeNode *found = NULL;
+    for (TreeNode *curr = _tree; curr != NULL; ) {
+        tx->acquire_lock(TransactionImpl::IndexLock, curr, false);
+        if (curr->key < key)
+            curr = curr->right;
+        else {
+            found = curr;
+            curr = curr->left;
+        }
+    }
+    if (found == NULL)
+        return NULL;
+    key = found->key;
+    return found->value;
+}
+
+bool PostingList::get_single(uint64_t &slot)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    if (_num_elems != 1)
+        return false;
+    slot = single();
+    return true;
+}
+
+size_t PostingList::size_bytes()
+{
+    if (_num_elems == 1)
+        return 0;
+    size_t bytes = 0;
+    visit([&bytes](const uint64_t &, PostingChunk *&chunk)
+          { bytes += sizeof(TreeNode) + chunk->size(); });
+    return bytes;
+}
+
+void PostingListTraverser::seek(uint64_t key, unsigned off)
+{
+    uint64_t slot;
+    if (_list != NULL && _list->get_single(slot)) {
+        _chunk = NULL;
+        if (slot >= key * PostingChunk::SLOTS + off) {
+            _key = slot / PostingChunk::SLOTS;
+            _off = slot % PostingChunk::SLOTS;
+            return;
+        }
+        _list = NULL;
+        return;
+    }
+
+    while (_list != NULL) {
+        uint64_t found = key;
+        PostingChunk *chunk = _list->next_chunk(found);
+        if (chunk == NULL)
+            break;
+        unsigned next = chunk->next(found == key ? off : 0);
+        if (next < PostingChunk::SLOTS) {
+            _chunk = chunk;
+            _key = found;
+            _off = next;
+            return;
+        }
+        key = found + 1;
+        off = 0;
+    }
+    _list = NULL;
+    _chunk = NULL;
+}
+
+void PostingListTraverser::reset(PostingList *l)
+{
+    _list = l;
+    PostingChunk **chunk = _list->_num_elems == 1 ? NULL : _list->find(_key);
+    _chunk = chunk == NULL ? NULL : *chunk;
+}
+
+bool PostingListTraverser::next()
+{
+    if (_chunk == NULL)
+        seek(_key, _off + 1);
+    else {
+        unsigned next = _chunk->next(_off + 1);
+        if (next < PostingChunk::SLOTS) {
+            _off = next;
+            return true;
+        }
+        seek(_key + 1, 0);
+    }
+    return _list != NULL;
+}
+
+void PostingListTraverser::skip(uint64_t n)
+{
+    while (n > 0 && _list != NULL) {
+        if (_chunk == NULL || !_chunk->contains(_off)) {
+            next();
+            --n;
+            continue;
+        }
+        unsigned rank = _chunk->rank(_off);
+        uint64_t left = _chunk->count - rank;
+        if (n < left) {
+            _off = _chunk->nth(rank + unsigned(n));
+            return;
+        }
+        n -= left;
+        seek(_key + 1, 0);
+    }
+}
@@ -0,0 +1,173 @@
+/**
+ * @file   PostingList.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "AvlTree.h"
+
+namespace PMGD {
+    class Allocator;
+
+    // A run of SLOTS table slots in a posting list. It holds a
+    // sorted array of the slot offsets while it has few members and a
+    // bitmap once it has more.
+    struct PostingChunk {
+        static const unsigned SLOTS = 4096;
+        static const uint16_t BITMAP = 0;
+
+        uint16_t count;
+        uint16_t capacity;      // Offsets in the array, or BITMAP
+        uint32_t unused;
+
+        uint16_t *offsets() { return (uint16_t *)(this + 1); }
+        uint64_t *bits() { return (uint64_t *)(this + 1); }
+
+        size_t size() const
+        {
+            return sizeof *this + (capacity == BITMAP ? SLOTS / 8
+                                   : capacity * sizeof(uint16_t));
+        }
+
+        bool contains(unsigned off);
+
+        // The first member at or after off, or SLOTS
+        unsigned next(unsigned off);
+
+        // The number of members before off, and the member with n
+        // members before it
+        unsigned rank(unsigned off);
+        unsigned nth(unsigned n);
+    };
+
+    // The objects with one value in a property index, as slots of the
+    // node or edge table. The slots are grouped in chunks by their
+    // high bits, and the chunks are kept in a tree by chunk number.
+    // Removing an object is a search in the tree and in one chunk
+    // instead of a walk of the whole list, and a scan returns the
+    // objects in table order.
+    // Most values of an index on ids or names have one object, so
+    // while the list has one member, its slot is kept in place of the
+    // root of the chunk tree, and there are no chunks. The tree is
+    // built when a second member comes and taken down when the list
+    // is back to one.
+    // This class *lives* in PM, inside the index tree node. Changes
+    // to it are made under the tree node's write lock.
+    class PostingList : public AvlTree<uint64_t, PostingChunk *> {
+        static const unsigned MIN_CAPACITY = 4;
+        static const unsigned MAX_CAPACITY = 128;
+
+        uint64_t _num_elems;
+
+        uint64_t single() const { return uint64_t(_tree); }
+
+        PostingChunk *new_chunk(unsigned capacity, Allocator &allocator);
+        PostingChunk *grow(PostingChunk *chunk, Allocator &allocator);
+        bool insert(uint64_t slot, Allocator &allocator);
+
+        friend class PostingListTraverser;
+        PostingChunk *next_chunk(uint64_t &key);
+
+        // Read locks the list, and gets the slot of its member if it
+        // has just one.
+        bool get_single(uint64_t &slot);
+
+    public:
+        PostingList() : _num_elems(0) { }
+
+        void add(uint64_t slot, Allocator &allocator);
+        void remove(uint64_t slot, Allocator &allocator);
+        size_t num_elems() const { return _num_elems; }
+
+        // Adds count slots in increasing order to a list new in this
+        // transaction, writing each chunk once at the size it ends up
+        // with. Nothing is logged.
+        void load(const uint64_t *slots, size_t count, Allocator &allocator);
+
+        // Bytes used by the chunks and their tree
+        size_t size_bytes();
+    };
+
+    // A posting list in a tree that counts the elements in each
+    // subtree, with room for the count of its tree node
+    class CountedPostingList : public PostingList {
+        uint64_t _subtree;
+
+        friend struct SubtreeCount<CountedPostingList>;
+
+    public:
+        CountedPostingList() : _subtree(0) { }
+    };
+
+    template <> struct SubtreeCount<CountedPostingList> {
+        static const bool kept = true;
+        static uint64_t weight(const CountedPostingList &list)
+            { return list.num_elems(); }
+        static uint64_t *field(CountedPostingList &list)
+            { return &list._subtree; }
+    };
+
+    // Walks a posting list in slot order. Its position survives the
+    // removal of the object at it; is_member() tells that case apart.
+    class PostingListTraverser {
+        PostingList *_list;
+        PostingChunk *_chunk;
+        uint64_t _key;
+        unsigned _off;
+
+        void seek(uint64_t key, unsigned off);
+
+    public:
+        PostingListTraverser(PostingList *l) { set(l); }
+
+        void set(PostingList *l) { _list = l; seek(0, 0); }
+
+        // Looks up the chunk again after the list moved or changed
+        // shape. The position is kept.
+        void reset(PostingList *l);
+
+        uint64_t ref() const
+            { return _key * PostingChunk::SLOTS + _off; }
+        bool is_member() const
+        {
+            if (_chunk != NULL)
+                return _chunk->contains(_off);
+            return _list != NULL && _list->_num_elems == 1
+                       && _list->single() == ref();
+        }
+        operator bool() const { return _list != NULL; }
+        bool next();
+
+        // Moves on n objects, stepping over whole chunks by their
+        // counts
+        void skip(uint64_t n);
+
+        bool check(void *p) const { return p == _list; }
+    };
+}
@@ -265,6 +265,8 @@ void PropertyList::remove_all_properties(
     TransactionImpl *tx = TransactionImpl::get_tx();
     GraphImpl *db = tx->get_db();
     Allocator &allocator = db->allocator();
+    db->index_manager().remove_composites(db, Graph::IndexType(index_type),
+                                          tag, obj);
     PropertyRef p(this);
     bool first = true;
     while (p.not_done()) {
@@ -282,7 +284,8 @@ void PropertyList::remove_all_properties(
                 break;
             case PropertyRef::p_string_ptr:
                 db->index_manager().update(db, Graph::IndexType(index_type),
-                                           tag, obj, p.get_id(), &p, NULL);
+                                           tag, obj, p.get_id(), &p, NULL,
+                                           false);
                 /* fall through */
             case PropertyRef::p_blob: { // Note: indexes not supported for blobs
                 PropertyRef::BlobRef *v = (PropertyRef::BlobRef *)p.val();
@@ -291,7 +294,8 @@ void PropertyList::remove_all_properties(
             }
             default:
                 db->index_manager().update(db, Graph::IndexType(index_type),
-                                           tag, obj, p.get_id(), &p, NULL);
+                                           tag, obj, p.get_id(), &p, NULL,
+                                           false);
                 break;
         }
         p.skip();
@@ -659,9 +663,8 @@ void PropertyRef::set_blob(const void *value, std::size_t size,
 {
     if (size > UINT_MAX) throw PMGDException(NotImplemented);
     void *p = allocator.alloc(size);
-    memcpy(p, value, size);
     TransactionImpl *tx = TransactionImpl::get_tx();
-    tx->flush_range(p, size);
+    tx->write_nolog(p, (void *)value, size);
     BlobRef *v = (BlobRef *)val();
     v->value = p;
     v->size = uint32_t(size);
@@ -0,0 +1,1003 @@
+/**
+ * @file   RadixIndex.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <new>
+#include <vector>
+#include "RadixIndex.h"
+#include "IndexString.h"
+#include "GraphImpl.h"
+#include "compiler.h"
+
+using namespace PMGD;
+
+// Keys as bytes that compare with memcmp as the values do
+static void append_be(uint64_t v, std::string &s)
+{
+    for (int shift = 56; shift >= 0; shift -= 8)
+        s.push_back(char(v >> shift));
+}
+
+static void append_key(long long key, std::string &s)
+    { append_be(uint64_t(key) ^ uint64_t(1) << 63, s); }
+static void append_key(bool key, std::string &s)
+    { s.push_back(key); }
+static void append_key(const Time &key, std::string &s)
+    { append_be(uint64_t(key.time_val) ^ uint64_t(1) << 63, s); }
+static void append_key(const IndexString &key, std::string &s)
+    { key.append_to(s); }
+
+static void append_key(double key, std::string &s)
+{
+    // -0.0 is equal to 0.0.
+    if (key == 0)
+        key = 0;
+    uint64_t bits;
+    memcpy(&bits, &key, sizeof bits);
+    append_be(bits >> 63 ? ~bits : bits | uint64_t(1) << 63, s);
+}
+
+template <typename K>
+static std::string radix_key(const K &key)
+{
+    std::string s;
+    append_key(key, s);
+    return s;
+}
+
+static int compare(const unsigned char *a, size_t len, const std::string &b)
+{
+    size_t n = len < b.size() ? len : b.size();
+    int c = memcmp(a, b.data(), n);
+    if (c != 0)
+        return c;
+    return len < b.size() ? -1 : len > b.size();
+}
+
+template <typename K>
+size_t RadixIndex<K>::node_size(unsigned type)
+{
+    switch (type) {
+        case NODE4: return sizeof(Node4);
+        case NODE16: return sizeof(Node16);
+        case NODE48: return sizeof(Node48);
+        default: return sizeof(Node256);
+    }
+}
+
+template <class N, class E>
+static E **find_sorted(N *node, unsigned char byte)
+{
+    for (unsigned i = 0; i < node->count; i++)
+        if (node->keys[i] == byte)
+            return &node->children[i];
+    return NULL;
+}
+
+// The slot for the child under byte, if there is one
+template <typename K>
+typename RadixIndex<K>::Entry **RadixIndex<K>::find_child(Node *node,
+                                                         unsigned char byte)
+{
+    switch (node->type) {
+        case NODE4:
+            return find_sorted<Node4, Entry>(static_cast<Node4 *>(node), byte);
+        case NODE16:
+            return find_sorted<Node16, Entry>(static_cast<Node16 *>(node), byte);
+        case NODE48:
+            {
+                Node48 *n = static_cast<Node48 *>(node);
+                return n->index[byte] ? &n->children[n->index[byte] - 1] : NULL;
+            }
+        default:
+            {
+                Node256 *n = static_cast<Node256 *>(node);
+                return n->children[byte] ? &n->children[byte] : NULL;
+            }
+    }
+}
+
+template <class N, class E>
+static E *next_sorted(N *node, int from, bool reverse, int &byte)
+{
+    if (reverse) {
+        for (int i = int(node->count) - 1; i >= 0; i--)
+            if (node->keys[i] <= from)
+                return byte = node->keys[i], node->children[i];
+    }
+    else {
+        for (unsigned i = 0; i < node->count; i++)
+            if (node->keys[i] >= from)
+                return byte = node->keys[i], node->children[i];
+    }
+    return NULL;
+}
+
+// The first child at or after from in the direction of the scan,
+// setting byte to its byte
+template <typename K>
+typename RadixIndex<K>::Entry *RadixIndex<K>::next_child(Node *node, int from,
+                                                        bool reverse, int &byte)
+{
+    int step = reverse ? -1 : 1;
+    switch (node->type) {
+        case NODE4:
+            return next_sorted<Node4, Entry>(static_cast<Node4 *>(node),
+                                             from, reverse, byte);
+        case NODE16:
+            return next_sorted<Node16, Entry>(static_cast<Node16 *>(node),
+                                              from, reverse, byte);
+        case NODE48:
+            {
+                Node48 *n = static_cast<Node48 *>(node);
+                for (int b = from; b >= 0 && b < 256; b += step)
+                    if (n->index[b])
+                        return byte = b, n->children[n->index[b] - 1];
+                return NULL;
+            }
+        default:
+            {
+                Node256 *n = static_cast<Node256 *>(node);
+                for (int b = from; b >= 0 && b < 256; b += step)
+                    if (n->children[b])
+                        return byte = b, n->children[b];
+                return NULL;
+            }
+    }
+}
+
+// Read locks the entries on the way down to the leaf for key.
+template <typename K>
+typename RadixIndex<K>::Leaf *RadixIndex<K>::find_leaf(const std::string &key,
+                                                      TransactionImpl *tx)
+{
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    Entry *e = _root;
+    size_t depth = 0;
+    while (e != NULL) {
+        tx->acquire_lock(TransactionImpl::IndexLock, e, false);
+        if (e->type == LEAF) {
+            Leaf *leaf = static_cast<Leaf *>(e);
+            return compare(leaf->key(), leaf->len, key) == 0 ? leaf : NULL;
+        }
+        Node *node = static_cast<Node *>(e);
+        if (node->prefix_len > key.size() - depth
+                || memcmp(prefix(node), key.data() + depth, node->prefix_len) != 0)
+            return NULL;
+        depth += node->prefix_len;
+        if (depth == key.size()) {
+            if (node->end != NULL)
+                tx->acquire_lock(TransactionImpl::IndexLock, node->end, false);
+            return node->end;
+        }
+        Entry **slot = find_child(node, key[depth]);
+        if (slot == NULL)
+            return NULL;
+        e = *slot;
+        depth++;
+    }
+    return NULL;
+}
+
+// New leaves and nodes are write locked, as in BTreeIndex. Leaves are
+// flushed here, and nodes by the caller once filled in.
+template <typename K>
+typename RadixIndex<K>::Leaf *RadixIndex<K>::new_leaf(const std::string &key,
+                                                     Allocator &allocator,
+                                                     TransactionImpl *tx)
+{
+    size_t size = sizeof(Leaf) + key.size();
+    Leaf *leaf = static_cast<Leaf *>(allocator.alloc(size));
+    tx->acquire_lock(TransactionImpl::IndexLock, leaf, true);
+    leaf->type = LEAF;
+    memset(leaf->unused, 0, sizeof leaf->unused);
+    leaf->len = uint32_t(key.size());
+    new (&leaf->list) PostingList();
+    memcpy(leaf->key(), key.data(), key.size());
+    tx->flush_range(leaf, size);
+    return leaf;
+}
+
+template <typename K>
+typename RadixIndex<K>::Node *RadixIndex<K>::new_node(unsigned type,
+                                                     const unsigned char *pre,
+                                                     uint32_t len,
+                                                     Allocator &allocator,
+                                                     TransactionImpl *tx)
+{
+    Node *node = static_cast<Node *>(allocator.alloc(node_size(type) + len));
+    tx->acquire_lock(TransactionImpl::IndexLock, node, true);
+    memset(node, 0, node_size(type));
+    node->type = uint8_t(type);
+    node->prefix_len = len;
+    memcpy(prefix(node), pre, len);
+    return node;
+}
+
+template <typename K>
+void RadixIndex<K>::free_node(Node *node, Allocator &allocator)
+{
+    allocator.free(node, node_size(node->type) + node->prefix_len);
+}
+
+// Adds a child to a node that is new in this transaction
+template <class N, class E>
+static void put_sorted(N *node, unsigned char byte, E *child)
+{
+    unsigned pos = 0;
+    while (pos < node->count && node->keys[pos] < byte)
+        pos++;
+    memmove(&node->keys[pos + 1], &node->keys[pos], node->count - pos);
+    memmove(&node->children[pos + 1], &node->children[pos],
+            (node->count - pos) * sizeof node->children[0]);
+    node->keys[pos] = byte;
+    node->children[pos] = child;
+    node->count++;
+}
+
+// As put_sorted, in a node that is not new
+template <class N, class E>
+static void insert_sorted(N *node, unsigned char byte, E *child,
+                          TransactionImpl *tx)
+{
+    unsigned n = node->count;
+    unsigned pos = 0;
+    while (pos < n && node->keys[pos] < byte)
+        pos++;
+    tx->log_range(&node->keys[pos], &node->keys[n]);
+    tx->log_range(&node->children[pos], &node->children[n]);
+    memmove(&node->keys[pos + 1], &node->keys[pos], n - pos);
+    memmove(&node->children[pos + 1], &node->children[pos],
+            (n - pos) * sizeof node->children[0]);
+    node->keys[pos] = byte;
+    node->children[pos] = child;
+    tx->write(&node->count, uint16_t(n + 1));
+}
+
+// Adds child under byte to node, which is in slot, guarded by the lock
+// on holder. A full node is copied into one of the next size, which
+// takes its place.
+template <typename K>
+void RadixIndex<K>::add_child(Entry **slot, void *holder, Node *node,
+                              unsigned char byte, Entry *child,
+                              Allocator &allocator, TransactionImpl *tx)
+{
+    tx->acquire_lock(TransactionImpl::IndexLock, node, true);
+    switch (node->type) {
+        case NODE4:
+            if (node->count < 4) {
+                insert_sorted(static_cast<Node4 *>(node), byte, child, tx);
+                return;
+            }
+            break;
+        case NODE16:
+            if (node->count < 16) {
+                insert_sorted(static_cast<Node16 *>(node), byte, child, tx);
+                return;
+            }
+            break;
+        case NODE48:
+            if (node->count < 48) {
+                // Removals leave holes.
+                Node48 *n = static_cast<Node48 *>(node);
+                unsigned i = 0;
+                while (n->children[i] != NULL)
+                    i++;
+                tx->write(&n->children[i], child);
+                tx->write(&n->index[byte], uint8_t(i + 1));
+                tx->write(&n->count, uint16_t(n->count + 1));
+                return;
+            }
+            break;
+        default:
+            {
+                Node256 *n = static_cast<Node256 *>(node);
+                tx->write(&n->children[byte], child);
+                tx->write(&n->count, uint16_t(n->count + 1));
+                return;
+            }
+    }
+
+    Node *grown = new_node(node->type + 1, prefix(node), node->prefix_len,
+                           allocator, tx);
+    grown->end = node->end;
+    int b = -1;
+    for (Entry *c = next_child(node, 0, false, b); c != NULL;
+            c = b < 255 ? next_child(node, b + 1, false, b) : NULL)
+        put(grown, (unsigned char)b, c);
+    put(grown, byte, child);
+    tx->flush_range(grown, node_size(grown->type) + grown->prefix_len);
+
+    tx->acquire_lock(TransactionImpl::IndexLock, holder, true);
+    tx->write(slot, static_cast<Entry *>(grown));
+    free_node(node, allocator);
+}
+
+template <typename K>
+void RadixIndex<K>::put(Node *node, unsigned char byte, Entry *child)
+{
+    switch (node->type) {
+        case NODE4:
+            put_sorted(static_cast<Node4 *>(node), byte, child);
+            break;
+        case NODE16:
+            put_sorted(static_cast<Node16 *>(node), byte, child);
+            break;
+        case NODE48:
+            {
+                Node48 *n = static_cast<Node48 *>(node);
+                n->children[n->count] = child;
+                n->index[byte] = uint8_t(++n->count);
+            }
+            break;
+        default:
+            static_cast<Node256 *>(node)->children[byte] = child;
+            node->count++;
+            break;
+    }
+}
+
+// A new node above the leaves or nodes a and b, which differ at the
+// byte after the len bytes at pre. A key that ends there is the end
+// of the node.
+template <typename K>
+typename RadixIndex<K>::Node *RadixIndex<K>::fork(const unsigned char *pre,
+                                                 uint32_t len,
+                                                 Entry *a, int a_byte,
+                                                 Entry *b, int b_byte,
+                                                 Allocator &allocator,
+                                                 TransactionImpl *tx)
+{
+    Node *node = new_node(NODE4, pre, len, allocator, tx);
+    Entry *entries[] = { a, b };
+    int bytes[] = { a_byte, b_byte };
+    for (unsigned i = 0; i < 2; i++) {
+        if (bytes[i] < 0)
+            node->end = static_cast<Leaf *>(entries[i]);
+        else
+            put(node, (unsigned char)bytes[i], entries[i]);
+    }
+    tx->flush_range(node, node_size(NODE4) + len);
+    return node;
+}
+
+template <typename K>
+PostingList *RadixIndex<K>::add(const K &k, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    std::string key = radix_key(k);
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+
+    // slot holds the entry being looked at, under the lock on holder.
+    Entry **slot = &_root;
+    void *holder = this;
+    size_t depth = 0;
+    Leaf *leaf;
+    for (;;) {
+        Entry *e = *slot;
+        if (e == NULL) {
+            tx->acquire_lock(TransactionImpl::IndexLock, holder, true);
+            leaf = new_leaf(key, allocator, tx);
+            tx->write(slot, static_cast<Entry *>(leaf));
+            break;
+        }
+
+        tx->acquire_lock(TransactionImpl::IndexLock, e, false);
+        if (e->type == LEAF) {
+            Leaf *old = static_cast<Leaf *>(e);
+            if (compare(old->key(), old->len, key) == 0) {
+                tx->acquire_lock(TransactionImpl::IndexLock, old, true);
+                return &old->list;
+            }
+            // A node for the bytes the two keys share
+            size_t i = depth;
+            while (i < old->len && i < key.size()
+                       && old->key()[i] == (unsigned char)key[i])
+                i++;
+            leaf = new_leaf(key, allocator, tx);
+            Node *node = fork(old->key() + depth, uint32_t(i - depth),
+                              old, i < old->len ? old->key()[i] : -1,
+                              leaf, i < key.size() ? (unsigned char)key[i] : -1,
+                              allocator, tx);
+            tx->acquire_lock(TransactionImpl::IndexLock, holder, true);
+            tx->write(slot, static_cast<Entry *>(node));
+            break;
+        }
+
+        Node *node = static_cast<Node *>(e);
+        unsigned char *pre = prefix(node);
+        uint32_t p = 0;
+        while (p < node->prefix_len && depth + p < key.size()
+                   && pre[p] == (unsigned char)key[depth + p])
+            p++;
+        if (p < node->prefix_len) {
+            // The key leaves the shared bytes: a node for the ones it
+            // keeps goes above a copy of this one with the rest.
+            Node *rest = new_node(node->type, pre + p + 1,
+                                  node->prefix_len - p - 1, allocator, tx);
+            memcpy(rest + 1, node + 1, node_size(node->type) - sizeof(Node));
+            rest->count = node->count;
+            rest->end = node->end;
+            tx->flush_range(rest, node_size(rest->type) + rest->prefix_len);
+            leaf = new_leaf(key, allocator, tx);
+            Node *up = fork(pre, p, rest, pre[p], leaf,
+                            depth + p < key.size() ? (unsigned char)key[depth + p] : -1,
+                            allocator, tx);
+            tx->acquire_lock(TransactionImpl::IndexLock, node, true);
+            tx->acquire_lock(TransactionImpl::IndexLock, holder, true);
+            tx->write(slot, static_cast<Entry *>(up));
+            free_node(node, allocator);
+            break;
+        }
+
+        depth += node->prefix_len;
+        if (depth == key.size()) {
+            if (node->end != NULL) {
+                tx->acquire_lock(TransactionImpl::IndexLock, node->end, true);
+                return &node->end->list;
+            }
+            tx->acquire_lock(TransactionImpl::IndexLock, node, true);
+            leaf = new_leaf(key, allocator, tx);
+            tx->write(&node->end, leaf);
+            break;
+        }
+
+        Entry **child = find_child(node, key[depth]);
+        if (child == NULL) {
+            leaf = new_leaf(key, allocator, tx);
+            add_child(slot, holder, node, key[depth], leaf, allocator, tx);
+            break;
+        }
+        slot = child;
+        holder = node;
+        depth++;
+    }
+
+    tx->iterator_callbacks().iterator_rebalance_notify(this);
+    return &leaf->list;
+}
+
+template <typename K>
+PostingList *RadixIndex<K>::find(const K &key, bool write_lock)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    Leaf *leaf = find_leaf(radix_key(key), tx);
+    if (leaf == NULL)
+        return NULL;
+    if (write_lock)
+        tx->acquire_lock(TransactionImpl::IndexLock, leaf, true);
+    return &leaf->list;
+}
+
+// Takes the child under byte out of node. Returns whether that
+// leaves the node empty.
+template <typename K>
+bool RadixIndex<K>::remove_child(Node *node, int byte, TransactionImpl *tx)
+{
+    tx->acquire_lock(TransactionImpl::IndexLock, node, true);
+    if (byte < 0)
+        tx->write(&node->end, (Leaf *)NULL);
+    else if (node->type == NODE4 || node->type == NODE16) {
+        unsigned n = node->count;
+        uint8_t *keys = node->type == NODE4 ? static_cast<Node4 *>(node)->keys
+                                            : static_cast<Node16 *>(node)->keys;
+        Entry **children = node->type == NODE4 ? static_cast<Node4 *>(node)->children
+                                               : static_cast<Node16 *>(node)->children;
+        unsigned pos = 0;
+        while (keys[pos] != byte)
+            pos++;
+        tx->log_range(&keys[pos], &keys[n - 1]);
+        tx->log_range(&children[pos], &children[n - 1]);
+        memmove(&keys[pos], &keys[pos + 1], n - pos - 1);
+        memmove(&children[pos], &children[pos + 1],
+                (n - pos - 1) * sizeof children[0]);
+        tx->write(&node->count, uint16_t(n - 1));
+    }
+    else if (node->type == NODE48) {
+        Node48 *n = static_cast<Node48 *>(node);
+        tx->write(&n->children[n->index[byte] - 1], (Entry *)NULL);
+        tx->write(&n->index[byte], uint8_t(0));
+        tx->write(&n->count, uint16_t(n->count - 1));
+    }
+    else {
+        Node256 *n = static_cast<Node256 *>(node);
+        tx->write(&n->children[byte], (Entry *)NULL);
+        tx->write(&n->count, uint16_t(n->count - 1));
+    }
+    return node->count == 0 && node->end == NULL;
+}
+
+template <typename K>
+void RadixIndex<K>::remove(const K &k, Allocator &allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    std::string key = radix_key(k);
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+
+    // The nodes on the way down, with the byte taken at each, or -1
+    // for the end
+    std::vector<std::pair<Node *, int>> path;
+    Entry *e = _root;
+    size_t depth = 0;
+    Leaf *leaf = NULL;
+    while (e != NULL) {
+        tx->acquire_lock(TransactionImpl::IndexLock, e, false);
+        if (e->type == LEAF) {
+            leaf = static_cast<Leaf *>(e);
+            if (compare(leaf->key(), leaf->len, key) != 0)
+                return;
+            break;
+        }
+        Node *node = static_cast<Node *>(e);
+        if (node->prefix_len > key.size() - depth
+                || memcmp(prefix(node), key.data() + depth, node->prefix_len) != 0)
+            return;
+        depth += node->prefix_len;
+        if (depth == key.size()) {
+            if (node->end == NULL)
+                return;
+            leaf = node->end;
+            path.push_back(std::make_pair(node, -1));
+            break;
+        }
+        Entry **slot = find_child(node, key[depth]);
+        if (slot == NULL)
+            return;
+        path.push_back(std::make_pair(node, int((unsigned char)key[depth])));
+        e = *slot;
+        depth++;
+    }
+    if (leaf == NULL)
+        return;
+
+    tx->acquire_lock(TransactionImpl::IndexLock, leaf, true);
+    assert(leaf->list.num_elems() == 0);
+
+    // Empty nodes go too.
+    size_t i = path.size();
+    while (i > 0 && remove_child(path[i - 1].first, path[i - 1].second, tx)) {
+        free_node(path[i - 1].first, allocator);
+        i--;
+    }
+    if (i == 0) {
+        tx->acquire_lock(TransactionImpl::IndexLock, this, true);
+        tx->write(&_root, (Entry *)NULL);
+    }
+    allocator.free(leaf, sizeof(Leaf) + leaf->len);
+
+    tx->iterator_callbacks().iterator_rebalance_notify(this);
+}
+
+namespace PMGD {
+    // One iterator for all the predicates, as for BTreeIndex. It
+    // keeps the nodes from the root down to the current leaf, with
+    // the byte taken at each, or -1 for the end of the node, which
+    // comes before its children going forward.
+    template <typename K>
+    class RadixIndex<K>::Radix_IteratorImpl
+        : public Index::Index_IteratorImplIntf
+    {
+    public:
+        struct Bound {
+            std::string key;
+            bool incl;
+            Bound(const std::string &k, bool i) : key(k), incl(i) { }
+        };
+
+    private:
+        RadixIndex *const _tree;
+        std::vector<std::pair<Node *, int>> _path;
+        Leaf *_leaf;
+        PostingListTraverser _list_it;
+        bool _vacant_flag = false;
+        TransactionImpl *_tx;
+        const Graph::IndexType _index_type;
+        const bool _reverse;
+        Bound *const _min;
+        Bound *const _max;
+        Bound *const _neq;
+
+        void lock(void *p) const
+            { _tx->acquire_lock(TransactionImpl::IndexLock, p, false); }
+
+        // The first leaf under e in the direction of the scan
+        Leaf *descend(Entry *e)
+        {
+            for (;;) {
+                lock(e);
+                if (e->type == LEAF)
+                    return static_cast<Leaf *>(e);
+                Node *node = static_cast<Node *>(e);
+                int byte;
+                Entry *child = (_reverse || node->end == NULL)
+                                   ? next_child(node, _reverse ? 255 : 0, _reverse, byte)
+                                   : NULL;
+                if (child == NULL) {
+                    _path.push_back(std::make_pair(node, -1));
+                    lock(node->end);
+                    return node->end;
+                }
+                _path.push_back(std::make_pair(node, byte));
+                e = child;
+            }
+        }
+
+        // The leaf after the ones under _path in the direction of the
+        // scan
+        Leaf *advance()
+        {
+            while (!_path.empty()) {
+                Node *node = _path.back().first;
+                int &pos = _path.back().second;
+                int byte;
+                Entry *child = NULL;
+                if (!_reverse)
+                    child = pos < 255 ? next_child(node, pos + 1, false, byte) : NULL;
+                else if (pos >= 0) {
+                    child = pos > 0 ? next_child(node, pos - 1, true, byte) : NULL;
+                    if (child == NULL && node->end != NULL) {
+                        pos = -1;
+                        lock(node->end);
+                        return node->end;
+                    }
+                }
+                if (child != NULL) {
+                    pos = byte;
+                    return descend(child);
+                }
+                _path.pop_back();
+            }
+            return NULL;
+        }
+
+        // The leaf nearest key in the direction of the scan, without
+        // passing it, or one just before it
+        Leaf *seek(const std::string &key)
+        {
+            _path.clear();
+            lock(_tree);
+            Entry *e = _tree->_root;
+            size_t depth = 0;
+            while (e != NULL) {
+                lock(e);
+                if (e->type == LEAF)
+                    return static_cast<Leaf *>(e);
+                Node *node = static_cast<Node *>(e);
+
+                // How the keys under the node compare to key
+                size_t avail = key.size() - depth;
+                size_t n = node->prefix_len < avail ? node->prefix_len : avail;
+                int c = memcmp(prefix(node), key.data() + depth, n);
+                if (c == 0 && node->prefix_len > avail)
+                    c = 1;
+                if (c != 0)
+                    return (c > 0) != _reverse ? descend(node) : advance();
+
+                depth += node->prefix_len;
+                if (depth == key.size()) {
+                    if (!_reverse)
+                        return descend(node);
+                    if (node->end == NULL)
+                        return advance();
+                    _path.push_back(std::make_pair(node, -1));
+                    lock(node->end);
+                    return node->end;
+                }
+
+                unsigned char byte = key[depth];
+                _path.push_back(std::make_pair(node, int(byte)));
+                Entry **child = find_child(node, byte);
+                if (child == NULL)
+                    return advance();
+                e = *child;
+                depth++;
+            }
+            return NULL;
+        }
+
+        bool before_start(const Leaf *leaf) const
+        {
+            Bound *start = _reverse ? _max : _min;
+            if (start == NULL)
+                return false;
+            int c = compare(leaf->key(), leaf->len, start->key);
+            return _reverse ? c > 0 || (c == 0 && !start->incl)
+                            : c < 0 || (c == 0 && !start->incl);
+        }
+
+        bool past_end(const Leaf *leaf) const
+        {
+            Bound *end = _reverse ? _min : _max;
+            if (end == NULL)
+                return false;
+            int c = compare(leaf->key(), leaf->len, end->key);
+            return _reverse ? c < 0 || (c == 0 && !end->incl)
+                            : c > 0 || (c == 0 && !end->incl);
+        }
+
+        // Moves from leaf on to the first one in range that is not
+        // skipped, or to the end.
+        void settle(Leaf *leaf)
+        {
+            for (; leaf != NULL; leaf = advance()) {
+                if (before_start(leaf))
+                    continue;
+                if (past_end(leaf))
+                    break;
+                if (_neq != NULL && compare(leaf->key(), leaf->len, _neq->key) == 0)
+                    continue;
+                _list_it.set(&leaf->list);
+                if (bool(_list_it)) {
+                    _leaf = leaf;
+                    return;
+                }
+            }
+            _leaf = NULL;
+            _list_it.set(NULL);
+        }
+
+    public:
+        Radix_IteratorImpl(RadixIndex *tree, Graph::IndexType index_type,
+                           bool reverse, Bound *min, Bound *max, Bound *neq)
+            : _tree(tree), _leaf(NULL), _list_it(NULL),
+              _tx(TransactionImpl::get_tx()), _index_type(index_type),
+              _reverse(reverse), _min(min), _max(max), _neq(neq)
+        {
+            if (_tx->is_read_write()) {
+                _tx->iterator_callbacks().register_iterator(this,
+                    [this](void *list) { remove_notify(list); },
+                    [this](void *tree) { rebalance_notify(tree); });
+            }
+
+            Bound *start = _reverse ? _max : _min;
+            if (start != NULL)
+                settle(seek(start->key));
+            else {
+                lock(_tree);
+                settle(_tree->_root == NULL ? NULL : descend(_tree->_root));
+            }
+        }
+
+        ~Radix_IteratorImpl()
+        {
+            if (_tx->is_read_write())
+                _tx->iterator_callbacks().unregister_iterator(this);
+            delete _min;
+            delete _max;
+            delete _neq;
+        }
+
+        operator bool() const { return _vacant_flag || bool(_list_it); }
+
+        bool next()
+        {
+            // If _vacant_flag is set, the iterator has already advanced
+            // to the next object, so just clear _vacant_flag.
+            if (EXPECT_FALSE(_vacant_flag)) {
+                _vacant_flag = false;
+                return operator bool();
+            }
+
+            if (_list_it.next())
+                return true;
+
+            if (_leaf == NULL)
+                return false;
+            settle(advance());
+            return bool(_list_it);
+        }
+
+        void *ref() const
+        {
+            if (EXPECT_FALSE(_vacant_flag || !_list_it.is_member()))
+                throw PMGDException(VacantIterator);
+            void *value = _tx->get_db()->object_table(_index_type)
+                              .get_object(_list_it.ref() + 1);
+            TransactionImpl::lock(_index_type, value, false);
+            return value;
+        }
+
+        uint64_t slot() const { return _list_it.ref(); }
+
+        void remove_notify(void *list)
+        {
+            // The list the iterator is on is being removed from the
+            // index, so move to the next one.
+            if (_list_it.check(list)) {
+                _vacant_flag = false;
+                next();
+                _vacant_flag = true;
+            }
+        }
+
+        void rebalance_notify(void *tree)
+        {
+            // Leaves stay where they are, but the nodes above them may
+            // have been replaced, so find the way down again.
+            if (tree == _tree && _leaf != NULL) {
+                Leaf *leaf = seek(std::string((const char *)_leaf->key(), _leaf->len));
+                while (leaf != NULL && leaf != _leaf)
+                    leaf = advance();
+                assert(leaf != NULL);
+            }
+            // The chunks of the list moved
+            else if (_list_it.check(tree))
+                _list_it.reset(static_cast<PostingList *>(tree));
+        }
+    };
+}
+
+template <typename K>
+Index::Index_IteratorImplIntf *RadixIndex<K>::get_iterator(Graph::IndexType index_type,
+                                                          bool reverse)
+{
+    return new Radix_IteratorImpl(this, index_type, reverse, NULL, NULL, NULL);
+}
+
+template <typename K>
+Index::Index_IteratorImplIntf *RadixIndex<K>::get_iterator(Graph::IndexType index_type,
+                                                          const K &k,
+                                                          PropertyPredicate::Op op,
+                                                          bool reverse)
+{
+    typedef typename Radix_IteratorImpl::Bound Bound;
+    Bound *min = NULL, *max = NULL, *neq = NULL;
+    std::string key = radix_key(k);
+
+    switch (op) {
+        case PropertyPredicate::Eq:
+            min = new Bound(key, true);
+            max = new Bound(key, true);
+            break;
+        case PropertyPredicate::Ne:
+            neq = new Bound(key, false);
+            break;
+        case PropertyPredicate::Lt:
+        case PropertyPredicate::Le:
+            max = new Bound(key, op == PropertyPredicate::Le);
+            break;
+        case PropertyPredicate::Gt:
+        case PropertyPredicate::Ge:
+            min = new Bound(key, op == PropertyPredicate::Ge);
+            break;
+        case PropertyPredicate::Prefix:
+            // The keys that start with key are the ones under the
+            // node it leads to, and a scan stops at the first after.
+            min = new Bound(key, true);
+            if (successor(key))
+                max = new Bound(key, false);
+            break;
+        default: // Since Index already checks ops, this shouldn't happen.
+            assert(0);
+            break;
+    }
+
+    return new Radix_IteratorImpl(this, index_type, reverse, min, max, neq);
+}
+
+template <typename K>
+Index::Index_IteratorImplIntf *RadixIndex<K>::get_iterator(Graph::IndexType index_type,
+                                                          const K &min,
+                                                          const K &max,
+                                                          PropertyPredicate::Op op,
+                                                          bool reverse)
+{
+    typedef typename Radix_IteratorImpl::Bound Bound;
+    bool incl_min = op == PropertyPredicate::GeLe || op == PropertyPredicate::GeLt;
+    bool incl_max = op == PropertyPredicate::GeLe || op == PropertyPredicate::GtLe;
+    return new Radix_IteratorImpl(this, index_type, reverse,
+                                  new Bound(radix_key(min), incl_min),
+                                  new Bound(radix_key(max), incl_max), NULL);
+}
+
+// Without avg, adds up the sizes, and with it, takes off the health
+// as AvlTreeIndex does.
+template <typename K>
+void RadixIndex<K>::stats_recursive(Entry *e, Graph::IndexStats &stats,
+                                    size_t *avg)
+{
+    if (e->type == LEAF) {
+        Leaf *leaf = static_cast<Leaf *>(e);
+        size_t elements = leaf->list.num_elems();
+        if (avg != NULL) {
+            if (elements > *avg)
+                stats.health_factor -= (100 * elements) / stats.total_elements;
+            return;
+        }
+        stats.total_unique_entries++;
+        stats.total_elements += elements;
+        stats.total_size_bytes += sizeof *leaf + leaf->len + leaf->list.size_bytes();
+        return;
+    }
+    Node *node = static_cast<Node *>(e);
+    if (avg == NULL)
+        stats.total_size_bytes += node_size(node->type) + node->prefix_len;
+    if (node->end != NULL)
+        stats_recursive(node->end, stats, avg);
+    int b = -1;
+    for (Entry *c = next_child(node, 0, false, b); c != NULL;
+            c = b < 255 ? next_child(node, b + 1, false, b) : NULL)
+        stats_recursive(c, stats, avg);
+}
+
+template <typename K>
+void RadixIndex<K>::index_stats_info(Graph::IndexStats &stats)
+{
+    // Each value has a leaf with its list; total_size_bytes has the
+    // actual sizes.
+    stats.unique_entry_size     = sizeof(Leaf) + sizeof(Entry *);
+    stats.total_unique_entries  = 0;
+    stats.total_elements        = 0;
+    stats.total_size_bytes      = sizeof(*this);
+    stats.health_factor         = 100;
+
+    if (_root == NULL)
+        return;
+
+    stats_recursive(_root, stats, NULL);
+    if (stats.total_unique_entries == 0)
+        return;
+
+    size_t avg_elem_per_node = stats.total_elements / stats.total_unique_entries;
+    stats_recursive(_root, stats, &avg_elem_per_node);
+}
+
+template <typename K>
+void RadixIndex<K>::prefetch_recursive(Entry *e, unsigned levels,
+                                       TransactionImpl *tx)
+{
+    if (e == NULL || levels == 0 || e->type == LEAF)
+        return;
+    tx->acquire_lock(TransactionImpl::IndexLock, e, false);
+    Node *node = static_cast<Node *>(e);
+    size_t size = node_size(node->type);
+    for (size_t i = 0; i < size; i += 64)
+        (void)*((volatile char *)node + i);
+    int b = -1;
+    for (Entry *c = next_child(node, 0, false, b); c != NULL;
+            c = b < 255 ? next_child(node, b + 1, false, b) : NULL)
+        prefetch_recursive(c, levels - 1, tx);
+}
+
+// Only the inner nodes are touched, as in BTreeIndex.
+template <typename K>
+void RadixIndex<K>::prefetch(unsigned levels)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    prefetch_recursive(_root, levels, tx);
+}
+
+// Explicitly instantiate any types that might be required
+template class RadixIndex<long long>;
+template class RadixIndex<bool>;
+template class RadixIndex<double>;
+template class RadixIndex<Time>;
+template class RadixIndex<IndexString>;
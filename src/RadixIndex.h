@@ -0,0 +1,161 @@
+/**
+ * @file   RadixIndex.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include "Index.h"
+#include "PostingList.h"
+#include "TransactionImpl.h"
+
+namespace PMGD {
+    class Allocator;
+
+    // An adaptive radix tree over the values of a property, each
+    // turned into bytes that sort as the values do: the transformed
+    // string for strings, and a big-endian form of the others. An
+    // inner node picks a child by one byte of the key, and comes in
+    // four sizes, for up to 4, 16, 48 or 256 children, growing into
+    // the next size when full. The bytes that all the keys below a
+    // node share are kept in the node rather than in a chain of
+    // nodes, and a key that is the only one below a byte is kept in
+    // a leaf under it with its posting list, so a lookup reads about
+    // one node per distinguishing byte of the key. For strings, that
+    // finds all the values with a given prefix in one descent.
+    // Nodes are locked as BTreeIndex locks them. A node that grows
+    // is replaced in its parent; nodes are not shrunk when values are
+    // removed, but empty ones are dropped.
+    // Data resides in PM
+    template <typename K> class RadixIndex : public Index {
+        enum { NODE4, NODE16, NODE48, NODE256, LEAF };
+
+        struct Entry {
+            uint8_t type;
+        };
+
+        // The key bytes follow the leaf.
+        struct Leaf : Entry {
+            uint8_t unused[3];
+            uint32_t len;
+            PostingList list;
+
+            unsigned char *key() const
+                { return (unsigned char *)(this + 1); }
+        };
+
+        // The shared bytes follow the children. end is the leaf for
+        // the key that ends with them, if there is one.
+        struct Node : Entry {
+            uint8_t unused;
+            uint16_t count;
+            uint32_t prefix_len;
+            Leaf *end;
+        };
+
+        struct Node4 : Node {
+            uint8_t keys[4];
+            Entry *children[4];
+        };
+
+        struct Node16 : Node {
+            uint8_t keys[16];
+            Entry *children[16];
+        };
+
+        // index holds one more than the position in children of the
+        // child for each byte, or 0.
+        struct Node48 : Node {
+            uint8_t index[256];
+            Entry *children[48];
+        };
+
+        struct Node256 : Node {
+            Entry *children[256];
+        };
+
+        Entry *_root;
+
+        class Radix_IteratorImpl;
+
+        static size_t node_size(unsigned type);
+        static unsigned char *prefix(Node *node)
+            { return reinterpret_cast<unsigned char *>(node) + node_size(node->type); }
+        static Entry **find_child(Node *node, unsigned char byte);
+        static Entry *next_child(Node *node, int from, bool reverse, int &byte);
+
+        Leaf *find_leaf(const std::string &key, TransactionImpl *tx);
+        Leaf *new_leaf(const std::string &key, Allocator &allocator,
+                       TransactionImpl *tx);
+        Node *new_node(unsigned type, const unsigned char *pre, uint32_t len,
+                       Allocator &allocator, TransactionImpl *tx);
+        static void put(Node *node, unsigned char byte, Entry *child);
+        Node *fork(const unsigned char *pre, uint32_t len,
+                   Entry *a, int a_byte, Entry *b, int b_byte,
+                   Allocator &allocator, TransactionImpl *tx);
+        void add_child(Entry **slot, void *holder, Node *node,
+                       unsigned char byte, Entry *child,
+                       Allocator &allocator, TransactionImpl *tx);
+        bool remove_child(Node *node, int byte, TransactionImpl *tx);
+        void free_node(Node *node, Allocator &allocator);
+
+        void stats_recursive(Entry *entry, Graph::IndexStats &stats, size_t *avg);
+        void prefetch_recursive(Entry *entry, unsigned levels,
+                                TransactionImpl *tx);
+
+    public:
+        RadixIndex(PropertyType ptype)
+            : Index(ptype, Graph::Radix), _root(NULL)
+        {
+            TransactionImpl *tx = TransactionImpl::get_tx();
+            tx->flush_range(this, sizeof *this);
+        }
+
+        // As for BTreeIndex, with the leaf for the key locked for
+        // changes to its list
+        PostingList *add(const K &key, Allocator &allocator);
+        PostingList *find(const K &key, bool write_lock = false);
+        void remove(const K &key, Allocator &allocator);
+
+        // Besides the ops that the trees support, Prefix finds the
+        // string values that start with key.
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type, bool reverse);
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type, const K &key,
+                                                    PropertyPredicate::Op op, bool reverse);
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type, const K &min,
+                                                    const K &max, PropertyPredicate::Op op,
+                                                    bool reverse);
+
+        // For statistics
+        void index_stats_info(Graph::IndexStats &stats);
+
+        // Touch the first levels of inner nodes
+        void prefetch(unsigned levels);
+    };
+}
@@ -0,0 +1,284 @@
+/**
+ * @file   TagIndex.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "TagIndex.h"
+#include "Allocator.h"
+#include "TransactionImpl.h"
+#include "exception.h"
+#include "compiler.h"
+
+using namespace PMGD;
+
+namespace PMGD {
+    class TagIndex::TagIndex_IteratorImpl : public Index::Index_IteratorImplIntf {
+        TagIndex *_index;
+        const FixedAllocator &_table;
+        Graph::IndexType _index_type;
+        TransactionImpl *_tx;
+        uint64_t _page_id;
+        Page *_page;
+        unsigned _bit;
+
+        void get_page()
+        {
+            _page = _index->next_page(_page_id);
+            if (_page != NULL)
+                _tx->acquire_lock(TransactionImpl::IndexLock, _page, false);
+        }
+
+        // Move to the first member at or after _bit
+        void find()
+        {
+            while (_page != NULL) {
+                if (_bit < PAGE_BITS && _page->count > 0) {
+                    unsigned w = _bit / 64;
+                    uint64_t word = _page->bits[w] & ~uint64_t(0) << _bit % 64;
+                    while (word == 0 && ++w < PAGE_WORDS)
+                        word = _page->bits[w];
+                    if (word != 0) {
+                        _bit = w * 64 + __builtin_ctzll(word);
+                        return;
+                    }
+                }
+                _page_id++;
+                _bit = 0;
+                get_page();
+            }
+        }
+
+    public:
+        TagIndex_IteratorImpl(TagIndex *index, const FixedAllocator &table,
+                              Graph::IndexType index_type)
+            : _index(index), _table(table), _index_type(index_type),
+              _tx(TransactionImpl::get_tx()), _page_id(0), _bit(0)
+        {
+            get_page();
+            find();
+        }
+
+        operator bool() const { return _page != NULL; }
+
+        bool next()
+        {
+            _bit++;
+            find();
+            return _page != NULL;
+        }
+
+        void *ref() const
+        {
+            // The object was removed from the tag since the iterator
+            // got to it.
+            if (EXPECT_FALSE(!(_page->bits[_bit / 64] >> _bit % 64 & 1)))
+                throw PMGDException(VacantIterator);
+            void *value = _table.get_object(_page_id * PAGE_BITS + _bit + 1);
+            TransactionImpl::lock(_index_type, value, false);
+            return value;
+        }
+
+        uint64_t slot() const { return _page_id * PAGE_BITS + _bit; }
+    };
+}
+
+TagIndex::Page *TagIndex::find_page(uint64_t page_id, Allocator *allocator)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+
+    if (page_id >= span(_height)) {
+        if (allocator == NULL)
+            return NULL;
+
+        // Grow by putting the root under new directories.
+        tx->acquire_lock(TransactionImpl::IndexLock, this, true);
+        uint32_t height = _height;
+        void *root = _root;
+        for (; page_id >= span(height); height++) {
+            if (root == NULL)
+                continue;
+            Dir *dir = (Dir *)allocator->alloc(sizeof(Dir));
+            memset(dir, 0, sizeof *dir);
+            dir->slots[0] = root;
+            tx->flush_range(dir, sizeof *dir);
+            root = dir;
+        }
+        tx->write(&_height, height);
+        tx->write(&_root, root);
+    }
+
+    // Each slot is protected by the lock on what holds it.
+    void **slot = &_root;
+    void *holder = this;
+    for (unsigned h = _height; ; h--) {
+        if (*slot == NULL) {
+            if (allocator == NULL)
+                return NULL;
+            size_t size = h == 0 ? sizeof(Page) : sizeof(Dir);
+            void *child = allocator->alloc(size);
+            memset(child, 0, size);
+            tx->flush_range(child, size);
+            tx->acquire_lock(TransactionImpl::IndexLock, holder, true);
+            tx->write(slot, child);
+        }
+        if (h == 0)
+            return (Page *)*slot;
+        Dir *dir = (Dir *)*slot;
+        tx->acquire_lock(TransactionImpl::IndexLock, dir, false);
+        slot = &dir->slots[page_id / span(h - 1) % DIR_SIZE];
+        holder = dir;
+    }
+}
+
+TagIndex::Page *TagIndex::next_page(uint64_t &page_id)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+
+    while (page_id < span(_height)) {
+        void *node = _root;
+        unsigned h = _height;
+        while (node != NULL && h > 0) {
+            Dir *dir = (Dir *)node;
+            tx->acquire_lock(TransactionImpl::IndexLock, dir, false);
+            node = dir->slots[page_id / span(h - 1) % DIR_SIZE];
+            h--;
+        }
+        if (node != NULL)
+            return (Page *)node;
+
+        // Skip the missing subtree of height h.
+        page_id = (page_id / span(h) + 1) * span(h);
+    }
+    return NULL;
+}
+
+void TagIndex::set(uint64_t slot, bool member, Allocator &allocator)
+{
+    Page *page = find_page(slot / PAGE_BITS, member ? &allocator : NULL);
+    if (page == NULL)
+        return;
+
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, page, true);
+    unsigned bit = slot % PAGE_BITS;
+    uint64_t *word = &page->bits[bit / 64];
+    uint64_t mask = uint64_t(1) << bit % 64;
+    if (bool(*word & mask) == member)
+        return;
+    tx->write(word, *word ^ mask);
+    tx->write(&page->count, member ? page->count + 1 : page->count - 1);
+}
+
+void TagIndex::add(void *const *objs, size_t count,
+                   const FixedAllocator &table, Allocator &allocator)
+{
+    for (size_t i = 0; i < count; i++)
+        set(table.get_id(objs[i]) - 1, true, allocator);
+}
+
+void TagIndex::remove(void *const *objs, size_t count,
+                      const FixedAllocator &table, Allocator &allocator)
+{
+    for (size_t i = 0; i < count; i++)
+        set(table.get_id(objs[i]) - 1, false, allocator);
+}
+
+bool TagIndex::has_elems()
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    uint64_t page_id = 0;
+    while (Page *page = next_page(page_id)) {
+        tx->acquire_lock(TransactionImpl::IndexLock, page, false);
+        if (page->count > 0)
+            return true;
+        page_id++;
+    }
+    return false;
+}
+
+Index::Index_IteratorImplIntf *TagIndex::get_iterator(Graph::IndexType index_type,
+                                                      const FixedAllocator &table)
+{
+    return new TagIndex_IteratorImpl(this, table, index_type);
+}
+
+void TagIndex::stats_recursive(void *root, unsigned height,
+                               Graph::IndexStats &stats)
+{
+    if (root == NULL)
+        return;
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::IndexLock,
+                                            root, false);
+    if (height == 0) {
+        stats.total_unique_entries++;
+        stats.total_elements += ((Page *)root)->count;
+        stats.total_size_bytes += sizeof(Page);
+        return;
+    }
+    stats.total_size_bytes += sizeof(Dir);
+    for (unsigned i = 0; i < DIR_SIZE; i++)
+        stats_recursive(((Dir *)root)->slots[i], height - 1, stats);
+}
+
+// Pages are the unique entries. There is no balance to speak of,
+// so the health is always 100.
+void TagIndex::index_stats_info(Graph::IndexStats &stats)
+{
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::IndexLock,
+                                            this, false);
+    stats.unique_entry_size     = sizeof(Page);
+    stats.total_unique_entries  = 0;
+    stats.total_elements        = 0;
+    stats.total_size_bytes      = sizeof(*this);
+    stats.health_factor         = 100;
+
+    stats_recursive(_root, _height, stats);
+}
+
+void TagIndex::prefetch_recursive(void *root, unsigned height,
+                                  unsigned levels, TransactionImpl *tx)
+{
+    if (root == NULL || levels == 0)
+        return;
+    tx->acquire_lock(TransactionImpl::IndexLock, root, false);
+    (void)*(volatile uint64_t *)root;
+    if (height > 0) {
+        for (unsigned i = 0; i < DIR_SIZE; i++)
+            prefetch_recursive(((Dir *)root)->slots[i], height - 1,
+                               levels - 1, tx);
+    }
+}
+
+void TagIndex::prefetch(unsigned levels)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::IndexLock, this, false);
+    prefetch_recursive(_root, _height, levels, tx);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file   TagIndex.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "Index.h"
+#include "FixedAllocator.h"
+
+namespace PMGD {
+    class Allocator;
+
+    // The nodes or edges of one tag, as a bitmap over the slots of
+    // the node or edge table. The bitmap is split into pages kept in a
+    // radix tree that grows in height as higher slots join the tag,
+    // so a sparse tag only pays for the pages it touches. Adds and
+    // removes lock just the page with the slot, and a scan returns
+    // the members in table order.
+    // Pages are kept once allocated, even when they empty, so an
+    // iterator never loses the page it is on.
+    // Data resides in PM
+    class TagIndex : public Index {
+    public:
+        // Slots per page. Adds to slots on different pages do not
+        // conflict.
+        static const unsigned PAGE_WORDS = 63;
+        static const unsigned PAGE_BITS = PAGE_WORDS * 64;
+
+    private:
+        static const unsigned DIR_BITS = 9;
+        static const unsigned DIR_SIZE = 1 << DIR_BITS;
+
+        // 512 bytes with the count
+        struct Page {
+            uint64_t count;
+            uint64_t bits[PAGE_WORDS];
+        };
+
+        // Each level of the tree is a directory of DIR_SIZE pointers
+        // to the level below. At height 0 the root is a page.
+        struct Dir {
+            void *slots[DIR_SIZE];
+        };
+
+        uint32_t _height;
+        void *_root;
+
+        class TagIndex_IteratorImpl;
+
+        static uint64_t span(unsigned height)
+            { return uint64_t(1) << DIR_BITS * height; }
+
+        Page *find_page(uint64_t page_id, Allocator *allocator);
+        Page *next_page(uint64_t &page_id);
+        void set(uint64_t slot, bool member, Allocator &allocator);
+
+        void stats_recursive(void *root, unsigned height,
+                             Graph::IndexStats &stats);
+        void prefetch_recursive(void *root, unsigned height, unsigned levels,
+                                TransactionImpl *tx);
+
+    public:
+        TagIndex() : Index(PropertyType::NoValue), _height(0), _root(NULL)
+        {
+            TransactionImpl *tx = TransactionImpl::get_tx();
+            tx->flush_range(this, sizeof *this);
+        }
+
+        void add(void *const *objs, size_t count,
+                 const FixedAllocator &table, Allocator &allocator);
+        void remove(void *const *objs, size_t count,
+                    const FixedAllocator &table, Allocator &allocator);
+
+        bool has_elems();
+
+        Index::Index_IteratorImplIntf *get_iterator(Graph::IndexType index_type,
+                                                    const FixedAllocator &table);
+
+        // For statistics
+        void index_stats_info(Graph::IndexStats &stats);
+
+        // Touch the top levels of the tree
+        void prefetch(unsigned levels);
+    };
+}
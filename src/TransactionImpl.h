@@ -106,20 +106,31 @@ namespace PMGD {
                 LockStatusMap mylocks; // locks acquired on existing components.
                 StripedLock &mainlock;          // Reference to the main lock from GraphImpl.
 
+                // Highest release stamp seen on a stripe when locking it.
+                uint64_t depends_on;
+
                 // We could maintain status of new objects separately but
                 // that might not be worth doing.
                 // TODO need some statistics on how often we hit in map,
                 // how long it takes and so on.
-                Locks(StripedLock &locks) : mainlock(locks) {}
+                Locks(StripedLock &locks) : mainlock(locks), depends_on(0) {}
 
                 // Return value indicates the state of given lock before
                 // this operation.
                 LockState acquire_lock(const void *addr, bool write);
-                void unlock_all();
+
+                // Write locks are stamped with commit_seq, if nonzero,
+                // so that later holders wait for this commit record.
+                void unlock_all(uint64_t commit_seq);
             };
 
             struct JournalEntry;
 
+            // Flush and undo loops over the journal, run for one
+            // persistence mode through TransactionManager::with_mode.
+            struct FlushLogged;
+            struct UndoLogged;
+
             static THREAD TransactionImpl *_per_thread_tx;
 
             GraphImpl *_db;
@@ -129,6 +140,17 @@ namespace PMGD {
             TransactionHandle _tx_handle;
             JournalEntry *_jcur;
 
+            // Position in the commit order, assigned in finalize_commit.
+            uint64_t _commit_seq;
+
+            // Highest commit sequence number of a transaction whose locks
+            // were released to this one before its commit was durable,
+            // for locks outside the striped lock tables.
+            uint64_t _depends_on;
+
+            // Called once the commit record is durable.
+            std::function<void()> _durable_callback;
+
             TransactionImpl *_outer_tx;
 
             // This has items such as address to free.
@@ -166,7 +188,6 @@ namespace PMGD {
                                  bool msync_needed,
                                  RangeSet &pending_commits);
 
-            TransactionId tx_id() const { return _tx_handle.id; }
             JournalEntry *jbegin()
                 { return static_cast<JournalEntry *>(_tx_handle.jbegin); }
             JournalEntry *jend()
@@ -179,10 +200,21 @@ namespace PMGD {
             ~TransactionImpl();
 
             GraphImpl *get_db() const { return _db; }
+            TransactionId tx_id() const { return _tx_handle.id; }
 
             bool is_read_write() const
                 { return _tx_type & Transaction::ReadWrite; }
 
+            bool early_lock_release() const
+                { return _tx_type & Transaction::EarlyLockRelease; }
+
+            uint64_t commit_seq() const { return _commit_seq; }
+            void depend_on(uint64_t seq)
+                { if (seq > _depends_on) _depends_on = seq; }
+
+            void set_durable_callback(std::function<void()> f)
+                { _durable_callback = f; }
+
             void check_read_write()
             {
                 if (!(_tx_type & Transaction::ReadWrite))
@@ -264,8 +296,7 @@ namespace PMGD {
             // write without logging
             void write_nolog(void *dst, void *src, size_t len)
             {
-                memcpy(dst, src, len);
-                flush_range(dst, len);
+                TransactionManager::copy(dst, src, len, _msync_needed, _pending_commits);
             }
 
             void commit()
@@ -280,6 +311,15 @@ namespace PMGD {
                 _committed = true;
             }
 
+            // Whether this thread has a read-write transaction open
+            static bool in_read_write_tx()
+            {
+                for (TransactionImpl *tx = _per_thread_tx; tx != NULL; tx = tx->_outer_tx)
+                    if (tx->is_read_write())
+                        return true;
+                return false;
+            }
+
             // get current transaction
             static inline TransactionImpl *get_tx()
             {
@@ -290,7 +330,7 @@ namespace PMGD {
 
             RangeSet *get_pending_commits() { return &_pending_commits; }
 
-            // flush a range using clflushopt. Caller must call
+            // flush a range of cache lines. Caller must call
             // commit to ensure the flushed data is durable.
             static void flush_range(void *ptr, size_t len, bool msync_needed, RangeSet &pc);
 
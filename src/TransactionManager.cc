@@ -29,6 +29,10 @@
 
 #include <stddef.h>
 #include <assert.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <string.h>
 #include "TransactionManager.h"
 #include "TransactionImpl.h"
 #include "RangeSet.h"
@@ -37,12 +41,67 @@
 
 using namespace PMGD;
 
+PersistMode TransactionManager::default_persist_mode()
+{
+#ifdef PM  // Means there is persistent memory
+    if (cpu_has_clwb())
+        return PersistMode::Clwb;
+    if (cpu_has_clflushopt())
+        return PersistMode::Clflushopt;
+    return PersistMode::Clflush;
+#else   // MSYNC
+    return PersistMode::Msync;
+#endif
+}
+
+namespace {
+    struct CopyLines {
+        template <PersistMode M>
+        static void run(void *dst, const void *src, size_t len,
+                        bool msync_needed, RangeSet &pending_commits)
+        {
+            memcpy(dst, src, len);
+            TransactionManager::flush_range<M>(dst, len, msync_needed, pending_commits);
+        }
+    };
+
+    // The copy bypasses the cache, so the lines only need marking.
+    template <>
+    void CopyLines::run<PersistMode::NTStore>(void *dst, const void *src, size_t len,
+                                              bool msync_needed, RangeSet &pending_commits)
+    {
+        TransactionManager::flush_range<PersistMode::None>(dst, len, msync_needed, pending_commits);
+        Persist<PersistMode::NTStore>::copy(dst, src, len);
+    }
+}
+
+void TransactionManager::copy(void *dst, const void *src, size_t len,
+                              bool msync_needed, RangeSet &pending_commits)
+{
+    with_mode<CopyLines>(dst, src, len, msync_needed, pending_commits);
+}
+
+PersistMode TransactionManager::_persist_mode = default_persist_mode();
+
+void TransactionManager::set_persist_mode(PersistMode mode)
+{
+    if ((mode == PersistMode::Clwb || mode == PersistMode::NTStore)
+            && !cpu_has_clwb())
+        throw PMGDException(InvalidConfig, "clwb not supported");
+    if (mode == PersistMode::Clflushopt && !cpu_has_clflushopt())
+        throw PMGDException(InvalidConfig, "clflushopt not supported");
+    _persist_mode = mode;
+}
+
 TransactionManager::TransactionManager(
             uint64_t transaction_table_addr, uint64_t transaction_table_size,
             uint64_t journal_addr, uint64_t journal_size,
             CommonParams &params)
     : _tx_table(reinterpret_cast<TransactionHdr *>(transaction_table_addr)),
       _journal_addr(reinterpret_cast<void *>(journal_addr)),
+      _commit_seq(0),
+      _active_writers(0),
+      _quiesced(false),
       _max_transactions(transaction_table_size / sizeof (TransactionHdr)),
       _extent_size(journal_size / _max_transactions),
       _max_extents(journal_size / _extent_size)
@@ -56,6 +115,8 @@ TransactionManager::TransactionManager(
     if (_max_extents < _max_transactions)
         throw PMGDException(InvalidConfig);
 
+    _pending_seqs.resize(_max_transactions);
+
     if (params.create) {
         reset_table(params.msync_needed, *params.pending_commits);
         _cur_tx_id = 0;
@@ -84,6 +145,7 @@ void TransactionManager::reset_table(bool msync_needed, RangeSet &pending_commit
         hdr->tx_id = 0;
         hdr->jbegin = tx_jbegin(i);
         hdr->jend = tx_jend(i);
+        hdr->commit_seq = 0;
         flush(hdr, msync_needed, pending_commits);
     }
 }
@@ -97,7 +159,12 @@ void TransactionManager::recover(bool read_only, bool msync_needed, RangeSet &pe
     // We can't open a graph read-only if it needs recovery. If there
     // are active transactions and the graph is read-only, throw an
     // exception.
+    // Transactions that had not reached their commit point still held
+    // all their locks, so nothing depends on them and they are undone
+    // first. Sequenced transactions may have released their locks early
+    // and are undone in reverse commit order.
     TransactionId max_tx_id = 0;
+    std::vector<int> active;
     for (int i = 0; i < _max_transactions; i++) {
         TransactionHdr *hdr = &_tx_table[i];
         TransactionId tx_id = hdr->tx_id;
@@ -105,22 +172,36 @@ void TransactionManager::recover(bool read_only, bool msync_needed, RangeSet &pe
         if (tx_id & TransactionHdr::ACTIVE) {
             if (read_only)
                 throw PMGDException(ReadOnly);
-
-            tx_id &= ~TransactionHdr::ACTIVE;
-            TransactionHandle handle(tx_id, i, hdr->jbegin, hdr->jend);
-            TransactionImpl::recover_tx(handle, msync_needed, pending_commits);
-
-            hdr->tx_id = tx_id;
-            flush(hdr, msync_needed, pending_commits);
+            active.push_back(i);
         }
 
+        tx_id &= ~TransactionHdr::ACTIVE;
         if (tx_id > max_tx_id)
             max_tx_id = tx_id;
     }
+
+    std::stable_sort(active.begin(), active.end(),
+        [this](int a, int b) {
+            uint64_t sa = _tx_table[a].commit_seq;
+            uint64_t sb = _tx_table[b].commit_seq;
+            return (sa == 0 ? ~0ull : sa) > (sb == 0 ? ~0ull : sb);
+        });
+
+    for (int i : active) {
+        TransactionHdr *hdr = &_tx_table[i];
+        TransactionId tx_id = hdr->tx_id & ~TransactionHdr::ACTIVE;
+        TransactionHandle handle(tx_id, i, hdr->jbegin, hdr->jend);
+        TransactionImpl::recover_tx(handle, msync_needed, pending_commits);
+
+        hdr->tx_id = tx_id;
+        hdr->commit_seq = 0;
+        flush(hdr, msync_needed, pending_commits);
+    }
     _cur_tx_id = max_tx_id;
 }
 
 TransactionHandle TransactionManager::alloc_transaction(bool read_only,
+                                                        bool nested,
                                                         bool msync_needed,
                                                         RangeSet &pending_commits)
 {
@@ -136,6 +217,17 @@ TransactionHandle TransactionManager::alloc_transaction(bool read_only,
         return TransactionHandle(-1, -1, dummy, dummy);
     }
 
+    while (1) {
+        if (!nested) {
+            while (_quiesced)
+                std::this_thread::yield();
+        }
+        atomic_inc(_active_writers);
+        if (nested || !_quiesced)
+            break;
+        xadd<int64_t>(_active_writers, -1);
+    }
+
     TransactionId tx_id = atomic_inc(_cur_tx_id) + 1;
 
     for (int i = 0; i < _max_transactions; i++) {
@@ -144,24 +236,85 @@ TransactionHandle TransactionManager::alloc_transaction(bool read_only,
         if ((prev_tx_id & TransactionHdr::ACTIVE) == 0
             && cmpxchg(hdr->tx_id, prev_tx_id, tx_id | TransactionHdr::ACTIVE))
         {
+            hdr->commit_seq = 0;
             flush(hdr, msync_needed, pending_commits);
             return TransactionHandle(tx_id, i, tx_jbegin(i), tx_jend(i));
         }
     }
+    xadd<int64_t>(_active_writers, -1);
     throw PMGDException(OutOfTransactions);
 }
 
+uint64_t TransactionManager::order_commit(const TransactionHandle &handle,
+                                          bool sync_header,
+                                          bool msync_needed,
+                                          RangeSet &pending_commits)
+{
+    uint64_t seq = atomic_inc(_commit_seq) + 1;
+    TransactionHdr *hdr = &_tx_table[handle.index];
+    hdr->commit_seq = seq;
+    flush(hdr, msync_needed, pending_commits);
+    _pending_seqs[handle.index] = seq;
+
+    if (sync_header) {
+        // Only the header has to be durable before the locks go.
+        // In the msync case, this syncs a single page instead of
+        // everything the transaction wrote.
+        RangeSet hdr_range;
+        flush(hdr, msync_needed, hdr_range);
+        commit(msync_needed, hdr_range);
+    }
+    return seq;
+}
+
+bool TransactionManager::pending_through(uint64_t seq) const
+{
+    for (int i = 0; i < _max_transactions; i++) {
+        uint64_t s = *static_cast<const volatile uint64_t *>(&_pending_seqs[i]);
+        if (s != 0 && s <= seq)
+            return true;
+    }
+    return false;
+}
+
 void TransactionManager::free_transaction(const TransactionHandle &handle,
+                                          uint64_t depends_on,
                                           bool msync_needed,
                                           RangeSet &pending_commits)
 {
     // If handle.index is -1, this is a read-only transaction, and
     // nothing needs to be done.
     if (handle.index != -1) {
+        // No transaction is acknowledged before one whose data it may
+        // have seen. Those took their place in the commit order before
+        // releasing the locks that let us see their data.
+        if (depends_on != 0) {
+            while (pending_through(depends_on))
+                pause();
+        }
+
         // Writing 0 to the transaction-id commits the transaction
         TransactionHdr *hdr = &_tx_table[handle.index];
         hdr->tx_id &= ~TransactionHdr::ACTIVE;
         flush(hdr, msync_needed, pending_commits);
         commit(msync_needed, pending_commits);
+
+        memory_barrier();
+        _pending_seqs[handle.index] = 0;
+        xadd<int64_t>(_active_writers, -1);
     }
 }
+
+void TransactionManager::quiesce()
+{
+    while (!cmpxchg<bool>(_quiesced, false, true))
+        std::this_thread::yield();
+    while (_active_writers != 0)
+        pause();
+}
+
+void TransactionManager::resume()
+{
+    memory_barrier();
+    _quiesced = false;
+}
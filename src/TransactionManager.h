@@ -31,11 +31,15 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <vector>
+#include <utility>
 #include <emmintrin.h>
 #include <immintrin.h>
 #include "arch.h"
 #include "os.h"
 #include "GraphConfig.h"
+#include "DirtyPageMap.h"
+#include "persist.h"
 
 namespace PMGD {
     // TransactionId is never reset and should not roll-over.
@@ -64,6 +68,12 @@ namespace PMGD {
         TransactionId tx_id;
         void *jbegin;
         void *jend;
+
+        // Position of this transaction in the commit order, or zero
+        // if it has not reached its commit point. Recovery uses it
+        // to undo transactions that released their locks early after
+        // any transactions that may have read their data.
+        uint64_t commit_seq;
     };
 
     class TransactionManager {
@@ -74,14 +84,49 @@ namespace PMGD {
         void *_journal_addr;
 
         TransactionId _cur_tx_id;
+
+        // Commit sequence numbers handed out, and per table entry the
+        // sequence number of a transaction whose commit record is not
+        // durable yet, or zero.
+        uint64_t _commit_seq;
+        std::vector<uint64_t> _pending_seqs;
+
+        // Read-write transactions in flight, and whether new top-level
+        // ones are held back so a snapshot can be taken.
+        volatile int64_t _active_writers;
+        volatile bool _quiesced;
+
         int _max_transactions;
         size_t _extent_size;
         int _max_extents;
 
+        static PersistMode _persist_mode;
+
+        // Operations for with_mode on single cache lines and commit points.
+        struct FlushLine {
+            template <PersistMode M>
+            static void run(void *addr, bool msync_needed, RangeSet &pending_commits)
+                { flush<M>(addr, msync_needed, pending_commits); }
+        };
+
+        struct CommitPoint {
+            template <PersistMode M>
+            static void run(bool msync_commit, RangeSet &pending_commits)
+                { Persist<M>::commit(msync_commit, pending_commits); }
+        };
+
+        struct FlushLines {
+            template <PersistMode M>
+            static void run(void *ptr, size_t len,
+                            bool msync_needed, RangeSet &pending_commits)
+                { flush_range<M>(ptr, len, msync_needed, pending_commits); }
+        };
+
         void reset_table(bool msync_needed, RangeSet &pending_commits);
         void recover(bool read_only, bool msync_needed, RangeSet &pending_commits);
         void *tx_jbegin(int index);
         void *tx_jend(int index);
+        bool pending_through(uint64_t seq) const;
 
     public:
         TransactionManager(const TransactionManager &) = delete;
@@ -93,31 +138,93 @@ namespace PMGD {
                            uint64_t journal_size,
                            CommonParams &params);
 
-        TransactionHandle alloc_transaction(bool read_only, bool msync_needed, RangeSet &);
-        void free_transaction(const TransactionHandle &, bool msync_needed, RangeSet &);
+        // A nested transaction is never held back by quiesce, since its
+        // outer transaction is already counted as active.
+        TransactionHandle alloc_transaction(bool read_only, bool nested,
+                                            bool msync_needed, RangeSet &);
+        // depends_on is the highest commit sequence number of a
+        // transaction whose early-released data this one may have seen.
+        // The commit record is written only once every transaction up
+        // to that point is durable; independent ones finish in any order.
+        void free_transaction(const TransactionHandle &, uint64_t depends_on,
+                              bool msync_needed, RangeSet &);
+
+        // Assign the next commit sequence number to a transaction that
+        // still holds its locks. The header is flushed into the caller's
+        // range set; if sync_header is set, it is also made durable on
+        // its own so the caller can release its locks before its data.
+        uint64_t order_commit(const TransactionHandle &, bool sync_header,
+                              bool msync_needed, RangeSet &);
+
+        // Hold back new read-write transactions and wait for the ones
+        // in flight to finish. Once quiesce returns, every committed
+        // transaction is durable and the regions are consistent.
+        void quiesce();
+        void resume();
 
         // Need a neutral spot to declare the following functions
-        // that handle persistence via PM way or msync way. In case
-        // of msync, the caller decides based on Graph create time
-        // flags if some msync action is needed or not.
+        // that handle persistence. The backend is selected when a
+        // graph is opened; since only one graph can be mapped per
+        // process, a static is enough. In case of msync, the caller
+        // decides based on Graph open time flags if some msync
+        // action is needed or not.
+        static PersistMode default_persist_mode();
+        static void set_persist_mode(PersistMode mode);
+        static PersistMode persist_mode() { return _persist_mode; }
+
+        // Call Op::run<M>(args...) for the selected mode M. Loops that
+        // flush cache lines are written as such templates, so that the
+        // mode is tested once per loop and each line gets an inlined
+        // Persist<M>::flush.
+        template <typename Op, typename... Args>
+        static inline void with_mode(Args &&... args)
+        {
+            switch (_persist_mode) {
+                case PersistMode::Msync:
+                    return Op::template run<PersistMode::Msync>(std::forward<Args>(args)...);
+                case PersistMode::Clflush:
+                    return Op::template run<PersistMode::Clflush>(std::forward<Args>(args)...);
+                case PersistMode::Clflushopt:
+                    return Op::template run<PersistMode::Clflushopt>(std::forward<Args>(args)...);
+                case PersistMode::Clwb:
+                    return Op::template run<PersistMode::Clwb>(std::forward<Args>(args)...);
+                case PersistMode::NTStore:
+                    return Op::template run<PersistMode::NTStore>(std::forward<Args>(args)...);
+                case PersistMode::None:
+                    return Op::template run<PersistMode::None>(std::forward<Args>(args)...);
+            }
+        }
+
+        template <PersistMode M>
         static inline void flush(void *addr, bool msync_needed, RangeSet &pending_commits)
         {
-#ifdef PM  // Means there is persistent memory
-            clflush(addr);
-#else   // MSYNC
-            if (msync_needed)
-                os::flush(addr, pending_commits);
-#endif
+            DirtyPageMap::mark(addr, msync_needed, pending_commits);
+            Persist<M>::flush(addr, msync_needed, pending_commits);
         }
 
-        static inline void commit(bool msync_commit, RangeSet &pending_commits)
+        // Flush every cache line in [ptr, ptr+len).
+        template <PersistMode M>
+        static inline void flush_range(void *ptr, size_t len,
+                                       bool msync_needed, RangeSet &pending_commits)
         {
-#ifdef PM
-            persistent_barrier();
-#else   // MSYNC
-            if (msync_commit)
-                os::commit(pending_commits);
-#endif
+            char *addr = (char *)((uintptr_t)ptr & -64);
+            char *eptr = (char *)ptr + len;
+            for (; addr < eptr; addr += 64)
+                flush<M>(addr, msync_needed, pending_commits);
         }
+
+        static inline void flush(void *addr, bool msync_needed, RangeSet &pending_commits)
+            { with_mode<FlushLine>(addr, msync_needed, pending_commits); }
+
+        static inline void commit(bool msync_commit, RangeSet &pending_commits)
+            { with_mode<CommitPoint>(msync_commit, pending_commits); }
+
+        static inline void flush_range(void *ptr, size_t len,
+                                       bool msync_needed, RangeSet &pending_commits)
+            { with_mode<FlushLines>(ptr, len, msync_needed, pending_commits); }
+
+        // Copy into space that needs no logging and make it durable.
+        static void copy(void *dst, const void *src, size_t len,
+                         bool msync_needed, RangeSet &pending_commits);
     };
 };
@@ -46,9 +46,13 @@ AllocatorUnit::VariableAllocator::VariableAllocator(AllocatorUnit &allocator,
     _chunk_to_scan = hdr->start_chunk;
     _last_chunk_scanned = NULL;
     _hdr = hdr;
+    _logged_tx = 0;
+    _logged_chunk = NULL;
+    _logged_size = NULL;
+    _logged_max = false;
 }
 
-void AllocatorUnit::VariableAllocator::FreeFormChunk::find_max_cont_space()
+void AllocatorUnit::VariableAllocator::FreeFormChunk::find_max_cont_space(bool &logged)
 {
     // Have to compute it all over again because we have no idea how
     // the free list got changed before this and since we do not
@@ -66,12 +70,18 @@ void AllocatorUnit::VariableAllocator::FreeFormChunk::find_max_cont_space()
         offset = free_spot->next;
     }
     if (max_cont_space != space) {
-        TransactionImpl *tx = TransactionImpl::get_tx();
-        tx->write(&max_cont_space, space);
+        if (!logged) {
+            TransactionImpl *tx = TransactionImpl::get_tx();
+            tx->log(&max_cont_space, sizeof max_cont_space);
+            logged = true;
+        }
+        max_cont_space = space;
     }
 }
 
-void *AllocatorUnit::VariableAllocator::FreeFormChunk::alloc(size_t sz)
+void *AllocatorUnit::VariableAllocator::FreeFormChunk::alloc(size_t sz,
+                                                            uint32_t *&logged_size,
+                                                            bool &logged_max)
 {
     if (sz > max_cont_space)
         return NULL;
@@ -94,7 +104,11 @@ void *AllocatorUnit::VariableAllocator::FreeFormChunk::alloc(size_t sz)
                 uint32_t new_offset = offset + (sz_free - sz);
                 addr = compute_addr(new_offset);
                 // But we do need to update the size.
-                tx->write(&free_spot->size, (uint32_t)(sz_free - sz));
+                if (logged_size != &free_spot->size) {
+                    tx->log(&free_spot->size, sizeof free_spot->size);
+                    logged_size = &free_spot->size;
+                }
+                free_spot->size = (uint32_t)(sz_free - sz);
             }
             else {   // This is where we might have some permanently wasted bytes
                 addr = compute_addr(offset);
@@ -108,10 +122,12 @@ void *AllocatorUnit::VariableAllocator::FreeFormChunk::alloc(size_t sz)
                 // Log first 8B of the address being returned to the user
                 // since that contained our free list information.
                 tx->log(free_spot, sizeof(free_spot_t));
+                if (logged_size == &free_spot->size)
+                    logged_size = NULL;
             }
             free_space -= sz;
             if (sz_free == max_cont_space)
-                find_max_cont_space();
+                find_max_cont_space(logged_max);
             return addr;
         } // If the current free spot doesn't have enough room, traverse
         else {
@@ -231,6 +247,21 @@ void *AllocatorUnit::VariableAllocator::alloc_large(size_t sz)
     return dst_chunk->compute_addr(CHUNK_SIZE - used);
 }
 
+void *AllocatorUnit::VariableAllocator::alloc(FreeFormChunk *chunk, size_t sz)
+{
+    // Chunks without room are passed over without logging anything.
+    if (sz > chunk->max_cont_space)
+        return NULL;
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    if (chunk != _logged_chunk || tx->tx_id() != _logged_tx) {
+        _logged_tx = tx->tx_id();
+        _logged_chunk = chunk;
+        _logged_size = NULL;
+        _logged_max = false;
+    }
+    return chunk->alloc(sz, _logged_size, _logged_max);
+}
+
 void *AllocatorUnit::VariableAllocator::alloc(size_t sz)
 {
     void *addr = NULL;
@@ -242,7 +273,7 @@ void *AllocatorUnit::VariableAllocator::alloc(size_t sz)
 
     // Check the vector first.
     for (FreeFormChunk *chunk : _free_chunks) {
-        addr = chunk->alloc(sz);
+        addr = alloc(chunk, sz);
 
         if (addr != NULL) {
             if (!chunk->has_space()) {
@@ -270,7 +301,7 @@ void *AllocatorUnit::VariableAllocator::alloc(size_t sz)
 
         // This chunk must not be in the DRAM lists since we go
         // in a sequence.
-        addr = _chunk_to_scan->alloc(sz);
+        addr = alloc(_chunk_to_scan, sz);
 
         // For later scans
         if (_chunk_to_scan->has_space())
@@ -288,7 +319,7 @@ void *AllocatorUnit::VariableAllocator::alloc(size_t sz)
     // This chunk will definitely have space in case of an abort.
     AllocatorAbortCallback<VariableAllocator>::restore_dram_state(tx,
                                                this, dst_chunk);
-    addr = dst_chunk->alloc(sz);
+    addr = alloc(dst_chunk, sz);
 
     // For later scans
     if (dst_chunk->has_space())
@@ -30,6 +30,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <cpuid.h>
 
 template <typename T>
 static inline bool cmpxchg(volatile T &m, T old_val, T new_val)
@@ -64,6 +65,15 @@ static inline unsigned bsr(T value)
     return unsigned(r);
 }
 
+template <typename T>
+static inline unsigned bsf(T value)
+{
+    T r;
+    // Find the index of the lowest bit = 1
+    __asm__("bsf %1,%0" : "=r"(r) : "r"(value));
+    return unsigned(r);
+}
+
 template <typename T>
 static inline T atomic_inc(volatile T &m)
 {
@@ -90,13 +100,38 @@ static inline void pause()
     asm("pause");
 }
 
-#define CONCAT_(x, y)     x##y
-#define CONCAT(x, y)      CONCAT_(x, y)
-#define STRINGIFY_(x)     #x
-#define STRINGIFY(x)      STRINGIFY_(x) 
 static inline void clflush(void *addr)
 {
-    __asm__(STRINGIFY(PMFLUSH) " %0" : : "m"(*(char *)addr), "m"(*(char (*)[64])((uintptr_t)addr & -64)));
+    __asm__ volatile ("clflush %0" : : "m"(*(char *)addr), "m"(*(char (*)[64])((uintptr_t)addr & -64)));
+}
+
+static inline void clflushopt(void *addr)
+{
+    __asm__ volatile ("clflushopt %0" : : "m"(*(char *)addr), "m"(*(char (*)[64])((uintptr_t)addr & -64)));
+}
+
+static inline void clwb(void *addr)
+{
+    __asm__ volatile ("clwb %0" : : "m"(*(char *)addr), "m"(*(char (*)[64])((uintptr_t)addr & -64)));
+}
+
+// Non-temporal store, bypassing the cache
+static inline void nt_store(uint64_t *addr, uint64_t value)
+{
+    __asm__ volatile ("movnti %1, %0" : "=m"(*addr) : "r"(value));
+}
+
+// CPUID leaf 7, EBX bits 23 and 24
+static inline bool cpu_has_clflushopt()
+{
+    unsigned a, b, c, d;
+    return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1 << 23));
+}
+
+static inline bool cpu_has_clwb()
+{
+    unsigned a, b, c, d;
+    return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1 << 24));
 }
 
 static inline void persistent_barrier()
@@ -48,10 +48,18 @@ EdgeID Edge::get_id() const
     return TransactionImpl::get_tx()->get_db()->edge_table().get_id(this);
 }
 
+Edge *EdgeRef::record() const
+{
+    Edge *e = edge();
+    if (e == NULL)
+        throw PMGDException(LightEdgeMismatch);
+    return e;
+}
+
 EdgeID EdgeRef::get_id() const
 {
     // get_id() for Edge takes care of locking.
-    return edge()->get_id();
+    return record()->get_id();
 }
 
 StringID Edge::get_tag() const
@@ -28,7 +28,15 @@
  */
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <map>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <iterator>
 #include "graph.h"
 #include "GraphConfig.h"
 #include "GraphImpl.h"
@@ -41,6 +49,10 @@
 #include "arch.h"
 #include "os.h"
 #include "Index.h"
+#include "TagIndex.h"
+#include "EdgeIndex.h"
+#include "CompositeIndex.h"
+#include "PostingList.h"
 #include "filter.h"
 
 using namespace PMGD;
@@ -50,7 +62,7 @@ static constexpr char info_name[] = "graph.jdb";
 extern constexpr char commit_id[] = "Commit id: " COMMIT_ID;
 
 struct GraphImpl::GraphInfo {
-    static const uint64_t VERSION = 8;
+    static const uint64_t VERSION = 26;
 
     uint64_t version;
 
@@ -60,12 +72,21 @@ struct GraphImpl::GraphInfo {
     RegionInfo stringtable_info;
     RegionInfo node_info;
     RegionInfo edge_info;
+    RegionInfo edgepos_info;
     RegionInfo allocator_info;
 
+    // Empty name if dirty page tracking is off
+    RegionInfo dirtymap_info;
+
     uint32_t max_stringid_length;
 
     char locale_name[32];
 
+    // See GraphImpl::num_removing
+    uint64_t num_removing;
+
+    FixedAllocator::Slab edge_slabs[GraphImpl::EDGE_SLABS];
+
     // We store allocator region information in the graph header
     // to avoid using pages within the allocator pools and avoid
     // wasting space due to alignment constraints.
@@ -98,23 +119,201 @@ Node &Graph::add_node(StringID tag)
     tx->acquire_lock(TransactionImpl::NodeLock, &ntable, true);
     Node *node = (Node *)ntable.alloc();
     node->init(tag, ntable.object_size(), _impl->allocator());
+    // New allocation, so flush without logging.
+    tx->flush_range(node, ntable.object_size());
     _impl->index_manager().add_node(node, _impl->allocator());
     return *node;
 }
 
+// get_list leaves the value write locked whether it was there or not,
+// so the second descent, from set_property, finds it where it was.
+// A unique index on tag 0 serves any tag, but the node found through
+// it may have another tag. Then the value is taken, and a new node
+// could not have it either.
+Node &Graph::get_or_add_node(StringID tag, StringID property_id,
+                             const Property &value,
+                             std::function<void(Node &)> f)
+{
+    IndexManager &im = _impl->index_manager();
+    Index *index = im.get_index(NodeIndex, tag, property_id, value.type());
+    bool any_tag = index == NULL || !index->unique();
+    if (any_tag)
+        index = im.get_index(NodeIndex, 0, property_id, value.type());
+    if (index == NULL || !index->unique())
+        throw PMGDException(InvalidID);
+
+    PostingList *list = index->get_list(value, _impl);
+    if (list->num_elems() > 0) {
+        PostingListTraverser t(list);
+        Node *node = (Node *)_impl->node_table().get_object(t.ref() + 1);
+        TransactionImpl::lock_node(node, false);
+        if (any_tag && tag != 0 && node->get_tag() != tag)
+            throw PMGDException(NotUnique);
+        return *node;
+    }
+
+    Node &node = add_node(tag);
+    node.set_property(property_id, value);
+    if (f)
+        f(node);
+    return node;
+}
+
 Edge &Graph::add_edge(Node &src, Node &dest, StringID tag)
 {
+    if (_impl->index_manager().is_light(tag))
+        throw PMGDException(LightEdgeMismatch);
     TransactionImpl *tx = TransactionImpl::get_tx();
     GraphImpl::EdgeTable &etable = _impl->edge_table();
-    tx->acquire_lock(TransactionImpl::EdgeLock, &etable, true);
-    Edge *edge = (Edge *)etable.alloc();
+    Edge *edge = (Edge *)etable.alloc(_impl->edge_slab(1));
     edge->init(src, dest, tag, etable.object_size());
-    src.add_edge(edge, Outgoing, tag, _impl->allocator());
-    dest.add_edge(edge, Incoming, tag, _impl->allocator());
+    void **pos = _impl->edge_positions(edge);
+    pos[0] = src.add_edge(edge, &dest, Outgoing, tag, _impl->allocator());
+    pos[1] = dest.add_edge(edge, &src, Incoming, tag, _impl->allocator());
+    // New allocation, so flush without logging.
+    tx->flush_range(edge, etable.object_size());
+    tx->flush_range(pos, GraphImpl::EDGE_POSITIONS_SIZE);
     _impl->index_manager().add_edge(edge, _impl->allocator());
     return *edge;
 }
 
+void Graph::set_light_edges(StringID tag)
+{
+    _impl->index_manager().set_light(tag);
+}
+
+void Graph::add_light_edge(Node &src, Node &dest, StringID tag)
+{
+    if (!_impl->index_manager().is_light(tag))
+        throw PMGDException(LightEdgeMismatch);
+    Allocator &allocator = _impl->allocator();
+    src.add_edge(NULL, &dest, Outgoing, tag, allocator);
+    dest.add_edge(NULL, &src, Incoming, tag, allocator);
+}
+
+void Graph::set_edge_order(StringID tag, StringID property_id,
+                           PropertyType ptype)
+{
+    _impl->index_manager().set_edge_order(tag, property_id, ptype);
+}
+
+void Graph::add_nodes(StringID tag, size_t count, std::function<void(Node &)> f)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    GraphImpl::NodeTable &ntable = _impl->node_table();
+    Allocator &allocator = _impl->allocator();
+    tx->acquire_lock(TransactionImpl::NodeLock, &ntable, true);
+
+    std::vector<void *> nodes;
+    nodes.reserve(count);
+    ntable.alloc(count, nodes);
+    for (void *p : nodes) {
+        static_cast<Node *>(p)->init(tag, ntable.object_size(), allocator);
+        tx->flush_range(p, ntable.object_size());
+    }
+    _impl->index_manager().add_nodes(tag, nodes.data(), count, allocator);
+
+    if (f) {
+        for (void *p : nodes)
+            f(*static_cast<Node *>(p));
+    }
+}
+
+void Graph::add_edges(const std::vector<EdgeSpec> &specs,
+                      std::function<void(Edge &)> f)
+{
+    // Light edges have no records, so they go in one at a time,
+    // ahead of the others and without the callback.
+    IndexManager &index_manager = _impl->index_manager();
+    auto light = [&index_manager](const EdgeSpec &spec)
+        { return index_manager.is_light(spec.tag); };
+    if (std::any_of(specs.begin(), specs.end(), light)) {
+        std::vector<EdgeSpec> full;
+        for (const EdgeSpec &spec : specs) {
+            if (light(spec))
+                add_light_edge(spec.source, spec.destination, spec.tag);
+            else
+                full.push_back(spec);
+        }
+        add_edges(full, f);
+        return;
+    }
+
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    GraphImpl::EdgeTable &etable = _impl->edge_table();
+    Allocator &allocator = _impl->allocator();
+
+    size_t count = specs.size();
+    std::vector<void *> edges;
+    edges.reserve(count);
+    etable.alloc(_impl->edge_slab(count), count, edges);
+    for (size_t i = 0; i < count; i++) {
+        const EdgeSpec &spec = specs[i];
+        static_cast<Edge *>(edges[i])->init(spec.source, spec.destination,
+                                            spec.tag, etable.object_size());
+    }
+
+    // Visit the edges grouped by the node at one end and the tag,
+    // keeping the given order within a group, and hand each group to
+    // that node at once.
+    std::vector<size_t> order(count);
+    std::vector<Edge *> group;
+    std::vector<void *> pos;
+    auto add_adjacency = [&](Direction dir) {
+        auto end = [&](size_t i) -> Node *
+            { return &(dir == Outgoing ? specs[i].source : specs[i].destination); };
+        for (size_t i = 0; i < count; i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return end(a) < end(b)
+                || (end(a) == end(b) && specs[a].tag.id() < specs[b].tag.id());
+        });
+        for (size_t i = 0; i < count; ) {
+            size_t j = i;
+            group.clear();
+            for (; j < count && end(order[j]) == end(order[i])
+                        && specs[order[j]].tag == specs[order[i]].tag; j++)
+                group.push_back(static_cast<Edge *>(edges[order[j]]));
+            pos.resize(group.size());
+            end(order[i])->add_edges(group.data(), group.size(), dir,
+                                     specs[order[i]].tag, pos.data(), allocator);
+            for (size_t k = 0; k < group.size(); k++)
+                _impl->edge_positions(group[k])[dir == Outgoing ? 0 : 1] = pos[k];
+            i = j;
+        }
+    };
+    add_adjacency(Outgoing);
+    add_adjacency(Incoming);
+
+    // New allocations, so flush without logging.
+    for (void *e : edges) {
+        tx->flush_range(e, etable.object_size());
+        tx->flush_range(_impl->edge_positions(static_cast<Edge *>(e)),
+                        GraphImpl::EDGE_POSITIONS_SIZE);
+    }
+
+    // The tag index only needs grouping by tag.
+    for (size_t i = 0; i < count; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        { return specs[a].tag.id() < specs[b].tag.id(); });
+    std::vector<void *> tagged;
+    for (size_t i = 0; i < count; ) {
+        size_t j = i;
+        tagged.clear();
+        for (; j < count && specs[order[j]].tag == specs[order[i]].tag; j++)
+            tagged.push_back(edges[order[j]]);
+        _impl->index_manager().add_edges(specs[order[i]].tag, tagged.data(),
+                                         tagged.size(), allocator);
+        i = j;
+    }
+
+    if (f) {
+        for (void *e : edges)
+            f(*static_cast<Edge *>(e));
+    }
+}
+
 void Graph::remove(Node &node)
 {
     TransactionImpl *tx = TransactionImpl::get_tx();
@@ -123,39 +322,438 @@ void Graph::remove(Node &node)
     tx->acquire_lock(TransactionImpl::NodeLock, &node, true);
 
     // Remove edges before properties to ensure we can get all locks
-    // before doing the work.
-    node.get_edges().process([this](Edge &edge) { remove(edge); });
+    // before doing the work. The node's own adjacency is freed as a
+    // whole by cleanup(), so only the other end of each edge is
+    // updated.
+    remove_edges(node, SIZE_MAX, false);
+    remove_node(node);
+}
+
+bool Graph::remove_partial(Node &node, size_t max_edges)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::NodeLock, &node, true);
+    if (!node._removing) {
+        tx->write(&node._removing, true);
+        _impl->add_removing(1);
+    }
+
+    // The node table stays unlocked until the last step.
+    if (!remove_edges(node, max_edges, true))
+        return false;
+    tx->acquire_lock(TransactionImpl::NodeLock, &_impl->node_table(), true);
+    remove_node(node);
+    _impl->add_removing(-1);
+    return true;
+}
 
+// The edges are gone already
+void Graph::remove_node(Node &node)
+{
     Allocator &allocator = _impl->allocator();
     _impl->index_manager().remove_node(&node, allocator);
 
     node.remove_all_properties();
     node.cleanup(allocator);
-    ntable.free(&node);
+    _impl->node_table().free(&node);
+}
+
+namespace {
+    // One end of an edge being removed by Graph::remove_edges. A
+    // light edge has no record, so it is found by its other end.
+    struct EdgeEnd {
+        Node *node;
+        Direction dir;
+        StringID tag;
+        Edge *edge;
+        void *pos;
+        Node *other;
+    };
+}
+
+// Removes up to max_edges of the edges of node, and returns true if
+// that was all of them. The adjacency updates are grouped by the node
+// at the other end and the tag, and the tag index updates by tag.
+// With own set, the edges also come out of the node's own adjacency;
+// otherwise cleanup() frees that as a whole.
+bool Graph::remove_edges(Node &node, size_t max_edges, bool own)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    GraphImpl::EdgeTable &etable = _impl->edge_table();
+    IndexManager &index_manager = _impl->index_manager();
+    Allocator &allocator = _impl->allocator();
+
+    // Self loops show up in both directions; take them from the
+    // outgoing side.
+    std::vector<std::pair<StringID, EdgeIndex::EdgeNodePair>> out, in;
+    bool all = node._out_edges == NULL
+                   || node._out_edges->get_pairs(max_edges, out);
+    if (all && node._in_edges != NULL)
+        all = node._in_edges->get_pairs(max_edges - out.size(), in);
+
+    std::vector<Edge *> edges;
+    std::vector<EdgeEnd> ends;
+    auto add_end = [&](Node *end, Direction dir, StringID tag, Edge *edge,
+                       void *pos, Node *other) {
+        if (own || end != &node)
+            ends.push_back(EdgeEnd{ end, dir, tag, edge, pos, other });
+    };
+    auto add = [&](const std::pair<StringID, EdgeIndex::EdgeNodePair> &p,
+                   Direction dir) {
+        Edge *edge = p.second.key();
+        Node *other = p.second.value();
+        if (dir == Incoming && other == &node)
+            return;
+        Direction back = (dir == Outgoing) ? Incoming : Outgoing;
+        if (edge == NULL) {
+            add_end(&node, dir, p.first, NULL, NULL, other);
+            add_end(other, back, p.first, NULL, NULL, &node);
+            return;
+        }
+        edges.push_back(edge);
+        void **pos = _impl->edge_positions(edge);
+        add_end(edge->_src, Outgoing, p.first, edge, pos[0], NULL);
+        add_end(edge->_dest, Incoming, p.first, edge, pos[1], NULL);
+    };
+    for (auto &p : out)
+        add(p, Outgoing);
+    for (auto &p : in)
+        add(p, Incoming);
+
+    FixedAllocator::Slab *slab = edges.empty() ? NULL : _impl->edge_slab(0);
+    for (Edge *edge : edges) {
+        tx->acquire_lock(TransactionImpl::EdgeLock, edge, true);
+        // Out of the ordered adjacency while the tag buckets are there
+        const IndexManager::EdgeOrder *order = index_manager.edge_order(edge->_tag);
+        if (order != NULL)
+            edge->remove_property(order->property_id);
+    }
+
+    std::stable_sort(ends.begin(), ends.end(),
+                     [](const EdgeEnd &a, const EdgeEnd &b) {
+        if (a.node != b.node)
+            return a.node < b.node;
+        if (a.dir != b.dir)
+            return a.dir < b.dir;
+        return a.tag.id() < b.tag.id();
+    });
+    std::vector<Edge *> group;
+    std::vector<void *> pos;
+    for (size_t i = 0; i < ends.size(); ) {
+        const EdgeEnd &first = ends[i];
+        group.clear();
+        pos.clear();
+        size_t j = i;
+        for (; j < ends.size() && ends[j].node == first.node
+                   && ends[j].dir == first.dir && ends[j].tag == first.tag; j++) {
+            if (ends[j].edge == NULL)
+                first.node->remove_light_edge(ends[j].other, first.dir,
+                                              first.tag, allocator);
+            else {
+                group.push_back(ends[j].edge);
+                pos.push_back(ends[j].pos);
+            }
+        }
+        if (!group.empty())
+            first.node->remove_edges(group.data(), pos.data(), group.size(),
+                                     first.dir, first.tag, allocator);
+        i = j;
+    }
+
+    std::stable_sort(edges.begin(), edges.end(), [](Edge *a, Edge *b)
+        { return a->_tag.id() < b->_tag.id(); });
+    std::vector<void *> tagged;
+    for (size_t i = 0; i < edges.size(); ) {
+        size_t j = i;
+        tagged.clear();
+        for (; j < edges.size() && edges[j]->_tag == edges[i]->_tag; j++)
+            tagged.push_back(edges[j]);
+        index_manager.remove_edges(edges[i]->_tag, tagged.data(),
+                                   tagged.size(), allocator);
+        i = j;
+    }
+
+    for (Edge *edge : edges) {
+        edge->remove_all_properties();
+        etable.free(slab, edge);
+    }
+    return all;
 }
 
 void Graph::remove(Edge &edge)
+{
+    remove_edge(edge, NULL);
+}
+
+void Graph::remove(EdgeRef &edge)
+{
+    remove_edge(edge, NULL);
+}
+
+void Graph::remove_edge(EdgeRef &edge, const Node *skip)
+{
+    if (edge.is_light())
+        remove_light_edge(edge.get_source(), edge.get_destination(),
+                          edge.get_tag(), skip);
+    else
+        remove_edge(static_cast<Edge &>(edge), skip);
+}
+
+// Light edges to the same neighbor with the same tag are all alike,
+// so each end drops the first one it finds.
+void Graph::remove_light_edge(Node &src, Node &dest, StringID tag,
+                              const Node *skip)
+{
+    Allocator &allocator = _impl->allocator();
+    if (&src != skip)
+        src.remove_light_edge(&dest, Outgoing, tag, allocator);
+    if (&dest != skip)
+        dest.remove_light_edge(&src, Incoming, tag, allocator);
+}
+
+void Graph::remove_edge(Edge &edge, const Node *skip)
 {
     TransactionImpl *tx = TransactionImpl::get_tx();
     GraphImpl::EdgeTable &etable = _impl->edge_table();
-    tx->acquire_lock(TransactionImpl::EdgeLock, &etable, true);
+    FixedAllocator::Slab *slab = _impl->edge_slab(0);
     tx->acquire_lock(TransactionImpl::EdgeLock, &edge, true);
     Allocator &allocator = _impl->allocator();
-    edge.get_source().remove_edge(&edge, Outgoing, allocator);
-    edge.get_destination().remove_edge(&edge, Incoming, allocator);
+
+    // Take the edge out of the ordered adjacency while the tag buckets
+    // at both ends are still there.
+    const IndexManager::EdgeOrder *order
+        = _impl->index_manager().edge_order(edge.get_tag());
+    if (order != NULL)
+        edge.remove_property(order->property_id);
+
+    Node &src = edge.get_source();
+    Node &dest = edge.get_destination();
+    void **pos = _impl->edge_positions(&edge);
+    if (&src != skip)
+        src.remove_edge(&edge, Outgoing, pos[0], allocator);
+    if (&dest != skip)
+        dest.remove_edge(&edge, Incoming, pos[1], allocator);
     _impl->index_manager().remove_edge(&edge, allocator);
 
     // Remove edge from nodes before properties to ensure we can get all locks
     // before doing the work.
     edge.remove_all_properties();
-    etable.free(&edge);
+    etable.free(slab, &edge);
 }
 
 void Graph::create_index(IndexType index_type, StringID tag,
-                         StringID property_id, const PropertyType ptype)
+                         StringID property_id, const PropertyType ptype,
+                         IndexKind kind, bool unique)
 {
     _impl->index_manager().create_index(index_type, tag,
-                                        property_id, ptype, _impl->allocator());
+                                        property_id, ptype, kind, unique,
+                                        _impl->allocator());
+}
+
+void Graph::create_index(IndexType index_type, StringID tag,
+                         const std::vector<IndexColumn> &columns)
+{
+    _impl->index_manager().create_index(index_type, tag, columns,
+                                        _impl->allocator());
+}
+
+void Graph::snapshot(const char *dest_name)
+{
+    _impl->snapshot(dest_name);
+}
+
+void Graph::export_delta(const char *delta_file)
+{
+    _impl->export_delta(delta_file);
+}
+
+// A delta file is a header followed by num_pages records, each the
+// page offset from the graph base address and the page contents.
+// A page may have more than one record; the last one holds its
+// contents at the new epoch.
+struct DeltaHeader {
+    static constexpr char MAGIC[8] = { 'P', 'M', 'G', 'D', 'D', 'L', 'T', '1' };
+    char magic[8];
+    uint64_t version;
+    uint64_t base_epoch;
+    uint64_t new_epoch;
+    uint64_t num_pages;
+};
+
+constexpr char DeltaHeader::MAGIC[8];
+
+void GraphImpl::export_delta(const char *delta_file)
+{
+    DirtyPageMap *map = _dirtymap_region.map();
+    if (map == NULL)
+        throw PMGDException(InvalidConfig, "dirty page tracking is not enabled");
+    if (TransactionImpl::in_read_write_tx())
+        throw PMGDException(NotImplemented);
+
+    FILE *f = fopen(delta_file, "wb");
+    if (f == NULL)
+        throw PMGDException(OpenFailed, errno, std::string(delta_file));
+
+    // As in snapshot, writers go on while the dirty pages are written.
+    // The pages they write meanwhile are written again, after the
+    // first records, once the writers are held back.
+    bool quiesced = false;
+    try {
+        std::unique_ptr<PageTracker> tracker(track_pages());
+
+        DeltaHeader hdr;
+        memcpy(hdr.magic, DeltaHeader::MAGIC, sizeof hdr.magic);
+        hdr.version = GraphInfo::VERSION;
+        hdr.base_epoch = map->epoch();
+        hdr.new_epoch = hdr.base_epoch + 1;
+        hdr.num_pages = 0;
+        bool ok = fwrite(&hdr, sizeof hdr, 1, f) == 1;
+
+        auto write_page = [&](uint64_t addr) {
+            uint64_t offset = addr - GraphConfig::BASE_ADDRESS;
+            ok = ok && fwrite(&offset, sizeof offset, 1, f) == 1
+                    && fwrite((void *)addr, DirtyPageMap::PAGE_BYTES, 1, f) == 1;
+            hdr.num_pages++;
+        };
+        map->for_each_dirty(write_page);
+
+        _transaction_manager.quiesce();
+        quiesced = true;
+        tracker->stop();
+        tracker->for_each(write_page);
+
+        // The delta must be durable before the map forgets its pages.
+        ok = ok && fseek(f, 0, SEEK_SET) == 0
+                && fwrite(&hdr, sizeof hdr, 1, f) == 1
+                && os::sync_file(f);
+        ok = (fclose(f) == 0) && ok;
+        f = NULL;
+        if (!ok)
+            throw PMGDException(OpenFailed, errno, std::string(delta_file) + " (write)");
+
+        // Only start the next epoch once the delta is complete.
+        map->reset(hdr.new_epoch, _init.params.msync_needed,
+                   *_init.params.pending_commits);
+    }
+    catch (...) {
+        if (f != NULL)
+            fclose(f);
+        if (quiesced)
+            _transaction_manager.resume();
+        throw;
+    }
+    _transaction_manager.resume();
+}
+
+// Find the file holding the graph page at addr among the info file
+// and the given regions, and the page's offset in that file. Returns
+// NULL if no file holds it.
+template <size_t N>
+static const char *locate_page(const RegionInfo *(&regions)[N], uint64_t addr,
+                               uint64_t &file_offset)
+{
+    if (addr < GraphConfig::BASE_ADDRESS + GraphConfig::INFO_SIZE) {
+        file_offset = addr - GraphConfig::BASE_ADDRESS;
+        return info_name;
+    }
+    for (const RegionInfo *r : regions) {
+        if (addr >= r->addr && addr < r->addr + r->len) {
+            file_offset = addr - r->addr;
+            return r->name;
+        }
+    }
+    return NULL;
+}
+
+void Graph::apply_delta(const char *db_name, const char *delta_file)
+{
+    // The copy is not mapped; its layout comes from its info file.
+    std::string dir = std::string(db_name) + "/";
+    std::map<std::string, FILE *> files;
+    auto open_file = [&](const char *name) {
+        FILE *&f = files[name];
+        if (f == NULL && (f = fopen((dir + name).c_str(), "r+b")) == NULL)
+            throw PMGDException(OpenFailed, errno, dir + name);
+        return f;
+    };
+
+    FILE *delta = NULL;
+    try {
+        uint64_t buf[GraphConfig::INFO_SIZE / sizeof(uint64_t)];
+        FILE *f = open_file(info_name);
+        if (fread(buf, sizeof buf, 1, f) != 1)
+            throw PMGDException(OpenFailed, dir + info_name + " (read)");
+        const GraphImpl::GraphInfo *info
+            = reinterpret_cast<const GraphImpl::GraphInfo *>(buf);
+        if (info->version != GraphImpl::GraphInfo::VERSION)
+            throw PMGDException(VersionMismatch);
+        if (info->dirtymap_info.name[0] == '\0')
+            throw PMGDException(InvalidConfig, "dirty page tracking is not enabled");
+
+        DirtyPageMap::Header map_hdr;
+        FILE *mf = open_file(info->dirtymap_info.name);
+        if (fread(&map_hdr, sizeof map_hdr, 1, mf) != 1)
+            throw PMGDException(OpenFailed, dir + info->dirtymap_info.name + " (read)");
+
+        if ((delta = fopen(delta_file, "rb")) == NULL)
+            throw PMGDException(OpenFailed, errno, std::string(delta_file));
+        DeltaHeader hdr;
+        if (fread(&hdr, sizeof hdr, 1, delta) != 1
+                || memcmp(hdr.magic, DeltaHeader::MAGIC, sizeof hdr.magic) != 0)
+            throw PMGDException(OpenFailed, std::string(delta_file) + " is not a delta");
+        if (hdr.version != info->version || hdr.base_epoch != map_hdr.epoch)
+            throw PMGDException(VersionMismatch, "delta does not follow this copy");
+
+        const RegionInfo *regions[] = {
+            &info->transaction_info, &info->journal_info,
+            &info->indexmanager_info, &info->stringtable_info,
+            &info->node_info, &info->edge_info, &info->edgepos_info,
+            &info->allocator_info };
+
+        std::string page(DirtyPageMap::PAGE_BYTES, '\0');
+        for (uint64_t i = 0; i < hdr.num_pages; i++) {
+            uint64_t offset;
+            if (fread(&offset, sizeof offset, 1, delta) != 1
+                    || fread(&page[0], page.size(), 1, delta) != 1)
+                throw PMGDException(OpenFailed, std::string(delta_file) + " (read)");
+
+            uint64_t file_offset;
+            const char *name = locate_page(regions, GraphConfig::BASE_ADDRESS + offset,
+                                           file_offset);
+            if (name == NULL)
+                throw PMGDException(OpenFailed, std::string(delta_file) + " does not match graph");
+
+            FILE *rf = open_file(name);
+            if (fseeko(rf, file_offset, SEEK_SET) != 0
+                    || fwrite(&page[0], page.size(), 1, rf) != 1)
+                throw PMGDException(OpenFailed, errno, dir + name + " (write)");
+        }
+
+        // Record the new backup point only once every page is durable.
+        for (auto &i : files) {
+            if (i.second != mf && !os::sync_file(i.second))
+                throw PMGDException(OpenFailed, errno, dir + i.first + " (fsync)");
+        }
+        map_hdr.epoch = hdr.new_epoch;
+        if (fseeko(mf, 0, SEEK_SET) != 0
+                || fwrite(&map_hdr, sizeof map_hdr, 1, mf) != 1
+                || !os::sync_file(mf))
+            throw PMGDException(OpenFailed, errno, dir + info->dirtymap_info.name + " (write)");
+    }
+    catch (...) {
+        if (delta != NULL)
+            fclose(delta);
+        for (auto &i : files)
+            if (i.second != NULL)
+                fclose(i.second);
+        throw;
+    }
+
+    fclose(delta);
+    for (auto &i : files) {
+        if (fclose(i.second) != 0)
+            throw PMGDException(OpenFailed, errno, dir + i.first + " (close)");
+    }
 }
 
 GraphImpl::GraphInit::GraphInit(const char *name, int options,
@@ -167,6 +765,33 @@ GraphImpl::GraphInit::GraphInit(const char *name, int options,
                params.create, false, params.read_only),
       info(reinterpret_cast<GraphInfo *>(GraphConfig::BASE_ADDRESS))
 {
+    // Select the persistence backend before anything is flushed.
+    switch (options & Graph::PersistMask) {
+    case Graph::PersistDefault:
+        TransactionManager::set_persist_mode(TransactionManager::default_persist_mode());
+        break;
+    case Graph::PersistMsync:
+        TransactionManager::set_persist_mode(PersistMode::Msync);
+        break;
+    case Graph::PersistClflush:
+        TransactionManager::set_persist_mode(PersistMode::Clflush);
+        break;
+    case Graph::PersistClflushopt:
+        TransactionManager::set_persist_mode(PersistMode::Clflushopt);
+        break;
+    case Graph::PersistClwb:
+        TransactionManager::set_persist_mode(PersistMode::Clwb);
+        break;
+    case Graph::PersistNTStore:
+        TransactionManager::set_persist_mode(PersistMode::NTStore);
+        break;
+    case Graph::PersistNone:
+        TransactionManager::set_persist_mode(PersistMode::None);
+        break;
+    default:
+        throw PMGDException(InvalidConfig);
+    }
+
     int msync_options = options & Graph::AlwaysMsync;
     switch (msync_options) {
     case 0:
@@ -200,6 +825,7 @@ GraphImpl::GraphInit::GraphInit(const char *name, int options,
             throw PMGDException(VersionMismatch);
     }
 
+    track_dirty_pages = config.track_dirty_pages;
     node_striped_lock_size = config.node_striped_lock_size;
     edge_striped_lock_size = config.edge_striped_lock_size;
     index_striped_lock_size = config.index_striped_lock_size;
@@ -219,7 +845,9 @@ void GraphImpl::GraphInfo::init(const GraphConfig &config,
     stringtable_info = config.stringtable_info;
     node_info = config.node_info;
     edge_info = config.edge_info;
+    edgepos_info = config.edgepos_info;
     allocator_info = config.allocator_info;
+    memset(&dirtymap_info, 0, sizeof dirtymap_info);
 
     max_stringid_length = config.max_stringid_length;
 
@@ -228,6 +856,9 @@ void GraphImpl::GraphInfo::init(const GraphConfig &config,
         throw PMGDException(InvalidConfig);
     memcpy(locale_name, config.locale_name.c_str(), size);
 
+    num_removing = 0;
+    memset(edge_slabs, 0, sizeof edge_slabs);
+
     TransactionImpl::flush_range(this, sizeof *this, msync_needed, pending_commits);
 }
 
@@ -237,6 +868,49 @@ GraphImpl::MapRegion::MapRegion(
 {
 }
 
+GraphImpl::DirtyMapRegion::DirtyMapRegion(const char *db_name, GraphInit &init)
+    : _region(NULL), _map(NULL)
+{
+    // Nothing is written to a read-only graph.
+    GraphInfo *info = init.info;
+    if (init.params.read_only)
+        return;
+
+    uint64_t span = info->allocator_info.addr + info->allocator_info.len
+                        - GraphConfig::BASE_ADDRESS;
+    if (info->dirtymap_info.name[0] == '\0') {
+        if (!init.track_dirty_pages)
+            return;
+        uint64_t addr = info->allocator_info.addr + info->allocator_info.len;
+        GraphConfig::init_region_info(info->dirtymap_info, "dirtymap.jdb", addr,
+                                      DirtyPageMap::region_size(span));
+        TransactionImpl::flush_range(&info->dirtymap_info, sizeof info->dirtymap_info,
+                                     init.params.msync_needed,
+                                     *init.params.pending_commits);
+    }
+
+    const RegionInfo &r = info->dirtymap_info;
+    bool create = true;
+    _region = new os::MapRegion(db_name, r.name, r.addr, r.len, create, false, false);
+    try {
+        _map = new DirtyPageMap(r.addr, create, GraphConfig::BASE_ADDRESS, span,
+                                info->journal_info.addr,
+                                info->journal_info.addr + info->journal_info.len,
+                                init.params.msync_needed,
+                                *init.params.pending_commits);
+    }
+    catch (...) {
+        delete _region;
+        throw;
+    }
+}
+
+GraphImpl::DirtyMapRegion::~DirtyMapRegion()
+{
+    delete _map;
+    delete _region;
+}
+
 GraphImpl::GraphImpl(const char *name, int options, const Graph::Config *config)
     : _init(name, options, config),
       _transaction_region(name, _init.info->transaction_info,
@@ -249,8 +923,10 @@ GraphImpl::GraphImpl(const char *name, int options, const Graph::Config *config)
                           _init.params.create, _init.params.read_only),
       _node_region(name, _init.info->node_info, _init.params.create, _init.params.read_only),
       _edge_region(name, _init.info->edge_info, _init.params.create, _init.params.read_only),
+      _edgepos_region(name, _init.info->edgepos_info, _init.params.create, _init.params.read_only),
       _allocator_region(name, _init.info->allocator_info,
                         _init.params.create, _init.params.read_only),
+      _dirtymap_region(name, _init),
       _transaction_manager(_init.info->transaction_info.addr,
                            _init.info->transaction_info.len,
                            _init.info->journal_info.addr,
@@ -266,7 +942,11 @@ GraphImpl::GraphImpl(const char *name, int options, const Graph::Config *config)
                   _init.params),
       _edge_table(_init.info->edge_info.addr,
                   _init.edge_size, _init.info->edge_info.len,
+                  _init.info->edge_slabs, EDGE_SLABS, TagIndex::PAGE_BITS,
                   _init.params),
+      _edge_positions(reinterpret_cast<void **>(_init.info->edgepos_info.addr)),
+      _edge_base(_init.info->edge_info.addr),
+      _edge_shift(bsf(_init.edge_size)),
       _allocator(this, _init.info->allocator_info.addr,
                  _init.info->allocator_info.len,
                  &_init.info->allocator_hdr,
@@ -277,11 +957,266 @@ GraphImpl::GraphImpl(const char *name, int options, const Graph::Config *config)
                   : std::locale()),
       _node_locks(_init.node_striped_lock_size, _init.node_stripe_width),
       _edge_locks(_init.edge_striped_lock_size, _init.edge_stripe_width),
-      _index_locks(_init.index_striped_lock_size, _init.index_stripe_width)
+      _index_locks(_init.index_striped_lock_size, _init.index_stripe_width),
+      _name(name),
+      _warmer(this, options)
 {
     TransactionManager::commit(_init.params.msync_needed, *_init.params.pending_commits);
 }
 
+uint64_t GraphImpl::num_removing()
+{
+    uint64_t *count = &_init.info->num_removing;
+    TransactionImpl::get_tx()->acquire_lock(TransactionImpl::NodeLock, count, false);
+    return *count;
+}
+
+void GraphImpl::add_removing(int delta)
+{
+    uint64_t *count = &_init.info->num_removing;
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    tx->acquire_lock(TransactionImpl::NodeLock, count, true);
+    tx->write(count, *count + delta);
+}
+
+// Concurrent transactions have different allocator instances, so
+// they only share a slab past EDGE_SLABS instances. A slab takes
+// edges from the table a tag index page worth at a time, so their
+// tag index adds do not conflict either.
+FixedAllocator::Slab *GraphImpl::edge_slab(size_t count)
+{
+    TransactionImpl *tx = TransactionImpl::get_tx();
+    FixedAllocator::Slab *slab = _edge_table.slab(_allocator.instance());
+    tx->acquire_lock(TransactionImpl::EdgeLock, slab, true);
+    if (!_edge_table.has_room(slab, count))
+        tx->acquire_lock(TransactionImpl::EdgeLock, &_edge_table, true);
+    return slab;
+}
+
+// Slabs before the table, as edge_slab does.
+void GraphImpl::lock_table(Graph::IndexType index_type)
+{
+    FixedAllocator &table = object_table(index_type);
+    unsigned n = std::min(table.num_slabs(), _allocator.num_instances());
+    for (unsigned i = 0; i < n; i++)
+        TransactionImpl::lock(index_type, table.slab(i), false);
+    TransactionImpl::lock(index_type, &table, false);
+}
+
+// Used part of each region, in the order the warm-up touches them.
+// Only the used prefix of the node, edge and allocator regions is
+// included, since the rest of the region files are sparse.
+GraphImpl::RangeList GraphImpl::used_ranges(bool with_indexes)
+{
+    RangeList ranges;
+    GraphInfo *info = _init.info;
+
+    if (with_indexes) {
+        ranges.push_back({ (void *)info->indexmanager_info.addr,
+                           info->indexmanager_info.len });
+        ranges.push_back({ (void *)info->stringtable_info.addr,
+                           info->stringtable_info.len });
+    }
+    ranges.push_back({ _node_table.begin(),
+                       (uint64_t)_node_table.end() - (uint64_t)_node_table.begin() });
+    ranges.push_back({ _edge_table.begin(),
+                       (uint64_t)_edge_table.end() - (uint64_t)_edge_table.begin() });
+    void **pos_begin = edge_positions((const Edge *)_edge_table.begin());
+    ranges.push_back({ pos_begin,
+                       (uint64_t)edge_positions((const Edge *)_edge_table.end())
+                           - (uint64_t)pos_begin });
+    ranges.push_back({ (void *)info->allocator_info.addr,
+                       (uint64_t)info->allocator_hdr.chunks_hdr.tail_ptr
+                           - info->allocator_info.addr });
+    return ranges;
+}
+
+GraphImpl::Warmer::Warmer(GraphImpl *db, int options)
+    : _stop(false)
+{
+    if (options & Graph::Prefetch) {
+        // Issue all the read-ahead requests up front so the kernel
+        // can service them in parallel.
+        for (auto &r : db->used_ranges(true))
+            os::prefetch(r.first, r.second);
+    }
+
+    if (options & Graph::WarmUp)
+        _thread = std::thread(&Warmer::run, this, db);
+}
+
+GraphImpl::Warmer::~Warmer()
+{
+    if (_thread.joinable()) {
+        _stop = true;
+        _thread.join();
+    }
+}
+
+bool GraphImpl::Warmer::touch(const void *addr, size_t len)
+{
+    const volatile char *p = (const volatile char *)addr;
+    for (size_t i = 0; i < len; i += SIZE_4KB) {
+        if (_stop)
+            return false;
+        (void)p[i];
+    }
+    return true;
+}
+
+void GraphImpl::Warmer::run(GraphImpl *db)
+{
+    GraphInfo *info = db->_init.info;
+
+    // Index structures first, since every lookup starts there.
+    if (!touch((void *)info->indexmanager_info.addr, info->indexmanager_info.len))
+        return;
+    if (!touch((void *)info->stringtable_info.addr, info->stringtable_info.len))
+        return;
+
+    try {
+        TransactionImpl tx(db, Transaction::ReadOnly);
+        db->index_manager().prefetch(INDEX_LEVELS);
+    }
+    catch (Exception &) {
+        // Lock contention with the application; not worth waiting for.
+    }
+
+    for (auto &r : db->used_ranges(false))
+        if (!touch(r.first, r.second))
+            return;
+}
+
+// Write the dirty page map of a copy at a new backup point: the
+// header alone, with the bitmaps left as a hole.
+static void write_clean_map(const std::string &file_name,
+                            const DirtyPageMap::Header &hdr, uint64_t len)
+{
+    FILE *f = fopen(file_name.c_str(), "wb");
+    if (f == NULL)
+        throw PMGDException(OpenFailed, errno, file_name);
+    bool ok = fwrite(&hdr, sizeof hdr, 1, f) == 1
+                && fseeko(f, len - 1, SEEK_SET) == 0
+                && fputc(0, f) != EOF;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok)
+        throw PMGDException(OpenFailed, errno, file_name + " (write)");
+}
+
+// Write the pages recorded by tracker from the mapped graph into
+// the copy at dest_name.
+template <size_t N>
+static void copy_pages(const PageTracker &tracker, const char *dest_name,
+                       const RegionInfo *(&regions)[N])
+{
+    std::string dir = std::string(dest_name) + "/";
+    std::map<std::string, FILE *> files;
+    try {
+        tracker.for_each([&](uint64_t addr) {
+            uint64_t file_offset;
+            const char *name = locate_page(regions, addr, file_offset);
+            if (name == NULL)
+                return;
+            FILE *&f = files[name];
+            if (f == NULL && (f = fopen((dir + name).c_str(), "r+b")) == NULL)
+                throw PMGDException(OpenFailed, errno, dir + name);
+            if (fseeko(f, file_offset, SEEK_SET) != 0
+                    || fwrite((void *)addr, DirtyPageMap::PAGE_BYTES, 1, f) != 1)
+                throw PMGDException(OpenFailed, errno, dir + name + " (write)");
+        });
+    }
+    catch (...) {
+        for (auto &i : files)
+            if (i.second != NULL)
+                fclose(i.second);
+        throw;
+    }
+
+    std::string failed;
+    for (auto &i : files) {
+        if (fclose(i.second) != 0 && failed.empty())
+            failed = dir + i.first + " (close)";
+    }
+    if (!failed.empty())
+        throw PMGDException(OpenFailed, failed);
+}
+
+PageTracker *GraphImpl::track_pages()
+{
+    const GraphInfo *info = _init.info;
+    uint64_t span = info->allocator_info.addr + info->allocator_info.len
+                        - GraphConfig::BASE_ADDRESS;
+    PageTracker *tracker;
+    _transaction_manager.quiesce();
+    try {
+        tracker = new PageTracker(GraphConfig::BASE_ADDRESS, span,
+                                  info->journal_info.addr,
+                                  info->journal_info.addr + info->journal_info.len);
+    }
+    catch (...) {
+        _transaction_manager.resume();
+        throw;
+    }
+    _transaction_manager.resume();
+    return tracker;
+}
+
+void GraphImpl::snapshot(const char *dest_name)
+{
+    // Waiting for writers to drain from inside a read-write
+    // transaction would never finish.
+    if (TransactionImpl::in_read_write_tx())
+        throw PMGDException(NotImplemented);
+
+    const GraphInfo *info = _init.info;
+    const RegionInfo *regions[] = {
+        &info->transaction_info, &info->journal_info,
+        &info->indexmanager_info, &info->stringtable_info,
+        &info->node_info, &info->edge_info, &info->edgepos_info,
+        &info->allocator_info };
+
+    if (_init.params.read_only) {
+        os::copy_region(_name.c_str(), dest_name, info_name);
+        for (const RegionInfo *r : regions)
+            os::copy_region(_name.c_str(), dest_name, r->name);
+        if (info->dirtymap_info.name[0] != '\0')
+            os::copy_region(_name.c_str(), dest_name, info->dirtymap_info.name);
+        return;
+    }
+
+    // Writers go on while the region files are copied. The pages they
+    // write meanwhile are tracked and written into the copy again once
+    // the writers are held back, so writers wait only for those pages.
+    std::unique_ptr<PageTracker> tracker(track_pages());
+
+    os::copy_region(_name.c_str(), dest_name, info_name);
+    for (const RegionInfo *r : regions)
+        os::copy_region(_name.c_str(), dest_name, r->name);
+
+    _transaction_manager.quiesce();
+    try {
+        tracker->stop();
+        copy_pages(*tracker, dest_name, regions);
+
+        // The copy is the new backup point for later deltas. Its map
+        // starts out clean, and the live one is reset only once the
+        // copy is complete, so a failed snapshot loses no dirty pages.
+        DirtyPageMap *map = _dirtymap_region.map();
+        if (map != NULL) {
+            const RegionInfo &r = info->dirtymap_info;
+            DirtyPageMap::Header hdr = { map->epoch() + 1, map->num_pages() };
+            write_clean_map(std::string(dest_name) + "/" + r.name, hdr, r.len);
+            map->reset(hdr.epoch, _init.params.msync_needed,
+                       *_init.params.pending_commits);
+        }
+    }
+    catch (...) {
+        _transaction_manager.resume();
+        throw;
+    }
+    _transaction_manager.resume();
+}
+
 namespace PMGD {
     template <typename B, typename T>
     class Graph_Iterator : public B {
@@ -366,6 +1301,36 @@ namespace PMGD {
         operator bool() const { return _iter && *_iter; }
         bool next() { return _iter->next(); }
     };
+
+    // Passes on the objects of an index iterator whose table slots are
+    // in a sorted list, looking only at the slots of the others
+    class SlotFilter_IteratorImpl : public Index::Index_IteratorImplIntf {
+        Index::Index_IteratorImplIntf *_iter;
+        std::vector<uint64_t> _slots;
+
+        void find()
+        {
+            while (*_iter && !std::binary_search(_slots.begin(), _slots.end(),
+                                                 _iter->slot()))
+                _iter->next();
+        }
+
+    public:
+        SlotFilter_IteratorImpl(Index::Index_IteratorImplIntf *iter,
+                                std::vector<uint64_t> &&slots)
+            : _iter(iter), _slots(std::move(slots))
+            { find(); }
+        ~SlotFilter_IteratorImpl() { delete _iter; }
+        void *ref() const { return _iter->ref(); }
+        uint64_t slot() const { return _iter->slot(); }
+        operator bool() const { return bool(*_iter); }
+        bool next()
+        {
+            _iter->next();
+            find();
+            return bool(*_iter);
+        }
+    };
 };
 
 template <typename B, typename T>
@@ -413,7 +1378,7 @@ NodeIterator Graph::get_nodes()
     TransactionImpl *tx = TransactionImpl::get_tx();
     GraphImpl::NodeTable &ntable = _impl->node_table();
     tx->acquire_lock(TransactionImpl::NodeLock, &ntable, false);
-    return NodeIterator(new Graph_NodeIteratorImpl(ntable));
+    return hide_removing(NodeIterator(new Graph_NodeIteratorImpl(ntable)));
 }
 
 NodeIterator Graph::get_nodes(StringID tag)
@@ -421,27 +1386,184 @@ NodeIterator Graph::get_nodes(StringID tag)
     if (tag.id() == 0)
         return get_nodes();
     else
-        return NodeIterator(new Index_NodeIteratorImpl(_impl->index_manager().get_iterator(NodeIndex, tag)));
+        return hide_removing(NodeIterator(new Index_NodeIteratorImpl(_impl->index_manager().get_iterator(NodeIndex, tag))));
 }
 
-NodeIterator Graph::get_nodes(StringID tag, const PropertyPredicate &pp, bool reverse)
+// Steps over the first offset objects
+template <typename I>
+static I skip(I i, size_t offset)
+{
+    while (offset-- > 0 && i)
+        i.next();
+    return i;
+}
+
+// The index finds the start when it does not have to leave out nodes
+// that remove_partial has started on.
+NodeIterator Graph::get_nodes(StringID tag, const PropertyPredicate &pp, bool reverse,
+                              size_t offset)
 {
     if (pp.id == 0)
-        return get_nodes(tag);
+        return skip(get_nodes(tag), offset);
     Index *index = _impl->index_manager().get_index(NodeIndex, tag, pp.id);
-    if (index)
-        return NodeIterator(new Index_NodeIteratorImpl(index->get_iterator(NodeIndex, pp, &_impl->locale(), reverse)));
+    if (index && index->supports(pp.op, _impl->locale())) {
+        if (_impl->num_removing() == 0)
+            return NodeIterator(new Index_NodeIteratorImpl(index->get_iterator(NodeIndex, pp, &_impl->locale(), reverse, offset)));
+        return skip(hide_removing(NodeIterator(new Index_NodeIteratorImpl(index->get_iterator(NodeIndex, pp, &_impl->locale(), reverse)))), offset);
+    }
     else
-        return get_nodes(tag).filter(pp); // TODO Causes re-lookup of tag
+        return skip(get_nodes(tag).filter(pp), offset); // TODO Causes re-lookup of tag
+}
+
+size_t Graph::count_nodes(StringID tag, const PropertyPredicate &pp)
+{
+    Index *index = pp.id == 0 ? NULL : _impl->index_manager().get_index(NodeIndex, tag, pp.id);
+    if (index && index->counted() && index->supports(pp.op, _impl->locale())
+            && _impl->num_removing() == 0)
+        return index->count(pp, &_impl->locale());
+    size_t count = 0;
+    for (NodeIterator i = get_nodes(tag, pp); i; i.next())
+        count++;
+    return count;
+}
+
+// The index for the property of pp, if it can serve pp
+static Index *single_index(GraphImpl *impl, Graph::IndexType index_type,
+                           StringID tag, const PropertyPredicate &pp)
+{
+    if (pp.id == 0)
+        return NULL;
+    Index *index = impl->index_manager().get_index(index_type, tag, pp.id);
+    if (index == NULL || !index->supports(pp.op, impl->locale()))
+        return NULL;
+    return index;
+}
+
+// A composite index is used if it serves more than one of the
+// predicates, or there is no index for the first one. Otherwise the
+// first predicate picks the index as it does on its own.
+static CompositeIndex *pick_composite(GraphImpl *impl, Graph::IndexType index_type,
+                                      StringID tag,
+                                      const std::vector<PropertyPredicate> &preds,
+                                      std::vector<const PropertyPredicate *> &served)
+{
+    IndexManager &index_manager = impl->index_manager();
+    CompositeIndex *index = index_manager.get_composite(index_type, tag, preds, served);
+    if (index != NULL && served.size() == 1
+            && single_index(impl, index_type, tag, preds[0]) != NULL)
+        index = NULL;
+    if (index == NULL)
+        served.assign(1, &preds[0]);
+    return index;
+}
+
+// The slots of the objects that an index iterator gives, sorted
+static std::vector<uint64_t> slots_of(Index::Index_IteratorImplIntf *iter)
+{
+    std::vector<uint64_t> slots;
+    for (; *iter; iter->next())
+        slots.push_back(iter->slot());
+    delete iter;
+    std::sort(slots.begin(), slots.end());
+    return slots;
+}
+
+// The iterator for the predicates that indexes serve, or NULL if
+// none does. The composite index, or else the index for the first
+// predicate that has one, gives the order. The other predicates with
+// an index each contribute the sorted slots of what they select; the
+// iterator passes on only the objects in all of them, so no object is
+// read for those predicates.
+static Index::Index_IteratorImplIntf *index_iterator(GraphImpl *impl,
+                                Graph::IndexType index_type, StringID tag,
+                                const std::vector<PropertyPredicate> &preds,
+                                bool reverse,
+                                std::vector<const PropertyPredicate *> &served)
+{
+    Index::Index_IteratorImplIntf *iter = NULL;
+    CompositeIndex *composite = pick_composite(impl, index_type, tag, preds, served);
+    if (composite != NULL)
+        iter = composite->get_iterator(index_type, served, impl->locale(), reverse);
+    else {
+        for (const PropertyPredicate &pp : preds) {
+            Index *index = single_index(impl, index_type, tag, pp);
+            if (index != NULL) {
+                iter = index->get_iterator(index_type, pp, &impl->locale(), reverse);
+                served.assign(1, &pp);
+                break;
+            }
+        }
+        if (iter == NULL)
+            return NULL;
+    }
+
+    std::vector<uint64_t> slots;
+    bool narrowed = false;
+    for (const PropertyPredicate &pp : preds) {
+        if (std::find(served.begin(), served.end(), &pp) != served.end())
+            continue;
+        Index *index = single_index(impl, index_type, tag, pp);
+        if (index == NULL)
+            continue;
+        std::vector<uint64_t> more = slots_of(
+                index->get_iterator(index_type, pp, &impl->locale(), false));
+        if (narrowed) {
+            std::vector<uint64_t> both;
+            std::set_intersection(slots.begin(), slots.end(),
+                                  more.begin(), more.end(),
+                                  std::back_inserter(both));
+            slots.swap(both);
+        }
+        else
+            slots.swap(more);
+        narrowed = true;
+        served.push_back(&pp);
+    }
+    if (!narrowed)
+        return iter;
+    return new SlotFilter_IteratorImpl(iter, std::move(slots));
+}
+
+// Checks the predicates that the index did not serve
+template <typename Ref>
+static std::function<Disposition(const Ref &)> check_rest(
+        const std::vector<PropertyPredicate> &preds,
+        const std::vector<const PropertyPredicate *> &served)
+{
+    std::vector<PropertyFilter<Ref>> filters;
+    for (const PropertyPredicate &pp : preds)
+        if (std::find(served.begin(), served.end(), &pp) == served.end())
+            filters.push_back(PropertyFilter<Ref>(pp));
+    return [filters](const Ref &r) mutable {
+        for (auto &pf : filters)
+            if (pf(r) == DontPass)
+                return DontPass;
+        return Pass;
+    };
+}
+
+NodeIterator Graph::get_nodes(StringID tag, const std::vector<PropertyPredicate> &preds,
+                              bool reverse)
+{
+    if (preds.empty())
+        return get_nodes(tag);
+    std::vector<const PropertyPredicate *> served;
+    Index::Index_IteratorImplIntf *iter = index_iterator(_impl, NodeIndex, tag, preds,
+                                                         reverse, served);
+    NodeIterator i(iter != NULL
+        ? hide_removing(NodeIterator(new Index_NodeIteratorImpl(iter)))
+        : get_nodes(tag, preds[0], reverse));
+    if (served.size() == preds.size())
+        return i;
+    return i.filter(check_rest<NodeRef>(preds, served));
 }
 
 
 EdgeIterator Graph::get_edges()
 {
-    TransactionImpl *tx = TransactionImpl::get_tx();
     GraphImpl::EdgeTable &etable = _impl->edge_table();
-    tx->acquire_lock(TransactionImpl::EdgeLock, &etable, false);
-    return EdgeIterator(new Graph_EdgeIteratorImpl(etable));
+    _impl->lock_table(EdgeIndex);
+    return hide_removing(EdgeIterator(new Graph_EdgeIteratorImpl(etable)));
 }
 
 EdgeIterator Graph::get_edges(StringID tag)
@@ -449,18 +1571,69 @@ EdgeIterator Graph::get_edges(StringID tag)
     if (tag.id() == 0)
         return get_edges();
     else
-        return EdgeIterator(new Index_EdgeIteratorImpl(_impl->index_manager().get_iterator(EdgeIndex, tag)));
+        return hide_removing(EdgeIterator(new Index_EdgeIteratorImpl(_impl->index_manager().get_iterator(EdgeIndex, tag))));
 }
 
-EdgeIterator Graph::get_edges(StringID tag, const PropertyPredicate &pp, bool reverse)
+EdgeIterator Graph::get_edges(StringID tag, const PropertyPredicate &pp, bool reverse,
+                              size_t offset)
 {
     if (pp.id == 0)
-        return get_edges(tag);
+        return skip(get_edges(tag), offset);
     Index *index = _impl->index_manager().get_index(EdgeIndex, tag, pp.id);
-    if (index)
-        return EdgeIterator(new Index_EdgeIteratorImpl(index->get_iterator(EdgeIndex, pp, &_impl->locale(), reverse)));
+    if (index && index->supports(pp.op, _impl->locale())) {
+        if (_impl->num_removing() == 0)
+            return EdgeIterator(new Index_EdgeIteratorImpl(index->get_iterator(EdgeIndex, pp, &_impl->locale(), reverse, offset)));
+        return skip(hide_removing(EdgeIterator(new Index_EdgeIteratorImpl(index->get_iterator(EdgeIndex, pp, &_impl->locale(), reverse)))), offset);
+    }
     else
-        return get_edges(tag).filter(pp); // TODO Causes re-lookup of tag
+        return skip(get_edges(tag).filter(pp), offset); // TODO Causes re-lookup of tag
+}
+
+size_t Graph::count_edges(StringID tag, const PropertyPredicate &pp)
+{
+    Index *index = pp.id == 0 ? NULL : _impl->index_manager().get_index(EdgeIndex, tag, pp.id);
+    if (index && index->counted() && index->supports(pp.op, _impl->locale())
+            && _impl->num_removing() == 0)
+        return index->count(pp, &_impl->locale());
+    size_t count = 0;
+    for (EdgeIterator i = get_edges(tag, pp); i; i.next())
+        count++;
+    return count;
+}
+
+EdgeIterator Graph::get_edges(StringID tag, const std::vector<PropertyPredicate> &preds,
+                              bool reverse)
+{
+    if (preds.empty())
+        return get_edges(tag);
+    std::vector<const PropertyPredicate *> served;
+    Index::Index_IteratorImplIntf *iter = index_iterator(_impl, EdgeIndex, tag, preds,
+                                                         reverse, served);
+    EdgeIterator i(iter != NULL
+        ? hide_removing(EdgeIterator(new Index_EdgeIteratorImpl(iter)))
+        : get_edges(tag, preds[0], reverse));
+    if (served.size() == preds.size())
+        return i;
+    return i.filter(check_rest<EdgeRef>(preds, served));
+}
+
+// Nodes that remove_partial has started on, and their edges, are left
+// out. See Node::hide_removing.
+NodeIterator Graph::hide_removing(NodeIterator i)
+{
+    if (!i || _impl->num_removing() == 0)
+        return i;
+    return i.filter([](const Node &n) { return n._removing ? DontPass : Pass; });
+}
+
+EdgeIterator Graph::hide_removing(EdgeIterator i)
+{
+    if (!i || _impl->num_removing() == 0)
+        return i;
+    return i.filter([](const EdgeRef &e) {
+        return e.get_source()._removing || e.get_destination()._removing
+                   ? DontPass : Pass;
+    });
 }
 
 NodeID Graph::get_id(const Node &node) const
@@ -32,6 +32,8 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 #include <signal.h>
 #include <errno.h>
 #include <list>
@@ -126,6 +128,14 @@ static const unsigned PAGE_SIZE = 4096;
 static const unsigned PAGE_OFFSET = PAGE_SIZE - 1;
 static const uint64_t PAGE_MASK = ~uint64_t(PAGE_OFFSET);
 
+void PMGD::os::prefetch(const void *addr, size_t len)
+{
+    uint64_t start = (uint64_t)addr & PAGE_MASK;
+    uint64_t end = (uint64_t)addr + len;
+    if (end > start)
+        madvise((void *)start, end - start, MADV_WILLNEED);
+}
+
 void PMGD::os::flush(void *addr, RangeSet &pending_commits)
 {
     uint64_t aligned_addr = (uint64_t)addr & PAGE_MASK;
@@ -139,6 +149,90 @@ void PMGD::os::commit(RangeSet &pending_commits)
     pending_commits.clear();
 }
 
+bool PMGD::os::copy_region(const char *db_name, const char *dest_name,
+                           const char *region_name)
+{
+    std::string src_name = std::string(db_name) + "/" + region_name;
+    std::string dst_name = std::string(dest_name) + "/" + region_name;
+
+    mkdir(dest_name, 0777);
+
+    int src = open(src_name.c_str(), O_RDONLY);
+    if (src < 0)
+        throw PMGDException(OpenFailed, errno, src_name + " (open)");
+    int dst = open(dst_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (dst < 0) {
+        int err = errno;
+        close(src);
+        throw PMGDException(OpenFailed, err, dst_name + " (open)");
+    }
+
+    struct stat sb;
+    bool reflinked = false;
+    std::string failed;
+    int err = 0;
+
+    if (fstat(src, &sb) < 0) {
+        err = errno;
+        failed = src_name + " (fstat)";
+        goto out;
+    }
+
+    if (ioctl(dst, FICLONE, src) == 0) {
+        reflinked = true;
+        goto out;
+    }
+
+    // The regions are large sparse files, so copy only the
+    // extents that hold data.
+    if (ftruncate(dst, sb.st_size) < 0) {
+        err = errno;
+        failed = dst_name + " (ftruncate)";
+        goto out;
+    }
+
+    {
+        static const size_t BUF_SIZE = 1 << 20;
+        std::string buf(BUF_SIZE, '\0');
+        off_t off = 0;
+        while (off < sb.st_size) {
+            off_t data = lseek(src, off, SEEK_DATA);
+            if (data < 0)
+                break;  // No more data (ENXIO)
+            off_t hole = lseek(src, data, SEEK_HOLE);
+            if (hole < 0)
+                hole = sb.st_size;
+            for (off = data; off < hole; ) {
+                size_t len = hole - off < off_t(BUF_SIZE) ? hole - off : BUF_SIZE;
+                ssize_t n = pread(src, &buf[0], len, off);
+                if (n <= 0 || pwrite(dst, &buf[0], n, off) != n) {
+                    err = n < 0 ? errno : EIO;
+                    failed = dst_name + " (copy)";
+                    goto out;
+                }
+                off += n;
+            }
+        }
+    }
+
+    if (fsync(dst) < 0) {
+        err = errno;
+        failed = dst_name + " (fsync)";
+    }
+
+out:
+    close(src);
+    close(dst);
+    if (!failed.empty())
+        throw PMGDException(OpenFailed, err, failed);
+    return reflinked;
+}
+
+bool PMGD::os::sync_file(FILE *f)
+{
+    return fflush(f) == 0 && fsync(fileno(f)) == 0;
+}
+
 // Linux delivers SIGBUS when an attempted access to a memory-mapped
 // file cannot be satisfied, either because the access is beyond the
 // end of the file or because there is no space left on the device.
@@ -203,6 +203,13 @@ namespace PMGD {
         // of an object does the caller wish to cover with one lock.
         const uint64_t _shift;
 
+        // Highest commit sequence number of a transaction that released
+        // a write lock in each group of stripes before its commit record
+        // was durable. Sharing an entry only makes a later transaction
+        // wait for one it did not depend on.
+        static const unsigned RELEASE_GROUP_SHIFT = 6;
+        std::vector<uint64_t> _release_seqs;
+
         static unsigned floor_log2(unsigned long long n)
             { return n <= 1 ? 0 : floor_log2(n/2) + 1; }
 
@@ -212,7 +219,8 @@ namespace PMGD {
         StripedLock(const size_t tot_bytes, const unsigned stripe_width)
             : _locks(tot_bytes / sizeof(RWLock)),
               _maskbits(_locks.size() - 1),
-              _shift(ceiling_log2(stripe_width))
+              _shift(ceiling_log2(stripe_width)),
+              _release_seqs((_locks.size() >> RELEASE_GROUP_SHIFT) + 1)
         {
             // For mask bits.
             assert(!(tot_bytes & (tot_bytes - 1)));
@@ -258,5 +266,20 @@ namespace PMGD {
 
         uint16_t reader_count(const uint64_t stripeid) const
           { return _locks[stripeid].reader_count(); }
+
+        // Read after taking the lock, set before releasing it.
+        uint64_t release_seq(const uint64_t stripeid) const
+        {
+            return *static_cast<const volatile uint64_t *>(
+                        &_release_seqs[stripeid >> RELEASE_GROUP_SHIFT]);
+        }
+
+        void set_release_seq(const uint64_t stripeid, uint64_t seq)
+        {
+            volatile uint64_t &s = _release_seqs[stripeid >> RELEASE_GROUP_SHIFT];
+            uint64_t old;
+            while ((old = s) < seq && !cmpxchg<uint64_t>(s, old, seq))
+                ;
+        }
     };
 }
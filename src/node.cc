@@ -28,7 +28,10 @@
  */
 
 #include <stddef.h>
+#include <limits.h>
 #include <string.h> // for memcpy
+#include <vector>
+#include <algorithm>
 #include "exception.h"
 #include "iterator.h"
 #include "property.h"
@@ -38,21 +41,45 @@
 #include "GraphImpl.h"
 #include "IndexManager.h"
 #include "TransactionImpl.h"
+#include "filter.h"
 
 using namespace PMGD;
 
+// The edge indexes are created with the first edge in each direction,
+// since many nodes never get any.
 void Node::init(StringID tag, unsigned object_size, Allocator &index_allocator)
 {
-    _out_edges = EdgeIndex::create(index_allocator);
-    _in_edges = EdgeIndex::create(index_allocator);
+    _out_edges = NULL;
+    _in_edges = NULL;
     _tag = tag;
+    _removing = false;
     _property_list.init(object_size - offsetof(Node, _property_list));
 }
 
 void Node::cleanup(Allocator &index_allocator)
 {
-    EdgeIndex::free(_out_edges, index_allocator);
-    EdgeIndex::free(_in_edges, index_allocator);
+    if (_out_edges != NULL)
+        EdgeIndex::free(_out_edges, index_allocator);
+    if (_in_edges != NULL)
+        EdgeIndex::free(_in_edges, index_allocator);
+}
+
+static size_t num_elems(EdgeIndex *idx)
+{
+    return idx == NULL ? 0 : idx->num_elems();
+}
+
+EdgeIndex *Node::edge_index(Direction dir, Allocator &index_allocator)
+{
+    EdgeIndex *&idx = (dir == Outgoing) ? _out_edges : _in_edges;
+    if (idx == NULL) {
+        TransactionImpl *tx = TransactionImpl::get_tx();
+        EdgeIndex *new_idx = EdgeIndex::create(index_allocator);
+        // New allocation, so flush without logging.
+        tx->flush_range(new_idx, sizeof *new_idx);
+        tx->write(&idx, new_idx);
+    }
+    return idx;
 }
 
 NodeID Node::get_id() const
@@ -61,39 +88,116 @@ NodeID Node::get_id() const
     return TransactionImpl::get_tx()->get_db()->node_table().get_id(this);
 }
 
-void Node::add_edge(Edge *edge, Direction dir, StringID tag, Allocator &index_allocator)
+void *Node::add_edge(Edge *edge, Node *other, Direction dir, StringID tag,
+                     Allocator &index_allocator)
 {
+    TransactionImpl *tx = TransactionImpl::get_tx();
+
+    // A busy tag bucket takes the edge into a segment of its own for
+    // this transaction, so concurrent adds to a hub node only need
+    // the node read locked. Not worth it if this transaction has the
+    // node write locked already.
+    if (tx->acquire_lock(TransactionImpl::NodeLock, this, false)
+            != TransactionImpl::WriteLock) {
+        EdgeIndex *idx = (dir == Outgoing) ? _out_edges : _in_edges;
+        void *pos;
+        if (idx != NULL && (pos = idx->append(tag, edge, other, index_allocator)) != NULL)
+            return pos;
+    }
+
     // Upgrade the reader lock to writer.
     TransactionImpl::lock_node(this, true);
-    if (dir == Outgoing)
-        _out_edges->add(tag, edge, &edge->get_destination(), index_allocator);
-    else
-        _in_edges->add(tag, edge, &edge->get_source(), index_allocator);
+    return edge_index(dir, index_allocator)->add(tag, edge, other, index_allocator);
 }
 
-void Node::remove_edge(Edge *edge, Direction dir, Allocator &index_allocator)
+// All the edges have this node at the dir end and the same tag
+void Node::add_edges(Edge *const *edges, size_t count, Direction dir,
+                     StringID tag, void **pos, Allocator &index_allocator)
+{
+    TransactionImpl::lock_node(this, true);
+    std::vector<EdgeIndex::EdgeNodePair> pairs;
+    pairs.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        Node *other = (dir == Outgoing) ? &edges[i]->get_destination()
+                                        : &edges[i]->get_source();
+        pairs.push_back(EdgeIndex::EdgeNodePair(edges[i], other));
+    }
+    edge_index(dir, index_allocator)->add(tag, pairs.data(), count, pos, index_allocator);
+}
+
+void Node::remove_edge(Edge *edge, Direction dir, void *pos, Allocator &index_allocator)
 {
     TransactionImpl::lock_node(this, true);
     if (dir == Outgoing)
-        _out_edges->remove(edge->get_tag(), edge, index_allocator);
+        _out_edges->remove(edge->get_tag(), edge, index_allocator, pos);
     else
-        _in_edges->remove(edge->get_tag(), edge, index_allocator);
+        _in_edges->remove(edge->get_tag(), edge, index_allocator, pos);
+}
+
+// All the edges have this node at the dir end and the same tag
+void Node::remove_edges(Edge *const *edges, void *const *pos, size_t count,
+                        Direction dir, StringID tag, Allocator &index_allocator)
+{
+    TransactionImpl::lock_node(this, true);
+    EdgeIndex *idx = (dir == Outgoing) ? _out_edges : _in_edges;
+    idx->remove(tag, edges, pos, count, index_allocator);
+}
+
+void Node::remove_light_edge(Node *other, Direction dir, StringID tag,
+                             Allocator &index_allocator)
+{
+    TransactionImpl::lock_node(this, true);
+    EdgeIndex *idx = (dir == Outgoing) ? _out_edges : _in_edges;
+    if (idx != NULL)
+        idx->remove_light(tag, other, index_allocator);
+}
+
+// The edge is in this node's index already, so the index exists.
+void Node::add_ordered_edge(Edge *edge, Direction dir, long long key,
+                            Allocator &index_allocator)
+{
+    TransactionImpl::lock_node(this, true);
+    EdgeIndex *idx = (dir == Outgoing) ? _out_edges : _in_edges;
+    idx->add_ordered(edge->get_tag(), key, edge, index_allocator);
+}
+
+void Node::remove_ordered_edge(Edge *edge, Direction dir, long long key,
+                               Allocator &index_allocator)
+{
+    TransactionImpl::lock_node(this, true);
+    EdgeIndex *idx = (dir == Outgoing) ? _out_edges : _in_edges;
+    if (idx != NULL)
+        idx->remove_ordered(edge->get_tag(), key, edge, index_allocator);
 }
 
 Node &Node::get_neighbor(Direction dir, StringID edge_tag) const
 {
-    if (dir == Outgoing || dir == Any) {
-        const EdgeIndex::EdgePosition *pos = _out_edges->get_first(edge_tag);
+    // The first edge may lead to a node being removed.
+    if (!_removing && TransactionImpl::get_tx()->get_db()->num_removing() > 0) {
+        if (dir == Outgoing || dir == Any) {
+            EdgeIterator i = get_edges(Outgoing, edge_tag);
+            if (i)
+                return i->get_destination();
+        }
+        if (dir == Incoming || dir == Any) {
+            EdgeIterator i = get_edges(Incoming, edge_tag);
+            if (i)
+                return i->get_source();
+        }
+        throw PMGDException(NullIterator);
+    }
+    if ((dir == Outgoing || dir == Any) && _out_edges != NULL) {
+        EdgeIndex::EdgePosition pos = _out_edges->get_first(edge_tag);
         if (pos) {
-            Node *n = pos->value.value();
+            Node *n = pos.node();
             TransactionImpl::lock_node(n, false);
             return *n;
         }
     }
-    if (dir == Incoming || dir == Any) {
-        const EdgeIndex::EdgePosition *pos = _in_edges->get_first(edge_tag);
+    if ((dir == Incoming || dir == Any) && _in_edges != NULL) {
+        EdgeIndex::EdgePosition pos = _in_edges->get_first(edge_tag);
         if (pos) {
-            Node *n = pos->value.value();
+            Node *n = pos.node();
             TransactionImpl::lock_node(n, false);
             return *n;
         }
@@ -117,17 +221,17 @@ namespace PMGD {
         // No tag given if _key_pos != NULL
         EdgeIndex::KeyPosition *_key_pos;
         StringID _tag;
-        const EdgeIndex::EdgePosition *_pos;
+        EdgeIndex::EdgePosition _pos;
         bool _vacant_flag = false;
         TransactionImpl *_tx;
 
         friend class EdgeRef;
-        Edge *get_edge() const { return _pos->value.key(); }
+        Edge *get_edge() const { return _pos.edge(); }
         StringID get_tag() const { return _tag; }
-        Node &get_source() const { return ((_dir == Incoming) ? *_pos->value.value() : *_n1); }
-        Node &get_destination() const { return ((_dir == Outgoing) ? *_pos->value.value() : *_n1); }
+        Node &get_source() const { return ((_dir == Incoming) ? *_pos.node() : *_n1); }
+        Node &get_destination() const { return ((_dir == Outgoing) ? *_pos.node() : *_n1); }
 
-        // When _pos is NULL, move to next key or direction
+        // When _pos is at the end, move to next key or direction
         void _next()
         {
             if (_key_pos != NULL) {
@@ -170,7 +274,7 @@ namespace PMGD {
                               EdgeIndex *out_idx,
                               const EdgeIndex::KeyPosition *key_pos,
                               StringID tag,
-                              const EdgeIndex::EdgePosition *pos)
+                              EdgeIndex::EdgePosition pos)
             : _ref(this),
               _n1(const_cast<Node *>(n)),
               _dir(dir),
@@ -206,19 +310,19 @@ namespace PMGD {
         // Always starts with incoming first
         Node_EdgeIteratorImpl(EdgeIndex *idx, EdgeIndex *out_idx, const Node *n, StringID tag)
             : Node_EdgeIteratorImpl(n, Incoming,
-                                    out_idx->num_elems() > 0 ? out_idx : NULL,
+                                    num_elems(out_idx) > 0 ? out_idx : NULL,
                                     NULL, tag, idx->get_first(tag))
         {
-            if (_pos == NULL)
+            if (!_pos)
                 _next();
         }
 
         Node_EdgeIteratorImpl(EdgeIndex *idx, EdgeIndex *out_idx, const Node *n)
             : Node_EdgeIteratorImpl(n, Incoming,
-                                    out_idx->num_elems() > 0 ? out_idx : NULL,
+                                    num_elems(out_idx) > 0 ? out_idx : NULL,
                                     idx->get_first())
         {
-            if (_pos == NULL)
+            if (!_pos)
                 _next();
         }
 
@@ -228,7 +332,7 @@ namespace PMGD {
                 _tx->iterator_callbacks().unregister_iterator(this);
         }
 
-        operator bool() const { return _vacant_flag || _pos != NULL; }
+        operator bool() const { return _vacant_flag || _pos; }
 
         EdgeRef *ref()
         {
@@ -247,16 +351,16 @@ namespace PMGD {
                 _vacant_flag = false;
                 return operator bool();
             }
-            if (_pos != NULL)
-                _pos = _pos->next;
-            if (_pos == NULL)
+            if (_pos)
+                _pos.next();
+            if (!_pos)
                 _next();
-            return _pos != NULL;
+            return _pos;
         }
 
         void remove_notify(void *list_node)
         {
-            if (list_node == _pos) {
+            if (_pos && list_node == _pos.pair()) {
                 // Clear _vacant_flag to ensure that next actually advances
                 // the iterator, and then set _vacant_flag to indicate that
                 // the current edge has been deleted.
@@ -275,7 +379,9 @@ EdgeIterator Node::get_edges(Direction dir, StringID tag) const
     if (tag == 0)
         return get_edges(dir);
     EdgeIndex *idx = (dir == Outgoing) ? _out_edges : _in_edges;
-    return EdgeIterator(new Node_EdgeIteratorImpl(idx, this, dir, tag));
+    if (idx == NULL)
+        return EdgeIterator(NULL);
+    return hide_removing(EdgeIterator(new Node_EdgeIteratorImpl(idx, this, dir, tag)));
 }
 
 EdgeIterator Node::get_edges(Direction dir) const
@@ -287,17 +393,17 @@ EdgeIterator Node::get_edges(Direction dir) const
     // the constructors to not crash. Not needed when you pass
     // tag value because that takes care of returning NULL at the
     // right point
-    if (idx->num_elems() <= 0)
+    if (num_elems(idx) <= 0)
         return EdgeIterator(NULL);
-    return EdgeIterator(new Node_EdgeIteratorImpl(idx, this, dir));
+    return hide_removing(EdgeIterator(new Node_EdgeIteratorImpl(idx, this, dir)));
 }
 
 EdgeIterator Node::get_edges(StringID tag) const
 {
     if (tag == 0)
         return get_edges();
-    size_t in_elems = _in_edges->num_elems();
-    size_t out_elems = _out_edges->num_elems();
+    size_t in_elems = num_elems(_in_edges);
+    size_t out_elems = num_elems(_out_edges);
     // Ensure there is at least one element in this index for
     // the constructors to not crash. Not needed when you pass
     // tag value because that takes care of returning NULL at the
@@ -305,14 +411,16 @@ EdgeIterator Node::get_edges(StringID tag) const
     if (in_elems <= 0 && out_elems <= 0)
         return EdgeIterator(NULL);
     if (in_elems <= 0)
-        return EdgeIterator(new Node_EdgeIteratorImpl(_out_edges, this, Outgoing, tag));
-    return EdgeIterator(new Node_EdgeIteratorImpl(_in_edges, _out_edges, this, tag));
+        return hide_removing(EdgeIterator(
+                   new Node_EdgeIteratorImpl(_out_edges, this, Outgoing, tag)));
+    return hide_removing(EdgeIterator(
+               new Node_EdgeIteratorImpl(_in_edges, _out_edges, this, tag)));
 }
 
 EdgeIterator Node::get_edges() const
 {
-    size_t in_elems = _in_edges->num_elems();
-    size_t out_elems = _out_edges->num_elems();
+    size_t in_elems = num_elems(_in_edges);
+    size_t out_elems = num_elems(_out_edges);
     // Ensure there is at least one element in this index for
     // the constructors to not crash. Not needed when you pass
     // tag value because that takes care of returning NULL at the
@@ -320,8 +428,255 @@ EdgeIterator Node::get_edges() const
     if (in_elems <= 0 && out_elems <= 0)
         return EdgeIterator(NULL);
     if (in_elems <= 0)
-        return EdgeIterator(new Node_EdgeIteratorImpl(_out_edges, this, Outgoing));
-    return EdgeIterator(new Node_EdgeIteratorImpl(_in_edges, _out_edges, this));
+        return hide_removing(EdgeIterator(
+                   new Node_EdgeIteratorImpl(_out_edges, this, Outgoing)));
+    return hide_removing(EdgeIterator(
+               new Node_EdgeIteratorImpl(_in_edges, _out_edges, this)));
+}
+
+// Leaves out the edges to nodes that Graph::remove_partial has started
+// on. Starting or finishing one changes the count, which stays read
+// locked from here on, so the flags cannot change under the iterator.
+// A node being removed still lists all its own edges.
+EdgeIterator Node::hide_removing(EdgeIterator i) const
+{
+    if (!i || _removing
+            || TransactionImpl::get_tx()->get_db()->num_removing() == 0)
+        return i;
+    return i.filter([this](const EdgeRef &e) {
+        const Node &other = (e.get_source() == *this) ? e.get_destination()
+                                                      : e.get_source();
+        return other._removing ? DontPass : Pass;
+    });
+}
+
+namespace PMGD {
+    // Iterates over the edges collected for get_edges_to, the first
+    // _num_in of them incoming, or, without a neighbor, over edges
+    // collected from the ordered adjacency, which all have records.
+    // Edges removed before the iterator reaches them are dropped.
+    class Node_NeighborEdgeIteratorImpl : public EdgeIteratorImplIntf {
+        EdgeRef _ref;
+        Node *_node;
+        Node *_neighbor;
+        std::vector<EdgeIndex::EdgeSlot> _edges;
+        size_t _num_in;
+        size_t _cur = 0;
+        bool _vacant_flag = false;
+        TransactionImpl *_tx;
+
+        friend class EdgeRef;
+        Edge *get_edge() const { return _edges[_cur].edge; }
+        StringID get_tag() const { return _edges[_cur].tag; }
+        Node &get_source() const
+        {
+            if (_neighbor == NULL)
+                return _edges[_cur].edge->get_source();
+            return _cur < _num_in ? neighbor() : *_node;
+        }
+
+        Node &get_destination() const
+        {
+            if (_neighbor == NULL)
+                return _edges[_cur].edge->get_destination();
+            return _cur < _num_in ? *_node : neighbor();
+        }
+
+        Node &neighbor() const
+        {
+            TransactionImpl::lock_node(_neighbor, false);
+            return *_neighbor;
+        }
+
+    public:
+        Node_NeighborEdgeIteratorImpl(const Node *node, const Node *neighbor,
+                                      std::vector<EdgeIndex::EdgeSlot> &&edges,
+                                      size_t num_in)
+            : _ref(this), _node(const_cast<Node *>(node)),
+              _neighbor(const_cast<Node *>(neighbor)),
+              _edges(std::move(edges)), _num_in(num_in),
+              _tx(TransactionImpl::get_tx())
+        {
+            if (_tx->is_read_write()) {
+                _tx->iterator_callbacks().register_iterator(this,
+                        [this](void *list_node) { remove_notify(list_node); });
+            }
+        }
+
+        ~Node_NeighborEdgeIteratorImpl()
+        {
+            if (_tx->is_read_write())
+                _tx->iterator_callbacks().unregister_iterator(this);
+        }
+
+        operator bool() const { return _vacant_flag || _cur < _edges.size(); }
+
+        EdgeRef *ref()
+        {
+            if (_vacant_flag)
+                throw PMGDException(VacantIterator);
+            return &_ref;
+        }
+
+        bool next()
+        {
+            // If _vacant_flag is set, the next edge has already moved
+            // into the current place, so we just clear _vacant_flag.
+            if (_vacant_flag)
+                _vacant_flag = false;
+            else if (_cur < _edges.size())
+                _cur++;
+            return operator bool();
+        }
+
+        void remove_notify(void *list_node)
+        {
+            for (size_t i = _cur; i < _edges.size(); i++) {
+                if (_edges[i].pos == list_node) {
+                    _edges.erase(_edges.begin() + i);
+                    if (i < _num_in)
+                        _num_in--;
+                    if (i == _cur)
+                        _vacant_flag = true;
+                    return;
+                }
+            }
+        }
+    };
+};
+
+EdgeIterator Node::get_edges_to(const Node &neighbor, Direction dir, StringID tag) const
+{
+    if (!_removing && TransactionImpl::get_tx()->get_db()->num_removing() > 0
+            && neighbor._removing)
+        return EdgeIterator(NULL);
+    std::vector<EdgeIndex::EdgeSlot> edges;
+    if ((dir == Incoming || dir == Any) && _in_edges != NULL)
+        _in_edges->get_edges_to(tag, &neighbor, edges);
+    size_t num_in = edges.size();
+    if ((dir == Outgoing || dir == Any) && _out_edges != NULL)
+        _out_edges->get_edges_to(tag, &neighbor, edges);
+    if (edges.empty())
+        return EdgeIterator(NULL);
+    return EdgeIterator(new Node_NeighborEdgeIteratorImpl(this, &neighbor,
+                                                          std::move(edges), num_in));
+}
+
+// Sets [min, max] to the order keys that can match pp. Returns false
+// if none can.
+static bool order_range(const PropertyPredicate &pp, PropertyType ptype,
+                        long long &min, long long &max)
+{
+    min = LLONG_MIN;
+    max = LLONG_MAX;
+    if (pp.op == PropertyPredicate::DontCare)
+        return true;
+    // Order keys are numbers, which have no prefixes.
+    if (pp.op == PropertyPredicate::Prefix || pp.v1.type() != ptype
+            || (pp.op >= PropertyPredicate::GeLe && pp.v2.type() != ptype))
+        throw PMGDException(PropertyTypeMismatch);
+    long long v1 = IndexManager::order_key(pp.v1);
+    long long v2 = pp.op >= PropertyPredicate::GeLe
+                       ? IndexManager::order_key(pp.v2) : 0;
+    switch (pp.op) {
+        case PropertyPredicate::Eq: min = max = v1; break;
+        case PropertyPredicate::Ne: break;
+        case PropertyPredicate::Gt:
+            if (v1 == LLONG_MAX) return false;
+            min = v1 + 1;
+            break;
+        case PropertyPredicate::Ge: min = v1; break;
+        case PropertyPredicate::Lt:
+            if (v1 == LLONG_MIN) return false;
+            max = v1 - 1;
+            break;
+        case PropertyPredicate::Le: max = v1; break;
+        case PropertyPredicate::GeLe: min = v1; max = v2; break;
+        case PropertyPredicate::GeLt:
+            if (v2 == LLONG_MIN) return false;
+            min = v1; max = v2 - 1;
+            break;
+        case PropertyPredicate::GtLe:
+            if (v1 == LLONG_MAX) return false;
+            min = v1 + 1; max = v2;
+            break;
+        case PropertyPredicate::GtLt:
+            if (v1 == LLONG_MAX || v2 == LLONG_MIN) return false;
+            min = v1 + 1; max = v2 - 1;
+            break;
+        default: break;
+    }
+    return min <= max;
+}
+
+EdgeIterator Node::get_edges(Direction dir, StringID tag,
+                             const PropertyPredicate &pp, bool reverse) const
+{
+    const IndexManager::EdgeOrder *order = (tag == 0) ? NULL
+        : TransactionImpl::get_tx()->get_db()->index_manager().edge_order(tag);
+    if (order == NULL || !(order->property_id == pp.id)) {
+        if (reverse)
+            throw PMGDException(NotImplemented);
+        return get_edges(dir, tag).filter(pp);
+    }
+
+    long long min, max;
+    if (!order_range(pp, order->ptype, min, max))
+        return EdgeIterator(NULL);
+    std::vector<EdgeIndex::OrderedSlot> ordered;
+    if ((dir == Incoming || dir == Any) && _in_edges != NULL)
+        _in_edges->get_ordered(tag, min, max, ordered);
+    size_t mid = ordered.size();
+    if ((dir == Outgoing || dir == Any) && _out_edges != NULL)
+        _out_edges->get_ordered(tag, min, max, ordered);
+    auto by_key = [](const EdgeIndex::OrderedSlot &a, const EdgeIndex::OrderedSlot &b)
+        { return a.first < b.first; };
+    std::inplace_merge(ordered.begin(), ordered.begin() + mid, ordered.end(), by_key);
+
+    bool ne = pp.op == PropertyPredicate::Ne;
+    long long ne_key = ne ? IndexManager::order_key(pp.v1) : 0;
+    std::vector<EdgeIndex::EdgeSlot> edges;
+    edges.reserve(ordered.size());
+    for (const EdgeIndex::OrderedSlot &e : ordered)
+        if (!ne || e.first != ne_key)
+            edges.push_back(e.second);
+    if (edges.empty())
+        return EdgeIterator(NULL);
+    if (reverse)
+        std::reverse(edges.begin(), edges.end());
+    return hide_removing(EdgeIterator(
+               new Node_NeighborEdgeIteratorImpl(this, NULL, std::move(edges), 0)));
+}
+
+std::vector<Node *> Node::get_sorted_neighbors(Direction dir, StringID tag) const
+{
+    // Buckets with a neighbor tree come out sorted, as do small ones
+    // whose adds kept neighbor order; the rest get sorted here.
+    std::vector<Node *> neighbors;
+    bool sorted = true;
+    int runs = 0;
+    if ((dir == Incoming || dir == Any) && _in_edges != NULL) {
+        sorted = _in_edges->get_neighbors(tag, neighbors);
+        runs++;
+    }
+    if ((dir == Outgoing || dir == Any) && _out_edges != NULL) {
+        size_t mid = neighbors.size();
+        bool out_sorted = _out_edges->get_neighbors(tag, neighbors);
+        if (runs > 0 && sorted && out_sorted)
+            std::inplace_merge(neighbors.begin(), neighbors.begin() + mid,
+                               neighbors.end());
+        sorted = sorted && out_sorted;
+        runs++;
+    }
+    if (!sorted)
+        std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()),
+                    neighbors.end());
+    if (!_removing && TransactionImpl::get_tx()->get_db()->num_removing() > 0)
+        neighbors.erase(std::remove_if(neighbors.begin(), neighbors.end(),
+                                       [](Node *n) { return n->_removing; }),
+                        neighbors.end());
+    return neighbors;
 }
 
 bool PMGD::Node::check_property(StringID id, Property &result) const
@@ -31,6 +31,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include "RangeSet.h"
 
 namespace PMGD {
@@ -67,7 +68,20 @@ namespace PMGD {
         size_t get_default_region_size();
         size_t get_alignment(size_t size);
 
+        // Hint that a mapped range will be needed soon.
+        void prefetch(const void *addr, size_t len);
+
         void flush(void *addr, RangeSet &pending_commits);
         void commit(RangeSet &pending_commits);
+
+        // Copy one region file of a graph into another graph directory,
+        // keeping holes. Returns true if the file system could share
+        // the blocks (reflink) instead of copying them.
+        bool copy_region(const char *db_name, const char *dest_name,
+                         const char *region_name);
+
+        // Write out a stream and make its file durable. Returns false,
+        // with errno set, if either step fails.
+        bool sync_file(FILE *f);
     };
 };
@@ -0,0 +1,115 @@
+/**
+ * @file   persist.h
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "arch.h"
+#include "os.h"
+#include "RangeSet.h"
+
+namespace PMGD {
+    // How modified cache lines are made durable. The mode is chosen
+    // when a graph is opened; each one is a specialization of Persist
+    // so the flush loops are compiled once per mode.
+    enum class PersistMode { Msync, Clflush, Clflushopt, Clwb, NTStore, None };
+
+    template <PersistMode M> struct Persist;
+
+    // Memory mapped files: flush only records the page, and commit
+    // writes the recorded pages back, unless NoMsync was requested.
+    template <> struct Persist<PersistMode::Msync> {
+        static void flush(void *addr, bool msync_needed, RangeSet &pending_commits)
+        {
+            if (msync_needed)
+                os::flush(addr, pending_commits);
+        }
+
+        static void commit(bool msync_commit, RangeSet &pending_commits)
+        {
+            if (msync_commit)
+                os::commit(pending_commits);
+        }
+    };
+
+    template <> struct Persist<PersistMode::Clflush> {
+        static void flush(void *addr, bool, RangeSet &) { clflush(addr); }
+        static void commit(bool, RangeSet &) { persistent_barrier(); }
+    };
+
+    template <> struct Persist<PersistMode::Clflushopt> {
+        static void flush(void *addr, bool, RangeSet &) { clflushopt(addr); }
+        static void commit(bool, RangeSet &) { persistent_barrier(); }
+    };
+
+    template <> struct Persist<PersistMode::Clwb> {
+        static void flush(void *addr, bool, RangeSet &) { clwb(addr); }
+        static void commit(bool, RangeSet &) { persistent_barrier(); }
+    };
+
+    // Bulk copies into freshly allocated space bypass the cache;
+    // in-place updates still use clwb.
+    template <> struct Persist<PersistMode::NTStore>
+        : public Persist<PersistMode::Clwb>
+    {
+        // Stream the aligned words with non-temporal stores, which
+        // need no flush; only partial words at either end are flushed.
+        static void copy(void *dst, const void *src, size_t len)
+        {
+            char *d = (char *)dst;
+            const char *s = (const char *)src;
+            size_t head = (-(uintptr_t)d) & 7;
+            if (head > len)
+                head = len;
+            if (head > 0) {
+                memcpy(d, s, head);
+                clwb(d);
+                d += head; s += head; len -= head;
+            }
+            for (; len >= 8; d += 8, s += 8, len -= 8) {
+                uint64_t v;
+                memcpy(&v, s, 8);
+                nt_store((uint64_t *)d, v);
+            }
+            if (len > 0) {
+                memcpy(d, s, len);
+                clwb(d);
+            }
+        }
+    };
+
+    // No durability at all, e.g. for a graph on tmpfs.
+    template <> struct Persist<PersistMode::None> {
+        static void flush(void *, bool, RangeSet &) { }
+        static void commit(bool, RangeSet &) { }
+    };
+}
@@ -30,6 +30,7 @@
 #include <stddef.h>
 #include <assert.h>
 #include <string.h>
+#include <algorithm>
 #include <thread>
 #include "transaction.h"
 #include "TransactionImpl.h"
@@ -57,6 +58,12 @@ void Transaction::commit()
     _impl = NULL;
 }
 
+void Transaction::commit(std::function<void()> on_durable)
+{
+    _impl->set_durable_callback(on_durable);
+    commit();
+}
+
 
 // TransactionImpl definitions
 
@@ -76,11 +83,15 @@ TransactionImpl::TransactionImpl(GraphImpl *db, int options)
     : _db(db),
       _tx_type(options),
       _committed(false),
+      _commit_seq(0),
+      _depends_on(0),
       _locks { Locks(db->node_locks()), Locks(db->edge_locks()), Locks(db->index_locks()) }
 {
     static_assert(sizeof (TransactionImpl::JournalEntry) == 64, "Journal entry size is not 64 bytes.");
 
     bool read_write = _tx_type & Transaction::ReadWrite;
+    if (!read_write)
+        _tx_type &= ~Transaction::EarlyLockRelease;
 
     if (read_write) {
         db->check_read_write();
@@ -93,6 +104,7 @@ TransactionImpl::TransactionImpl(GraphImpl *db, int options)
         throw PMGDException(NotImplemented);
 
     _tx_handle = db->transaction_manager().alloc_transaction(!read_write,
+                                                        in_read_write_tx(),
                                                         _msync_needed, _pending_commits);
 
     _jcur = jbegin();
@@ -113,16 +125,28 @@ TransactionImpl::~TransactionImpl()
         _finalize_callback_list.do_callbacks(this);
     }
 
-    for (unsigned i = 0; i < NUM_LOCK_REGIONS; ++i)
-        _locks[i].unlock_all();
+    uint64_t depends_on = _depends_on;
+    for (unsigned i = 0; i < NUM_LOCK_REGIONS; ++i) {
+        depends_on = std::max(depends_on, _locks[i].depends_on);
+        _locks[i].unlock_all(_commit_seq);
+    }
 
     // Free the journal after everything is done.
     if (_tx_type & Transaction::ReadWrite) {
+        // With early lock release, the data flushed in finalize_commit
+        // is made durable only now, after the locks are gone.
+        if (_committed && early_lock_release())
+            TransactionManager::commit(_msync_needed, _pending_commits);
+
         TransactionManager *tx_manager = &_db->transaction_manager();
-        tx_manager->free_transaction(_tx_handle, _msync_needed, _pending_commits);
+        tx_manager->free_transaction(_tx_handle, depends_on,
+                                     _msync_needed, _pending_commits);
     }
 
     _per_thread_tx = _outer_tx;
+
+    if (_committed && _durable_callback)
+        _durable_callback();
 }
 
 void TransactionImpl::log_je(void *src_ptr, size_t len)
@@ -157,39 +181,51 @@ void TransactionImpl::log(void *ptr, size_t len)
     TransactionManager::commit(_always_msync, _pending_commits);
 }
 
+struct TransactionImpl::FlushLogged {
+    template <PersistMode M>
+    static void run(const JournalEntry *jbegin, const JournalEntry *jend,
+                    bool msync_needed, RangeSet &pending_commits)
+    {
+        for (const JournalEntry *je = jbegin; je < jend; je++)
+            TransactionManager::flush<M>(je->addr, msync_needed, pending_commits);
+    }
+};
+
+// Restore the entries in reverse order, and flush each one.
+struct TransactionImpl::UndoLogged {
+    template <PersistMode M>
+    static void run(const JournalEntry *jbegin, const JournalEntry *jend,
+                    bool msync_needed, RangeSet &pending_commits)
+    {
+        for (const JournalEntry *je = jend; je-- > jbegin; ) {
+            memcpy(je->addr, &je->data[0], je->len);
+            TransactionManager::flush<M>(je->addr, msync_needed, pending_commits);
+        }
+    }
+};
+
 void TransactionImpl::finalize_commit()
 {
     _commit_callback_list.do_callbacks(this);
 
     // Flush (and make durable) dirty in-place data pointed to by log entries
-    for (JournalEntry *je = jbegin(); je < _jcur; je++)
-        TransactionManager::flush(je->addr, _msync_needed, _pending_commits);
-    TransactionManager::commit(_msync_needed, _pending_commits);
-}
-
-
-template<typename T>
-static inline T align_low(T var, size_t sz)
-{
-    return (T)((uint64_t)var & ~(sz-1));
-}
-
-template<typename T>
-static inline T align_high(T var, size_t sz)
-{
-    return (T)(((uint64_t)var + (sz-1)) & ~(sz-1));
+    TransactionManager::with_mode<FlushLogged>(jbegin(), _jcur,
+                                               _msync_needed, _pending_commits);
+
+    // Take a place in the commit order while the locks are still held,
+    // so that any transaction that sees our data commits after us.
+    bool elr = early_lock_release();
+    _commit_seq = _db->transaction_manager().order_commit(_tx_handle, elr,
+                                          _msync_needed, _pending_commits);
+    if (!elr)
+        TransactionManager::commit(_msync_needed, _pending_commits);
 }
 
 void TransactionImpl::flush_range(void *ptr, size_t len,
                                 bool msync_needed,
                                 RangeSet &pending_commits)
 {
-    // adjust the size to flush
-    len = align_high(len + ((size_t)ptr & (64-1)), 64);
-
-    char *addr, *eptr;
-    for (addr = (char *)ptr, eptr = (char *)ptr+len; addr < eptr; addr += 64)
-        TransactionManager::flush(addr, msync_needed, pending_commits);
+    TransactionManager::flush_range(ptr, len, msync_needed, pending_commits);
 }
 
 void TransactionImpl::flush_range(void *ptr, size_t len)
@@ -218,10 +254,7 @@ void TransactionImpl::rollback(const TransactionHandle &h,
     for (je = jbegin; je < jend && je->tx_id == h.id; je++);
 
     // rollback in the reverse order
-    while (je-- > jbegin) {
-        memcpy(je->addr, &je->data[0], je->len);
-        TransactionManager::flush(je->addr, msync_needed, pending_commits);
-    }
+    TransactionManager::with_mode<UndoLogged>(jbegin, je, msync_needed, pending_commits);
 
     // Unless we have NoMsync, rollback can safely commit in case
     // of PM=MSYNC
@@ -252,15 +285,19 @@ TransactionImpl::LockState TransactionImpl::Locks::acquire_lock(const void *addr
             mainlock.read_lock(stripeid);
             it->second = ReadLock;
         }
+        depends_on = std::max(depends_on, mainlock.release_seq(stripeid));
         return LockNotFound;
     }
 }
 
-void TransactionImpl::Locks::unlock_all()
+void TransactionImpl::Locks::unlock_all(uint64_t commit_seq)
 {
     for (auto it = mylocks.begin(); it != mylocks.end(); ++it) {
-        if (it->second == WriteLock)
+        if (it->second == WriteLock) {
+            if (commit_seq != 0)
+                mainlock.set_release_seq(it->first, commit_seq);
             mainlock.write_unlock(it->first);
+        }
         else if (it->second == ReadLock)
             mainlock.read_unlock(it->first);
     }
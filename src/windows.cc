@@ -173,6 +173,16 @@ void PMGD::os::SigHandler::sigbus_handler(int)
 {
 }
 
+void PMGD::os::prefetch(const void *addr, size_t len)
+{
+}
+
+bool PMGD::os::copy_region(const char *db_name, const char *dest_name,
+                           const char *region_name)
+{
+    throw PMGDException(NotImplemented);
+}
+
 size_t PMGD::os::get_default_region_size() { return SIZE_1GB; }
 
 size_t PMGD::os::get_alignment(size_t size)
@@ -0,0 +1,168 @@
+/**
+ * @file   batchtest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+/*
+ * Test for bulk insertion of nodes and edges: the graph should look
+ * the same as one built a node and an edge at a time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_NODES = 500;
+
+static long long count(EdgeIterator i)
+{
+    long long n = 0;
+    for (; i; i.next())
+        n++;
+    return n;
+}
+
+static long long count(NodeIterator i)
+{
+    long long n = 0;
+    for (; i; i.next())
+        n++;
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf batchgraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        Graph db("batchgraph", Graph::Create);
+
+        std::vector<Node *> nodes;
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            db.add_nodes("item", NUM_NODES, [&nodes](Node &n) {
+                n.set_property("id", (long long)nodes.size());
+                nodes.push_back(&n);
+            });
+            tx.commit();
+        }
+
+        // An aborted batch leaves nothing behind.
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            db.add_nodes("item", 10);
+            std::vector<Graph::EdgeSpec> edges;
+            edges.push_back({*nodes[0], *nodes[1], "next"});
+            db.add_edges(edges);
+        }
+
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            std::vector<Graph::EdgeSpec> edges;
+            for (int i = 0; i < NUM_NODES; i++) {
+                edges.push_back({*nodes[i], *nodes[(i + 1) % NUM_NODES], "next"});
+                edges.push_back({*nodes[0], *nodes[i], "hub"});
+            }
+            edges.push_back({*nodes[4], *nodes[4], "self"});
+            int i = 0;
+            db.add_edges(edges, [&i, &edges, &r](Edge &e) {
+                if (e.get_source() != edges[i].source
+                        || e.get_destination() != edges[i].destination
+                        || e.get_tag() != edges[i].tag)
+                    r = 1;
+                e.set_property("n", i++);
+            });
+            tx.commit();
+        }
+
+        {
+            Transaction tx(db);
+            if (count(db.get_nodes("item")) != NUM_NODES)
+                r = 1;
+            if (count(db.get_edges("next")) != NUM_NODES)
+                r = 1;
+            if (count(db.get_edges("hub")) != NUM_NODES)
+                r = 1;
+            if (count(nodes[0]->get_edges(Outgoing, "hub")) != NUM_NODES)
+                r = 1;
+            if (count(nodes[0]->get_edges(Incoming)) != 2)
+                r = 1;
+            if (count(nodes[4]->get_edges("self")) != 2)
+                r = 1;
+            for (int i = 1; i < NUM_NODES; i++) {
+                if (count(nodes[i]->get_edges(Outgoing)) != 1 + (i == 4)
+                        || count(nodes[i]->get_edges(Incoming)) != 2 + (i == 4))
+                    r = 1;
+                if (nodes[i]->get_property("id").int_value() != i)
+                    r = 1;
+                if (count(nodes[0]->get_edges_to(*nodes[i], Outgoing, "hub")) != 1)
+                    r = 1;
+            }
+            tx.commit();
+        }
+
+        // The recorded adjacency positions must be right for removal.
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            for (int i = 0; i < NUM_NODES; i += 2)
+                db.remove(*nodes[i]);
+            tx.commit();
+        }
+
+        {
+            Transaction tx(db);
+            if (count(db.get_nodes("item")) != NUM_NODES / 2)
+                r = 1;
+            if (count(db.get_edges("next")) != 0)
+                r = 1;
+            if (count(db.get_edges("hub")) != 0)
+                r = 1;
+            if (count(db.get_edges()) != 0)
+                r = 1;
+            for (int i = 1; i < NUM_NODES; i += 2)
+                if (count(nodes[i]->get_edges()) != 0)
+                    r = 1;
+            tx.commit();
+        }
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
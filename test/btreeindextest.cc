@@ -0,0 +1,256 @@
+/**
+ * @file   btreeindextest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+
+/*
+ * Test for B+-tree property indexes: every query on a B+-tree index
+ * has to return what the same query on an AVL index does, as the
+ * values are added, removed during iteration, and after reopening.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_NODES = 6000;
+static const int NUM_VALUES = 1500;
+static const int BATCH = 100;
+
+static long long value(int i) { return (i * 7919LL) % NUM_VALUES; }
+
+static std::string name(long long v)
+{
+    // Some longer than the inline string prefix
+    return "k" + std::to_string(v % 700) + (v % 3 == 0 ? "-long-suffix" : "");
+}
+
+static std::vector<NodeID> ids(Graph &db, const PropertyPredicate &pp,
+                               bool reverse)
+{
+    std::vector<NodeID> r;
+    for (NodeIterator i = db.get_nodes("item", pp, reverse); i; i.next())
+        r.push_back(db.get_id(*i));
+    return r;
+}
+
+static PropertyPredicate predicate(const char *id, PropertyPredicate::Op op,
+                                   const Property &v1, const Property &v2)
+{
+    if (op == PropertyPredicate::DontCare)
+        return PropertyPredicate(id);
+    if (op >= PropertyPredicate::GeLe)
+        return PropertyPredicate(id, op, v1, v2);
+    return PropertyPredicate(id, op, v1);
+}
+
+// The AVL index answer. Ne is put together from Lt and Gt, since the
+// AVL Ne iterator skips part of the tree after the excluded value.
+static std::vector<NodeID> expected(Graph &db, const char *id,
+                                    PropertyPredicate::Op op,
+                                    const Property &v1, const Property &v2,
+                                    bool reverse)
+{
+    if (op != PropertyPredicate::Ne)
+        return ids(db, predicate(id, op, v1, v2), reverse);
+    std::vector<NodeID> r = ids(db, PropertyPredicate(id,
+        reverse ? PropertyPredicate::Gt : PropertyPredicate::Lt, v1), reverse);
+    std::vector<NodeID> rest = ids(db, PropertyPredicate(id,
+        reverse ? PropertyPredicate::Lt : PropertyPredicate::Gt, v1), reverse);
+    r.insert(r.end(), rest.begin(), rest.end());
+    return r;
+}
+
+// Runs each query on the AVL property and on the B+-tree one
+static int compare(Graph &db, const char *when)
+{
+    typedef PropertyPredicate PP;
+    struct Query {
+        PP::Op op;
+        Property v1, v2;
+    };
+    const Query int_queries[] = {
+        { PP::DontCare, 0LL, 0LL },
+        { PP::Eq, 17LL, 0LL },
+        { PP::Eq, (long long)NUM_VALUES, 0LL },
+        { PP::Ne, 17LL, 0LL },
+        { PP::Lt, 300LL, 0LL },
+        { PP::Le, 300LL, 0LL },
+        { PP::Gt, 1200LL, 0LL },
+        { PP::Ge, 1200LL, 0LL },
+        { PP::GeLe, 100LL, 700LL },
+        { PP::GeLt, 100LL, 700LL },
+        { PP::GtLe, 100LL, 700LL },
+        { PP::GtLt, 100LL, 700LL },
+        { PP::GeLe, 2000LL, 3000LL },
+    };
+    const Query string_queries[] = {
+        { PP::DontCare, "", "" },
+        { PP::Eq, "k5", "" },
+        { PP::Eq, "k6-long-suffix", "" },
+        { PP::Ne, "k5", "" },
+        { PP::Lt, "k3", "" },
+        { PP::Ge, "k3", "" },
+        { PP::GeLt, "k1", "k4-long-suffix" },
+        { PP::GtLe, "k1", "k4-long-suffix" },
+    };
+
+    int r = 0;
+    // The AVL string iterators copy their bounds into PM.
+    Transaction tx(db, Transaction::ReadWrite);
+    for (int reverse = 0; reverse < 2; reverse++) {
+        for (const Query &q : int_queries) {
+            if (expected(db, "a", q.op, q.v1, q.v2, reverse)
+                    != ids(db, predicate("b", q.op, q.v1, q.v2), reverse)) {
+                printf("%s: integer query %d differs (reverse %d)\n",
+                       when, int(q.op), reverse);
+                r = 1;
+            }
+        }
+        for (const Query &q : string_queries) {
+            if (expected(db, "s", q.op, q.v1, q.v2, reverse)
+                    != ids(db, predicate("t", q.op, q.v1, q.v2), reverse)) {
+                printf("%s: string query %d differs (reverse %d)\n",
+                       when, int(q.op), reverse);
+                r = 1;
+            }
+        }
+    }
+
+    Graph::IndexStats a = db.get_index_stats(Graph::NodeIndex, "item", "a");
+    Graph::IndexStats b = db.get_index_stats(Graph::NodeIndex, "item", "b");
+    if (a.total_elements != b.total_elements
+            || a.total_unique_entries != b.total_unique_entries) {
+        printf("%s: stats differ\n", when);
+        r = 1;
+    }
+    tx.commit();
+    return r;
+}
+
+static void set(Node &n, long long v)
+{
+    n.set_property("a", v);
+    n.set_property("b", v);
+    n.set_property("s", name(v));
+    n.set_property("t", name(v));
+}
+
+int main(int argc, char **argv)
+{
+    // With -r, only reopen and check an existing graph.
+    bool create = !(argc > 1 && strcmp(argv[1], "-r") == 0);
+
+    if (create && system("rm -rf btreeindexgraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        if (create) {
+            Graph db("btreeindexgraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "item", "a", PropertyType::Integer);
+                db.create_index(Graph::NodeIndex, "item", "b", PropertyType::Integer,
+                                Graph::BPlusTree);
+                db.create_index(Graph::NodeIndex, "item", "s", PropertyType::String);
+                db.create_index(Graph::NodeIndex, "item", "t", PropertyType::String,
+                                Graph::BPlusTree);
+                tx.commit();
+            }
+            for (int b = 0; b < NUM_NODES; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = b; i < b + BATCH; i++)
+                    set(db.add_node("item"), value(i));
+                tx.commit();
+            }
+            r |= compare(db, "added");
+
+            // An aborted batch leaves nothing behind.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = 0; i < BATCH; i++)
+                    set(db.add_node("item"), NUM_VALUES + i);
+            }
+            r |= compare(db, "aborted");
+
+            // Removing values under a B+-tree iterator
+            for (long long lo = 700; lo < 900; lo += 20) {
+                Transaction tx(db, Transaction::ReadWrite);
+                PropertyPredicate pp("b", PropertyPredicate::GeLt, lo, lo + 20);
+                for (NodeIterator i = db.get_nodes("item", pp); i; i.next()) {
+                    Node &n = *i;
+                    n.remove_property("a");
+                    n.remove_property("b");
+                    n.remove_property("s");
+                    n.remove_property("t");
+                    try {
+                        i->get_id();
+                        r = 1;
+                    }
+                    catch (Exception e) {
+                        if (e.num != VacantIterator)
+                            throw;
+                    }
+                }
+                tx.commit();
+            }
+            r |= compare(db, "removed");
+
+            // Changing values to ones ahead of a reverse iterator
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                PropertyPredicate pp("b", PropertyPredicate::Lt, 40LL);
+                for (NodeIterator i = db.get_nodes("item", pp, true); i; i.next())
+                    set(*i, i->get_property("b").int_value() + NUM_VALUES);
+                tx.commit();
+            }
+            r |= compare(db, "changed");
+        }
+
+        Graph db("btreeindexgraph");
+        r |= compare(db, "reopened");
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
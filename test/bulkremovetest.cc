@@ -0,0 +1,201 @@
+/**
+ * @file   bulkremovetest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+/*
+ * Test for removing nodes with many edges, in one transaction and
+ * over several with Graph::remove_partial.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_LEAVES = 2000;
+static const int BATCH = 100;
+static const int CHUNK = 300;
+
+static long long count(EdgeIterator i)
+{
+    long long n = 0;
+    for (; i; i.next())
+        n++;
+    return n;
+}
+
+static long long count(NodeIterator i)
+{
+    long long n = 0;
+    for (; i; i.next())
+        n++;
+    return n;
+}
+
+static int check(const char *what, long long got, long long expected)
+{
+    if (got != expected) {
+        printf("%s: expected %lld, got %lld\n", what, expected, got);
+        return 1;
+    }
+    return 0;
+}
+
+// Links every leaf to the node, with a mix of directions, tags, an
+// indexed property, an edge order and light edges.
+static void build(Graph &db, Node &node, std::vector<Node *> &leaves, int n)
+{
+    for (int b = 0; b < n; b += BATCH) {
+        Transaction tx(db, Transaction::ReadWrite);
+        for (int i = b; i < b + BATCH; i++) {
+            Node &leaf = *leaves[i];
+            Edge &e = db.add_edge(node, leaf, "link");
+            e.set_property("w", (long long)i);
+            if (i % 2 == 0)
+                db.add_edge(leaf, node, "ref").set_property("note", "back");
+            if (i % 3 == 0)
+                db.add_edge(node, leaf, "msg").set_property("seq", (long long)i);
+            if (i % 5 == 0)
+                db.add_light_edge(leaf, node, "follows");
+        }
+        tx.commit();
+    }
+    Transaction tx(db, Transaction::ReadWrite);
+    db.add_edge(node, node, "link").set_property("w", -1LL);
+    db.add_light_edge(node, node, "follows");
+    tx.commit();
+}
+
+// Whatever is left of the node or its edges should not be visible.
+static int check_gone(Graph &db, const char *tag, std::vector<Node *> &leaves,
+                      Node &other, long long other_edges)
+{
+    int r = 0;
+    Transaction tx(db);
+    r |= check("tag nodes", count(db.get_nodes(tag)), 0);
+    r |= check("all nodes", count(db.get_nodes()), NUM_LEAVES + 1);
+    r |= check("link edges", count(db.get_edges("link")), other_edges);
+    r |= check("indexed edges", count(db.get_edges("link",
+               PropertyPredicate("w", PropertyPredicate::Ge, 0LL))), other_edges);
+    r |= check("all edges", count(db.get_edges()), other_edges);
+    for (int i = 0; i < NUM_LEAVES; i += 7) {
+        Node &leaf = *leaves[i];
+        r |= check("leaf edges", count(leaf.get_edges()), 1);
+        r |= check("leaf neighbors", leaf.get_sorted_neighbors().size(), 1);
+        r |= check("leaf ordered", count(leaf.get_edges(Incoming, "msg",
+                   PropertyPredicate("seq"))), 0);
+        if (&leaf.get_neighbor(Any, "link") != &other)
+            r = 1;
+    }
+    tx.commit();
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf bulkremovegraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        Graph db("bulkremovegraph", Graph::Create);
+        std::vector<Node *> leaves;
+        Node *hub, *other;
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            db.set_light_edges("follows");
+            db.set_edge_order("msg", "seq", PropertyType::Integer);
+            db.create_index(Graph::EdgeIndex, "link", "w", PropertyType::Integer);
+            hub = &db.add_node("hub");
+            other = &db.add_node("other");
+            tx.commit();
+        }
+        for (int b = 0; b < NUM_LEAVES; b += BATCH) {
+            Transaction tx(db, Transaction::ReadWrite);
+            for (int i = b; i < b + BATCH; i++) {
+                leaves.push_back(&db.add_node("leaf"));
+                db.add_edge(*other, *leaves[i], "link").set_property("w", 0LL);
+            }
+            tx.commit();
+        }
+        build(db, *hub, leaves, NUM_LEAVES);
+
+        // The hub goes in pieces. It vanishes with the first piece,
+        // and an aborted piece leaves it all in place.
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            if (db.remove_partial(*hub, CHUNK))
+                r = 1;
+        }
+        {
+            Transaction tx(db);
+            r |= check("hub after abort", count(db.get_nodes("hub")), 1);
+            r |= check("hub edges after abort",
+                       count(hub->get_edges(Outgoing, "link")), NUM_LEAVES + 1);
+            tx.commit();
+        }
+        int steps = 0;
+        for (bool done = false; !done; steps++) {
+            Transaction tx(db, Transaction::ReadWrite);
+            done = db.remove_partial(*hub, CHUNK);
+            tx.commit();
+            if (!done)
+                r |= check_gone(db, "hub", leaves, *other, NUM_LEAVES);
+        }
+        r |= check("steps", steps > 1, 1);
+        r |= check_gone(db, "hub", leaves, *other, NUM_LEAVES);
+
+        // Rebuild a smaller one and remove it in one go.
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            hub = &db.add_node("hub");
+            tx.commit();
+        }
+        build(db, *hub, leaves, NUM_LEAVES / 4);
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            db.remove(*hub);
+            tx.commit();
+        }
+        r |= check_gone(db, "hub", leaves, *other, NUM_LEAVES);
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
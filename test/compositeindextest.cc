@@ -0,0 +1,262 @@
+/**
+ * @file   compositeindextest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+
+/*
+ * Test for composite indexes: lists of predicates have to find the
+ * same nodes as checking every node, in the order of the index where
+ * it serves them, as nodes gain, change and lose the properties, and
+ * after reopening.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+typedef PropertyPredicate PP;
+
+static const int NUM_NODES = 3000;
+static const int BATCH = 100;
+
+static std::string name(int i)
+{
+    // Some longer than the inline string prefix
+    return (i % 4 == 0 ? "n-long-name-" : "n") + std::to_string(i % 40);
+}
+
+static void set(Node &n, int i)
+{
+    if (i % 17 != 0)
+        n.set_property("last", name(i));
+    if (i % 11 != 0)
+        n.set_property("year", 1950LL + (i * 37) % 70);
+    n.set_property("score", ((i * 13) % 200 - 100) * 0.5);
+    n.set_property("active", i % 3 == 0);
+}
+
+// The nodes found, checking that they come in order of property id
+// if it is given. Nodes without it come first.
+static std::vector<NodeID> ids(Graph &db, const std::vector<PP> &preds,
+                               bool reverse, const char *id, bool &ordered)
+{
+    std::vector<NodeID> r;
+    bool had = false;
+    Property last;
+    ordered = true;
+    for (NodeIterator i = db.get_nodes("person", preds, reverse); i; i.next()) {
+        r.push_back(db.get_id(*i));
+        if (id == NULL)
+            continue;
+        Property p;
+        bool has = i->check_property(id, p);
+        if (r.size() > 1) {
+            bool before = reverse ? (has && !had) || (has && had && last < p)
+                                  : (had && !has) || (has && had && p < last);
+            if (before)
+                ordered = false;
+        }
+        had = has;
+        last = p;
+    }
+    return r;
+}
+
+// Each node checked against every predicate
+static std::vector<NodeID> expected(Graph &db, const std::vector<PP> &preds)
+{
+    std::vector<NodeID> r;
+    for (NodeIterator i = db.get_nodes("person"); i; i.next()) {
+        bool pass = true;
+        for (const PP &pp : preds)
+            if (PropertyFilter<Node>(pp)(*i) != Pass)
+                pass = false;
+        if (pass)
+            r.push_back(db.get_id(*i));
+    }
+    std::sort(r.begin(), r.end());
+    return r;
+}
+
+static int compare(Graph &db, const char *when)
+{
+    // The property ids need it.
+    Transaction tx(db);
+    struct Query {
+        std::vector<PP> preds;
+        const char *order;   // The property it comes out in order of
+    };
+    const Query queries[] = {
+        { { PP("last", PP::Eq, "n5") }, "year" },
+        { { PP("last", PP::Eq, "n5"), PP("year", PP::GeLt, 1960LL, 1990LL) }, "year" },
+        { { PP("last", PP::Eq, "n5"), PP("year", PP::Lt, 1970LL) }, "year" },
+        { { PP("year", PP::Le, 1980LL), PP("last", PP::Eq, "n-long-name-8") }, "year" },
+        { { PP("last", PP::Eq, "n1"), PP("year", PP::Eq, 1987LL),
+            PP("score", PP::Gt, 0.0) }, NULL },
+        { { PP("last", PP::Gt, "n3") }, "last" },
+        { { PP("year", PP::Ge, 2000LL) }, NULL },
+        { { PP("active", PP::Eq, true), PP("score", PP::Le, 10.0) }, "score" },
+        { { PP("score", PP::GtLt, -20.0, 20.0), PP("active", PP::Eq, false) }, "score" },
+        { { PP("active", PP::Eq, true), PP("score", PP::Eq, -0.0) }, NULL },
+        { { PP("last", PP::Ne, "n5"), PP("year", PP::Eq, 1960LL) }, NULL },
+    };
+
+    int r = 0;
+    int q = 0;
+    for (const Query &query : queries) {
+        std::vector<NodeID> want = expected(db, query.preds);
+        for (int reverse = 0; reverse < 2; reverse++) {
+            bool ordered;
+            std::vector<NodeID> found = ids(db, query.preds, reverse,
+                                            query.order, ordered);
+            if (!ordered) {
+                printf("%s: query %d is out of order (reverse %d)\n",
+                       when, q, reverse);
+                r = 1;
+            }
+            std::sort(found.begin(), found.end());
+            if (found != want) {
+                printf("%s: query %d found %zu, not %zu (reverse %d)\n",
+                       when, q, found.size(), want.size(), reverse);
+                r = 1;
+            }
+        }
+        q++;
+    }
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    // With -r, only reopen and check an existing graph.
+    bool create = !(argc > 1 && strcmp(argv[1], "-r") == 0);
+
+    if (create && system("rm -rf compositeindexgraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        if (create) {
+            Graph db("compositeindexgraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "person",
+                                { { "last", PropertyType::String },
+                                  { "year", PropertyType::Integer } });
+                db.create_index(Graph::NodeIndex, "person",
+                                { { "active", PropertyType::Boolean },
+                                  { "score", PropertyType::Float } });
+                // Again, with no effect
+                db.create_index(Graph::NodeIndex, "person",
+                                { { "last", PropertyType::String },
+                                  { "year", PropertyType::Integer } });
+                tx.commit();
+            }
+            for (int b = 0; b < NUM_NODES; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = b; i < b + BATCH; i++)
+                    set(db.add_node("person"), i);
+                tx.commit();
+            }
+            r |= compare(db, "added");
+
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = 0; i < BATCH; i++)
+                    set(db.add_node("person"), i);
+            }
+            r |= compare(db, "aborted");
+
+            // A value of the wrong type changes nothing.
+            try {
+                Transaction tx(db, Transaction::ReadWrite);
+                NodeIterator i = db.get_nodes("person");
+                i->set_property("year", "1970");
+                tx.commit();
+                printf("type mismatch not caught\n");
+                r = 1;
+            }
+            catch (Exception e) {
+                if (e.num != PropertyTypeMismatch)
+                    throw;
+            }
+
+            // Gaining, changing and losing values
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                int j = 0;
+                for (NodeIterator i = db.get_nodes("person"); i; i.next(), j++) {
+                    if (j % 5 == 0)
+                        i->set_property("year", 1940LL + j % 90);
+                    else if (j % 5 == 1)
+                        i->remove_property("year");
+                    else if (j % 5 == 2 && j % 2 == 0)
+                        i->remove_property("last");
+                    else if (j % 5 == 3)
+                        i->set_property("last", name(j + 1));
+                }
+                tx.commit();
+            }
+            r |= compare(db, "changed");
+
+            // Removing nodes under a composite iterator
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                std::vector<PP> preds = { PP("last", PP::Eq, "n7") };
+                for (NodeIterator i = db.get_nodes("person", preds); i; i.next())
+                    db.remove(*i);
+                preds = { PP("active", PP::Eq, true), PP("score", PP::Lt, -30.0) };
+                for (NodeIterator i = db.get_nodes("person", preds, true); i; i.next())
+                    db.remove(*i);
+                tx.commit();
+            }
+            r |= compare(db, "removed");
+        }
+
+        Graph db("compositeindexgraph");
+        r |= compare(db, "reopened");
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
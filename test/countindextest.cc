@@ -0,0 +1,262 @@
+/**
+ * @file   countindextest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+
+/*
+ * Test for counted AVL indexes: count_nodes on a counted index has
+ * to give the size of what the same query returns on an AVL index,
+ * and an iterator that starts at an offset has to return the rest of
+ * what the AVL iterator does, both ways, for every op, with values
+ * that have from one object to thousands. This has to hold for an
+ * index filled when it was created, as objects are added, removed
+ * and changed, after an abort, while a node is partly removed, and
+ * after reopening.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_NODES = 20000;
+static const int NUM_VALUES = 3000;
+static const int BATCH = 100;
+
+static long long value(int i) { return (i * 7919LL) % NUM_VALUES; }
+static bool flag(long long v) { return v % 3 != 0; }
+// Fewer values than a, so the string index can be filled in one
+// transaction
+static std::string name(long long v) { return "user" + std::to_string(v / 8); }
+
+static std::vector<NodeID> ids(Graph &db, const PropertyPredicate &pp,
+                               bool reverse = false, size_t offset = 0)
+{
+    std::vector<NodeID> r;
+    for (NodeIterator i = db.get_nodes("item", pp, reverse, offset); i; i.next())
+        r.push_back(db.get_id(*i));
+    return r;
+}
+
+// Runs each query on the AVL property and the counted one
+static int compare(Graph &db, const char *when)
+{
+    typedef PropertyPredicate PP;
+    int r = 0;
+    Transaction tx(db);
+    std::vector<std::pair<PP, PP>> queries = {
+        { PP("a"), PP("c") },
+        { PP("a", PP::Eq, 1234LL), PP("c", PP::Eq, 1234LL) },
+        { PP("a", PP::Eq, -1LL), PP("c", PP::Eq, -1LL) },
+        { PP("a", PP::Ne, 1234LL), PP("c", PP::Ne, 1234LL) },
+        { PP("a", PP::Lt, 700LL), PP("c", PP::Lt, 700LL) },
+        { PP("a", PP::Le, 700LL), PP("c", PP::Le, 700LL) },
+        { PP("a", PP::Gt, 2100LL), PP("c", PP::Gt, 2100LL) },
+        { PP("a", PP::Ge, 2100LL), PP("c", PP::Ge, 2100LL) },
+        { PP("a", PP::GeLe, 100LL, 1900LL), PP("c", PP::GeLe, 100LL, 1900LL) },
+        { PP("a", PP::GeLt, 100LL, 1900LL), PP("c", PP::GeLt, 100LL, 1900LL) },
+        { PP("a", PP::GtLe, 100LL, 1900LL), PP("c", PP::GtLe, 100LL, 1900LL) },
+        { PP("a", PP::GtLt, 100LL, 1900LL), PP("c", PP::GtLt, 100LL, 1900LL) },
+        { PP("a", PP::GtLt, 100LL, 101LL), PP("c", PP::GtLt, 100LL, 101LL) },
+        { PP("a", PP::GeLt, 1900LL, 100LL), PP("c", PP::GeLt, 1900LL, 100LL) },
+        { PP("ab", PP::Eq, true), PP("cb", PP::Eq, true) },
+        { PP("ab", PP::Ne, true), PP("cb", PP::Ne, true) },
+        { PP("ab", PP::Ge, false), PP("cb", PP::Ge, false) },
+        { PP("ab", PP::Lt, true), PP("cb", PP::Lt, true) },
+        { PP("s", PP::Eq, name(77)), PP("cs", PP::Eq, name(77)) },
+        { PP("s", PP::Lt, "user5"), PP("cs", PP::Lt, "user5") },
+        { PP("s", PP::GeLt, "user1", "user2"), PP("cs", PP::GeLt, "user1", "user2") },
+        { PP("s", PP::Prefix, "user12"), PP("cs", PP::Prefix, "user12") },
+        { PP("s", PP::Prefix, ""), PP("cs", PP::Prefix, "") },
+    };
+    for (auto &q : queries) {
+        for (bool reverse : { false, true }) {
+            std::vector<NodeID> all = ids(db, q.first, reverse);
+            size_t n = all.size();
+            if (db.count_nodes("item", q.second) != n
+                    || db.count_nodes("item", q.first) != n) {
+                printf("%s: count on %s differs\n", when,
+                       q.second.id.name().c_str());
+                r = 1;
+            }
+            for (size_t offset : { size_t(1), size_t(5), n / 3, n / 2,
+                                   n - 1, n, n + 3 }) {
+                std::vector<NodeID> rest(all.begin() + std::min(offset, n), all.end());
+                if (ids(db, q.second, reverse, offset) != rest
+                        || (offset == n / 3 && ids(db, q.first, reverse, offset) != rest)) {
+                    printf("%s: offset %zu on %s%s differs\n", when, offset,
+                           q.second.id.name().c_str(), reverse ? " reversed" : "");
+                    r = 1;
+                }
+            }
+        }
+    }
+    return r;
+}
+
+static void set(Node &n, long long v)
+{
+    n.set_property("a", v);
+    n.set_property("c", v);
+    n.set_property("ab", flag(v));
+    n.set_property("cb", flag(v));
+    n.set_property("s", name(v));
+    n.set_property("cs", name(v));
+}
+
+static void add(Graph &db, int begin, int end)
+{
+    for (int b = begin; b < end; b += BATCH) {
+        Transaction tx(db, Transaction::ReadWrite);
+        for (int i = b; i < b + BATCH && i < end; i++)
+            set(db.add_node("item"), value(i));
+        tx.commit();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // With -r, only reopen and check an existing graph.
+    bool create = !(argc > 1 && strcmp(argv[1], "-r") == 0);
+
+    if (create && system("rm -rf countindexgraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        if (create) {
+            Graph db("countindexgraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "item", "a", PropertyType::Integer);
+                db.create_index(Graph::NodeIndex, "item", "c", PropertyType::Integer,
+                                Graph::CountedAvl);
+                db.create_index(Graph::NodeIndex, "item", "ab", PropertyType::Boolean);
+                db.create_index(Graph::NodeIndex, "item", "s", PropertyType::String);
+                tx.commit();
+            }
+            add(db, 0, NUM_NODES / 2);
+
+            // These are filled from the nodes there already.
+            for (auto &p : std::vector<std::pair<const char *, PropertyType>>
+                               { { "cb", PropertyType::Boolean },
+                                 { "cs", PropertyType::String } }) {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "item", p.first, p.second,
+                                Graph::CountedAvl);
+                tx.commit();
+            }
+            r |= compare(db, "loaded");
+            add(db, NUM_NODES / 2, NUM_NODES);
+            r |= compare(db, "added");
+
+            // An aborted batch, with its new nodes, leaves nothing behind.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = 0; i < BATCH; i++)
+                    set(db.add_node("item"), value(i));
+            }
+            r |= compare(db, "aborted");
+
+            // Removing values under a counted iterator, and nodes
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                PropertyPredicate pp("c", PropertyPredicate::GeLt, 500LL, 560LL);
+                for (NodeIterator i = db.get_nodes("item", pp, true); i; i.next()) {
+                    Node &n = *i;
+                    for (const char *p : { "c", "cs", "a", "s" })
+                        n.remove_property(p);
+                }
+                tx.commit();
+            }
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                PropertyPredicate pp("c", PropertyPredicate::Lt, 40LL);
+                for (NodeIterator i = db.get_nodes("item", pp); i; i.next())
+                    db.remove(*i);
+                tx.commit();
+            }
+            r |= compare(db, "removed");
+
+            // Changing values under a counted iterator, to ones past it
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                PropertyPredicate pp("c", PropertyPredicate::GeLt, 1200LL, 1220LL);
+                for (NodeIterator i = db.get_nodes("item", pp); i; i.next())
+                    set(*i, i->get_property("c").int_value() + NUM_VALUES);
+                tx.commit();
+            }
+            r |= compare(db, "changed");
+
+            // Counts leave out a node that is partly removed.
+            Node *hub;
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                hub = &db.add_node("item");
+                set(*hub, 1234);
+                PropertyPredicate pp("c", PropertyPredicate::Eq, 1235LL);
+                for (NodeIterator i = db.get_nodes("item", pp); i; i.next())
+                    db.add_edge(*hub, *i, "link");
+                tx.commit();
+            }
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                if (db.remove_partial(*hub, 1))
+                    r = 1;
+                tx.commit();
+            }
+            r |= compare(db, "partly removed");
+            for (bool done = false; !done; ) {
+                Transaction tx(db, Transaction::ReadWrite);
+                done = db.remove_partial(*hub, 1);
+                tx.commit();
+            }
+            r |= compare(db, "removed all");
+        }
+
+        Graph db("countindexgraph");
+        r |= compare(db, "reopened");
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
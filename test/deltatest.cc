@@ -0,0 +1,198 @@
+/**
+ * @file   deltatest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Test for incremental backups: take a snapshot, export two deltas,
+ * then apply them to the snapshot and compare it with the original.
+ * A snapshot that fails part way must not lose pages from the next
+ * delta. A delta exported while other threads add nodes must give a
+ * consistent copy, and must not lose their pages from the next delta.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static void add_nodes(Graph &db, int first, int count)
+{
+    Transaction tx(db, Transaction::ReadWrite);
+    Node *prev = NULL;
+    for (int i = first; i < first + count; i++) {
+        Node &n = db.add_node("item");
+        n.set_property("id", i);
+        if (prev != NULL)
+            db.add_edge(*prev, n, "next");
+        prev = &n;
+    }
+    tx.commit();
+}
+
+static const int NUM_THREADS = 4;
+
+static std::atomic<bool> done(false);
+
+static void add_pairs(Graph &db)
+{
+    while (!done) {
+        try {
+            Transaction tx(db, Transaction::ReadWrite);
+            Node &a = db.add_node("pair");
+            Node &b = db.add_node("pair");
+            db.add_edge(a, b, "link");
+            tx.commit();
+        }
+        catch (Exception e) {
+            if (e.num != LockTimeout) {
+                print_exception(e);
+                exit(1);
+            }
+        }
+    }
+}
+
+// Returns the number of pairs, or -1 if nodes and edges disagree.
+static long long count_pairs(const char *name)
+{
+    Graph db(name, Graph::ReadOnly);
+    Transaction tx(db);
+    long long nodes = 0, edges = 0;
+    for (NodeIterator i = db.get_nodes("pair"); i; i.next())
+        nodes++;
+    for (EdgeIterator i = db.get_edges("link"); i; i.next())
+        edges++;
+    tx.commit();
+    return nodes == 2 * edges ? edges : -1;
+}
+
+static long long sum_ids(const char *name)
+{
+    Graph db(name, Graph::ReadOnly);
+    Transaction tx(db);
+    long long sum = 0;
+    for (NodeIterator i = db.get_nodes("item"); i; i.next())
+        sum += i->get_property("id").int_value();
+    for (EdgeIterator i = db.get_edges("next"); i; i.next())
+        sum += 1000000;
+    tx.commit();
+    return sum;
+}
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf deltagraph deltagraph.copy deltagraph.[1-4]") < 0)
+        return 1;
+
+    try {
+        {
+            Graph::Config config;
+            config.track_dirty_pages = true;
+            Graph db("deltagraph", Graph::Create, &config);
+            add_nodes(db, 0, 100);
+            db.snapshot("deltagraph.copy");
+            add_nodes(db, 100, 100);
+            try {
+                db.snapshot("deltagraph.missing/copy");
+                printf("Snapshot into a missing directory\n");
+                return 1;
+            }
+            catch (Exception e) {
+                if (e.num != OpenFailed)
+                    throw;
+            }
+            db.export_delta("deltagraph.1");
+
+            Transaction tx(db, Transaction::ReadWrite);
+            for (NodeIterator i = db.get_nodes("item"); i; i.next()) {
+                if (i->get_property("id").int_value() % 3 == 0)
+                    db.remove(*i);
+            }
+            tx.commit();
+            add_nodes(db, 200, 10);
+            db.export_delta("deltagraph.2");
+
+            // Enough pages that the writers overlap the export.
+            for (int i = 0; i < 100; i++)
+                add_nodes(db, 1000 + 1000 * i, 1000);
+
+            std::vector<std::thread> threads;
+            for (int i = 0; i < NUM_THREADS; i++)
+                threads.push_back(std::thread(add_pairs, std::ref(db)));
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            db.export_delta("deltagraph.3");
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            done = true;
+            for (auto &t : threads)
+                t.join();
+            db.export_delta("deltagraph.4");
+        }
+
+        long long expected = sum_ids("deltagraph");
+        long long expected_pairs = count_pairs("deltagraph");
+
+        // Out of order must be refused.
+        try {
+            Graph::apply_delta("deltagraph.copy", "deltagraph.2");
+            printf("Applied delta out of order\n");
+            return 1;
+        }
+        catch (Exception e) {
+            if (e.num != VersionMismatch)
+                throw;
+        }
+
+        Graph::apply_delta("deltagraph.copy", "deltagraph.1");
+        Graph::apply_delta("deltagraph.copy", "deltagraph.2");
+        Graph::apply_delta("deltagraph.copy", "deltagraph.3");
+        long long pairs = count_pairs("deltagraph.copy");
+        printf("pairs at delta 3: %lld\n", pairs);
+        if (pairs <= 0)
+            return 1;
+
+        Graph::apply_delta("deltagraph.copy", "deltagraph.4");
+        long long restored = sum_ids("deltagraph.copy");
+        pairs = count_pairs("deltagraph.copy");
+        printf("expected %lld restored %lld\n", expected, restored);
+        printf("expected %lld pairs restored %lld\n", expected_pairs, pairs);
+        if (expected != restored || expected_pairs != pairs)
+            return 1;
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    printf("Test passed\n");
+    return 0;
+}
@@ -102,6 +102,34 @@ int EdgeIndexTest::run_edge_test(Graph &db, Allocator &allocator1)
     edge_table->remove("tag20", entry1.key(), allocator1);
     edge_table->add("tag20", entry2.key(), entry2.value(), allocator1);
 
+    cout << "Step 4: Testing chunked pairs\n";
+    Edge *edges[NUM_TEST_ELEMS];
+    for (int i = 0; i < NUM_TEST_ELEMS; i++) {
+        edges[i] = (Edge *)allocator1.alloc(16);
+        edge_table->add("tag30", edges[i], entry1.value(), allocator1);
+    }
+    for (int i = 0; i < NUM_TEST_ELEMS; i += 2)
+        edge_table->remove("tag30", edges[i], allocator1);
+    // The freed slots get reused
+    for (int i = 0; i < NUM_TEST_ELEMS; i += 4)
+        edge_table->add("tag30", edges[i], entry1.value(), allocator1);
+
+    int count = 0;
+    for (EdgeIndex::EdgePosition pos = edge_table->get_first("tag30"); pos; pos.next()) {
+        if (pos.node() != entry1.value())
+            return 1;
+        count++;
+    }
+    int expected = NUM_TEST_ELEMS / 2 + (NUM_TEST_ELEMS + 3) / 4;
+    cout << "Pairs: " << count << ", expected: " << expected << "\n";
+    if (count != expected)
+        return 1;
+
+    for (int i = 0; i < NUM_TEST_ELEMS; i++)
+        edge_table->remove("tag30", edges[i], allocator1);
+    if (edge_table->get_first("tag30"))
+        return 1;
+
     tx.commit();
 
     return 0;
@@ -113,7 +141,10 @@ int EdgeIndexTest::run_test()
         Graph db("edgeindexgraph", Graph::Create);
         Allocator *allocator1 = Allocator::get_main_allocator(db);
 
-        run_edge_test(db, *allocator1);
+        if (run_edge_test(db, *allocator1) != 0) {
+            cout << "Test failed\n";
+            return 1;
+        }
     }
     catch (Exception e) {
         print_exception(e);
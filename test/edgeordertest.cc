@@ -0,0 +1,251 @@
+/**
+ * @file   edgeordertest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+/*
+ * Test for window queries on edge tags whose adjacency is ordered by
+ * an edge property, checked against filtering the whole adjacency.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_EDGES = 300;
+static const int BATCH = 30;
+
+static Time minute(int m)
+{
+    struct tm tm = {};
+    tm.tm_year = 117;
+    tm.tm_mday = 1;
+    tm.tm_hour = m / 60;
+    tm.tm_min = m % 60;
+    return Time(&tm, 0, 0);
+}
+
+static std::vector<long long> seqs(EdgeIterator i)
+{
+    std::vector<long long> v;
+    for (; i; i.next())
+        v.push_back(i->get_property("seq").int_value());
+    return v;
+}
+
+// The ordered query against a sorted filter of the whole adjacency
+static int check(const Node &n, Direction dir, const PropertyPredicate &pp)
+{
+    std::vector<long long> expected = seqs(n.get_edges(dir, "msg").filter(pp));
+    std::sort(expected.begin(), expected.end());
+    std::vector<long long> got = seqs(n.get_edges(dir, "msg", pp));
+    std::vector<long long> rgot = seqs(n.get_edges(dir, "msg", pp, true));
+    std::reverse(rgot.begin(), rgot.end());
+    if (got != expected || rgot != expected) {
+        printf("op %d dir %d: expected %zu edges, got %zu and %zu reversed\n",
+               pp.op, dir, expected.size(), got.size(), rgot.size());
+        return 1;
+    }
+    return 0;
+}
+
+static int check_all(const Node &n)
+{
+    int r = 0;
+    typedef PropertyPredicate P;
+    for (Direction dir : { Outgoing, Incoming, Any }) {
+        r |= check(n, dir, P("seq"));
+        r |= check(n, dir, P("seq", P::Eq, 500));
+        r |= check(n, dir, P("seq", P::Ne, 500));
+        r |= check(n, dir, P("seq", P::Gt, 1000));
+        r |= check(n, dir, P("seq", P::Ge, 1000));
+        r |= check(n, dir, P("seq", P::Lt, 1000));
+        r |= check(n, dir, P("seq", P::Le, 1000));
+        r |= check(n, dir, P("seq", P::GeLe, 100, 200));
+        r |= check(n, dir, P("seq", P::GeLt, 100, 200));
+        r |= check(n, dir, P("seq", P::GtLe, 100, 200));
+        r |= check(n, dir, P("seq", P::GtLt, 100, 200));
+        r |= check(n, dir, P("seq", P::GtLt, 200, 100));
+    }
+    return r;
+}
+
+template <typename F>
+static int check_throws(const char *what, int expected, F f)
+{
+    try {
+        f();
+    }
+    catch (Exception e) {
+        if (e.num == expected)
+            return 0;
+        print_exception(e);
+    }
+    printf("%s: expected exception %d\n", what, expected);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf edgeordergraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        Node *hub;
+        {
+            Graph db("edgeordergraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.set_edge_order("msg", "seq", PropertyType::Integer);
+                db.set_edge_order("call", "at", PropertyType::Time);
+                hub = &db.add_node("hub");
+                Node &other = db.add_node("other");
+                db.add_edge(*hub, other, "likes");
+
+                r |= check_throws("edges exist", EdgeOrderMismatch,
+                    [&]() { db.set_edge_order("likes", "seq", PropertyType::Integer); });
+                r |= check_throws("string order", PropertyTypeInvalid,
+                    [&]() { db.set_edge_order("tag", "name", PropertyType::String); });
+                r |= check_throws("light", LightEdgeMismatch,
+                    [&]() { db.set_light_edges("msg"); });
+
+                tx.commit();
+            }
+
+            // Sequence numbers out of order, a few repeated, some edges
+            // without one, and both directions.
+            for (int b = 0; b < NUM_EDGES; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = b; i < b + BATCH; i++) {
+                    Node &n = db.add_node("leaf");
+                    Edge &e = (i % 3 == 0) ? db.add_edge(n, *hub, "msg")
+                                           : db.add_edge(*hub, n, "msg");
+                    if (i % 10 != 9)
+                        e.set_property("seq", (long long)(i * 37 % NUM_EDGES * 10));
+                    if (i % 50 == 0)
+                        e.set_property("seq", 500LL);
+                    e.set_property("size", (long long)i);
+                    Edge &c = db.add_edge(*hub, n, "call");
+                    c.set_property("at", minute(i));
+                }
+                tx.commit();
+            }
+
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                Edge &loop = db.add_edge(*hub, *hub, "msg");
+                loop.set_property("seq", 150LL);
+
+                Edge &e = db.add_edge(*hub, hub->get_neighbor(Outgoing, "likes"),
+                                      "msg");
+                r |= check_throws("property type", PropertyTypeMismatch,
+                    [&]() { e.set_property("seq", "x"); });
+                tx.commit();
+            }
+
+            {
+                Transaction tx(db);
+                r |= check_all(*hub);
+
+                // Newest calls in a window
+                std::vector<Time> times;
+                for (EdgeIterator i = hub->get_edges(Outgoing, "call",
+                        PropertyPredicate("at", PropertyPredicate::GeLt,
+                                          minute(60), minute(120)), true);
+                     i; i.next())
+                    times.push_back(i->get_property("at").time_value());
+                if (times.size() != 60 || !(times[0] == minute(119))
+                        || !(times[59] == minute(60)))
+                    r = 1;
+
+                r |= check_throws("predicate type", PropertyTypeMismatch,
+                    [&]() { hub->get_edges(Outgoing, "call",
+                                PropertyPredicate("at", PropertyPredicate::Gt, 3LL)); });
+                r |= check_throws("reverse filter", NotImplemented,
+                    [&]() { hub->get_edges(Outgoing, "msg",
+                                PropertyPredicate("size"), true); });
+                if (seqs(hub->get_edges(Outgoing, "msg",
+                        PropertyPredicate("size", PropertyPredicate::Lt, 10LL))).size() != 6)
+                    r = 1;
+                tx.commit();
+            }
+
+            // Move and drop values, and remove edges and nodes through
+            // an ordered iterator.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                int k = 0;
+                for (EdgeIterator i = hub->get_edges(Any, "msg",
+                        PropertyPredicate("seq", PropertyPredicate::Ge, 1000LL));
+                     i; i.next(), k++) {
+                    if (k % 4 == 0)
+                        db.remove(*i);
+                    else if (k % 4 == 1)
+                        i->set_property("seq", 10000LL + k);
+                    else if (k % 4 == 2)
+                        i->remove_property("seq");
+                    else {
+                        Node &n = (i->get_source() == *hub) ? i->get_destination()
+                                                            : i->get_source();
+                        db.remove(n);
+                    }
+                }
+                r |= check_all(*hub);
+                tx.commit();
+            }
+        }
+
+        Graph db("edgeordergraph");
+        Transaction tx(db, Transaction::ReadWrite);
+        r |= check_all(*hub);
+        Node &n = db.add_node("leaf");
+        db.add_edge(*hub, n, "msg").set_property("seq", 123LL);
+        if (seqs(hub->get_edges(Outgoing, "msg",
+                PropertyPredicate("seq", PropertyPredicate::Eq, 123LL))).size() != 1)
+            r = 1;
+        r |= check_all(*hub);
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
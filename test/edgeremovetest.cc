@@ -0,0 +1,138 @@
+/**
+ * @file   edgeremovetest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Test for edge removal on a hub node: remove edges in an order
+ * unrelated to insertion, then remove the hub, and check that the
+ * adjacency of every node stays consistent.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_LEAVES = 1000;
+static const int BATCH = 250;
+
+static long long count(EdgeIterator i)
+{
+    long long n = 0;
+    for (; i; i.next())
+        n++;
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf edgeremovegraph") < 0)
+        return 1;
+
+    try {
+        Graph db("edgeremovegraph", Graph::Create);
+
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            Node &hub = db.add_node("hub");
+            hub.set_property("id", 0);
+            tx.commit();
+        }
+
+        for (int i = 0; i < NUM_LEAVES; i += BATCH) {
+            Transaction tx(db, Transaction::ReadWrite);
+            Node &hub = *db.get_nodes("hub");
+            for (int j = i; j < i + BATCH; j++) {
+                Node &leaf = db.add_node("leaf");
+                db.add_edge(hub, leaf, j % 2 ? "odd" : "even");
+                db.add_edge(leaf, hub, "back");
+            }
+            tx.commit();
+        }
+
+        // Remove every third out edge, in shuffled order.
+        std::vector<int> order;
+        for (int i = 0; i < NUM_LEAVES; i += 3)
+            order.push_back(i);
+        std::shuffle(order.begin(), order.end(), std::mt19937(1));
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            std::vector<Edge *> victims;
+            Node &hub = *db.get_nodes("hub");
+            for (EdgeIterator e = hub.get_edges(Outgoing); e; e.next()) {
+                Edge &edge = *e;
+                victims.push_back(&edge);
+            }
+            for (int i : order)
+                db.remove(*victims[i]);
+            tx.commit();
+        }
+
+        {
+            Transaction tx(db);
+            Node &hub = *db.get_nodes("hub");
+            long long out = count(hub.get_edges(Outgoing));
+            long long in = count(hub.get_edges(Incoming));
+            long long odd = count(hub.get_edges(Outgoing, "odd"));
+            long long even = count(hub.get_edges(Outgoing, "even"));
+            printf("out %lld (odd %lld, even %lld) in %lld\n", out, odd, even, in);
+            if (out != NUM_LEAVES - (long long)order.size() || out != odd + even
+                    || in != NUM_LEAVES)
+                return 1;
+            tx.commit();
+        }
+
+        // Removing the hub takes every remaining edge with it.
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            db.remove(*db.get_nodes("hub"));
+            tx.commit();
+        }
+
+        Transaction tx(db);
+        for (NodeIterator n = db.get_nodes("leaf"); n; n.next())
+            if (count(n->get_edges()) != 0)
+                return 1;
+        if (count(db.get_edges()) != 0)
+            return 1;
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    printf("Test passed\n");
+    return 0;
+}
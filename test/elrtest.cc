@@ -0,0 +1,143 @@
+/**
+ * @file   elrtest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * Test for early lock release: several threads update the same node
+ * with EarlyLockRelease transactions and count durability callbacks.
+ * Then each thread updates a node of its own, so that its commits do
+ * not wait for the others.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_THREADS = 4;
+static const int NUM_TX_PER_THREAD = 200;
+
+static std::atomic<int> durable_count(0);
+static std::atomic<int> commit_count(0);
+
+static void update_thread(Graph &db, Node &node, int tid)
+{
+    for (int i = 0; i < NUM_TX_PER_THREAD; ) {
+        try {
+            Transaction tx(db, Transaction::ReadWrite
+                                   | Transaction::EarlyLockRelease);
+            // Reads don't lock the node, so write first to take the lock.
+            node.set_property("writer", tid);
+            long long v = node.get_property("count").int_value();
+            node.set_property("count", v + 1);
+            tx.commit([]() { durable_count++; });
+            commit_count++;
+            i++;
+        }
+        catch (Exception e) {
+            if (e.num != LockTimeout) {
+                print_exception(e);
+                exit(1);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf elrgraph") < 0)
+        return 1;
+
+    try {
+        {
+            Graph db("elrgraph", Graph::Create);
+            Node *node;
+            Node *own[NUM_THREADS];
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                node = &db.add_node("counter");
+                node->set_property("count", 0LL);
+                for (int i = 0; i < NUM_THREADS; i++) {
+                    own[i] = &db.add_node("own");
+                    own[i]->set_property("count", 0LL);
+                }
+                tx.commit();
+            }
+
+            std::vector<std::thread> threads;
+            for (int i = 0; i < NUM_THREADS; i++)
+                threads.push_back(std::thread(update_thread,
+                                              std::ref(db), std::ref(*node), i));
+            for (auto &t : threads)
+                t.join();
+
+            threads.clear();
+            for (int i = 0; i < NUM_THREADS; i++)
+                threads.push_back(std::thread(update_thread,
+                                              std::ref(db), std::ref(*own[i]), i));
+            for (auto &t : threads)
+                t.join();
+
+            if (durable_count != commit_count) {
+                printf("%d commits but %d durability callbacks\n",
+                       int(commit_count), int(durable_count));
+                return 1;
+            }
+        }
+
+        // Reopen and check that every update made it.
+        Graph db("elrgraph", Graph::ReadOnly);
+        Transaction tx(db);
+        NodeIterator ni = db.get_nodes("counter");
+        long long count = ni->get_property("count").int_value();
+        printf("count %lld\n", count);
+        if (count != NUM_THREADS * NUM_TX_PER_THREAD)
+            return 1;
+        int owners = 0;
+        for (NodeIterator i = db.get_nodes("own"); i; i.next()) {
+            if (i->get_property("count").int_value() != NUM_TX_PER_THREAD)
+                return 1;
+            owners++;
+        }
+        if (owners != NUM_THREADS)
+            return 1;
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    printf("Test passed\n");
+    return 0;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file   hashindextest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+
+/*
+ * Test for hash property indexes: equality queries on a hash index
+ * have to return what the same queries on an AVL index do, with
+ * enough values to split the table into several directories, as
+ * values are added, removed during iteration, and after reopening.
+ * Other predicates fall back to filtering the tag.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_NODES = 24000;
+static const int NUM_VALUES = 20000;
+static const int BATCH = 100;
+
+static long long value(int i) { return (i * 7919LL) % NUM_VALUES; }
+
+static std::string name(long long v)
+{
+    // Some longer than the inline string prefix
+    return "k" + std::to_string(v) + (v % 3 == 0 ? "-long-suffix" : "");
+}
+
+// -0.0 for 0, which has to find 0.0 too
+static double half(long long v) { return v == 0 ? -0.0 : v * 0.5; }
+
+static std::vector<NodeID> ids(Graph &db, const PropertyPredicate &pp,
+                               bool reverse = false)
+{
+    std::vector<NodeID> r;
+    for (NodeIterator i = db.get_nodes("item", pp, reverse); i; i.next())
+        r.push_back(db.get_id(*i));
+    return r;
+}
+
+static std::vector<NodeID> sorted(std::vector<NodeID> v)
+{
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+// Runs each query on the AVL properties and on the hash ones
+static int compare(Graph &db, const char *when)
+{
+    typedef PropertyPredicate PP;
+    int r = 0;
+    Transaction tx(db);
+    for (long long v = 0; v < 2 * NUM_VALUES; v += 97) {
+        std::vector<NodeID> a = ids(db, PP("a", PP::Eq, v));
+        if (a != ids(db, PP("h", PP::Eq, v))
+                || a != ids(db, PP("h", PP::Eq, v), true)
+                || a != ids(db, PP("g", PP::Eq, v == 0 ? 0.0 : half(v)))
+                || ids(db, PP("s", PP::Eq, name(v)))
+                       != ids(db, PP("t", PP::Eq, name(v)))) {
+            printf("%s: value %lld differs\n", when, v);
+            r = 1;
+        }
+    }
+
+    if (sorted(ids(db, PP("a", PP::GeLt, 100LL, 900LL)))
+            != sorted(ids(db, PP("h", PP::GeLt, 100LL, 900LL)))
+        || sorted(ids(db, PP("s", PP::Lt, "k2")))
+            != sorted(ids(db, PP("t", PP::Lt, "k2")))) {
+        printf("%s: range query differs\n", when);
+        r = 1;
+    }
+
+    Graph::IndexStats a = db.get_index_stats(Graph::NodeIndex, "item", "a");
+    for (const char *p : { "h", "g", "t" }) {
+        Graph::IndexStats h = db.get_index_stats(Graph::NodeIndex, "item", p);
+        if (a.total_elements != h.total_elements
+                || a.total_unique_entries != h.total_unique_entries) {
+            printf("%s: stats for %s differ\n", when, p);
+            r = 1;
+        }
+    }
+    return r;
+}
+
+static void set(Node &n, long long v)
+{
+    n.set_property("a", v);
+    n.set_property("h", v);
+    n.set_property("g", half(v));
+    n.set_property("s", name(v));
+    n.set_property("t", name(v));
+}
+
+static void clear(Node &n)
+{
+    for (const char *p : { "a", "h", "g", "s", "t" })
+        n.remove_property(p);
+}
+
+int main(int argc, char **argv)
+{
+    // With -r, only reopen and check an existing graph.
+    bool create = !(argc > 1 && strcmp(argv[1], "-r") == 0);
+
+    if (create && system("rm -rf hashindexgraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        if (create) {
+            Graph db("hashindexgraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "item", "a", PropertyType::Integer);
+                db.create_index(Graph::NodeIndex, "item", "h", PropertyType::Integer,
+                                Graph::Hash);
+                db.create_index(Graph::NodeIndex, "item", "g", PropertyType::Float,
+                                Graph::Hash);
+                db.create_index(Graph::NodeIndex, "item", "s", PropertyType::String);
+                db.create_index(Graph::NodeIndex, "item", "t", PropertyType::String,
+                                Graph::Hash);
+                tx.commit();
+            }
+            for (int b = 0; b < NUM_NODES; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = b; i < b + BATCH; i++)
+                    set(db.add_node("item"), value(i));
+                tx.commit();
+            }
+            r |= compare(db, "added");
+
+            // An aborted batch, with its splits, leaves nothing behind.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = 0; i < BATCH; i++)
+                    set(db.add_node("item"), NUM_VALUES + i * 97);
+            }
+            r |= compare(db, "aborted");
+
+            // Removing values under a hash iterator
+            for (long long v = 0; v < NUM_VALUES; v += 97 * 3) {
+                Transaction tx(db, Transaction::ReadWrite);
+                PropertyPredicate pp("h", PropertyPredicate::Eq, v);
+                for (NodeIterator i = db.get_nodes("item", pp); i; i.next()) {
+                    clear(*i);
+                    try {
+                        i->get_id();
+                        r = 1;
+                    }
+                    catch (Exception e) {
+                        if (e.num != VacantIterator)
+                            throw;
+                    }
+                }
+                tx.commit();
+            }
+            // And all the values of a part of the table
+            for (int b = 0; b < NUM_NODES / 4; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = b; i < b + BATCH; i++) {
+                    PropertyPredicate pp("a", PropertyPredicate::Eq, value(i));
+                    for (NodeIterator n = db.get_nodes("item", pp); n; n.next())
+                        clear(*n);
+                }
+                tx.commit();
+            }
+            r |= compare(db, "removed");
+
+            // Changing values to new ones under a hash iterator
+            for (long long v = 97; v < NUM_VALUES; v += 97 * 3) {
+                Transaction tx(db, Transaction::ReadWrite);
+                PropertyPredicate pp("h", PropertyPredicate::Eq, v);
+                for (NodeIterator i = db.get_nodes("item", pp); i; i.next())
+                    set(*i, v + NUM_VALUES);
+                tx.commit();
+            }
+            r |= compare(db, "changed");
+        }
+
+        Graph db("hashindexgraph");
+        r |= compare(db, "reopened");
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
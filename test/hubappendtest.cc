@@ -0,0 +1,310 @@
+/**
+ * @file   hubappendtest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+/*
+ * Test for edge adds to a hub node that only read lock the node:
+ * the appended edges are seen, found and removed like any other,
+ * another transaction can get at the hub while one is adding, and
+ * two transactions can add to it at once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_LEAVES = 200;
+static const int NUM_FIRST = 100;
+
+static long long count(EdgeIterator i)
+{
+    long long n = 0;
+    for (; i; i.next())
+        n++;
+    return n;
+}
+
+static int check(const char *what, long long got, long long expected)
+{
+    if (got != expected) {
+        printf("%s: expected %lld, got %lld\n", what, expected, got);
+        return 1;
+    }
+    return 0;
+}
+
+static std::atomic<int> step(0);
+
+static void wait_for(int s)
+{
+    while (step < s)
+        std::this_thread::yield();
+}
+
+// Adds an edge out of the hub and holds on to it until the reader
+// is done.
+static void writer(Graph &db, Node &hub, Node &leaf, int &r)
+{
+    try {
+        Transaction tx(db, Transaction::ReadWrite);
+        db.add_edge(hub, leaf, "link");
+        step = 1;
+        wait_for(2);
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        r = 1;
+        step = 2;
+    }
+}
+
+static void reader(Graph &db, int &r)
+{
+    wait_for(1);
+    try {
+        Transaction tx(db);
+        Node &hub = *db.get_nodes("hub");
+        r |= check("in edges while adding", count(hub.get_edges(Incoming)), 1);
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        r = 1;
+    }
+    step = 2;
+}
+
+// Two writers add to the hub at once. The first holds its
+// transaction open across both of the second's. It adds an edge
+// elsewhere before the second starts, so that they get different
+// allocator instances, and the second's first transaction takes a
+// slab of the edge table for its instance.
+static void first_writer(Graph &db, Node &hub, Node &leaf,
+                         Node &other1, Node &other2, int &r)
+{
+    try {
+        Transaction tx(db, Transaction::ReadWrite);
+        db.add_edge(other1, other2, "back");
+        step = 3;
+        wait_for(4);
+        db.add_edge(hub, leaf, "link");
+        step = 5;
+        wait_for(6);
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        r = 1;
+        step = 6;
+    }
+}
+
+static void second_writer(Graph &db, Node &hub, Node &leaf1, Node &leaf2,
+                          int &r)
+{
+    wait_for(3);
+    try {
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            db.add_edge(hub, leaf1, "link");
+            tx.commit();
+        }
+        step = 4;
+        wait_for(5);
+        Transaction tx(db, Transaction::ReadWrite);
+        db.add_edge(hub, leaf2, "link");
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        r = 1;
+    }
+    step = 6;
+}
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf hubappendgraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        // Concurrent writers need an allocator instance each.
+        Graph::Config config;
+        config.num_allocators = std::min(2u, std::thread::hardware_concurrency());
+        Graph db("hubappendgraph", Graph::Create, &config);
+
+        std::vector<Node *> leaves;
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            Node &hub = db.add_node("hub");
+            for (int i = 0; i < NUM_LEAVES; i++)
+                leaves.push_back(&db.add_node("leaf"));
+            for (int i = 0; i < NUM_FIRST; i++)
+                db.add_edge(hub, *leaves[i], "link");
+            db.add_edge(*leaves[0], hub, "back");
+            tx.commit();
+        }
+
+        // The hub is busy now, so these go in a segment.
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            Node &hub = *db.get_nodes("hub");
+            for (int i = NUM_FIRST; i < NUM_LEAVES; i++)
+                db.add_edge(hub, *leaves[i], "link");
+            db.add_edge(hub, *leaves[0], "link");
+            tx.commit();
+        }
+
+        {
+            Transaction tx(db);
+            Node &hub = *db.get_nodes("hub");
+            r |= check("out edges", count(hub.get_edges(Outgoing, "link")),
+                       NUM_LEAVES + 1);
+            r |= check("all edges", count(hub.get_edges()), NUM_LEAVES + 2);
+            r |= check("edges to leaf 0",
+                       count(hub.get_edges_to(*leaves[0], Outgoing, "link")), 2);
+            r |= check("edges to last leaf",
+                       count(hub.get_edges_to(*leaves[NUM_LEAVES - 1], Any, 0)), 1);
+            r |= check("neighbors", hub.get_sorted_neighbors(Outgoing).size(),
+                       NUM_LEAVES);
+            tx.commit();
+        }
+
+        // Remove edges from both the main list and the segment, and
+        // a whole leaf.
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            Node &hub = *db.get_nodes("hub");
+            for (EdgeIterator e = hub.get_edges_to(*leaves[0], Outgoing, 0); e; e.next())
+                db.remove(*e);
+            for (int i = 1; i < NUM_LEAVES; i += 2)
+                db.remove(*leaves[i]);
+            tx.commit();
+        }
+
+        {
+            Transaction tx(db);
+            Node &hub = *db.get_nodes("hub");
+            r |= check("out edges after remove",
+                       count(hub.get_edges(Outgoing, "link")), NUM_LEAVES / 2 - 1);
+            r |= check("neighbors after remove",
+                       hub.get_sorted_neighbors(Outgoing).size(), NUM_LEAVES / 2 - 1);
+            tx.commit();
+        }
+
+        // A reader gets the hub while another transaction is adding
+        // an edge to it.
+        {
+            Node *hub;
+            {
+                Transaction tx(db);
+                hub = &*db.get_nodes("hub");
+                tx.commit();
+            }
+            int rw = 0, rr = 0;
+            std::thread w(writer, std::ref(db), std::ref(*hub),
+                          std::ref(*leaves[2]), std::ref(rw));
+            std::thread rd(reader, std::ref(db), std::ref(rr));
+            w.join();
+            rd.join();
+            r |= rw | rr;
+
+            Transaction tx(db);
+            r |= check("edges to leaf 2",
+                       count(hub->get_edges_to(*leaves[2], Outgoing, "link")), 2);
+            tx.commit();
+        }
+
+        if (config.num_allocators > 1) {
+            Node *hub;
+            {
+                Transaction tx(db);
+                hub = &*db.get_nodes("hub");
+                tx.commit();
+            }
+            // The leaves the writers add to at once are far apart, so
+            // that their neighbor tree entries are not on one lock stripe.
+            const int added[] = { 4, 6, 100 };
+            int r1 = 0, r2 = 0;
+            std::thread w1(first_writer, std::ref(db), std::ref(*hub),
+                           std::ref(*leaves[added[1]]), std::ref(*leaves[10]),
+                           std::ref(*leaves[12]), std::ref(r1));
+            std::thread w2(second_writer, std::ref(db), std::ref(*hub),
+                           std::ref(*leaves[added[0]]),
+                           std::ref(*leaves[added[2]]), std::ref(r2));
+            w1.join();
+            w2.join();
+            r |= r1 | r2;
+
+            Transaction tx(db);
+            r |= check("out edges after concurrent adds",
+                       count(hub->get_edges(Outgoing, "link")), NUM_LEAVES / 2 + 3);
+            r |= check("tagged edges after concurrent adds",
+                       count(db.get_edges("link")), NUM_LEAVES / 2 + 3);
+            r |= check("all edges after concurrent adds",
+                       count(db.get_edges()), NUM_LEAVES / 2 + 5);
+            for (int i : added)
+                r |= check("edges to leaf",
+                           count(hub->get_edges_to(*leaves[i], Outgoing, "link")), 2);
+            tx.commit();
+        }
+
+        // Removing the hub frees its segments.
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            db.remove(*db.get_nodes("hub"));
+            tx.commit();
+        }
+
+        {
+            Transaction tx(db);
+            r |= check("leaf 2 edges", count(leaves[2]->get_edges()), 0);
+            tx.commit();
+        }
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
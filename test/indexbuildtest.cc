@@ -0,0 +1,425 @@
+/**
+ * @file   indexbuildtest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+
+/*
+ * Test for building indexes over existing objects: an index created
+ * on a populated graph has to find what checking every object does,
+ * for each index kind, composite and edge indexes, and indexes on
+ * tag 0, and keep doing so as values change afterwards and after
+ * reopening. Also checks that a creation waits for a transaction
+ * that changed a property first, and sees its change, and that a
+ * small journal holds the creation of an index with many values.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+typedef PropertyPredicate PP;
+
+static const int NUM_NODES = 30000;
+static const int BATCH = 100;
+
+static std::string name(int i)
+{
+    // Some longer than the inline string prefix
+    return (i % 4 == 0 ? "n-long-name-" : "n") + std::to_string(i % 3000);
+}
+
+static void set(Node &n, int i)
+{
+    if (i % 13 != 0) {
+        n.set_property("a", (long long)(i * 7919 % 7000));
+        n.set_property("b", (long long)(i * 7919 % 7000));
+        n.set_property("h", (long long)(i * 7919 % 7000));
+    }
+    n.set_property("s", name(i));
+    n.set_property("f", (i % 200 - 100) * 0.25);
+    n.set_property("uid", (long long)i);
+    n.set_property("dup", (long long)(i % 100));
+    n.set_property("g", (long long)(i % 50));
+    if (i % 5 == 0)
+        n.set_property("flag", i % 10 == 0);
+}
+
+template <typename F>
+static int check_throws(const char *what, int expected, F f)
+{
+    try {
+        f();
+    }
+    catch (Exception e) {
+        if (e.num == expected)
+            return 0;
+        print_exception(e);
+    }
+    printf("%s: expected exception %d\n", what, expected);
+    return 1;
+}
+
+template <typename I>
+static std::vector<uint64_t> sorted_ids(Graph &db, I i)
+{
+    std::vector<uint64_t> r;
+    for (; i; i.next())
+        r.push_back(db.get_id(*i));
+    std::sort(r.begin(), r.end());
+    return r;
+}
+
+// The nodes found through the index, in order of the property,
+// against every node with the tag checked
+static int check(Graph &db, StringID tag, const std::vector<PP> &preds,
+                 const char *when)
+{
+    std::vector<uint64_t> found;
+    for (NodeIterator i = db.get_nodes(tag, preds); i; i.next())
+        found.push_back(db.get_id(*i));
+    std::vector<uint64_t> expected;
+    for (NodeIterator i = db.get_nodes(tag); i; i.next()) {
+        bool pass = true;
+        for (const PP &pp : preds)
+            if (PropertyFilter<Node>(pp)(*i) != Pass)
+                pass = false;
+        if (pass)
+            expected.push_back(db.get_id(*i));
+    }
+    std::sort(found.begin(), found.end());
+    if (found != expected) {
+        printf("%s: %s query found %zu nodes, expected %zu\n", when,
+               preds[0].id.name().c_str(), found.size(), expected.size());
+        return 1;
+    }
+    return 0;
+}
+
+static int check_order(Graph &db, const PP &pp, const char *when)
+{
+    Property last;
+    bool first = true;
+    for (NodeIterator i = db.get_nodes("item", pp); i; i.next()) {
+        Property p = i->get_property(pp.id);
+        if (!first && p < last) {
+            printf("%s: %s out of order\n", when, pp.id.name().c_str());
+            return 1;
+        }
+        last = p;
+        first = false;
+    }
+    return 0;
+}
+
+static int compare(Graph &db, const char *when)
+{
+    int r = 0;
+    Transaction tx(db);
+    for (long long v = 0; v < 7000; v += 331) {
+        r |= check(db, "item", { PP("a", PP::Eq, v) }, when);
+        r |= check(db, "item", { PP("b", PP::Eq, v) }, when);
+        r |= check(db, "item", { PP("h", PP::Eq, v) }, when);
+    }
+    r |= check(db, "item", { PP("a", PP::GeLt, 100LL, 900LL) }, when);
+    r |= check(db, "item", { PP("b", PP::GtLe, 6000LL, 7000LL) }, when);
+    r |= check(db, "item", { PP("s", PP::Eq, name(17)) }, when);
+    r |= check(db, "item", { PP("s", PP::Lt, "n2") }, when);
+    r |= check(db, "item", { PP("f", PP::GeLe, -5.0, 5.0) }, when);
+    r |= check(db, "item", { PP("flag", PP::Eq, true) }, when);
+    r |= check(db, "item", { PP("uid", PP::Eq, 12345LL) }, when);
+    r |= check(db, "item", { PP("s", PP::Eq, name(8)), PP("f", PP::Gt, 0.0) }, when);
+    r |= check(db, "item", { PP("s", PP::Eq, name(12)), PP("f", PP::Le, 10.0) }, when);
+    r |= check(db, "other", { PP("g", PP::Eq, 7LL) }, when);
+    r |= check(db, "item", { PP("g", PP::Eq, 7LL) }, when);
+    r |= check_order(db, PP("b", PP::Ge, 3500LL), when);
+    r |= check_order(db, PP("s", PP::Gt, "n1"), when);
+
+    std::vector<uint64_t> w;
+    for (EdgeIterator i = db.get_edges("link"); i; i.next())
+        if (i->get_property("w").int_value() == 3)
+            w.push_back(db.get_id(*i));
+    std::sort(w.begin(), w.end());
+    if (sorted_ids(db, db.get_edges("link", PP("w", PP::Eq, 3LL))) != w) {
+        printf("%s: edge query differs\n", when);
+        r = 1;
+    }
+
+    // The counts of values and objects match the plain indexes.
+    Graph::IndexStats a = db.get_index_stats(Graph::NodeIndex, "item", "a");
+    for (const char *p : { "b", "h" }) {
+        Graph::IndexStats s = db.get_index_stats(Graph::NodeIndex, "item", p);
+        if (s.total_elements != a.total_elements
+                || s.total_unique_entries != a.total_unique_entries) {
+            printf("%s: stats for %s differ\n", when, p);
+            r = 1;
+        }
+    }
+    return r;
+}
+
+// The fill logs about one journal entry for each page of the
+// allocator it takes objects from, rather than a few for each value,
+// so a small journal holds the creation of big indexes.
+static int small_journal()
+{
+    static const int NUM_VALUES = 100000;
+    Graph::Config config;
+    config.journal_size = 16 * 1024 * 1024;
+    Graph db("indexbuildjournalgraph", Graph::Create, &config);
+    for (int b = 0; b < NUM_VALUES; b += 1000) {
+        Transaction tx(db, Transaction::ReadWrite);
+        for (int i = b; i < b + 1000; i++)
+            db.add_node("value").set_property("v", (long long)i);
+        tx.commit();
+    }
+    {
+        Transaction tx(db, Transaction::ReadWrite);
+        db.create_index(Graph::NodeIndex, "value", "v", PropertyType::Integer,
+                        Graph::Hash);
+        tx.commit();
+    }
+
+    int r = 0;
+    Transaction tx(db);
+    for (long long v = 0; v < NUM_VALUES; v += 9973)
+        r |= check(db, "value", { PP("v", PP::Eq, v) }, "small journal");
+    Graph::IndexStats s = db.get_index_stats(Graph::NodeIndex, "value", "v");
+    if (s.total_unique_entries != NUM_VALUES) {
+        printf("small journal: %zu values, expected %d\n",
+               (size_t)s.total_unique_entries, NUM_VALUES);
+        r = 1;
+    }
+    return r;
+}
+
+static std::atomic<int> step(0);
+
+static void wait_for(int s)
+{
+    while (step < s)
+        usleep(1000);
+}
+
+// Holds a change to a property until the main thread has seen its
+// creation of an index on it wait
+static void writer(Graph &db, int &r)
+{
+    try {
+        Transaction tx(db, Transaction::ReadWrite);
+        Node &n = *db.get_nodes("item", PP("uid", PP::Eq, 78LL));
+        n.set_property("late", 77LL);
+        step = 1;
+        wait_for(2);
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        r = 1;
+    }
+    step = 3;
+}
+
+int main(int argc, char **argv)
+{
+    // With -r, only reopen and check an existing graph.
+    bool create = !(argc > 1 && strcmp(argv[1], "-r") == 0);
+
+    if (create && system("rm -rf indexbuildgraph indexbuildjournalgraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        if (create) {
+            // Each index is filled in the transaction that creates it,
+            // so the journal has to hold the new entries.
+            Graph::Config config;
+            config.journal_size = 1024 * 1024 * 1024;
+            Graph db("indexbuildgraph", Graph::Create, &config);
+            for (int b = 0; b < NUM_NODES; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                Node *prev = NULL;
+                for (int i = b; i < b + BATCH; i++) {
+                    Node &n = db.add_node(i % 7 == 0 ? "other" : "item");
+                    set(n, i);
+                    if (prev != NULL)
+                        db.add_edge(*prev, n, "link").set_property("w", (long long)(i % 10));
+                    prev = &n;
+                }
+                tx.commit();
+            }
+            // Leave some free slots in the table.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (long long v = 0; v < NUM_NODES; v += 97)
+                    for (NodeIterator i = db.get_nodes("item", PP("uid", PP::Eq, v));
+                            i; i.next())
+                        db.remove(*i);
+                tx.commit();
+            }
+
+            // An aborted creation leaves no index behind.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "item", "a", PropertyType::Integer);
+            }
+            {
+                Transaction tx(db);
+                if (db.get_index_stats(Graph::NodeIndex, "item", "a").total_elements != 0) {
+                    printf("aborted index still there\n");
+                    r = 1;
+                }
+            }
+
+            // One transaction each, to stay within the journal
+            auto create = [&](std::function<void()> f) {
+                Transaction tx(db, Transaction::ReadWrite);
+                f();
+                tx.commit();
+            };
+            create([&]{ db.create_index(Graph::NodeIndex, "item", "a",
+                                        PropertyType::Integer); });
+            create([&]{ db.create_index(Graph::NodeIndex, "item", "b",
+                                        PropertyType::Integer, Graph::BPlusTree); });
+            create([&]{ db.create_index(Graph::NodeIndex, "item", "h",
+                                        PropertyType::Integer, Graph::Hash); });
+            create([&]{ db.create_index(Graph::NodeIndex, "item", "s",
+                                        PropertyType::String, Graph::BPlusTree); });
+            create([&]{ db.create_index(Graph::NodeIndex, "item", "f",
+                                        PropertyType::Float); });
+            create([&]{ db.create_index(Graph::NodeIndex, "item", "flag",
+                                        PropertyType::Boolean, Graph::BPlusTree); });
+            create([&]{ db.create_index(Graph::NodeIndex, "item", "uid",
+                                        PropertyType::Integer, Graph::BPlusTree,
+                                        true); });
+            create([&]{ db.create_index(Graph::NodeIndex, 0, "g",
+                                        PropertyType::Integer, Graph::Hash); });
+            create([&]{ db.create_index(Graph::NodeIndex, "item",
+                                        { { "s", PropertyType::String },
+                                          { "f", PropertyType::Float } }); });
+            create([&]{ db.create_index(Graph::EdgeIndex, "link", "w",
+                                        PropertyType::Integer, Graph::BPlusTree); });
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                r |= check_throws("duplicates", NotUnique, [&]() {
+                    db.create_index(Graph::NodeIndex, "item", "dup", PropertyType::Integer,
+                                    Graph::AvlIndex, true); });
+            }
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                r |= check_throws("type", PropertyTypeMismatch, [&]() {
+                    db.create_index(Graph::NodeIndex, "item", "dup", PropertyType::String); });
+            }
+            r |= compare(db, "built");
+
+            // Changes after the build, enough to split the loaded nodes
+            for (int b = 0; b < NUM_NODES; b += 3 * BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = b; i < b + BATCH; i++) {
+                    Node &n = db.add_node("item");
+                    set(n, i + NUM_NODES);
+                }
+                tx.commit();
+            }
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (NodeIterator i = db.get_nodes("item", PP("b", PP::Lt, 2000LL)); i; i.next())
+                    i->set_property("b", i->get_property("b").int_value() + 9000);
+                for (NodeIterator i = db.get_nodes("item", PP("s", PP::Eq, name(8))); i; i.next())
+                    i->remove_property("s");
+                tx.commit();
+            }
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (NodeIterator i = db.get_nodes("item", PP("b", PP::Ge, 9000LL)); i; i.next())
+                    i->set_property("b", i->get_property("b").int_value() - 9000);
+                tx.commit();
+            }
+            r |= compare(db, "changed");
+
+            // A creation waits for a transaction that has changed the
+            // property, and sees the change once it is committed.
+            int wr = 0;
+            std::thread w(writer, std::ref(db), std::ref(wr));
+            wait_for(1);
+            bool waited = false;
+            for (;;) {
+                try {
+                    Transaction tx(db, Transaction::ReadWrite);
+                    db.create_index(Graph::NodeIndex, "item", "late", PropertyType::Integer);
+                    tx.commit();
+                    break;
+                }
+                catch (Exception e) {
+                    if (e.num != LockTimeout)
+                        throw;
+                    waited = true;
+                    step = 2;
+                    wait_for(3);
+                }
+            }
+            step = 2;
+            w.join();
+            r |= wr;
+            {
+                Transaction tx(db);
+                if (!waited || sorted_ids(db, db.get_nodes("item", PP("late", PP::Eq, 77LL)))
+                                    != sorted_ids(db, db.get_nodes("item", PP("uid", PP::Eq, 78LL)))) {
+                    printf("creation missed a concurrent change\n");
+                    r = 1;
+                }
+            }
+        }
+
+        Graph db("indexbuildgraph");
+        r |= compare(db, "reopened");
+        if (create)
+            r |= small_journal();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
@@ -193,6 +193,35 @@ int main(int argc, char **argv)
             printf("\tConfirming searched prop value: %lld\n", i->get_property("id1").int_value());
         }
 
+        // An excluded or crossed bound that is a key in the tree
+        // must not bring in that key's nodes.
+        int empty_count = 0;
+        printf("## Trying iterator with tag tag1 and property range:203-203 (empty) with GELT\n");
+        PropertyPredicate pp17("id1", PropertyPredicate::GeLt, 203, 203);
+        for (NodeIterator i = db.get_nodes("tag1", pp17); i; i.next()) {
+            printf("Node %" PRIu64 ": tag %s\n", db.get_id(*i), i->get_tag().name().c_str());
+            empty_count++;
+        }
+
+        printf("## Trying iterator with tag tag1 and property range:210-202 (crossed) with GELT\n");
+        PropertyPredicate pp18("id1", PropertyPredicate::GeLt, 210, 202);
+        for (NodeIterator i = db.get_nodes("tag1", pp18); i; i.next()) {
+            printf("Node %" PRIu64 ": tag %s\n", db.get_id(*i), i->get_tag().name().c_str());
+            empty_count++;
+        }
+
+        printf("## Trying iterator with tag tag1 and property range:203-203 (empty) with GTLE\n");
+        PropertyPredicate pp19("id1", PropertyPredicate::GtLe, 203, 203);
+        for (NodeIterator i = db.get_nodes("tag1", pp19); i; i.next()) {
+            printf("Node %" PRIu64 ": tag %s\n", db.get_id(*i), i->get_tag().name().c_str());
+            empty_count++;
+        }
+
+        if (empty_count > 0) {
+            printf("Empty ranges returned %d nodes\n", empty_count);
+            return 1;
+        }
+
         tx.commit();
     }
     catch (Exception e) {
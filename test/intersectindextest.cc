@@ -0,0 +1,249 @@
+/**
+ * @file   intersectindextest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+
+/*
+ * Test for queries with several predicates that single property
+ * indexes serve: the objects have to be the ones that match all the
+ * predicates, in the order of the index for the first predicate that
+ * has one, or of the composite index, both ways. Indexes of every
+ * kind take part, with predicates that no index serves mixed in, as
+ * objects are changed and removed during iteration, and after
+ * reopening.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+typedef PropertyPredicate PP;
+
+static const int NUM_NODES = 6000;
+static const int BATCH = 100;
+
+static void set(Node &n, long long i)
+{
+    n.set_property("x", (i * 7919) % 1000);          // AVL
+    n.set_property("y", i % 7);                      // Hash
+    n.set_property("z", "n" + std::to_string(i % 50)); // B+-tree
+    n.set_property("c", i % 13);                     // Counted AVL
+    n.set_property("w", i % 5);                      // No index
+    n.set_property("p", i % 3);                      // Composite (p, q)
+    n.set_property("q", (i * 31) % 100);
+}
+
+// Whether the node matches pp, looked at directly
+static bool matches(Node &n, const PP &pp)
+{
+    Property p;
+    if (!n.check_property(pp.id, p))
+        return false;
+    if (p.type() == PropertyType::String) {
+        const std::string &s = p.string_value();
+        const std::string &v = pp.v1.string_value();
+        switch (pp.op) {
+            case PP::Eq: return s == v;
+            case PP::Prefix: return s.compare(0, v.size(), v) == 0;
+            case PP::Lt: return s < v;
+            default: abort();
+        }
+    }
+    long long v = p.int_value();
+    long long a = pp.v1.int_value();
+    switch (pp.op) {
+        case PP::Eq: return v == a;
+        case PP::Ne: return v != a;
+        case PP::Lt: return v < a;
+        case PP::Ge: return v >= a;
+        case PP::GeLt: return v >= a && v < pp.v2.int_value();
+        default: abort();
+    }
+}
+
+static std::vector<NodeID> ids(Graph &db, NodeIterator i)
+{
+    std::vector<NodeID> r;
+    for (; i; i.next())
+        r.push_back(db.get_id(*i));
+    return r;
+}
+
+// The ids of the nodes that match all of preds, in the order of
+// the single predicate query for order
+static std::vector<NodeID> expected(Graph &db, const std::vector<PP> &preds,
+                                    const std::vector<PP> &order, bool reverse)
+{
+    std::vector<NodeID> r;
+    for (NodeIterator i = db.get_nodes("item", order, reverse); i; i.next()) {
+        bool all = true;
+        for (const PP &pp : preds)
+            all = all && matches(*i, pp);
+        if (all)
+            r.push_back(db.get_id(*i));
+    }
+    return r;
+}
+
+struct Query {
+    std::vector<PP> preds;
+    std::vector<PP> order;  // What gives the order
+};
+
+static std::vector<Query> queries()
+{
+    return {
+        { { PP("x", PP::GeLt, 100LL, 600LL), PP("y", PP::Eq, 3LL) },
+          { PP("x", PP::GeLt, 100LL, 600LL) } },
+        { { PP("y", PP::Eq, 3LL), PP("x", PP::GeLt, 100LL, 600LL) },
+          { PP("y", PP::Eq, 3LL) } },
+        // Hash serves only Eq, so x gives the order.
+        { { PP("y", PP::Ne, 3LL), PP("x", PP::Lt, 400LL), PP("c", PP::Ge, 5LL) },
+          { PP("x", PP::Lt, 400LL) } },
+        { { PP("w", PP::Eq, 2LL), PP("c", PP::Eq, 4LL), PP("z", PP::Prefix, "n1") },
+          { PP("c", PP::Eq, 4LL) } },
+        { { PP("z", PP::Lt, "n3"), PP("w", PP::Ne, 0LL), PP("x", PP::Ge, 500LL),
+            PP("y", PP::Eq, 1LL) },
+          { PP("z", PP::Lt, "n3") } },
+        { { PP("p", PP::Eq, 1LL), PP("q", PP::GeLt, 20LL, 70LL),
+            PP("c", PP::Lt, 6LL), PP("w", PP::Eq, 3LL) },
+          { PP("p", PP::Eq, 1LL), PP("q", PP::GeLt, 20LL, 70LL) } },
+        { { PP("x", PP::Eq, 5000LL), PP("y", PP::Eq, 1LL) },
+          { PP("x", PP::Eq, 5000LL) } },
+        { { PP("c", PP::Eq, 1LL), PP("c", PP::Eq, 2LL) },
+          { PP("c", PP::Eq, 1LL) } },
+    };
+}
+
+static int compare(Graph &db, const char *when)
+{
+    int r = 0;
+    Transaction tx(db);
+    std::vector<Query> qs = queries();
+    for (size_t q = 0; q < qs.size(); q++) {
+        for (bool reverse : { false, true }) {
+            std::vector<NodeID> e = expected(db, qs[q].preds, qs[q].order, reverse);
+            if (ids(db, db.get_nodes("item", qs[q].preds, reverse)) != e) {
+                printf("%s: query %zu%s differs\n", when, q,
+                       reverse ? " reversed" : "");
+                r = 1;
+            }
+        }
+    }
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    // With -r, only reopen and check an existing graph.
+    bool create = !(argc > 1 && strcmp(argv[1], "-r") == 0);
+
+    if (create && system("rm -rf intersectindexgraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        if (create) {
+            Graph db("intersectindexgraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "item", "x", PropertyType::Integer);
+                db.create_index(Graph::NodeIndex, "item", "y", PropertyType::Integer,
+                                Graph::Hash);
+                db.create_index(Graph::NodeIndex, "item", "z", PropertyType::String,
+                                Graph::BPlusTree);
+                db.create_index(Graph::NodeIndex, "item", "c", PropertyType::Integer,
+                                Graph::CountedAvl);
+                db.create_index(Graph::NodeIndex, "item",
+                                { { "p", PropertyType::Integer },
+                                  { "q", PropertyType::Integer } });
+                tx.commit();
+            }
+            for (int b = 0; b < NUM_NODES; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = b; i < b + BATCH; i++)
+                    set(db.add_node("item"), i);
+                tx.commit();
+            }
+            r |= compare(db, "added");
+
+            // Changing an indexed property that narrowed the query,
+            // and one that did not, under the iterator
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                std::vector<PP> preds = { PP("x", PP::GeLt, 100LL, 600LL),
+                                          PP("y", PP::Eq, 3LL) };
+                for (NodeIterator i = db.get_nodes("item", preds); i; i.next()) {
+                    Node &n = *i;
+                    n.set_property("y", 4LL);
+                    n.set_property("w", 2LL);
+                }
+                tx.commit();
+            }
+            r |= compare(db, "changed");
+
+            // Removing nodes under the iterator
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                std::vector<PP> preds = { PP("c", PP::Eq, 4LL),
+                                          PP("z", PP::Prefix, "n1") };
+                for (NodeIterator i = db.get_nodes("item", preds, true); i; i.next())
+                    db.remove(*i);
+                tx.commit();
+            }
+            {
+                Transaction tx(db);
+                std::vector<PP> preds = { PP("c", PP::Eq, 4LL),
+                                          PP("z", PP::Prefix, "n1") };
+                if (db.get_nodes("item", preds))
+                    r = 1;
+            }
+            r |= compare(db, "removed");
+        }
+
+        Graph db("intersectindexgraph");
+        r |= compare(db, "reopened");
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
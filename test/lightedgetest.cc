@@ -0,0 +1,219 @@
+/**
+ * @file   lightedgetest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+/*
+ * Test for light edges: edges of a tag that are kept only in the
+ * adjacency of their ends, with no edge record.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_LEAVES = 100;
+
+static long long count(EdgeIterator i)
+{
+    long long n = 0;
+    for (; i; i.next())
+        n++;
+    return n;
+}
+
+static int check(const char *what, long long got, long long expected)
+{
+    if (got != expected) {
+        printf("%s: expected %lld, got %lld\n", what, expected, got);
+        return 1;
+    }
+    return 0;
+}
+
+// Runs f and checks that it throws the given exception
+template <typename F>
+static int check_throws(const char *what, int expected, F f)
+{
+    try {
+        f();
+    }
+    catch (Exception e) {
+        if (e.num == expected)
+            return 0;
+        print_exception(e);
+    }
+    printf("%s: expected exception %d\n", what, expected);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf lightedgegraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        Node *a, *b, *c, *hub;
+        std::vector<Node *> leaves;
+        {
+            Graph db("lightedgegraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.set_light_edges("follows");
+                a = &db.add_node("person");
+                b = &db.add_node("person");
+                c = &db.add_node("person");
+                hub = &db.add_node("hub");
+                db.add_light_edge(*a, *b, "follows");
+                db.add_light_edge(*a, *b, "follows");
+                db.add_light_edge(*b, *c, "follows");
+                db.add_light_edge(*c, *c, "follows");
+                Edge &likes = db.add_edge(*a, *b, "likes");
+                likes.set_property("weight", 3);
+
+                r |= check_throws("add_edge", LightEdgeMismatch,
+                    [&]() { db.add_edge(*a, *b, "follows"); });
+                r |= check_throws("add_light_edge", LightEdgeMismatch,
+                    [&]() { db.add_light_edge(*a, *b, "likes"); });
+                r |= check_throws("set_light_edges", LightEdgeMismatch,
+                    [&]() { db.set_light_edges("likes"); });
+                r |= check_throws("create_index", LightEdgeMismatch,
+                    [&]() { db.create_index(Graph::EdgeIndex, "follows",
+                                            "weight", PropertyType::Integer); });
+
+                for (int i = 0; i < NUM_LEAVES; i++) {
+                    leaves.push_back(&db.add_node("leaf"));
+                    db.add_light_edge(*hub, *leaves[i], "follows");
+                }
+                tx.commit();
+            }
+
+            // The hub is busy now, so these take the append path. The
+            // batch mixes light and full edges.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                std::vector<Graph::EdgeSpec> specs;
+                for (int i = 0; i < NUM_LEAVES; i++)
+                    specs.push_back({ *hub, *leaves[i], "follows" });
+                specs.push_back({ *hub, *a, "likes" });
+                int records = 0;
+                db.add_edges(specs, [&records](Edge &) { records++; });
+                r |= check("batch records", records, 1);
+                tx.commit();
+            }
+
+            {
+                Transaction tx(db);
+                r |= check("a follows", count(a->get_edges(Outgoing, "follows")), 2);
+                r |= check("b followers", count(b->get_edges(Incoming, "follows")), 2);
+                r |= check("c follows", count(c->get_edges(Any, "follows")), 3);
+                r |= check("a to b", count(a->get_edges_to(*b)), 3);
+                r |= check("b to a", count(b->get_edges_to(*a, Incoming, "follows")), 2);
+                r |= check("graph edges", count(db.get_edges()), 2);
+                r |= check("graph follows", count(db.get_edges("follows")), 0);
+                r |= check("hub follows", count(hub->get_edges(Outgoing, "follows")),
+                           2 * NUM_LEAVES);
+                r |= check("hub to leaf", count(hub->get_edges_to(*leaves[7])), 2);
+                r |= check("hub neighbors", hub->get_sorted_neighbors(Outgoing).size(),
+                           NUM_LEAVES + 1);
+
+                for (EdgeIterator e = b->get_edges_to(*a); e; e.next()) {
+                    if (e->get_source() != *a || e->get_destination() != *b)
+                        r = 1;
+                    if (e->get_tag() == StringID("follows")) {
+                        Property p;
+                        if (!e->is_light() || e->check_property("weight", p)
+                                || e->get_properties())
+                            r = 1;
+                        r |= check_throws("get_id", LightEdgeMismatch,
+                                          [&]() { e->get_id(); });
+                        r |= check_throws("get_property", PropertyNotFound,
+                                          [&]() { e->get_property("weight"); });
+                    }
+                    else if (e->is_light() || e->get_property("weight").int_value() != 3)
+                        r = 1;
+                }
+                tx.commit();
+            }
+
+            // Remove through an iterator, then whole nodes.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (EdgeIterator e = a->get_edges(Outgoing, "follows"); e; e.next())
+                    db.remove(*e);
+                db.remove(*c);
+                for (EdgeIterator e = hub->get_edges_to(*leaves[0]); e; e.next())
+                    db.remove(*e);
+                tx.commit();
+            }
+
+            {
+                Transaction tx(db);
+                r |= check("a follows after remove",
+                           count(a->get_edges(Outgoing, "follows")), 0);
+                r |= check("b edges after remove", count(b->get_edges()), 1);
+                r |= check("leaf 0 after remove", count(leaves[0]->get_edges()), 0);
+                r |= check("hub follows after remove",
+                           count(hub->get_edges(Outgoing, "follows")),
+                           2 * NUM_LEAVES - 2);
+                tx.commit();
+            }
+
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.remove(*hub);
+                tx.commit();
+            }
+        }
+
+        // The tag stays light across a reopen.
+        Graph db("lightedgegraph");
+        Transaction tx(db, Transaction::ReadWrite);
+        r |= check("leaf 1 after hub removal", count(leaves[1]->get_edges()), 0);
+        r |= check_throws("add_edge after reopen", LightEdgeMismatch,
+            [&]() { db.add_edge(*a, *b, "follows"); });
+        db.add_light_edge(*b, *a, "follows");
+        r |= check("a followers", count(a->get_edges(Incoming, "follows")), 1);
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
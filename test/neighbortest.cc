@@ -32,6 +32,7 @@
  */
 
 #include <stdio.h>
+#include <stdexcept>
 #include <vector>
 #include <algorithm>
 #include "pmgd.h"
@@ -170,6 +171,8 @@ int main(int argc, char **argv)
             {
                 static int test_id = 0;
                 test_id++;
+                // The intersection should give the same nodes in id order.
+                std::vector<int> expected = msgs;
                 NodeIterator ni = get_joint_neighbors(v);
                 for (; ni; ni.next()) {
                     int id = ni->get_property("id").int_value();
@@ -189,6 +192,14 @@ int main(int argc, char **argv)
                     fprintf(stderr, "\n");
                     r = 2;
                 }
+                std::sort(expected.begin(), expected.end());
+                std::vector<int> found;
+                for (NodeIterator ii = intersect_neighbors(v); ii; ii.next())
+                    found.push_back(ii->get_property("id").int_value());
+                if (found != expected) {
+                    fprintf(stderr, "neighbortest: failure 3-%d(c)\n", test_id);
+                    r = 2;
+                }
             };
 
         auto check_messages1 =
@@ -218,6 +229,10 @@ int main(int argc, char **argv)
         }
         catch (std::out_of_range) {
         }
+        if (intersect_neighbors({ })) {
+            fprintf(stderr, "neighbortest: intersect_neighbors with no constraints returned nodes\n");
+            r = 2;
+        }
 
         check_messages1(ann, bob, { 1, 2, 3 });
         check_messages2(ann, bob, { 1, 3 });
@@ -0,0 +1,111 @@
+/**
+ * @file   persisttest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Test for the persistence backends selected at open time: write
+ * the same data with each backend the processor supports, then
+ * reopen with the default backend and check it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const struct {
+    int option;
+    const char *name;
+} modes[] = {
+    { Graph::PersistMsync, "msync" },
+    { Graph::PersistClflush, "clflush" },
+    { Graph::PersistClflushopt, "clflushopt" },
+    { Graph::PersistClwb, "clwb" },
+    { Graph::PersistNTStore, "ntstore" },
+    { Graph::PersistNone, "none" },
+};
+
+static const int NUM_NODES = 100;
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf persistgraph") < 0)
+        return 1;
+
+    // Long enough to take the bulk copy path.
+    std::string blob(1000, 'x');
+
+    try {
+        for (auto &m : modes) {
+            try {
+                Graph db("persistgraph", Graph::Create | m.option);
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = 0; i < NUM_NODES; i++) {
+                    Node &n = db.add_node(m.name);
+                    n.set_property("id", i);
+                    n.set_property("blob", Property(Property::blob_t(blob.data(), blob.size())));
+                }
+                tx.commit();
+                printf("%s: ok\n", m.name);
+            }
+            catch (Exception e) {
+                if (e.num != InvalidConfig)
+                    throw;
+                printf("%s: not supported\n", m.name);
+            }
+        }
+
+        Graph db("persistgraph");
+        Transaction tx(db);
+        for (auto &m : modes) {
+            int n = 0;
+            for (NodeIterator i = db.get_nodes(m.name); i; i.next()) {
+                Property p = i->get_property("blob");
+                if (p.blob_value().size != blob.size()
+                        || memcmp(p.blob_value().value, blob.data(), blob.size()) != 0)
+                    return 1;
+                n++;
+            }
+            if (n != 0 && n != NUM_NODES)
+                return 1;
+        }
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    printf("Test passed\n");
+    return 0;
+}
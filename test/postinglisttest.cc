@@ -0,0 +1,212 @@
+/**
+ * @file   postinglisttest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+
+/*
+ * Test for the posting lists under property indexes: values shared
+ * by many nodes over several chunks, values with one node, removal
+ * while iterating, and reopening.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+// Enough nodes for several chunks of each posting list
+static const int NUM_NODES = 12000;
+static const int NUM_STATUS = 3;
+static const int BATCH = 100;
+
+static int check(const char *what, long long got, long long expected)
+{
+    if (got != expected) {
+        printf("%s: expected %lld, got %lld\n", what, expected, got);
+        return 1;
+    }
+    return 0;
+}
+
+// Counts the nodes with the status, checking they come in table
+// order and have the value.
+static int scan(Graph &db, long long status, long long expected)
+{
+    int r = 0;
+    long long n = 0;
+    NodeID last = 0;
+    PropertyPredicate pp("status", PropertyPredicate::Eq, status);
+    for (NodeIterator i = db.get_nodes("item", pp); i; i.next()) {
+        NodeID id = db.get_id(*i);
+        if (id <= last || i->get_property("status").int_value() != status)
+            r = 1;
+        last = id;
+        n++;
+    }
+    return r | check("status", n, expected);
+}
+
+int main(int argc, char **argv)
+{
+    // With -r, only reopen and check an existing graph.
+    bool create = !(argc > 1 && strcmp(argv[1], "-r") == 0);
+
+    if (create && system("rm -rf postinglistgraph") < 0)
+        return 1;
+
+    int r = 0;
+    long long counts[NUM_STATUS] = { 0 };
+    try {
+        if (create) {
+            Graph db("postinglistgraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "item", "status", PropertyType::Integer);
+                db.create_index(Graph::NodeIndex, "item", "uid", PropertyType::Integer);
+                tx.commit();
+            }
+            for (int b = 0; b < NUM_NODES; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = b; i < b + BATCH; i++) {
+                    Node &n = db.add_node("item");
+                    // Status 2 stays sparse enough for array chunks.
+                    long long status = i % 100 == 0 ? 2 : i % 2;
+                    n.set_property("status", status);
+                    n.set_property("uid", (long long)i);
+                }
+                tx.commit();
+            }
+
+            Transaction tx(db);
+            r |= scan(db, 0, NUM_NODES / 2 - NUM_NODES / 100);
+            r |= scan(db, 1, NUM_NODES / 2);
+            r |= scan(db, 2, NUM_NODES / 100);
+            long long n = 0;
+            for (NodeIterator i = db.get_nodes("item",
+                     PropertyPredicate("uid", PropertyPredicate::Eq, 4321LL));
+                 i; i.next())
+                n++;
+            r |= check("uid", n, 1);
+            tx.commit();
+
+            // A value with one member keeps it in the list itself. A
+            // second member moves both into chunks, and removing one
+            // moves the other back, also under an iterator.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                Node &a = *db.get_nodes("item",
+                              PropertyPredicate("uid", PropertyPredicate::Eq, 10LL));
+                Node &b = *db.get_nodes("item",
+                              PropertyPredicate("uid", PropertyPredicate::Eq, 9001LL));
+                a.set_property("status", 7LL);
+                r |= scan(db, 7, 1);
+                b.set_property("status", 7LL);
+                r |= scan(db, 7, 2);
+                long long seen = 0;
+                for (NodeIterator i = db.get_nodes("item",
+                         PropertyPredicate("status", PropertyPredicate::Eq, 7LL));
+                     i; i.next()) {
+                    if (&*i == &a)
+                        a.remove_property("status");
+                    seen++;
+                }
+                r |= check("one of two", seen, 2);
+                r |= scan(db, 7, 1);
+                b.set_property("status", 1LL);
+                r |= scan(db, 7, 0);
+                a.set_property("status", 0LL);
+                tx.commit();
+            }
+
+            // Moving the current node to another value leaves the
+            // iterator vacant until it moves on.
+            for (int b = 0; b < NUM_NODES / 4; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                {
+                    // The iterator must go before its transaction.
+                    NodeIterator i = db.get_nodes("item",
+                        PropertyPredicate("status", PropertyPredicate::Eq, 1LL));
+                    for (int k = 0; k < BATCH && i; k++) {
+                        i->set_property("status", 0LL);
+                        try {
+                            i->get_id();
+                            r = 1;
+                        }
+                        catch (Exception e) {
+                            if (e.num != VacantIterator)
+                                throw;
+                        }
+                        i.next();
+                    }
+                }
+                tx.commit();
+            }
+
+            // Emptying a value while iterating over a range moves the
+            // iterator on to the next value.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                long long seen = 0;
+                for (NodeIterator i = db.get_nodes("item",
+                         PropertyPredicate("status", PropertyPredicate::Ge, 1LL));
+                     i; i.next()) {
+                    if (i->get_property("status").int_value() == 2)
+                        i->remove_property("status");
+                    seen++;
+                }
+                r |= check("range", seen, NUM_NODES / 2 - NUM_NODES / 4
+                                          + NUM_NODES / 100);
+                tx.commit();
+            }
+        }
+
+        counts[0] = NUM_NODES / 2 - NUM_NODES / 100 + NUM_NODES / 4;
+        counts[1] = NUM_NODES / 2 - NUM_NODES / 4;
+        counts[2] = 0;
+
+        Graph db("postinglistgraph");
+        Transaction tx(db);
+        for (int s = 0; s < NUM_STATUS; s++)
+            r |= scan(db, s, counts[s]);
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
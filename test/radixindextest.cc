@@ -0,0 +1,278 @@
+/**
+ * @file   radixindextest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+
+/*
+ * Test for radix property indexes: queries on a radix index have to
+ * return what the same queries on an AVL index do, in the same order,
+ * with names that share prefixes of every length and a first byte
+ * that takes most of its values, so the nodes grow to full size.
+ * Prefix queries have to match on the radix, AVL and B+-tree
+ * indexes, on a hash index and on a property without an index, as
+ * values are added, removed and changed during iteration, and after
+ * reopening.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_NODES = 20000;
+static const int NUM_VALUES = 16000;
+static const int BATCH = 100;
+
+static long long value(int i) { return (i * 7919LL) % NUM_VALUES; }
+
+static std::string name(long long v)
+{
+    switch (v % 4) {
+        case 0: return "user" + std::to_string(v);
+        // Prefixes of the names above
+        case 1: return "user" + std::to_string(v / 10);
+        // Longer than a node prefix, after all but one first byte
+        case 2: return std::string(1, char(v % 255 + 1)) + "-long-name-"
+                    + std::to_string(v);
+        default: return "mail." + std::to_string(v % 100) + "@example.com";
+    }
+}
+
+// Negative values, and -0.0 for 0, which has to find 0.0 too
+static long long signed_value(long long v) { return v - NUM_VALUES / 2; }
+static double half(long long v) { return v == 0 ? -0.0 : signed_value(v) * 0.5; }
+
+static std::vector<NodeID> ids(Graph &db, const PropertyPredicate &pp,
+                               bool reverse = false)
+{
+    std::vector<NodeID> r;
+    for (NodeIterator i = db.get_nodes("item", pp, reverse); i; i.next())
+        r.push_back(db.get_id(*i));
+    return r;
+}
+
+static std::vector<NodeID> sorted(std::vector<NodeID> v)
+{
+    std::sort(v.begin(), v.end());
+    return v;
+}
+
+// Runs each query on the AVL properties and on the radix ones
+static int compare(Graph &db, const char *when)
+{
+    typedef PropertyPredicate PP;
+    int r = 0;
+    Transaction tx(db);
+    for (long long v = 0; v < 2 * NUM_VALUES; v += 97) {
+        std::vector<NodeID> a = ids(db, PP("a", PP::Eq, signed_value(v)));
+        if (a != ids(db, PP("ri", PP::Eq, signed_value(v)))
+                || a != ids(db, PP("ri", PP::Eq, signed_value(v)), true)
+                || ids(db, PP("f", PP::Eq, v == 0 ? 0.0 : half(v)))
+                       != ids(db, PP("rf", PP::Eq, v == 0 ? 0.0 : half(v)))
+                || ids(db, PP("s", PP::Eq, name(v)))
+                       != ids(db, PP("r", PP::Eq, name(v)))) {
+            printf("%s: value %lld differs\n", when, v);
+            r = 1;
+        }
+    }
+
+    // Ranges, in the same order both ways
+    std::vector<std::pair<PP, PP>> ranges = {
+        { PP("a", PP::GeLt, -500LL, 900LL), PP("ri", PP::GeLt, -500LL, 900LL) },
+        { PP("a", PP::Gt, 7000LL), PP("ri", PP::Gt, 7000LL) },
+        { PP("a", PP::Le, -7000LL), PP("ri", PP::Le, -7000LL) },
+        { PP("a", PP::Ne, 0LL), PP("ri", PP::Ne, 0LL) },
+        { PP("f", PP::GtLe, -10.0, 10.0), PP("rf", PP::GtLe, -10.0, 10.0) },
+        { PP("s", PP::Lt, "user5"), PP("r", PP::Lt, "user5") },
+        { PP("s", PP::GeLt, "mail.", "user2"), PP("r", PP::GeLt, "mail.", "user2") },
+        { PP("s", PP::Gt, "user123"), PP("r", PP::Gt, "user123") },
+        { PP("s", PP::GeLe, "user12", "user12"), PP("r", PP::GeLe, "user12", "user12") },
+    };
+    for (auto &q : ranges) {
+        if (ids(db, q.first) != ids(db, q.second)
+                || ids(db, q.first, true) != ids(db, q.second, true)) {
+            printf("%s: range query on %s differs\n", when,
+                   q.second.id.name().c_str());
+            r = 1;
+        }
+    }
+
+    std::vector<std::string> prefixes = {
+        "", "u", "user", "user1", "user12", "user123", "user99999",
+        "mail.4", "mail.42@", std::string(1, char(255)),
+        std::string(1, char(255)) + "-long", std::string(1, char(200)),
+        "zzz",
+    };
+    for (const std::string &p : prefixes) {
+        std::vector<NodeID> radix = ids(db, PP("r", PP::Prefix, p));
+        if (radix != ids(db, PP("s", PP::Prefix, p))
+                || radix != ids(db, PP("b", PP::Prefix, p))
+                || ids(db, PP("r", PP::Prefix, p), true)
+                       != ids(db, PP("b", PP::Prefix, p), true)
+                || sorted(radix) != sorted(ids(db, PP("h", PP::Prefix, p)))
+                || sorted(radix) != sorted(ids(db, PP("u", PP::Prefix, p)))) {
+            printf("%s: prefix '%s' differs\n", when, p.c_str());
+            r = 1;
+        }
+    }
+
+    for (auto &p : std::vector<std::pair<const char *, const char *>>
+                       { { "s", "r" }, { "a", "ri" }, { "f", "rf" } }) {
+        Graph::IndexStats x = db.get_index_stats(Graph::NodeIndex, "item", p.first);
+        Graph::IndexStats y = db.get_index_stats(Graph::NodeIndex, "item", p.second);
+        if (x.total_elements != y.total_elements
+                || x.total_unique_entries != y.total_unique_entries) {
+            printf("%s: stats for %s differ\n", when, p.second);
+            r = 1;
+        }
+    }
+    return r;
+}
+
+static void set(Node &n, long long v)
+{
+    n.set_property("a", signed_value(v));
+    n.set_property("ri", signed_value(v));
+    n.set_property("f", half(v));
+    n.set_property("rf", half(v));
+    for (const char *p : { "s", "b", "h", "r", "u" })
+        n.set_property(p, name(v));
+}
+
+static void clear(Node &n)
+{
+    for (const char *p : { "a", "ri", "f", "rf", "s", "b", "h", "r", "u" })
+        n.remove_property(p);
+}
+
+int main(int argc, char **argv)
+{
+    // With -r, only reopen and check an existing graph.
+    bool create = !(argc > 1 && strcmp(argv[1], "-r") == 0);
+
+    if (create && system("rm -rf radixindexgraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        if (create) {
+            Graph db("radixindexgraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "item", "a", PropertyType::Integer);
+                db.create_index(Graph::NodeIndex, "item", "ri", PropertyType::Integer,
+                                Graph::Radix);
+                db.create_index(Graph::NodeIndex, "item", "f", PropertyType::Float);
+                db.create_index(Graph::NodeIndex, "item", "rf", PropertyType::Float,
+                                Graph::Radix);
+                db.create_index(Graph::NodeIndex, "item", "s", PropertyType::String);
+                db.create_index(Graph::NodeIndex, "item", "b", PropertyType::String,
+                                Graph::BPlusTree);
+                db.create_index(Graph::NodeIndex, "item", "h", PropertyType::String,
+                                Graph::Hash);
+                db.create_index(Graph::NodeIndex, "item", "r", PropertyType::String,
+                                Graph::Radix);
+                tx.commit();
+            }
+            for (int b = 0; b < NUM_NODES; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = b; i < b + BATCH; i++)
+                    set(db.add_node("item"), value(i));
+                tx.commit();
+            }
+            r |= compare(db, "added");
+
+            // An aborted batch, with its new nodes, leaves nothing behind.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = 0; i < BATCH; i++)
+                    set(db.add_node("item"), NUM_VALUES + i * 97);
+            }
+            r |= compare(db, "aborted");
+
+            // Removing values under a radix iterator
+            for (const char *p : { "user123", "mail.37@", "\x90-" }) {
+                Transaction tx(db, Transaction::ReadWrite);
+                PropertyPredicate pp("r", PropertyPredicate::Prefix, p);
+                for (NodeIterator i = db.get_nodes("item", pp); i; i.next()) {
+                    clear(*i);
+                    try {
+                        i->get_id();
+                        r = 1;
+                    }
+                    catch (Exception e) {
+                        if (e.num != VacantIterator)
+                            throw;
+                    }
+                }
+                tx.commit();
+            }
+            // And all the values in a range, backwards
+            for (long long v = -NUM_VALUES / 2; v < -NUM_VALUES / 4; v += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                PropertyPredicate pp("ri", PropertyPredicate::GeLt, v, v + BATCH);
+                for (NodeIterator i = db.get_nodes("item", pp, true); i; i.next())
+                    clear(*i);
+                tx.commit();
+            }
+            r |= compare(db, "removed");
+
+            // Changing values to new ones under a radix iterator. The
+            // new names are all before the prefix.
+            for (const char *p : { "user98", "user87" }) {
+                Transaction tx(db, Transaction::ReadWrite);
+                PropertyPredicate pp("r", PropertyPredicate::Prefix, p);
+                for (NodeIterator i = db.get_nodes("item", pp); i; i.next())
+                    set(*i, i->get_property("a").int_value()
+                                + NUM_VALUES / 2 + NUM_VALUES);
+                tx.commit();
+            }
+            r |= compare(db, "changed");
+        }
+
+        Graph db("radixindexgraph");
+        r |= compare(db, "reopened");
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
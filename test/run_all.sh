@@ -82,7 +82,12 @@ tests=( alloctest allocaborttest avltest chunklisttest edgeindextest
         reverseindexrangetest rotest
         statsindextest statsallocatortest
         soltest stringtabletest txtest removetest
-        mtalloctest stripelocktest mtavltest mtaddfindremovetest
+        mtalloctest stripelocktest mtavltest mtaddfindremovetest elrtest snapshottest
+        deltatest warmuptest persisttest edgeremovetest supernodetest batchtest
+        hubappendtest lightedgetest edgeordertest bulkremovetest
+        tagindextest postinglisttest btreeindextest hashindextest
+        compositeindextest uniqueindextest indexbuildtest radixindextest
+        countindextest intersectindextest
         test720 test750 test767
         load_pmgd_tests
         BindingsTest DateTest )
@@ -96,7 +101,15 @@ graph_dirs=( fixedallocgraph varallocgraph avlgraph chunklistgraph edgeindexgrap
              statsindexgraph statsallocatorgraph
              reverseindexrangegraph rograph
              solgraph stringtablegraph txgraph removegraph
-             mtallocgraph mtaddfindremovegraph
+             mtallocgraph mtaddfindremovegraph elrgraph
+             snapshotgraph snapshotgraph.copy
+             deltagraph deltagraph.copy warmupgraph persistgraph
+             edgeremovegraph supernodegraph batchgraph hubappendgraph
+             lightedgegraph edgeordergraph bulkremovegraph
+             tagindexgraph postinglistgraph btreeindexgraph hashindexgraph
+             compositeindexgraph uniqueindexgraph indexbuildgraph
+             indexbuildjournalgraph
+             radixindexgraph countindexgraph intersectindexgraph
              test720graph test750graph test767graph
              bindingsgraph )
 
@@ -99,13 +99,15 @@ void test_total_bytes(Graph& db, bool& flag_success)
 
     printf("Stats tot_bytes2 id2\n");
     st = db.get_index_stats(Graph::NodeIndex, "tot_bytes2", "id2");
-    if (st.total_size_bytes != 1744){
+    if (st.total_size_bytes != 496){
         // Total size should be
-        // 16 + 64*2 + 100*16 = 1744
+        // 16 + 64*2 + 2*(40 + 136) = 496
         // sizeof(AvlTreeIndex) = 16
         // sizeof(TreeNode) = 64
         // 2 Keys
-        // 100 elements, each of 16
+        // 50 elements each, in one chunk of the posting list
+        // sizeof(chunk TreeNode) = 40
+        // sizeof(chunk) = 8 + 64*2 = 136
         printf("-----------> tot_bytes2: id2 index wrong size\n");
         flag_success = false;
     }
@@ -117,13 +119,16 @@ void test_total_bytes(Graph& db, bool& flag_success)
 
     printf("Stats tot_bytes3 id1\n");
     st = db.get_index_stats(Graph::NodeIndex, "tot_bytes3", "id1");
-    if (st.total_size_bytes != 52016){
+    if (st.total_size_bytes != 36576){
         // Total size should be
-        // 16 + 48*750 + 1000*16 = 52016
+        // 16 + 48*750 + 40 + 520 = 36576
         // sizeof(AvlTreeIndex) = 16
         // sizeof(TreeNode) = 48
         // 750 Keys
-        // 1000 elements, each of 16
+        // 749 keys with one element, kept in the posting list itself
+        // 250 elements for key 22, in one chunk of the posting list
+        // sizeof(chunk TreeNode) = 40
+        // sizeof(chunk) = 8 + 512 = 520, a bitmap
         printf("-----------> tot_bytes3: id1 index wrong size\n");
         flag_success = false;
     }
@@ -148,14 +153,14 @@ void test_string_remainder_case(Graph& db, bool& flag_success)
             // This string is 12 chars larger than
             // the prefix len in IndexString,
             // thus, the whole index should by
-            // 196 bytes.
+            // 156 bytes.
             n.set_property("id1", "justabitlongerstring");
         }
     }
 
     printf("Stats string id1\n");
     Graph::IndexStats st = db.get_index_stats(Graph::NodeIndex, "string", "id1");
-    if (st.total_size_bytes != 188){
+    if (st.total_size_bytes != 156){
         printf("-----------> string: id1 index wrong size\n");
         flag_success = false;
     }
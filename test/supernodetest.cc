@@ -0,0 +1,226 @@
+/**
+ * @file   supernodetest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+/*
+ * Test for edge lookup by neighbor, both on a node with few edges and
+ * on a hub whose adjacency is also kept keyed by neighbor.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include "pmgd.h"
+#include "util.h"
+#include "neighbor.h"
+
+using namespace PMGD;
+
+static const int NUM_LEAVES = 500;
+
+static long long count(EdgeIterator i)
+{
+    long long n = 0;
+    for (; i; i.next())
+        n++;
+    return n;
+}
+
+static int check(const Node &n, const Node &m, Direction dir, StringID tag,
+                 long long expected)
+{
+    long long c = count(n.get_edges_to(m, dir, tag));
+    if (c != expected) {
+        printf("expected %lld edges, got %lld\n", expected, c);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf supernodegraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        Graph db("supernodegraph", Graph::Create);
+
+        std::vector<Node *> leaves;
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            Node &hub = db.add_node("hub");
+            Node &small = db.add_node("small");
+            for (int i = 0; i < NUM_LEAVES; i++) {
+                Node &leaf = db.add_node("leaf");
+                leaves.push_back(&leaf);
+                db.add_edge(hub, leaf, "link");
+            }
+            // Parallel edges and edges both ways for a few leaves
+            for (int i = 0; i < NUM_LEAVES; i += 100) {
+                db.add_edge(hub, *leaves[i], "link");
+                db.add_edge(hub, *leaves[i], "other");
+                db.add_edge(*leaves[i], hub, "link");
+                db.add_edge(small, *leaves[i], "link");
+            }
+            db.add_edge(small, small, "self");
+            tx.commit();
+        }
+
+        {
+            Transaction tx(db);
+            Node &hub = *db.get_nodes("hub");
+            Node &small = *db.get_nodes("small");
+            Node &l0 = *leaves[0];
+            Node &l1 = *leaves[1];
+
+            r |= check(hub, l0, Outgoing, "link", 2);
+            r |= check(hub, l0, Outgoing, 0, 3);
+            r |= check(hub, l0, Incoming, "link", 1);
+            r |= check(hub, l0, Any, 0, 4);
+            r |= check(hub, l1, Outgoing, "link", 1);
+            r |= check(hub, l1, Incoming, 0, 0);
+            r |= check(hub, l1, Outgoing, "other", 0);
+            r |= check(l0, hub, Incoming, 0, 3);
+            r |= check(small, l0, Outgoing, "link", 1);
+            r |= check(small, l1, Any, 0, 0);
+            r |= check(small, hub, Any, 0, 0);
+            r |= check(small, small, Any, "self", 2);
+
+            // Sorted and deduplicated, from the tree for the hub and
+            // from the chunks for the small node
+            std::vector<Node *> out = hub.get_sorted_neighbors(Outgoing, "link");
+            std::vector<Node *> any = hub.get_sorted_neighbors();
+            std::vector<Node *> few = small.get_sorted_neighbors(Any, 0);
+            std::vector<Node *> sorted_leaves = leaves;
+            std::sort(sorted_leaves.begin(), sorted_leaves.end());
+            if (out != sorted_leaves || any != sorted_leaves
+                    || few.size() != NUM_LEAVES / 100 + 1
+                    || !std::is_sorted(few.begin(), few.end())) {
+                printf("sorted neighbors mismatch\n");
+                r = 1;
+            }
+
+            for (EdgeIterator e = hub.get_edges_to(l0, Outgoing, "link"); e; e.next())
+                if (e->get_source() != hub || e->get_destination() != l0
+                        || e->get_tag() != StringID("link"))
+                    r = 1;
+            tx.commit();
+        }
+
+        // Small buckets filled in neighbor order, in reverse order and
+        // out of order. The first two keep their pairs in order.
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            Node &hub = *db.get_nodes("hub");
+            Node &small = *db.get_nodes("small");
+            std::vector<Node *> few(leaves.begin() + 1, leaves.begin() + 41);
+            std::sort(few.begin(), few.end());
+            for (size_t i = 0; i < few.size(); i++) {
+                db.add_edge(small, *few[i], "up");
+                db.add_edge(small, *few[few.size() - 1 - i], "down");
+                db.add_edge(small, *few[i * 7 % few.size()], "mixed");
+            }
+            // Parallel edges fit in after the last neighbor or before
+            // the first.
+            db.add_edge(small, *few.back(), "up");
+            db.add_edge(small, *few.front(), "down");
+            for (const char *tag : { "up", "down", "mixed" }) {
+                std::vector<Node *> order;
+                for (EdgeIterator e = small.get_edges(Outgoing, tag); e; e.next())
+                    order.push_back(&e->get_destination());
+                if (strcmp(tag, "mixed") != 0
+                        && !std::is_sorted(order.begin(), order.end())) {
+                    printf("%s edges out of order\n", tag);
+                    r = 1;
+                }
+                if (small.get_sorted_neighbors(Outgoing, tag) != few) {
+                    printf("%s sorted neighbors mismatch\n", tag);
+                    r = 1;
+                }
+            }
+
+            // Long enough runs for the block merge, with a tail. The
+            // constraints name the direction at the result nodes.
+            std::vector<Node *> hub_out = hub.get_sorted_neighbors(Outgoing);
+            std::vector<Node *> small_out = small.get_sorted_neighbors(Outgoing);
+            std::vector<Node *> both, found;
+            std::set_intersection(hub_out.begin(), hub_out.end(),
+                                  small_out.begin(), small_out.end(),
+                                  std::back_inserter(both));
+            for (NodeIterator i = intersect_neighbors(
+                                      { JointNeighborConstraint{ Incoming, 0, hub },
+                                        JointNeighborConstraint{ Incoming, 0, small } });
+                     i; i.next())
+                found.push_back(&*i);
+            if (found != both || both.size() != few.size() + NUM_LEAVES / 100) {
+                printf("intersection mismatch\n");
+                r = 1;
+            }
+            tx.commit();
+        }
+
+        // Remove through the lookup iterator, then remove whole leaves.
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            Node &hub = *db.get_nodes("hub");
+            for (EdgeIterator e = hub.get_edges_to(*leaves[100], Any, 0); e; e.next())
+                db.remove(*e);
+            for (int i = 1; i < NUM_LEAVES; i += 2)
+                db.remove(*leaves[i]);
+            tx.commit();
+        }
+
+        {
+            Transaction tx(db);
+            Node &hub = *db.get_nodes("hub");
+            r |= check(hub, *leaves[100], Any, 0, 0);
+            r |= check(hub, *leaves[200], Any, 0, 4);
+            r |= check(hub, *leaves[2], Outgoing, "link", 1);
+            long long out = count(hub.get_edges(Outgoing, "link"));
+            if (out != NUM_LEAVES / 2 + 3) {
+                printf("expected %d out edges, got %lld\n", NUM_LEAVES / 2 + 3, out);
+                r = 1;
+            }
+            tx.commit();
+        }
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
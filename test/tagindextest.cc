@@ -0,0 +1,160 @@
+/**
+ * @file   tagindextest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+
+/*
+ * Test for the tag index: membership over several bitmap pages,
+ * table order, removal while iterating, and reopening.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+// Enough nodes for several pages of the tag bitmap
+static const int NUM_NODES = 10000;
+static const int BATCH = 100;
+
+static int check(const char *what, long long got, long long expected)
+{
+    if (got != expected) {
+        printf("%s: expected %lld, got %lld\n", what, expected, got);
+        return 1;
+    }
+    return 0;
+}
+
+// Counts the nodes of the tag, checking they come in table order
+// and all have the tag.
+static int scan(Graph &db, const char *tag, long long expected)
+{
+    int r = 0;
+    long long n = 0;
+    NodeID last = 0;
+    for (NodeIterator i = db.get_nodes(tag); i; i.next()) {
+        NodeID id = db.get_id(*i);
+        if (id <= last || i->get_tag() != tag)
+            r = 1;
+        last = id;
+        n++;
+    }
+    return r | check(tag, n, expected);
+}
+
+int main(int argc, char **argv)
+{
+    // With -r, only reopen and check an existing graph.
+    bool create = !(argc > 1 && strcmp(argv[1], "-r") == 0);
+
+    if (create && system("rm -rf tagindexgraph") < 0)
+        return 1;
+
+    int r = 0;
+    try {
+        if (create) {
+            Graph db("tagindexgraph", Graph::Create);
+            for (int b = 0; b < NUM_NODES; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int i = b; i < b + BATCH; i++) {
+                    Node &n = db.add_node(i % 2 == 0 ? "even" : "odd");
+                    if (i % 1000 == 0)
+                        db.add_edge(n, n, "self");
+                }
+                tx.commit();
+            }
+
+            Transaction tx(db);
+            r |= scan(db, "even", NUM_NODES / 2);
+            r |= scan(db, "odd", NUM_NODES / 2);
+            long long edges = 0;
+            for (EdgeIterator i = db.get_edges("self"); i; i.next())
+                edges++;
+            r |= check("self", edges, NUM_NODES / 1000);
+            Graph::IndexStats stats = db.get_index_stats(Graph::NodeIndex, "even");
+            r |= check("stats", stats.total_elements, NUM_NODES / 2);
+            tx.commit();
+
+            // Removing the current node leaves the iterator vacant
+            // until it moves on.
+            int removed = 0;
+            for (int b = 0; b < NUM_NODES / 2; b += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                NodeIterator i = db.get_nodes("odd");
+                for (int k = 0; k < b / 2 && i; k++)
+                    i.next();
+                for (int k = 0; k < BATCH / 2 && i; k++) {
+                    Node &n = *i;
+                    db.remove(n);
+                    removed++;
+                    try {
+                        i->get_tag();
+                        r = 1;
+                    }
+                    catch (Exception e) {
+                        if (e.num != VacantIterator)
+                            throw;
+                    }
+                    i.next();
+                }
+                tx.commit();
+            }
+            Transaction tx2(db);
+            r |= scan(db, "odd", NUM_NODES / 2 - removed);
+            tx2.commit();
+
+            // An aborted add leaves the tag as it was
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.add_node("odd");
+            }
+        }
+
+        Graph db("tagindexgraph");
+        Transaction tx(db);
+        r |= scan(db, "even", NUM_NODES / 2);
+        r |= scan(db, "odd", NUM_NODES / 2 - NUM_NODES / 4);
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
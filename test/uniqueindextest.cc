@@ -0,0 +1,329 @@
+/**
+ * @file   uniqueindextest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+
+
+
+/*
+ * Test for unique property indexes and get_or_add_node: a value
+ * taken by one node cannot be set on another, get_or_add_node adds
+ * a node only for a new value, also when several threads race to add
+ * the same values, and all this holds after an abort and a reopen.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_USERS = 2000;
+static const int NUM_THREADS = 4;
+static const int RACE_VALUES = 300;
+
+static std::string email(long long v)
+    { return "user" + std::to_string(v) + "@example.com"; }
+
+static size_t count(Graph &db, StringID tag, const PropertyPredicate &pp)
+{
+    size_t n = 0;
+    for (NodeIterator i = db.get_nodes(tag, pp); i; i.next())
+        n++;
+    return n;
+}
+
+template <typename F>
+static int check_throws(const char *what, int expected, F f)
+{
+    try {
+        f();
+    }
+    catch (Exception e) {
+        if (e.num == expected)
+            return 0;
+        print_exception(e);
+    }
+    printf("%s: expected exception %d\n", what, expected);
+    return 1;
+}
+
+// Each of uid, email and handle has one node per value
+static int check_users(Graph &db, const char *when, long long max)
+{
+    typedef PropertyPredicate PP;
+    int r = 0;
+    Transaction tx(db);
+    for (long long v = 0; v < max; v++) {
+        NodeIterator i = db.get_nodes("user", PP("uid", PP::Eq, v));
+        if (!i) {
+            printf("%s: no user %lld\n", when, v);
+            r = 1;
+            continue;
+        }
+        NodeID id = db.get_id(*i);
+        i.next();
+        NodeIterator e = db.get_nodes("user", PP("email", PP::Eq, email(v)));
+        NodeIterator h = db.get_nodes("user", PP("handle", PP::Eq, email(v)));
+        if (i || !e || db.get_id(*e) != id || !h || db.get_id(*h) != id
+                || count(db, "user", PP("email", PP::Eq, email(v))) != 1) {
+            printf("%s: user %lld is not unique\n", when, v);
+            r = 1;
+        }
+    }
+    if (count(db, "user", PP("uid")) != size_t(max)) {
+        printf("%s: %zu users, expected %lld\n", when,
+               count(db, "user", PP("uid")), max);
+        r = 1;
+    }
+    return r;
+}
+
+static void set_user(Node &n, long long v)
+{
+    n.set_property("email", email(v));
+    n.set_property("handle", email(v));
+}
+
+// Threads adding the same ids in the same order. The loser of a race
+// for a value times out on its lock and tries again.
+static void racer(Graph &db, int &added, int &r)
+{
+    for (long long v = 0; v < RACE_VALUES; v++) {
+        for (;;) {
+            try {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.get_or_add_node("peer", "pid", v,
+                                   [&added](Node &) { added++; });
+                tx.commit();
+                break;
+            }
+            catch (Exception e) {
+                if (e.num != LockTimeout) {
+                    print_exception(e);
+                    r = 1;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // With -r, only reopen and check an existing graph.
+    bool create = !(argc > 1 && strcmp(argv[1], "-r") == 0);
+
+    if (create && system("rm -rf uniqueindexgraph") < 0)
+        return 1;
+
+    typedef PropertyPredicate PP;
+    int r = 0;
+    try {
+        if (create) {
+            Graph db("uniqueindexgraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "user", "uid", PropertyType::Integer,
+                                Graph::BPlusTree, true);
+                db.create_index(Graph::NodeIndex, "user", "email", PropertyType::String,
+                                Graph::AvlIndex, true);
+                db.create_index(Graph::NodeIndex, "user", "handle", PropertyType::String,
+                                Graph::Hash, true);
+                db.create_index(Graph::NodeIndex, "user", "name", PropertyType::String);
+                // Creating it again does not make it unique.
+                db.create_index(Graph::NodeIndex, "user", "name", PropertyType::String,
+                                Graph::AvlIndex, true);
+                db.create_index(Graph::NodeIndex, 0, "ext", PropertyType::Integer,
+                                Graph::AvlIndex, true);
+                db.create_index(Graph::NodeIndex, "peer", "pid", PropertyType::Integer,
+                                Graph::AvlIndex, true);
+                tx.commit();
+            }
+
+            // New values add nodes, once.
+            int added = 0;
+            for (int pass = 0; pass < 2; pass++) {
+                for (long long b = 0; b < NUM_USERS; b += 100) {
+                    Transaction tx(db, Transaction::ReadWrite);
+                    for (long long v = b; v < b + 100; v++) {
+                        Node &n = db.get_or_add_node("user", "uid", v,
+                                      [&added, v](Node &n) {
+                                          set_user(n, v);
+                                          added++;
+                                      });
+                        if (n.get_property("uid").int_value() != v)
+                            r = 1;
+                    }
+                    tx.commit();
+                }
+            }
+            if (added != NUM_USERS) {
+                printf("added %d users, expected %d\n", added, NUM_USERS);
+                r = 1;
+            }
+            r |= check_users(db, "added", NUM_USERS);
+
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                Node &a = *db.get_nodes("user", PP("uid", PP::Eq, 1LL));
+                Node &b = *db.get_nodes("user", PP("uid", PP::Eq, 2LL));
+
+                // A taken value throws, and nothing changes.
+                r |= check_throws("uid", NotUnique,
+                    [&]() { b.set_property("uid", 1LL); });
+                r |= check_throws("email", NotUnique,
+                    [&]() { b.set_property("email", email(1)); });
+                r |= check_throws("handle", NotUnique,
+                    [&]() { b.set_property("handle", email(1)); });
+                if (b.get_property("uid").int_value() != 2
+                        || b.get_property("email").string_value() != email(2)
+                        || count(db, "user", PP("uid", PP::Eq, 2LL)) != 1
+                        || count(db, "user", PP("uid", PP::Eq, 1LL)) != 1) {
+                    printf("failed set changed the node\n");
+                    r = 1;
+                }
+
+                // Setting a node's own value again is fine, and so is
+                // a value that is free.
+                a.set_property("uid", 1LL);
+                a.set_property("email", email(1));
+                b.set_property("uid", (long long)NUM_USERS);
+                b.set_property("uid", 2LL);
+
+                // Not unique indexes take any number of nodes.
+                a.set_property("name", "same");
+                b.set_property("name", "same");
+                r |= check_throws("not unique", InvalidID,
+                    [&]() { db.get_or_add_node("user", "name", "same"); });
+                r |= check_throws("no index", InvalidID,
+                    [&]() { db.get_or_add_node("user", "age", 1LL); });
+                r |= check_throws("type", PropertyTypeMismatch,
+                    [&]() { db.get_or_add_node("user", "uid", "1"); });
+
+                // The index on tag 0 takes any tag, but only finds
+                // nodes with the tag asked for.
+                a.set_property("ext", 7LL);
+                r |= check_throws("ext", NotUnique, [&]() {
+                    db.add_node("other").set_property("ext", 7LL); });
+                r |= check_throws("ext with another tag", NotUnique,
+                    [&]() { db.get_or_add_node("other", "ext", 7LL); });
+                if (&db.get_or_add_node("user", "ext", 7LL) != &a
+                        || &db.get_or_add_node(0, "ext", 7LL) != &a
+                        || db.get_or_add_node("other", "ext", 8LL).get_tag()
+                               != StringID("other")) {
+                    printf("tag 0 index lookup failed\n");
+                    r = 1;
+                }
+                tx.commit();
+            }
+
+            // An aborted add leaves the value free.
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.get_or_add_node("user", "uid", (long long)NUM_USERS);
+            }
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                Node &n = db.get_or_add_node("user", "uid", (long long)NUM_USERS,
+                              [&added](Node &n) {
+                                  set_user(n, NUM_USERS);
+                                  added++;
+                              });
+                if (added != NUM_USERS + 1 || count(db, "user",
+                            PP("uid", PP::Eq, (long long)NUM_USERS)) != 1)
+                    r = 1;
+
+                // Removing a node frees its values.
+                db.remove(n);
+                db.add_node("user").set_property("email", email(NUM_USERS));
+                tx.commit();
+            }
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                Node &n = *db.get_nodes("user", PP("email", PP::Eq, email(NUM_USERS)));
+                db.remove(n);
+                tx.commit();
+            }
+            r |= check_users(db, "changed", NUM_USERS);
+
+            // Racing threads add each value once.
+            std::vector<int> adds(NUM_THREADS), errors(NUM_THREADS);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < NUM_THREADS; t++)
+                threads.push_back(std::thread(racer, std::ref(db),
+                                              std::ref(adds[t]),
+                                              std::ref(errors[t])));
+            int total = 0;
+            for (int t = 0; t < NUM_THREADS; t++) {
+                threads[t].join();
+                total += adds[t];
+                r |= errors[t];
+            }
+            {
+                Transaction tx(db);
+                for (long long v = 0; v < RACE_VALUES; v++)
+                    if (count(db, "peer", PP("pid", PP::Eq, v)) != 1) {
+                        printf("race: %lld not unique\n", v);
+                        r = 1;
+                    }
+                if (total != RACE_VALUES || count(db, "peer", PP("pid")) != RACE_VALUES) {
+                    printf("race: added %d peers\n", total);
+                    r = 1;
+                }
+            }
+        }
+
+        Graph db("uniqueindexgraph");
+        r |= check_users(db, "reopened", NUM_USERS);
+        {
+            Transaction tx(db, Transaction::ReadWrite);
+            Node &b = *db.get_nodes("user", PP("uid", PP::Eq, 2LL));
+            r |= check_throws("reopened uid", NotUnique,
+                [&]() { b.set_property("uid", 1LL); });
+            if (db.get_id(db.get_or_add_node("user", "uid", 5LL))
+                    != db.get_id(*db.get_nodes("user", PP("uid", PP::Eq, 5LL))))
+                r = 1;
+            tx.commit();
+        }
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    if (r == 0)
+        printf("Test passed\n");
+    return r;
+}
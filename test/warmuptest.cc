@@ -0,0 +1,103 @@
+/**
+ * @file   warmuptest.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Test for the open-time warm-up options: reopen a populated graph
+ * with Prefetch and WarmUp, both reading while the background thread
+ * runs and closing before it is likely to finish.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+static const int NUM_NODES = 10000;
+static const int BATCH = 500;
+
+static long long count(NodeIterator i)
+{
+    long long n = 0;
+    for (; i; i.next())
+        n++;
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    if (system("rm -rf warmupgraph") < 0)
+        return 1;
+
+    try {
+        {
+            Graph db("warmupgraph", Graph::Create);
+            {
+                Transaction tx(db, Transaction::ReadWrite);
+                db.create_index(Graph::NodeIndex, "item", "id", PropertyType::Integer);
+                tx.commit();
+            }
+            Node *prev = NULL;
+            for (int i = 0; i < NUM_NODES; i += BATCH) {
+                Transaction tx(db, Transaction::ReadWrite);
+                for (int j = i; j < i + BATCH; j++) {
+                    Node &n = db.add_node("item");
+                    n.set_property("id", j);
+                    if (prev != NULL)
+                        db.add_edge(*prev, n, "next");
+                    prev = &n;
+                }
+                tx.commit();
+            }
+        }
+
+        // Close right away, with the warm-up thread still running.
+        {
+            Graph db("warmupgraph", Graph::WarmUp);
+        }
+
+        Graph db("warmupgraph", Graph::ReadOnly | Graph::Prefetch | Graph::WarmUp);
+        Transaction tx(db);
+        long long n = count(db.get_nodes("item",
+                                 PropertyPredicate("id", PropertyPredicate::Ge, 5000)));
+        printf("nodes %lld\n", n);
+        if (n != NUM_NODES - 5000)
+            return 1;
+        tx.commit();
+    }
+    catch (Exception e) {
+        print_exception(e);
+        return 1;
+    }
+
+    printf("Test passed\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file   deltagraph.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/**
+ * Export or apply incremental backups of a graphstore
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+void print_usage(FILE *stream);
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-h") == 0) {
+        print_usage(stdout);
+        return 0;
+    }
+
+    if (argc < 4) {
+        fprintf(stderr, "deltagraph: Missing arguments\n");
+        print_usage(stderr);
+        return 1;
+    }
+
+    const char *db_name = argv[2];
+
+    try {
+        if (strcmp(argv[1], "export") == 0) {
+            if (argc != 4) {
+                fprintf(stderr, "deltagraph: Export takes one delta file\n");
+                return 1;
+            }
+            Graph db(db_name, Graph::ReadWrite);
+            db.export_delta(argv[3]);
+        }
+        else if (strcmp(argv[1], "apply") == 0) {
+            for (int i = 3; i < argc; i++)
+                Graph::apply_delta(db_name, argv[i]);
+        }
+        else {
+            fprintf(stderr, "deltagraph: %s: Unrecognized command\n", argv[1]);
+            print_usage(stderr);
+            return 1;
+        }
+    }
+    catch (Exception e) {
+        print_exception(e, stderr);
+        return 1;
+    }
+
+    return 0;
+}
+
+void print_usage(FILE *stream)
+{
+    fprintf(stream, "Usage: deltagraph export GRAPHSTORE DELTA\n");
+    fprintf(stream, "       deltagraph apply COPY DELTA...\n");
+    fprintf(stream, "\n");
+    fprintf(stream, "export writes the pages of GRAPHSTORE changed since its last snapshot\n");
+    fprintf(stream, "or export to DELTA. GRAPHSTORE must have been created or opened with\n");
+    fprintf(stream, "dirty page tracking, and must not be open in another process.\n");
+    fprintf(stream, "\n");
+    fprintf(stream, "apply brings COPY, a snapshot made with snapgraph or Graph::snapshot,\n");
+    fprintf(stream, "forward by applying each DELTA in turn. Deltas must be given in the\n");
+    fprintf(stream, "order they were exported.\n");
+    fprintf(stream, "\n");
+    fprintf(stream, "  -h  print this help and exit\n");
+}
@@ -84,7 +84,14 @@ int main(int argc, char **argv)
 
     // Graph configuration options
     Graph::Config config;
-    while (argi + 1 < argc) {
+    while (argi < argc) {
+        if (check_arg(argv[argi], 'T', "track-dirty-pages")) {
+            config.track_dirty_pages = true;
+            argi += 1;
+            continue;
+        }
+        if (argi + 1 >= argc)
+            break;
         if (check_arg(argv[argi], 'R', "region-size"))
             config.default_region_size = strtoull(argv[argi+1], 0, 16);
         else if (check_arg(argv[argi], 'N', "node-table-size"))
@@ -308,6 +315,10 @@ void print_usage(FILE *stream)
 "          Set the default value of object/area covered by one lock\n"
 "          This is used whenever other values are not specified.\n"
 "\n"
+"  -T, --track-dirty-pages\n"
+"          Keep a record of the pages changed since the last snapshot or\n"
+"          delta export, so deltagraph can export incremental backups.\n"
+"\n"
 "  -l, --locale LOCALE-NAME\n"
 "          Set the name of the locale to be used for ordering strings in\n"
 "          indices. The locale must be available each time the graph is\n"
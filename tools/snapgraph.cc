@@ -0,0 +1,97 @@
+/**
+ * @file   snapgraph.cc
+ *
+ * @section LICENSE
+ *
+ * The MIT License
+ *
+ * @copyright Copyright (c) 2017 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/**
+ * Copy a graphstore to a new directory
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include "pmgd.h"
+#include "util.h"
+
+using namespace PMGD;
+
+void print_usage(FILE *stream);
+
+int main(int argc, char **argv)
+{
+    bool recover = false;
+    int argi = 1;
+
+    while (argi < argc && argv[argi][0] == '-') {
+        switch (argv[argi][1]) {
+            case 'h':
+                print_usage(stdout);
+                return 0;
+
+            case 'r':
+                recover = true;
+                break;
+
+            default:
+                fprintf(stderr, "snapgraph: %s: Unrecognized option\n", argv[argi]);
+                print_usage(stderr);
+                return 1;
+        }
+        argi++;
+    }
+
+    if (!(argi + 1 < argc)) {
+        fprintf(stderr, "snapgraph: No graphstore or destination specified\n");
+        print_usage(stderr);
+        return 1;
+    }
+
+    const char *db_name = argv[argi];
+    const char *dest_name = argv[argi + 1];
+
+    try {
+        Graph db(db_name, recover ? Graph::ReadWrite : Graph::ReadOnly);
+        db.snapshot(dest_name);
+    }
+    catch (Exception e) {
+        print_exception(e, stderr);
+        return 1;
+    }
+
+    return 0;
+}
+
+void print_usage(FILE *stream)
+{
+    fprintf(stream, "Usage: snapgraph [OPTION]... GRAPHSTORE DESTINATION\n");
+    fprintf(stream, "Copy GRAPHSTORE to the directory DESTINATION, using reflinks where\n");
+    fprintf(stream, "the file system supports them and keeping the region files sparse.\n");
+    fprintf(stream, "GRAPHSTORE must not be open in another process; applications take\n");
+    fprintf(stream, "online snapshots with Graph::snapshot.\n");
+    fprintf(stream, "\n");
+    fprintf(stream, "  -h  print this help and exit\n");
+    fprintf(stream, "  -r  open the graph read/write, so recovery can be performed if necessary\n");
+}
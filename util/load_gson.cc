@@ -81,15 +81,7 @@ public:
 static Node *get_node(Graph &db, long long id, PMGD::StringID tag,
                         std::function<void(Node &)> node_func)
 {
-    NodeIterator nodes = db.get_nodes(0,
-            PropertyPredicate(ID, PropertyPredicate::Eq, id));
-    if (nodes) return &*nodes;
-
-    Node &node = db.add_node(tag);
-    node.set_property(ID, id);
-    if (node_func)
-        node_func(node);
-    return &node;
+    return &db.get_or_add_node(tag, ID, id, node_func);
 }
 
 static Edge *get_edge(Graph &db, long long id,
@@ -258,7 +250,8 @@ static void load_gson(Graph &db,
     }
     Transaction tx(db, Transaction::ReadWrite);
     ID = StringID(ID_STR);
-    db.create_index(Graph::NodeIndex, 0, ID_STR, PropertyType::Integer);
+    db.create_index(Graph::NodeIndex, 0, ID_STR, PropertyType::Integer,
+                    Graph::AvlIndex, true);
     db.create_index(Graph::EdgeIndex, 0, ID_STR, PropertyType::Integer);
     tx.commit();
     load_nodes(db, jnodes, node_func, edge_func);
@@ -57,7 +57,8 @@ void load_tsv(Graph &db, FILE *f,
     char buf[500];
 
     Transaction tx(db, Transaction::ReadWrite);
-    db.create_index(Graph::NodeIndex, 0, ID_STR, PropertyType::Integer);
+    db.create_index(Graph::NodeIndex, 0, ID_STR, PropertyType::Integer,
+                    Graph::AvlIndex, true);
     tx.commit();
 
     while (fgets(buf, sizeof buf, f) != NULL) {
@@ -78,16 +79,7 @@ void load_tsv(Graph &db, FILE *f,
 static Node &get_node(Graph &db, long long id,
                       std::function<void(Node &)> node_func)
 {
-    NodeIterator nodes = db.get_nodes(0,
-                             PropertyPredicate(ID_STR, PropertyPredicate::Eq, id));
-    if (nodes) return *nodes;
-
-    // Node not found; add it
-    Node &node = db.add_node(0);
-    node.set_property(ID_STR, id);
-    if (node_func)
-        node_func(node);
-    return node;
+    return db.get_or_add_node(0, ID_STR, id, node_func);
 }
 
 void do_nothing_node(PMGD::Node &) { }
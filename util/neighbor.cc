@@ -28,11 +28,13 @@
  */
 
 #include <utility>
+#include <algorithm>
 #include <vector>
 #include <set>
 #include <unordered_set>
 #include <queue>
 #include <deque>
+#include <emmintrin.h>
 #include "pmgd.h"
 #include "neighbor.h"
 
@@ -59,6 +61,20 @@ static Node *get_neighbor(const Node &n, const EdgeRef &e, const Direction &dir)
 }
 
 
+// Constraint directions are as seen from the neighbor, so flip them
+// to go from the constraint node to its neighbors.
+static Direction fix_direction(Direction dir)
+{
+    switch (dir) {
+        case Any: return Any;
+        case Incoming: return Outgoing;
+        case Outgoing: return Incoming;
+    }
+    assert(0);
+    return Any;
+}
+
+
 /**
  * Iterator for the neighbors of a node
  */
@@ -154,17 +170,6 @@ class JointNeighborIteratorImpl : public NodeIteratorImplIntf
         return false;
     }
 
-    static Direction fix_direction(Direction dir)
-    {
-        switch (dir) {
-            case Any: return Any;
-            case Incoming: return Outgoing;
-            case Outgoing: return Incoming;
-        }
-        assert(0);
-        return Any;
-    }
-
 public:
     JointNeighborIteratorImpl
         (const std::vector<JointNeighborConstraint> &constraints, bool unique)
@@ -189,6 +194,129 @@ public:
 };
 
 
+/**
+ * Iterator for the result of intersect_neighbors
+ */
+class IntersectionIteratorImpl : public NodeIteratorImplIntf
+{
+    typedef std::vector<JointNeighborConstraint> V;
+    typedef std::vector<Node *> Run;
+
+    Run _result;
+    size_t _pos;
+
+    // Returns the first index at or after lo whose node is not less
+    // than n, probing 1, 2, 4, ... ahead before a binary search.
+    static size_t gallop(const Run &run, size_t lo, Node *n)
+    {
+        size_t step = 1;
+        size_t hi = lo;
+        while (hi < run.size() && run[hi] < n) {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        if (hi > run.size())
+            hi = run.size();
+        return std::lower_bound(run.begin() + lo, run.begin() + hi, n)
+                   - run.begin();
+    }
+
+    // Past this many nodes in the two runs the merge waits on memory,
+    // and the block compare measured slower than the scalar loop.
+    static const size_t BLOCK_MERGE_MAX = 16384;
+
+    // Node pointers equal in both 32-bit halves of a 64-bit lane
+    static __m128i equal64(__m128i a, __m128i b)
+    {
+        __m128i eq = _mm_cmpeq_epi32(a, b);
+        return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+    }
+
+    // Merges two nodes of _result against two of run at a time, both
+    // being sorted without repeats, and moves on the pair with the
+    // smaller last node. Stops when either has fewer than two left,
+    // with i and j where the scalar merge takes over. A match of the
+    // second node means its pair moves on, so the stores at out never
+    // overwrite a pair that is read again.
+    void block_merge(const Run &run, size_t &i, size_t &j, size_t &out)
+    {
+        while (i + 2 <= _result.size() && j + 2 <= run.size()) {
+            __m128i a = _mm_loadu_si128((const __m128i *)&_result[i]);
+            __m128i b = _mm_loadu_si128((const __m128i *)&run[j]);
+            __m128i b_swapped = _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2));
+            int match = _mm_movemask_pd(_mm_castsi128_pd(
+                            _mm_or_si128(equal64(a, b), equal64(a, b_swapped))));
+            Node *a1 = _result[i + 1];
+            Node *b1 = run[j + 1];
+            if (match & 1)
+                _result[out++] = _result[i];
+            if (match & 2)
+                _result[out++] = a1;
+            i += 2 * (a1 <= b1);
+            j += 2 * (b1 <= a1);
+        }
+    }
+
+    // Keeps the nodes of _result that are also in run.
+    void intersect(const Run &run)
+    {
+        size_t out = 0;
+        size_t j = 0;
+        if (run.size() / 32 > _result.size()) {
+            for (size_t i = 0; i < _result.size() && j < run.size(); i++) {
+                j = gallop(run, j, _result[i]);
+                if (j < run.size() && run[j] == _result[i])
+                    _result[out++] = _result[i];
+            }
+        }
+        else {
+            size_t i = 0;
+            if (_result.size() + run.size() <= BLOCK_MERGE_MAX)
+                block_merge(run, i, j, out);
+            while (i < _result.size() && j < run.size()) {
+                Node *a = _result[i];
+                Node *b = run[j];
+                if (a == b)
+                    _result[out++] = a;
+                i += (a <= b);
+                j += (b <= a);
+            }
+        }
+        _result.resize(out);
+    }
+
+public:
+    IntersectionIteratorImpl(const V &constraints)
+        : _pos(0)
+    {
+        std::vector<Run> runs;
+        for (const JointNeighborConstraint &c : constraints)
+            runs.push_back(c.node.get_sorted_neighbors(
+                               fix_direction(c.edge_constraint.dir),
+                               c.edge_constraint.tag));
+        // No constraints give no nodes.
+        if (runs.empty())
+            return;
+        std::sort(runs.begin(), runs.end(),
+                  [](const Run &a, const Run &b) { return a.size() < b.size(); });
+        _result = std::move(runs[0]);
+        for (size_t i = 1; i < runs.size() && !_result.empty(); i++)
+            intersect(runs[i]);
+    }
+
+    operator bool() const { return _pos < _result.size(); }
+
+    bool next()
+    {
+        _pos++;
+        return operator bool();
+    }
+
+    Node *ref() { return _result[_pos]; }
+};
+
+
 class NeighborhoodIteratorImpl : public NodeIteratorImplIntf
 {
 public:
@@ -418,6 +546,12 @@ NodeIterator get_joint_neighbors
     return NodeIterator(new JointNeighborIteratorImpl(constraints, unique));
 }
 
+NodeIterator intersect_neighbors
+    (const std::vector<JointNeighborConstraint> &constraints)
+{
+    return NodeIterator(new IntersectionIteratorImpl(constraints));
+}
+
 
 NeighborhoodIterator get_neighborhood
     (const Node &node,
@@ -46,6 +46,13 @@
  *     list, and is connected by an edge satisfying the edge constraint
  *     for that node.
  *
+ * intersect_neighbors returns the same nodes as get_joint_neighbors,
+ *     in node id order and without duplicates. It intersects the
+ *     sorted neighbor lists of the constraint nodes, smallest first,
+ *     galloping through lists much larger than the running result.
+ *     An empty constraint list gives no nodes, where get_joint_neighbors
+ *     throws std::out_of_range.
+ *
  * The 'unique' parameter indicates whether the function should track
  * all nodes returned and avoid returning duplicates. If the graph is
  * known to be organized in such a way that no duplicates could occur,
@@ -96,6 +103,9 @@ extern PMGD::NodeIterator get_joint_neighbors
     (const std::vector<JointNeighborConstraint> &constraints,
      bool unique = true);
 
+extern PMGD::NodeIterator intersect_neighbors
+    (const std::vector<JointNeighborConstraint> &constraints);
+
 extern NeighborhoodIterator get_neighborhood
     (const PMGD::Node &node,
      const std::vector<EdgeConstraint> &constraints,